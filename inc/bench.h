@@ -0,0 +1,129 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Storage benchmark: runs a fixed list of sequential and random, read and
+ * write workloads (512 bytes to 1 MB transfers) against a storage target and
+ * reports the throughput, the IOPS and the latency percentiles.
+ *
+ * \section Usage
+ *
+ * -# Initialize the benchmark with Bench_Initialize(), giving the free
+ *    running cycle counter used for the timing and the transfer buffer.
+ * -# Describe each target with a BenchTarget: an I/O function working on
+ *    byte offsets inside a test area of dwCapacity bytes, and an optional
+ *    sync function called at the end of the write workloads.
+ * -# Run the workloads of gBenchWorkloads[] with Bench_Run() and print the
+ *    results with Bench_PrintHeader() / Bench_PrintResult().
+ *
+ * The benchmark does not access any peripheral and the random offsets come
+ * from a fixed seed, so the same workloads build and run on a host against
+ * a simulated target and the figures can be compared directly.
+ */
+
+#ifndef _BENCH_
+#define _BENCH_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Maximum number of transfers of a workload (one latency sample each) */
+#define BENCH_MAXOPS            1024
+
+/** Workload directions */
+#define BENCH_READ              0
+#define BENCH_WRITE             1
+
+/** Workload access patterns */
+#define BENCH_SEQUENTIAL        0
+#define BENCH_RANDOM            1
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Free running cycle counter */
+typedef uint32_t (*BenchClockFunc)( void ) ;
+
+/** Transfer of dwSize bytes at dwOffset inside the test area, returns 0 if successful */
+typedef uint32_t (*BenchIoFunc)( void* pArg, uint32_t dwOffset, uint8_t* pBuffer, uint32_t dwSize, uint8_t bWrite ) ;
+
+/** Commits the written data, returns 0 if successful */
+typedef uint32_t (*BenchSyncFunc)( void* pArg ) ;
+
+/** Workload */
+typedef struct _BenchWorkload
+{
+    /** Name printed in the report */
+    const char* pName ;
+    /** BENCH_READ or BENCH_WRITE */
+    uint8_t bWrite ;
+    /** BENCH_SEQUENTIAL or BENCH_RANDOM */
+    uint8_t bRandom ;
+    uint16_t wReserved ;
+    /** Transfer size in bytes */
+    uint32_t dwSize ;
+    /** Number of transfers (at most BENCH_MAXOPS) */
+    uint32_t dwCount ;
+} BenchWorkload ;
+
+/** Storage target */
+typedef struct _BenchTarget
+{
+    /** Name printed in the report */
+    const char* pName ;
+    /** Transfer function */
+    BenchIoFunc fIo ;
+    /** Sync function, can be 0 */
+    BenchSyncFunc fSync ;
+    /** Argument of the functions */
+    void* pArg ;
+    /** Size of the test area in bytes */
+    uint32_t dwCapacity ;
+} BenchTarget ;
+
+/** Result of a workload, times in microseconds */
+typedef struct _BenchResult
+{
+    /** Bytes transferred */
+    uint32_t dwBytes ;
+    /** Transfers done */
+    uint32_t dwOps ;
+    /** Total time, including the final sync */
+    uint32_t dwTotalUs ;
+    /** Latency percentiles */
+    uint32_t dwP50Us ;
+    uint32_t dwP90Us ;
+    uint32_t dwP99Us ;
+    uint32_t dwMaxUs ;
+} BenchResult ;
+
+/*----------------------------------------------------------------------------
+ *        Exported variables
+ *----------------------------------------------------------------------------*/
+
+extern const BenchWorkload gBenchWorkloads[] ;
+
+extern const uint32_t gdwBenchNumWorkloads ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern void Bench_Initialize( BenchClockFunc fClock, uint32_t dwCyclesPerUs, uint8_t* pBuffer, uint32_t dwBufferSize ) ;
+
+extern uint32_t Bench_Run( const BenchTarget* pTarget, const BenchWorkload* pWorkload, BenchResult* pResult ) ;
+
+extern void Bench_PrintHeader( void ) ;
+
+extern void Bench_PrintResult( const BenchTarget* pTarget, const BenchWorkload* pWorkload, const BenchResult* pResult ) ;
+
+#endif /* #ifndef _BENCH_ */
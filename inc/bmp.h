@@ -0,0 +1,127 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !Purpose
+///
+/// Decoding of BMP images (uncompressed 24-bit, 8-bit palette and RLE8).
+///
+/// !Usage
+///
+/// -# BMP_Decode() converts a BMP file held in memory into a 24-bit buffer.
+/// -# BMP_DrawStream() reads a BMP file through a read function, one chunk
+///    at a time, and draws it on the LCD row by row in RGB565; no staging
+///    buffer for the image is needed.
+//------------------------------------------------------------------------------
+
+#ifndef BMP_H
+#define BMP_H
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// BMP magic number ('BM').
+#define BMP_TYPE            0x4D42
+
+/// Size of the BITMAPINFOHEADER header
+#define BITMAPINFOHEADER    40
+
+/// Compression methods
+#define BMP_RGB             0
+#define BMP_RLE8            1
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// BMP file header (BITMAPFILEHEADER followed by BITMAPINFOHEADER)
+//------------------------------------------------------------------------------
+typedef struct _BMPHeader
+{
+    /// Signature, must be BMP_TYPE
+    uint16_t type;
+    /// Size of the file in bytes
+    uint32_t fileSize;
+    uint16_t reserved1;
+    uint16_t reserved2;
+    /// Offset of the image data from the start of the file
+    uint32_t offset;
+    /// Size of the info header
+    uint32_t headerSize;
+    /// Image width in pixels
+    uint32_t width;
+    /// Image height in pixels, negative for a top-down image
+    uint32_t height;
+    /// Number of color planes (1)
+    uint16_t planes;
+    /// Bits per pixel
+    uint16_t bits;
+    /// Compression method (BMP_RGB or BMP_RLE8)
+    uint32_t compression;
+    /// Size of the image data in bytes
+    uint32_t imageSize;
+    uint32_t xresolution;
+    uint32_t yresolution;
+    /// Number of palette entries (0 means 2^bits)
+    uint32_t ncolours;
+    uint32_t importantcolours;
+} __attribute__ ((packed)) BMPHeader;
+
+/// Reads up to dwSize bytes of the file, returns the number of bytes read
+typedef uint32_t (*BmpReadFunc)( void* pArg, uint8_t* pBuffer, uint32_t dwSize );
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+extern uint8_t BMP_IsValid( void *file );
+
+extern uint32_t BMP_GetFileSize( void *file );
+
+extern void WriteBMPheader( uint32_t* pAddressHeader, uint32_t bmpHSize, uint32_t bmpVSize, uint8_t nbByte_Pixels );
+
+extern void BMP_displayHeader( uint32_t* pAddressHeader );
+
+extern uint8_t BMP_Decode( void *file, uint8_t *buffer, uint32_t width, uint32_t height, uint8_t bpp );
+
+extern uint8_t BMP_DrawStream( BmpReadFunc fRead, void* pArg, uint32_t dwX, uint32_t dwY );
+
+extern void RGB565toBGR555( uint8_t *fileSource, uint8_t *fileDestination, uint32_t width, uint32_t height, uint8_t bpp );
+
+#endif //#ifndef BMP_H
@@ -76,10 +76,15 @@
 
 #include "chip.h"
 
+#include "bench.h"
+#include "bmp.h"
 #include "board_lowlevel.h"
 #include "board_memories.h"
 #include "clock.h"
 #include "dmacd.h"
+#include "dma_mem.h"
+#include "download.h"
+#include "emac_phy.h"
 #include "hamming.h"
 #include "hx8347.h"
 #include "frame_buffer.h"
@@ -92,6 +97,10 @@
 #include "lcd_gimp_image.h"
 #include "led.h"
 #include "math.h"
+#include "netboot.h"
+#include "prof.h"
+#include "sched.h"
+#include "spid.h"
 #include "timetick.h"
 #include "uart_console.h"
 
@@ -248,6 +257,13 @@
 
 /// Dma channel number
 #define BOARD_MCI_DMA_CHANNEL                         0
+/// Dma channel used by the memory copy/fill service
+#define BOARD_MEM_DMA_CHANNEL                         1
+/// Dma channel streaming pixels to the LCD
+#define BOARD_LCD_DMA_CHANNEL                         2
+/// Dma channels of the SPI command driver (32-byte FIFO on the receive one)
+#define BOARD_SPI_DMA_RX_CHANNEL                      3
+#define BOARD_SPI_DMA_TX_CHANNEL                      4
 
 
 /** Rtc */
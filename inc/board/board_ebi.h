@@ -11,6 +11,7 @@
  * - \ref PIN_EBI_PSRAM_NBS
  * - \ref PIN_EBI_A1
  * - \ref PIN_EBI_NCS1
+ * - \ref PIN_EBI_NCS3
  * - \ref PIN_EBI_LCD_RS
  *
  */
@@ -30,6 +31,8 @@
 #define PIN_EBI_NCS1                {PIO_PA7B_NCS1, PIOA, ID_PIOA, PIO_PERIPH_B, PIO_PULLUP}
 /** EBI NCS2 pin */
 #define PIN_EBI_NCS2                {PIO_PB24B_NCS2, PIOB, ID_PIOB, PIO_PERIPH_B, PIO_PULLUP}
+/** EBI NCS3 pin */
+#define PIN_EBI_NCS3                {PIO_PB27A_NCS3, PIOB, ID_PIOB, PIO_PERIPH_A, PIO_PULLUP}
 /** EBI pins for PSRAM address bus */
 #define PIN_EBI_PSRAM_ADDR_BUS      {0x3f00fff, PIOC, ID_PIOC, PIO_PERIPH_A, PIO_PULLUP}
 /** EBI pins for PSRAM NBS pins */
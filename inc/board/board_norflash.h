@@ -5,6 +5,9 @@
  * \section NorFlash
  * - \ref BOARD_NORFLASH_ADDR
  * - \ref BOARD_NORFLASH_DFT_BUS_SIZE
+ * - \ref BOARD_NORFLASH_MAX_SIZE
+ * - \ref BOARD_NORFLASH_XIP_SIZE
+ * - \ref PINS_NORFLASH
  *
  */
 
@@ -15,6 +18,12 @@
 #define BOARD_NORFLASH_ADDR     0x63000000
 /** Default NOR bus size after power up reset */
 #define BOARD_NORFLASH_DFT_BUS_SIZE 8
+/** Size of the NCS3 window, the largest norflash that can be mapped */
+#define BOARD_NORFLASH_MAX_SIZE (16 * 1024 * 1024)
+/** Partition at the start of the norflash holding the XIP kernel, the FAT volume follows */
+#define BOARD_NORFLASH_XIP_SIZE (4 * 1024 * 1024)
+/** Norflash control pins; the data and address buses are set up with the SDRAM */
+#define PINS_NORFLASH           PIN_EBI_NRD, PIN_EBI_NWE, PIN_EBI_NCS3
 
 
 #endif /* _BOARD_NORFLASH_ */
@@ -54,4 +54,19 @@
 /**  SDRAM bus width */
 #define BOARD_SDRAM_BUSWIDTH    16
 
+// ----------------------------------------------------------------------------------------------------------
+// SDRAM map
+// ----------------------------------------------------------------------------------------------------------
+/**  Areas kept by the bootloader at the top of the SDRAM, from the top down; the
+     kernel and ramdisk images are loaded below BOARD_SDRAM_RING_ADDR */
+/**  FAT free-cluster bitmaps of diskio.c, one per drive (NAND and MMC) */
+#define BOARD_SDRAM_FREEMAP_SIZE    (1024*1024)
+#define BOARD_SDRAM_FREEMAP_ADDR    (EBI_SDRAMC_ADDR + BOARD_SDRAM_SIZE - 2 * BOARD_SDRAM_FREEMAP_SIZE)
+/**  SD write-back windows of MEDSdcard.c */
+#define BOARD_SDRAM_WCACHE_SIZE     (4*1024*1024)
+#define BOARD_SDRAM_WCACHE_ADDR     (BOARD_SDRAM_FREEMAP_ADDR - BOARD_SDRAM_WCACHE_SIZE)
+/**  Serial download ring or network boot client of main.c (never both) */
+#define BOARD_SDRAM_RING_SIZE       (32*1024)
+#define BOARD_SDRAM_RING_ADDR       (BOARD_SDRAM_WCACHE_ADDR - BOARD_SDRAM_RING_SIZE)
+
 #endif /* _BOARD_SDRAM_ */
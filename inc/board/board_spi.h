@@ -8,6 +8,14 @@
  * - \ref PIN_SPI_SPCK
  * - \ref PINS_SPI
  * - \ref PIN_SPI_NPCS0_PA11
+ * - \ref PIN_SPI_NPCS1_PB20
+ *
+ * AT26 serial flash
+ * - \ref BOARD_AT26_SPI_BASE
+ * - \ref BOARD_AT26_SPI_ID
+ * - \ref BOARD_AT26_PINS
+ * - \ref BOARD_AT26_NPCS
+ * - \ref BOARD_AT26_SPCK
  *
  */
  
@@ -25,5 +33,15 @@
 #define PIN_SPI_NPCS0  {PIO_PA28A_SPI0_NPCS0, PIOA, ID_PIOA, PIO_PERIPH_A, PIO_DEFAULT}
 /** List of SPI pin definitions (MISO, MOSI & SPCK). */
 #define PINS_SPI        PIN_SPI_MISO, PIN_SPI_MOSI, PIN_SPI_SPCK
+/** SPI chip select 1 pin definition, on PB20 (PA29 is the EBI NRD). */
+#define PIN_SPI_NPCS1_PB20  {PIO_PB20B_SPI0_NPCS1, PIOB, ID_PIOB, PIO_PERIPH_B, PIO_DEFAULT}
+
+/** AT26 serial flash on SPI0, NPCS1 (NPCS0 is the touchscreen controller) */
+#define BOARD_AT26_SPI_BASE     SPI0
+#define BOARD_AT26_SPI_ID       ID_SPI0
+#define BOARD_AT26_PINS         PINS_SPI, PIN_SPI_NPCS1_PB20
+#define BOARD_AT26_NPCS         1
+/** Serial flash clock, 42 MHz: within the SPI master timings, the AT26 fast read runs up to 66 MHz */
+#define BOARD_AT26_SPCK         (BOARD_MCK / 2)
 
 #endif /* _BOARD_SPI_ */
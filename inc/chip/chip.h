@@ -60,6 +60,16 @@
     #define NO_INIT
 #endif
 
+/* Define RAMFUNC attribute: the function is copied to the zero-wait-state
+ * SRAM at startup (.ramfunc, see bootloader.ld) */
+#if defined   ( __CC_ARM   )
+    #define RAMFUNC __attribute__ ((section(".ramfunc")))
+#elif defined ( __ICCARM__ )
+    #define RAMFUNC __ramfunc
+#elif defined (  __GNUC__  )
+    #define RAMFUNC __attribute__ ((section(".ramfunc"), long_call, noinline))
+#endif
+
 /*
  * SAM3X Embedded IP features.
  * Define the feature to use it. Comment it out to not use it.
@@ -99,7 +109,7 @@
 #include "dacc.h"
 #include "dmac.h"
 #include "eefc.h"
-//#include "emac.h"
+#include "emac.h"
 #include "flashd.h"
 #include "hsmci.h"
 #include "matrix.h"
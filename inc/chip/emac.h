@@ -40,10 +40,13 @@
 ///
 /// -# Initialize EMAC with EMAC_Init with MAC address.
 /// -# Then the caller application need to initialize the PHY driver before further calling EMAC
-///      driver.
-/// -# Get a packet from network
-///      -# Interrupt mode: EMAC_Set_RxCb to register a function to process the frame packet
-///      -# Polling mode: EMAC_Poll for a data packet from network
+///      driver: EMAC_SetMdcClock, EMAC_EnableRMII and EMAC_EnableMdio, then EMAC_ReadPhy and
+///      EMAC_WritePhy to negotiate the link, and EMAC_SetLinkSpeed with its result
+///      (EMAC_PhyLinkUp in emac_phy.h does all of this).
+/// -# Get a packet from network: EMAC_StartRx with a ring of receive descriptors owned by the
+///      caller. Each descriptor points at a EMAC_RX_UNITSIZE bytes buffer which can be anywhere
+///      in memory; the frames are stored EMAC_RX_OFFSET bytes into their first buffer.
+///      EMAC_SetRxEnabled pauses the receiver without moving its position in the ring.
 /// -# Send a packet to network with EMAC_Send.
 ///
 /// Please refer to the list of functions in the #Overview# tab of this unit
@@ -59,26 +62,39 @@
 //         Definitions
 //-----------------------------------------------------------------------------
 
-/// Number of buffer for RX, be carreful: MUST be 2^n
-#define RX_BUFFERS  16
 /// Number of buffer for TX, be carreful: MUST be 2^n
-#define TX_BUFFERS   8
+#define TX_BUFFERS   2
 
 /// Buffer Size
 #define EMAC_RX_UNITSIZE            128     /// Fixed size for RX buffer
 #define EMAC_TX_UNITSIZE            1518    /// Size for ETH frame length
 
+/// Offset of a frame in its first RX buffer, aligns the IP header on a word
+#define EMAC_RX_OFFSET              2
+
 // The MAC can support frame lengths up to 1536 bytes.
 #define EMAC_FRAME_LENTGH_MAX       1536
 
+/// RX descriptor, address word
+#define EMAC_RX_OWNERSHIP_BIT       (1u <<  0)
+#define EMAC_RX_WRAP_BIT            (1u <<  1)
+/// RX descriptor, status word
+#define EMAC_RX_SOF_BIT             (1u << 14)
+#define EMAC_RX_EOF_BIT             (1u << 15)
+#define EMAC_LENGTH_FRAME           0x0FFF
+
+/// TX descriptor, status word
+#define EMAC_TX_USED_BIT            (1u << 31)
+#define EMAC_TX_WRAP_BIT            (1u << 30)
+#define EMAC_TX_ERROR_BIT           (1u << 29)  /// Retry limit exceeded
+#define EMAC_TX_UNDERRUN_BIT        (1u << 28)
+#define EMAC_TX_EXHAUSTED_BIT       (1u << 27)
+#define EMAC_TX_LAST_BUFFER_BIT     (1u << 15)
+
 
 //-----------------------------------------------------------------------------
 //         Types
 //-----------------------------------------------------------------------------
-/// Callback used by send function
-typedef void (*EMAC_TxCallback)( uint32_t dwStatus ) ;
-typedef void (*EMAC_RxCallback)( uint32_t dwStatus ) ;
-typedef void (*EMAC_WakeupCallback)( void ) ;
 
 #ifdef __ICCARM__          // IAR
 #pragma pack(4)            // IAR
@@ -89,37 +105,18 @@ typedef struct _EmacRxTDescriptor
 {
     uint32_t addr;
     uint32_t status;
-} __attribute__((packed, aligned(8))) EmacRxTDescriptor, *PEmacRxTDescriptor;
+} __attribute__((aligned(8))) EmacRxTDescriptor, *PEmacRxTDescriptor;
 
 /** Describes the type and attribute of Transmit Transfer descriptor. */
 typedef struct _EmacTxTDescriptor
 {
     uint32_t addr;
     uint32_t status;
-} __attribute__((packed, aligned(8))) EmacTxTDescriptor, *PEmacTxTDescriptor;
+} __attribute__((aligned(8))) EmacTxTDescriptor, *PEmacTxTDescriptor;
 #ifdef __ICCARM__          // IAR
 #pragma pack()             // IAR
 #endif                     // IAR
 
-/**  Descriptors for RX (required aligned by 8) */
-typedef struct _RxTd
-{
-   volatile EmacRxTDescriptor td[RX_BUFFERS];
-   EMAC_RxCallback rxCb;  /** Callback function to be invoked once a frame has been received */
-   uint16_t idx;
-} RxTd ;
-
-/** Descriptors for TX (required aligned by 8) */
-typedef struct _TxTd
-{
-   volatile EmacTxTDescriptor td[TX_BUFFERS] ;
-   EMAC_TxCallback txCb[TX_BUFFERS] ;   /** Callback function to be invoked once TD has been processed */
-   EMAC_WakeupCallback wakeupCb ;       /**  Callback function to be invoked once several TD have been released */
-   uint16_t wakeupThreshold ;           /** Number of free TD before wakeupCb is invoked */
-   uint16_t head ;                      /** Circular buffer head pointer incremented by the upper layer (buffer to be sent) */
-   uint16_t tail ;                      /** Circular buffer head pointer incremented by the IT handler (buffer sent) */
-} TxTd ;
-
 
 //-----------------------------------------------------------------------------
 /// Describes the statistics of the EMAC.
@@ -168,32 +165,20 @@ extern void EMAC_Init( Emac* pEmac, uint32_t dwId, const uint8_t *pucMacAddress,
 #define EMAC_NBC_DISABLE  0
 #define EMAC_NBC_ENABLE   2
 
-extern void EMAC_Handler( Emac* pEmac ) ;
-
 extern void EMAC_Reset( Emac* pEmac ) ;
 
-extern uint32_t EMAC_Send( Emac* pEmac, void *pvBuffer, uint32_t dwSize, EMAC_TxCallback fEMAC_TxCallback ) ;
+extern void EMAC_StartRx( Emac* pEmac, volatile EmacRxTDescriptor* pRing ) ;
+
+extern void EMAC_SetRxEnabled( Emac* pEmac, uint32_t dwEnabled ) ;
+
+extern uint32_t EMAC_Send( Emac* pEmac, const void *pvBuffer, uint32_t dwSize ) ;
 
 /// Return for EMAC_Send function
 #define EMAC_TX_OK                     0
 #define EMAC_TX_BUFFER_BUSY            1
 #define EMAC_TX_INVALID_PACKET         2
 
-extern uint32_t EMAC_Poll( Emac* pEmac, uint8_t *pFrame, uint32_t frameSize, uint32_t *pRcvSize ) ;
-
-/// Return for EMAC_Poll function
-#define EMAC_RX_OK                   0
-#define EMAC_RX_NO_DATA              1
-#define EMAC_RX_FRAME_SIZE_TOO_SMALL 2
-
 extern void EMAC_GetStatistics( Emac* pEmac, EmacStats *pStats, uint32_t dwReset ) ;
 
-extern uint32_t EMAC_TxLoad( Emac* pEmac ) ;
-
-extern void EMAC_Set_RxCb( Emac* pEmac, EMAC_RxCallback pRxCb ) ;
-extern void EMAC_Clear_RxCb( Emac* pEmac ) ;
-extern char EMAC_Set_TxWakeUpCb( Emac* pEmac, EMAC_WakeupCallback pTxWakeUpCb, uint32_t dwThreshold ) ;
-extern void EMAC_Clear_TxWakeUpCb( Emac* pEmac ) ;
-
 #endif // #ifndef _EMAC_
 
@@ -93,11 +93,11 @@ extern void SMC_ECC_Configure(Smc* pSmc, uint32_t type, uint32_t pageSize);
 extern uint32_t SMC_ECC_GetCorrectoinType(Smc* pSmc);
 extern uint8_t SMC_ECC_GetStatus(Smc *pSmc, uint8_t eccNumber);
 extern void SMC_ECC_GetValue(Smc* pSmc, uint32_t *ecc);
-extern void SMC_ECC_GetEccParity(
+extern RAMFUNC void SMC_ECC_GetEccParity(
     uint32_t pageDataSize,
     uint8_t *code,
     uint8_t dataPath);
-extern uint8_t SMC_ECC_VerifyHsiao(
+extern RAMFUNC uint8_t SMC_ECC_VerifyHsiao(
     uint8_t *data,
     uint32_t size,
     const uint8_t *originalCode,
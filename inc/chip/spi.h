@@ -77,50 +77,6 @@
  extern "C" {
 #endif
 
-/*----------------------------------------------------------------------------
- *        Types
- *----------------------------------------------------------------------------*/
-
-/** SPI transfer complete callback. */
-typedef void (*SpidCallback)( uint8_t, void* ) ;
-
-/** \brief Spi Transfer Request prepared by the application upper layer.
- *
- * This structure is sent to the SPI_SendCommand function to start the transfer.
- * At the end of the transfer, the callback is invoked by the interrupt handler.
- */
-typedef struct _SpidCmd
-{
-    /** Pointer to the command data. */
-	uint8_t *pCmd;
-    /** Command size in bytes. */
-	uint8_t cmdSize;
-    /** Pointer to the data to be sent. */
-	uint8_t *pData;
-    /** Data size in bytes. */
-	unsigned short dataSize;
-    /** SPI chip select. */
-	uint8_t spiCs;
-    /** Callback function invoked at the end of transfer. */
-	SpidCallback callback;
-    /** Callback arguments. */
-	void *pArgument;
-} SpidCmd ;
-
-/** Constant structure associated with SPI port. This structure prevents
-    client applications to have access in the same time. */
-typedef struct _Spid
-{
-    /** Pointer to SPI Hardware registers */
-	Spi* pSpiHw ;
-    /** SPI Id as defined in the product datasheet */
-	char spiId ;
-    /** Current SpiCommand being processed */
-	SpidCmd *pCurrentCommand ;
-    /** Mutual exclusion semaphore. */
-	volatile char semaphore ;
-} Spid ;
-
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -0,0 +1,80 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Asynchronous memory-to-memory copy and fill service running on one DMAC
+ * channel (BOARD_MEM_DMA_CHANNEL).
+ *
+ * \section Usage
+ *
+ * -# Initialize the service once with DMA_MemInitialize().
+ * -# Start a bulk copy with DMA_Memcpy() or a bulk fill with DMA_Memset().
+ *    Both functions return as soon as the transfer is started; the optional
+ *    callback is invoked from the DMAC interrupt when the whole range is done.
+ * -# Poll DMA_MemIsFinished() or block with DMA_MemWait() before touching
+ *    the destination range. DMA_MemWait() returns DMAMEM_STATUS_ERROR when
+ *    the DMAC stopped on an AHB error; the caller must then redo the work.
+ *
+ * Transfers shorter than DMAMEM_CPU_THRESHOLD bytes, transfers involving
+ * internal flash, and transfers requested while the channel is already busy
+ * are performed synchronously by the CPU. The callback is then invoked
+ * before the function returns.
+ *
+ * Large transfers are split into a chain of DmaLinkList descriptors of at
+ * most DMAMEM_LLI_WORDS words each; ranges larger than one chain are
+ * re-armed from the interrupt handler.
+ */
+
+#ifndef _DMA_MEM_
+#define _DMA_MEM_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Transfers below this size (in bytes) are done by the CPU. */
+#define DMAMEM_CPU_THRESHOLD    256
+/** Number of descriptors in one linked list chain. */
+#define DMAMEM_NUM_LLI          16
+/** Number of words moved by one descriptor (BTSIZE is 16-bit). */
+#define DMAMEM_LLI_WORDS        0x4000
+
+/** Transfer completed successfully. */
+#define DMAMEM_STATUS_SUCCESS   0
+/** The DMAC reported an AHB access error. */
+#define DMAMEM_STATUS_ERROR     1
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** DMA memory service completion callback. */
+typedef void (*DmaMemCallback)( void* pArg, uint32_t dwStatus ) ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern void DMA_MemInitialize( void ) ;
+
+extern uint32_t DMA_Memcpy( void* pDest, const void* pSrc, uint32_t dwSize, DmaMemCallback fCallback, void* pArg ) ;
+
+extern uint32_t DMA_Memset( void* pDest, uint8_t ucValue, uint32_t dwSize, DmaMemCallback fCallback, void* pArg ) ;
+
+extern uint32_t DMA_MemIsFinished( void ) ;
+
+extern uint32_t DMA_MemWait( void ) ;
+
+extern void DMA_MemHandler( uint32_t dwStatus ) ;
+
+extern uint32_t DMA_MemBuildChain( DmaLinkList* pLli, uint32_t dwNumLli, uint32_t dwDest, uint32_t dwSrc,
+                                   uint32_t dwWords, uint32_t dwFixedSrc ) ;
+
+#endif /* #ifndef _DMA_MEM_ */
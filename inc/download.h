@@ -0,0 +1,192 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Serial download protocol: images are sent as CRC-checked frames under a
+ * sliding window (go-back-N), so the sender keeps the line busy instead of
+ * waiting for an acknowledge after every frame.
+ *
+ * \section Frames
+ *
+ * Every frame is a 12-byte header, up to DOWNLOAD_MAX_PAYLOAD bytes of
+ * payload and the CRC-32 of the header and payload, all little endian:
+ *
+ * | Offset | Size | Field                                                 |
+ * |--------|------|-------------------------------------------------------|
+ * | 0      | 2    | DOWNLOAD_MAGIC ("DL")                                 |
+ * | 2      | 1    | Type (DOWNLOAD_TYPE_xxx)                              |
+ * | 3      | 1    | Flags (DOWNLOAD_FLAG_xxx)                             |
+ * | 4      | 2    | Sequence number                                       |
+ * | 6      | 2    | Payload length                                        |
+ * | 8      | 4    | Argument: byte offset (DATA) or status (ACK)          |
+ *
+ * A session is a HELLO (image description), the DATA frames, an END, then
+ * the next image or a BYE. The frames sent by the host are numbered in a
+ * single sequence starting with the DOWNLOAD_FLAG_START frame. The target
+ * only accepts the next frame in sequence and answers every frame with an
+ * ACK giving the next sequence number it expects; a frame received ahead of
+ * a lost one triggers a NAK so that the host goes back without waiting for
+ * its timeout. The ACK of an END carries the status of the image.
+ *
+ * \section Usage
+ *
+ * -# Initialize a receiver with Download_InitReceiver(), giving the function
+ *    providing the destination of an image, the one called once an image is
+ *    complete and the one sending the answers.
+ * -# Feed the received bytes, as they come, to Download_Input() until it
+ *    returns 1 (BYE received).
+ *
+ * The protocol engine does not access any peripheral: the host tool builds
+ * the same file for the sender and for a simulated target.
+ */
+
+#ifndef _DOWNLOAD_
+#define _DOWNLOAD_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Frame layout */
+#define DOWNLOAD_MAGIC0             'D'
+#define DOWNLOAD_MAGIC1             'L'
+#define DOWNLOAD_HEADER_SIZE        12
+#define DOWNLOAD_CRC_SIZE           4
+#define DOWNLOAD_MAX_PAYLOAD        1024
+#define DOWNLOAD_MAX_FRAME          (DOWNLOAD_HEADER_SIZE + DOWNLOAD_MAX_PAYLOAD + DOWNLOAD_CRC_SIZE)
+
+/** Frames sent by the host ahead of the last acknowledge */
+#define DOWNLOAD_WINDOW             8
+
+/** Frame types sent by the host */
+#define DOWNLOAD_TYPE_HELLO         0x01
+#define DOWNLOAD_TYPE_DATA          0x02
+#define DOWNLOAD_TYPE_END           0x03
+#define DOWNLOAD_TYPE_BYE           0x04
+
+/** Frame types sent by the target */
+#define DOWNLOAD_TYPE_ACK           0x81
+#define DOWNLOAD_TYPE_NAK           0x82
+
+/** First frame of a session: resets the receiver sequence */
+#define DOWNLOAD_FLAG_START         0x01
+
+/** HELLO payload: size (4), CRC-32 (4), commit (1), reserved (3), name */
+#define DOWNLOAD_NAME_SIZE          16
+#define DOWNLOAD_HELLO_SIZE         (12 + DOWNLOAD_NAME_SIZE)
+
+/** Where the target stores an image once received */
+#define DOWNLOAD_COMMIT_NONE        0
+#define DOWNLOAD_COMMIT_SD          1
+#define DOWNLOAD_COMMIT_NAND        2
+
+/** Image status, in the ACK of an END */
+#define DOWNLOAD_STATUS_OK          0
+#define DOWNLOAD_STATUS_REJECTED    1
+#define DOWNLOAD_STATUS_CRC         2
+#define DOWNLOAD_STATUS_SIZE        3
+#define DOWNLOAD_STATUS_COMMIT      4
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Image announced by a HELLO */
+typedef struct _DownloadImage
+{
+    /** Name, null terminated */
+    char pName[DOWNLOAD_NAME_SIZE + 1] ;
+    /** DOWNLOAD_COMMIT_xxx */
+    uint8_t bCommit ;
+    /** Size in bytes */
+    uint32_t dwSize ;
+    /** CRC-32 of the whole image */
+    uint32_t dwCrc ;
+} DownloadImage ;
+
+/** Decoded frame, the payload points in the parser buffer */
+typedef struct _DownloadFrame
+{
+    uint8_t bType ;
+    uint8_t bFlags ;
+    uint16_t wSeq ;
+    uint32_t dwArg ;
+    uint32_t dwLength ;
+    const uint8_t* pPayload ;
+} DownloadFrame ;
+
+/** Frame parser */
+typedef struct _DownloadParser
+{
+    /** Frame being received */
+    uint8_t pBuffer[DOWNLOAD_MAX_FRAME] ;
+    /** Bytes of the frame received */
+    uint32_t dwFill ;
+    /** Frames dropped on a bad header or CRC */
+    uint32_t dwErrors ;
+} DownloadParser ;
+
+/** Returns the destination of an image of at least pImage->dwSize bytes, or 0 to reject it */
+typedef uint8_t* (*DownloadOpenFunc)( void* pArg, const DownloadImage* pImage ) ;
+
+/** Called with an image received and checked, returns a DOWNLOAD_STATUS_xxx */
+typedef uint32_t (*DownloadCloseFunc)( void* pArg, const DownloadImage* pImage, uint8_t* pData ) ;
+
+/** Sends a frame to the host; the frame may be reused on return */
+typedef void (*DownloadSendFunc)( void* pArg, const uint8_t* pFrame, uint32_t dwSize ) ;
+
+/** Target side of the protocol */
+typedef struct _DownloadReceiver
+{
+    DownloadOpenFunc fOpen ;
+    DownloadCloseFunc fClose ;
+    DownloadSendFunc fSend ;
+    void* pArg ;
+
+    DownloadParser parser ;
+    /** Next sequence number expected, valid once bStarted is set */
+    uint16_t wExpected ;
+    uint8_t bStarted ;
+    /** A NAK has been sent for wExpected */
+    uint8_t bNakSent ;
+    /** Status of the last image, repeated in the ACK of a duplicate END */
+    uint32_t dwStatus ;
+
+    /** Image being received */
+    DownloadImage image ;
+    uint8_t* pData ;
+    uint32_t dwReceived ;
+    uint32_t dwCrc ;
+
+    /** Statistics */
+    uint32_t dwFrames ;
+    uint32_t dwNaks ;
+    uint32_t dwDuplicates ;
+} DownloadReceiver ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern uint32_t Download_Crc32( uint32_t dwCrc, const uint8_t* pData, uint32_t dwSize ) ;
+
+extern uint32_t Download_BuildFrame( uint8_t* pFrame, uint8_t bType, uint8_t bFlags, uint16_t wSeq, uint32_t dwArg,
+                                     const uint8_t* pPayload, uint32_t dwLength ) ;
+
+extern uint32_t Download_BuildHello( uint8_t* pPayload, const DownloadImage* pImage ) ;
+
+extern uint32_t Download_Parse( DownloadParser* pParser, const uint8_t* pData, uint32_t dwSize, DownloadFrame* pFrame ) ;
+
+extern void Download_InitReceiver( DownloadReceiver* pReceiver, DownloadOpenFunc fOpen, DownloadCloseFunc fClose,
+                                   DownloadSendFunc fSend, void* pArg ) ;
+
+extern uint32_t Download_Input( DownloadReceiver* pReceiver, const uint8_t* pData, uint32_t dwSize ) ;
+
+#endif /* #ifndef _DOWNLOAD_ */
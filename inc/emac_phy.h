@@ -0,0 +1,71 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Link bring-up of the EMAC with an IEEE 802.3 clause 22 PHY on its RMII
+ * and MDIO interface.
+ *
+ * \section Usage
+ *
+ * -# Configure the EMAC pins (BOARD_EMAC_RUN_PINS).
+ * -# Call EMAC_PhyLinkUp() with the MAC address: it initializes the EMAC,
+ *    finds the PHY, restarts the auto-negotiation and, once the link is up,
+ *    sets the EMAC to the speed and duplex negotiated. The EMAC is then ready
+ *    for EMAC_StartRx() and EMAC_Send().
+ *
+ * The driver does not keep a time base: the time spent waiting for the link
+ * is measured with the millisecond clock given by the application.
+ */
+
+#ifndef _EMAC_PHY_
+#define _EMAC_PHY_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "chip.h"
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** IEEE 802.3 clause 22 PHY registers */
+#define MII_BMCR                0
+#define MII_BMSR                1
+#define MII_PHYID1              2
+#define MII_ANLPAR              5
+#define MII_BMCR_ANRESTART      (1 << 9)
+#define MII_BMCR_ANENABLE       (1 << 12)
+#define MII_BMSR_LINK           (1 << 2)
+#define MII_BMSR_ANCOMPLETE     (1 << 5)
+#define MII_ANLPAR_10FD         (1 << 6)
+#define MII_ANLPAR_100HD        (1 << 7)
+#define MII_ANLPAR_100FD        (1 << 8)
+
+/** Polls of the MDIO interface before a PHY access is given up */
+#define EMAC_PHY_MDIO_RETRY     100000
+
+/** EMAC_PhyLinkUp() return codes */
+#define EMAC_PHY_OK             0
+#define EMAC_PHY_NOPHY          1
+#define EMAC_PHY_NOLINK         2
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Millisecond clock of the application */
+typedef uint32_t (*EmacPhyClockFunc)( void ) ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern uint32_t EMAC_PhyLinkUp( Emac* pEmac, uint32_t dwId, const uint8_t* pMac, uint32_t dwPhyAddress,
+                                EmacPhyClockFunc fClock, uint32_t dwTimeoutMs ) ;
+
+#endif /* #ifndef _EMAC_PHY_ */
@@ -41,7 +41,8 @@
  *        Exported functions
  *----------------------------------------------------------------------------*/
 
-extern void FB_SetFrameBuffer(LcdColor_t *pBuffer, uint8_t ucWidth, uint8_t ucHeight);
+extern void FB_SetFrameBuffer(LcdColor_t *pBuffer, uint32_t dwWidth, uint32_t dwHeight);
+extern void FB_SetPosition(uint32_t dwX, uint32_t dwY);
 extern void FB_SetColor(uint32_t color);
 extern uint32_t FB_DrawLine ( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 );
 extern uint32_t FB_DrawPixel( uint32_t x, uint32_t y );
@@ -50,4 +51,5 @@ extern uint32_t FB_DrawFilledCircle( uint32_t dwX, uint32_t dwY, uint32_t dwRadi
 extern uint32_t FB_DrawRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 );
 extern uint32_t FB_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 );
 extern uint32_t FB_DrawPicture( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const void *pBuffer );
+extern uint32_t FB_Flush( void );
 #endif /* #ifndef _FRAME_BUFFER_ */
@@ -160,6 +160,14 @@
 
 typedef uint16_t LcdColor_t;
 
+/** Pixel transfer completed successfully */
+#define LCD_DMA_STATUS_SUCCESS  0
+/** The DMAC reported an AHB access error */
+#define LCD_DMA_STATUS_ERROR    1
+
+/** Pixel transfer completion callback, invoked from the DMAC interrupt */
+typedef void (*LcdDmaCallback)( void* pArg, uint32_t dwStatus ) ;
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -175,6 +183,15 @@ extern uint32_t LCD_DrawFilledCircle( uint32_t dwX, uint32_t dwY, uint32_t dwRad
 extern uint32_t LCD_DrawRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 ) ;
 extern uint32_t LCD_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 );
 extern uint32_t LCD_DrawPicture( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer );
+extern uint32_t LCD_DrawFilledRectangleAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2,
+                                              LcdDmaCallback fCallback, void* pArg ) ;
+extern uint32_t LCD_DrawPictureAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer,
+                                      LcdDmaCallback fCallback, void* pArg ) ;
+extern uint32_t LCD_DrawPictureStrideAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer,
+                                            uint32_t dwStride, LcdDmaCallback fCallback, void* pArg ) ;
+extern uint32_t LCD_IsFinished( void ) ;
+extern void LCD_Wait( void ) ;
+extern void LCD_DmaHandler( uint32_t dwStatus ) ;
 extern void LCD_SetBacklight( uint32_t level ) ;
 
 extern void LCD_SetWindow( uint32_t dwX, uint32_t dwY, uint32_t dwWidth, uint32_t dwHeight ) ;
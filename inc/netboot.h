@@ -0,0 +1,197 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Network boot: fetches images from a TFTP server (RFC 1350) over UDP/IPv4
+ * with the blocksize (RFC 2348), transfer size (RFC 2349) and windowsize
+ * (RFC 7440) options, and answers ARP so that the server can reach the board.
+ * The addresses are static, there is no DHCP.
+ *
+ * \section Receive
+ *
+ * The frames are received by the EMAC in a ring of NETBOOT_RX_BUFFERS
+ * descriptors, each pointing at a 128-byte buffer, a frame starting
+ * NETBOOT_RX_OFFSET bytes into its first buffer. With NETBOOT_BLOCK_SIZE
+ * bytes blocks, the first buffer of a DATA frame holds the offset, the 46
+ * bytes of headers and the first 80 bytes of data, and each next buffer 128
+ * bytes of data. So before acknowledging a window, the client lays out the
+ * slots where the frames of the next window will land: the first descriptor
+ * of a slot keeps its ring buffer, the next ones point straight at the
+ * destination of the block. Only the first 80 bytes of a block are copied.
+ *
+ * A frame that does not land at the start of the slot of its block (a frame
+ * of another protocol in between, a lost block) is gathered from the buffers
+ * it used instead, and the slots are laid out again at the next acknowledge.
+ * Only the next block in sequence is accepted, so a descriptor never points
+ * at data already accepted once the receiver has gone past it.
+ *
+ * \section Usage
+ *
+ * -# Describe the interface with a NetbootDevice: the functions sending a
+ *    frame, starting and pausing the receiver and reading the time.
+ * -# Initialize the client with Netboot_Initialize(), which builds the ring
+ *    in the Netboot structure and starts the receiver on it.
+ * -# Fetch each image with Netboot_Fetch().
+ *
+ * The client does not access any peripheral: the host tool
+ * resources/host/netsim.c runs it against a simulated EMAC ring and a TFTP
+ * server on the loopback.
+ */
+
+#ifndef _NETBOOT_
+#define _NETBOOT_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** IPv4 address a.b.c.d */
+#define NETBOOT_ADDRESS( a, b, c, d )   (((uint32_t)(a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+/** Receive ring, the EMAC buffers are 128 bytes */
+#define NETBOOT_RX_BUFFERS          128
+#define NETBOOT_RX_UNITSIZE         128
+#define NETBOOT_RX_OFFSET           2
+
+/** EMAC receive descriptor, address word */
+#define NETBOOT_RX_OWNERSHIP        (1u << 0)
+#define NETBOOT_RX_WRAP             (1u << 1)
+#define NETBOOT_RX_ADDRESS          0xFFFFFFFCu
+
+/** EMAC receive descriptor, status word */
+#define NETBOOT_RX_LENGTH           0x00000FFFu
+#define NETBOOT_RX_SOF              (1u << 14)
+#define NETBOOT_RX_EOF              (1u << 15)
+
+/** Options requested: 80 + 10 * 128 bytes blocks fit a 1500-byte IP packet */
+#define NETBOOT_BLOCK_SIZE          1360
+#define NETBOOT_WINDOW_SIZE         8
+
+/** Largest frame handled, without FCS */
+#define NETBOOT_MAX_FRAME           1514
+
+/** Retransmission timeout and number of retries without progress */
+#define NETBOOT_TIMEOUT_MS          250
+#define NETBOOT_RETRIES             20
+
+/** Netboot_Fetch() results */
+#define NETBOOT_OK                  0
+#define NETBOOT_ERROR_ARP           1
+#define NETBOOT_ERROR_TIMEOUT       2
+#define NETBOOT_ERROR_SERVER        3
+#define NETBOOT_ERROR_SIZE          4
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** EMAC receive descriptor */
+typedef struct _NetbootRxDescriptor
+{
+    uint32_t dwAddress ;
+    uint32_t dwStatus ;
+} __attribute__ ((aligned (8))) NetbootRxDescriptor ;
+
+/** Sends a frame (without FCS); the frame may be reused on return */
+typedef void (*NetbootSendFunc)( void* pArg, const uint8_t* pFrame, uint32_t dwSize ) ;
+
+/** Points the receiver at the first descriptor of the ring and enables it */
+typedef void (*NetbootRxStartFunc)( void* pArg, NetbootRxDescriptor* pRing ) ;
+
+/** Pauses (bEnable 0) or resumes the receiver, returns the index of the next descriptor it will use */
+typedef uint32_t (*NetbootRxEnableFunc)( void* pArg, uint8_t bEnable ) ;
+
+/** Free running time in milliseconds */
+typedef uint32_t (*NetbootClockFunc)( void ) ;
+
+/** Called while waiting for a frame, can be 0 */
+typedef void (*NetbootIdleFunc)( void* pArg ) ;
+
+/** Network interface */
+typedef struct _NetbootDevice
+{
+    NetbootSendFunc fSend ;
+    NetbootRxStartFunc fRxStart ;
+    NetbootRxEnableFunc fRxEnable ;
+    NetbootClockFunc fClock ;
+    NetbootIdleFunc fIdle ;
+    void* pArg ;
+} NetbootDevice ;
+
+/** Statistics */
+typedef struct _NetbootStats
+{
+    /** Frames received */
+    uint32_t dwFrames ;
+    /** Blocks received in place, only their head copied */
+    uint32_t dwDirect ;
+    /** Blocks gathered from the buffers they landed in */
+    uint32_t dwGathered ;
+    /** Frames dropped: not for the board, malformed, incomplete */
+    uint32_t dwDropped ;
+    /** Acknowledges sent on a timeout or a lost block */
+    uint32_t dwResent ;
+} NetbootStats ;
+
+/** Client state; the ring and its buffers must be reachable by the EMAC */
+typedef struct _Netboot
+{
+    /** Receive ring and its own buffers */
+    NetbootRxDescriptor pRing[NETBOOT_RX_BUFFERS] ;
+    uint8_t pBuffers[NETBOOT_RX_BUFFERS][NETBOOT_RX_UNITSIZE] ;
+    /** Block whose slot each descriptor belongs to, 0 if none */
+    uint32_t pdwSlot[NETBOOT_RX_BUFFERS] ;
+    /** Next descriptor to read */
+    uint32_t dwRead ;
+
+    const NetbootDevice* pDevice ;
+    uint8_t pMac[6] ;
+    uint8_t pServerMac[6] ;
+    uint8_t bServerMac ;
+    uint32_t dwIp ;
+    uint32_t dwServer ;
+    uint16_t wIpId ;
+    uint16_t wPort ;
+
+    /** Transfer in progress */
+    uint8_t bState ;
+    uint8_t bAck ;
+    uint8_t bGap ;
+    uint8_t bError ;
+    uint16_t wServerPort ;
+    uint8_t* pDest ;
+    uint32_t dwMax ;
+    uint32_t dwBlockSize ;
+    uint32_t dwWindow ;
+    uint32_t dwTsize ;
+    /** Next block expected (from 1, not wrapped at 65536) */
+    uint32_t dwBlock ;
+    uint32_t dwInWindow ;
+    uint32_t dwReceived ;
+    /** Time of the last progress and attempts since */
+    uint32_t dwLast ;
+    uint32_t dwRetries ;
+
+    NetbootStats stats ;
+
+    /** Frame gathered from its buffers, frame being sent */
+    uint8_t pGather[NETBOOT_MAX_FRAME] ;
+    uint8_t pTx[NETBOOT_MAX_FRAME] ;
+} Netboot ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern void Netboot_Initialize( Netboot* pNet, const NetbootDevice* pDevice, const uint8_t* pMac, uint32_t dwIp, uint32_t dwServer ) ;
+
+extern uint32_t Netboot_Fetch( Netboot* pNet, const char* pName, uint8_t* pDest, uint32_t dwMax, uint32_t* pdwSize ) ;
+
+#endif /* #ifndef _NETBOOT_ */
@@ -0,0 +1,138 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Boot profiler, built with -DPROFILE: scoped cycle counters around the
+ * storage and display entry points, and a statistical PC sampler, to tell
+ * where the boot cycles go.
+ *
+ * \section Usage
+ *
+ * -# Start the DWT cycle counter, then call Prof_Initialize() once the
+ *    console is up: it starts the PC sampling from the SysTick interrupt.
+ * -# Enclose a function body with PROF_SCOPE( PROF_xxx ), placed after the
+ *    last declaration: the scope is left on any return. A region inside a
+ *    function is enclosed with PROF_ENTER() / PROF_EXIT(). Scopes nest; the
+ *    time of a nested scope is removed from the self time of its parent.
+ * -# Call Prof_Dump() at the end of the boot: it stops the sampling and
+ *    prints the scope statistics and the PC histogram on the console.
+ *
+ * \section Dump
+ *
+ * Every line of the scope table starts with '#'. The histogram follows as
+ * "@ <address> <samples>" lines, one per bucket hit, the address being the
+ * start of the bucket. resources/gcc/profile.sh folds the buckets into
+ * functions against the ELF symbols, giving the "<samples> <function>"
+ * profile read by resources/gcc/ramfunc.sh.
+ *
+ * Scopes must not be used from interrupt handlers; the time spent in the
+ * handlers is counted in the scope they interrupt. Without PROFILE the
+ * macros expand to nothing.
+ */
+
+#ifndef _PROF_
+#define _PROF_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Scopes, named in the dump by gpProfScopeNames[] (prof.c). The LCD
+    scopes time the start of the DMA transfers, not their completion. */
+#define PROF_F_OPEN             0
+#define PROF_F_READ             1
+#define PROF_F_WRITE            2
+#define PROF_F_LSEEK            3
+#define PROF_F_SYNC             4
+#define PROF_DISK_READ          5
+#define PROF_DISK_WRITE         6
+#define PROF_SD_INIT            7
+#define PROF_SD_READ            8
+#define PROF_SD_WRITE           9
+#define PROF_NAND_READ          10
+#define PROF_NAND_WRITE         11
+#define PROF_NAND_FLUSH         12
+#define PROF_LCD_INIT           13
+#define PROF_LCD_FILL           14
+#define PROF_LCD_PICTURE        15
+#define PROF_BMP_DRAW           16
+#define PROF_NUM_SCOPES         17
+
+/** PC sampling period in cycles, prime so that it does not lock on a loop */
+#define PROF_SAMPLE_CYCLES      8387
+
+/** PC histogram buckets, shared between the code in flash and in SRAM */
+#define PROF_PC_BUCKETS         4096
+#define PROF_PC_RAM_BUCKETS     512
+
+#if defined( PROFILE )
+
+/** Enter a scope, left on any exit of the enclosing block */
+#define PROF_SCOPE( bId ) \
+    ProfFrame _profFrame __attribute__((cleanup(Prof_Exit))) ; Prof_Enter( &_profFrame, bId )
+
+/** Enter a scope with a frame declared by the caller */
+#define PROF_ENTER( pFrame, bId )   Prof_Enter( pFrame, bId )
+
+/** Leave the scope entered with the frame */
+#define PROF_EXIT( pFrame )         Prof_Exit( pFrame )
+
+#else
+
+#define PROF_SCOPE( bId )
+#define PROF_ENTER( pFrame, bId )
+#define PROF_EXIT( pFrame )
+
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** Scope being run, kept on the stack of the function */
+typedef struct _ProfFrame
+{
+    /** Enclosing scope */
+    struct _ProfFrame* pParent ;
+    /** Cycle counter on entry */
+    uint32_t dwStart ;
+    /** Cycles spent in the nested scopes */
+    uint32_t dwChildren ;
+    /** PROF_xxx */
+    uint32_t dwId ;
+} ProfFrame ;
+
+/** Statistics of a scope, in cycles */
+typedef struct _ProfScope
+{
+    uint32_t dwCalls ;
+    uint32_t dwMin ;
+    uint32_t dwMax ;
+    /** Time in the scope, nested scopes included */
+    uint64_t qwTotal ;
+    /** Time in the scope, nested scopes excluded */
+    uint64_t qwSelf ;
+} ProfScope ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern void Prof_Initialize( void ) ;
+
+extern void Prof_Enter( ProfFrame* pFrame, uint32_t dwId ) ;
+
+extern void Prof_Exit( ProfFrame* pFrame ) ;
+
+extern void Prof_Sample( uint32_t dwPc ) ;
+
+extern void Prof_Dump( uint32_t dwCyclesPerUs ) ;
+
+#endif /* #ifndef _PROF_ */
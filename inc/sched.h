@@ -0,0 +1,136 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Cooperative scheduler running stackless tasks (protothreads) on the single
+ * core, used to overlap the boot steps which spend most of their time
+ * waiting on peripherals.
+ *
+ * \section Usage
+ *
+ * -# Initialize the scheduler with Sched_Initialize(), giving the free
+ *    running cycle counter used for the timing report and the function
+ *    called when every task is waiting (e.g. __WFI).
+ * -# Register each task with Sched_AddTask(). A task is a function whose
+ *    body is enclosed in SCHED_BEGIN() / SCHED_END(); it gives the CPU back
+ *    with SCHED_YIELD(), SCHED_WAIT_UNTIL() or SCHED_WAIT_EVENTS().
+ *    Local variables are not preserved across these points: keep the task
+ *    state in static variables or in the structure pointed by pArg.
+ * -# Signal events with Sched_PostEvent(), from a task or from an interrupt
+ *    handler (e.g. on a transfer completion). Events are sticky flags until
+ *    cleared by Sched_ClearEvent().
+ * -# Run the tasks with Sched_Run() until they are all done, then print the
+ *    per-task timing with Sched_PrintReport().
+ *
+ * The scheduler does not access any peripheral: the cycle counter and the
+ * idle hook are given by the application, so it also builds on a host with
+ * a simulated clock.
+ */
+
+#ifndef _SCHED_
+#define _SCHED_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Task return codes */
+#define SCHED_RC_YIELD          0
+#define SCHED_RC_DONE           1
+
+/** Task states */
+#define SCHED_STATE_READY       0
+#define SCHED_STATE_WAITING     1
+#define SCHED_STATE_DONE        2
+
+/** Start of a task body */
+#define SCHED_BEGIN( pTask )    switch ( (pTask)->wLine ) { case 0:
+
+/** Leave the task body early: the task is done */
+#define SCHED_EXIT( pTask )     do { (pTask)->wLine = 0 ; return SCHED_RC_DONE ; } while ( 0 )
+
+/** End of a task body: the task is done */
+#define SCHED_END( pTask )      } (pTask)->wLine = 0 ; return SCHED_RC_DONE
+
+/** Give the CPU back to the other tasks */
+#define SCHED_YIELD( pTask ) \
+    do { (pTask)->wLine = __LINE__ ; return SCHED_RC_YIELD ; case __LINE__: ; } while ( 0 )
+
+/** Give the CPU back until the condition is true */
+#define SCHED_WAIT_UNTIL( pTask, condition ) \
+    do { (pTask)->wLine = __LINE__ ; case __LINE__: if ( !(condition) ) return SCHED_RC_YIELD ; } while ( 0 )
+
+/** Sleep until all the events of the mask are posted */
+#define SCHED_WAIT_EVENTS( pTask, dwMask ) \
+    do { (pTask)->dwWaitEvents = (dwMask) ; (pTask)->wLine = __LINE__ ; return SCHED_RC_YIELD ; case __LINE__: ; } while ( 0 )
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+typedef struct _SchedTask SchedTask ;
+
+/** Task body, returns SCHED_RC_YIELD or SCHED_RC_DONE */
+typedef uint8_t (*SchedTaskFunc)( SchedTask* pTask ) ;
+
+/** Free running cycle counter */
+typedef uint32_t (*SchedClockFunc)( void ) ;
+
+/** Called when every task is waiting for an event */
+typedef void (*SchedIdleFunc)( void ) ;
+
+/** Task control block */
+struct _SchedTask
+{
+    /** Name printed in the timing report */
+    const char* pName ;
+    /** Task body */
+    SchedTaskFunc fRun ;
+    /** Task argument */
+    void* pArg ;
+    /** Resume point inside the task body */
+    uint16_t wLine ;
+    /** SCHED_STATE_xxx */
+    uint8_t bState ;
+    uint8_t bReserved ;
+    /** Events the task is waiting for */
+    uint32_t dwWaitEvents ;
+    /** Number of times the task body has been called */
+    uint32_t dwRuns ;
+    /** Cycles spent inside the task body */
+    uint32_t dwBusyCycles ;
+    /** Cycle counter when the task was first run and when it was done */
+    uint32_t dwStartCycle ;
+    uint32_t dwEndCycle ;
+    /** Next registered task */
+    SchedTask* pNext ;
+} ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern void Sched_Initialize( SchedClockFunc fClock, SchedIdleFunc fIdle ) ;
+
+extern void Sched_AddTask( SchedTask* pTask, const char* pName, SchedTaskFunc fRun, void* pArg ) ;
+
+extern void Sched_PostEvent( uint32_t dwEvents ) ;
+
+extern void Sched_ClearEvent( uint32_t dwEvents ) ;
+
+extern uint32_t Sched_GetEvents( void ) ;
+
+extern uint32_t Sched_RunOnce( void ) ;
+
+extern void Sched_Run( void ) ;
+
+extern void Sched_PrintReport( uint32_t dwCyclesPerUs ) ;
+
+#endif /* #ifndef _SCHED_ */
@@ -0,0 +1,113 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * SPI command driver: sends a command to a device on a chip select, then
+ * streams its data phase with the DMAC, the chip select staying asserted
+ * from the first command byte to the last data byte.
+ *
+ * \section Usage
+ *
+ * -# Initialize the driver with SPID_Configure() and each chip select with
+ *    SPID_ConfigureCS() (SPI_CSR value, see spi.h).
+ * -# Fill a SpidCmd and start it with SPID_SendCommand(). The function
+ *    returns once the transfer is started; the optional callback is invoked
+ *    from the DMAC interrupt when the data phase is done.
+ * -# Poll SPID_IsBusy() before reusing the command or its buffers.
+ *
+ * The command bytes, and data phases shorter than SPID_CPU_THRESHOLD bytes,
+ * are moved by the CPU. Longer data phases run on BOARD_SPI_DMA_TX_CHANNEL
+ * and BOARD_SPI_DMA_RX_CHANNEL with the SPI hardware handshake, as chains of
+ * SPID_NUM_LLI descriptors re-armed from the interrupt: a read of any size
+ * is a single command on the bus.
+ */
+
+#ifndef _SPID_
+#define _SPID_
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Data phases below this size (in bytes) are moved by the CPU */
+#define SPID_CPU_THRESHOLD      32
+/** Number of descriptors in one chain */
+#define SPID_NUM_LLI            8
+/** Bytes moved by one descriptor (BTSIZE is 16-bit) */
+#define SPID_LLI_BYTES          0x8000
+
+/** A command is already in progress on the driver */
+#define SPID_ERROR_LOCK         1
+/** The DMAC reported an AHB access error during the data phase */
+#define SPID_ERROR_DMA          2
+
+/*----------------------------------------------------------------------------
+ *        Types
+ *----------------------------------------------------------------------------*/
+
+/** SPI transfer complete callback, with 0 or SPID_ERROR_xxx */
+typedef void (*SpidCallback)( uint8_t, void* ) ;
+
+/** \brief Spi Transfer Request prepared by the application upper layer.
+ *
+ * This structure is sent to the SPID_SendCommand function to start the transfer.
+ * At the end of the transfer, the callback is invoked by the interrupt handler.
+ */
+typedef struct _SpidCmd
+{
+    /** Pointer to the command data, overwritten with the bytes received. */
+    uint8_t *pCmd ;
+    /** Command size in bytes. */
+    uint8_t cmdSize ;
+    /** 1 if pData receives the data phase, 0 if it is sent. */
+    uint8_t dataIn ;
+    /** Pointer to the data to be sent or received. */
+    uint8_t *pData ;
+    /** Data size in bytes. */
+    uint32_t dataSize ;
+    /** SPI chip select. */
+    uint8_t spiCs ;
+    /** Callback function invoked at the end of transfer. */
+    SpidCallback callback ;
+    /** Callback arguments. */
+    void *pArgument ;
+} SpidCmd ;
+
+/** Constant structure associated with SPI port. This structure prevents
+    client applications to have access in the same time. */
+typedef struct _Spid
+{
+    /** Pointer to SPI Hardware registers (Spi*) */
+    void* pSpiHw ;
+    /** SPI Id as defined in the product datasheet */
+    uint8_t spiId ;
+    /** Current SpiCommand being processed */
+    SpidCmd *pCurrentCommand ;
+    /** Bytes of the data phase already programmed in the DMAC */
+    uint32_t dwArmed ;
+    /** Mutual exclusion semaphore. */
+    volatile uint8_t semaphore ;
+} Spid ;
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern void SPID_Configure( Spid* pSpid, void* pSpiHw, uint8_t bSpiId ) ;
+
+extern void SPID_ConfigureCS( Spid* pSpid, uint32_t dwCs, uint32_t dwCsr ) ;
+
+extern uint32_t SPID_SendCommand( Spid* pSpid, SpidCmd* pCommand ) ;
+
+extern uint32_t SPID_IsBusy( const Spid* pSpid ) ;
+
+extern void SPID_DmaHandler( uint32_t dwStatus ) ;
+
+#endif /* #ifndef _SPID_ */
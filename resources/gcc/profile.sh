@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# Fold the PC sampling dump of the boot profiler (inc/prof.h) into functions.
+#
+# Usage:
+#   arm-none-eabi-nm -n --defined-only bootloader.elf | \
+#       sh profile.sh <capture> > profile.txt
+#
+# <capture> is the console output of a boot built with -DPROFILE; the lines
+# outside the dump are ignored. Every "@ <address> <samples>" bucket is
+# charged to the closest code symbol at or below its address: a bucket may
+# straddle the end of a small function and is then charged to the function
+# it starts in. The result holds the scope table of the dump as comments,
+# then one "<samples> <function>" pair per line, most sampled first: it is
+# the <profile> read by "ramfunc.sh select".
+#
+
+capture=$1
+
+if [ -z "$capture" ]; then
+    echo "usage: $0 <capture>" >&2
+    exit 1
+fi
+
+awk '
+    function hex(s,    i, v) {
+        v = 0
+        s = tolower(s)
+        sub(/^0x/, "", s)
+        for (i = 1; i <= length(s); i++)
+            v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+        return v
+    }
+    # Function holding an address: last symbol at or below it
+    function lookup(a,    lo, hi, mid) {
+        if (n == 0 || a < addr[1]) return "?"
+        lo = 1
+        hi = n
+        while (lo < hi) {
+            mid = int((lo + hi + 1) / 2)
+            if (addr[mid] <= a) lo = mid
+            else hi = mid - 1
+        }
+        return name[lo]
+    }
+    # nm -n output on stdin: <address> <type> <name>, thumb bit cleared
+    NR == FNR {
+        if (NF == 3 && ($2 == "T" || $2 == "t")) {
+            n++
+            addr[n] = hex($1)
+            addr[n] -= addr[n] % 2
+            name[n] = $3
+        }
+        next
+    }
+    # capture: printf "\n\r" leaves the CR at the start of the next line
+    { gsub(/\r/, "") }
+    /^# prof: scopes/ { dump = 1 }
+    !dump { next }
+    /^# prof: end/ { dump = 0; next }
+    /^#/ { print; next }
+    /^@ / && NF == 3 {
+        samples[lookup(hex($2))] += $3
+        total += $3
+    }
+    END {
+        printf "# %d samples in the code\n", total
+        fflush()
+        for (f in samples)
+            printf "%d %s\n", samples[f], f | "sort -rn"
+        close("sort -rn")
+    }' - "$capture"
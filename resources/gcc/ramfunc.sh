@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# Profile-guided selection of the functions copied to SRAM (.ramfunc).
+#
+# Usage:
+#   arm-none-eabi-nm -S --defined-only bootloader.elf | \
+#       sh ramfunc.sh select <profile> <budget> > ramfunc.lst
+#   arm-none-eabi-nm bootloader.elf | sh ramfunc.sh report <budget>
+#
+# <profile> is a text file with one "<samples> <function>" pair per line, as
+# produced by the PC sampling profiler dump (lines starting with '#' are
+# ignored). Functions are ranked by samples per byte and taken greedily until
+# <budget> bytes of SRAM are used. The resulting list holds one function name
+# per line; the Makefile renames their .text.<name> input sections to
+# .ramfunc.<name> before linking.
+#
+# Functions running before the .relocate segment is copied to SRAM can not
+# be moved and are always skipped.
+#
+
+RAMFUNC_EXCLUDE="ResetException LowLevelInit"
+
+mode=$1
+
+case "$mode" in
+select)
+    profile=$2
+    budget=$3
+    awk -v exclude="$RAMFUNC_EXCLUDE" '
+        function hex(s,    i, v) {
+            v = 0
+            s = tolower(s)
+            for (i = 1; i <= length(s); i++)
+                v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+            return v
+        }
+        BEGIN {
+            n = split(exclude, ex, " ")
+            for (i = 1; i <= n; i++) skip[ex[i]] = 1
+        }
+        # nm -S output on stdin: <address> <size> <type> <name>
+        NR == FNR {
+            if (NF == 4 && ($3 == "T" || $3 == "t"))
+                size[$4] = hex($2)
+            next
+        }
+        # profile file: <samples> <function>
+        /^#/ || NF < 2 { next }
+        { samples[$2] += $1 }
+        END {
+            for (f in samples) {
+                if (!(f in size) || (f in skip) || size[f] == 0) continue
+                printf "%.6f %d %s\n", samples[f] / size[f], size[f], f | "sort -rn"
+            }
+        }' - "$profile" | awk -v budget="$budget" '
+        {
+            aligned = int(($2 + 3) / 4) * 4
+            if (used + aligned > budget) next
+            used += aligned
+            print $3
+            printf "-I- ramfunc: %-32s %6d bytes\n", $3, aligned > "/dev/stderr"
+        }
+        END {
+            printf "-I- ramfunc: %d of %d bytes selected\n", used, budget > "/dev/stderr"
+        }'
+    ;;
+report)
+    budget=$2
+    awk -v budget="$budget" '
+        function hex(s,    i, v) {
+            v = 0
+            s = tolower(s)
+            for (i = 1; i <= length(s); i++)
+                v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+            return v
+        }
+        $3 == "_sramfunc" { start = hex($1) }
+        $3 == "_eramfunc" { end = hex($1) }
+        END {
+            used = end - start
+            printf "-I- ramfunc: %d of %d bytes of SRAM used (%d%%)\n", used, budget, budget ? used * 100 / budget : 0
+        }'
+    ;;
+*)
+    echo "usage: $0 select <profile> <budget> | report <budget>" >&2
+    exit 1
+    ;;
+esac
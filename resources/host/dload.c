@@ -0,0 +1,479 @@
+/**
+ * \file
+ *
+ * Host side of the serial download (see inc/download.h).
+ *
+ * Build with "make dload", then:
+ *
+ *   dload [-b baud] [-c none|sd|nand] [-w window] <tty> <name>=<file>...
+ *       Send the files, e.g. "dload -c sd /dev/ttyUSB0 Image=zImage"; the
+ *       board enters the download mode with 'd' on the console at boot.
+ *
+ *   dload -t [-o dir] <tty>
+ *       Simulate the target with the same protocol engine, writing the
+ *       images received to <dir>. With a pty pair, the whole protocol runs
+ *       on the host:
+ *           socat pty,raw,echo=0,link=/tmp/a pty,raw,echo=0,link=/tmp/b &
+ *           dload -t -o out /tmp/b & dload /tmp/a Image=zImage
+ *
+ *   -e <n> drops about one byte in <n> sent (one answer in <n>/16 in
+ *   target mode) to exercise the retransmissions.
+ */
+
+#include "download.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* Consecutive timeouts before giving up */
+#define DLOAD_RETRIES           20
+
+/* The target may be writing an image to its media when an END is sent */
+#define DLOAD_COMMIT_TIMEOUT_MS 60000
+
+/* Frame of the session */
+typedef struct
+{
+    uint8_t type ;
+    uint8_t image ;
+    uint32_t offset ;
+    uint32_t length ;
+} Slot ;
+
+typedef struct
+{
+    DownloadImage desc ;
+    const char* path ;
+    uint8_t* data ;
+} Image ;
+
+static int drop_rate ;
+static const char* out_dir = "." ;
+
+static const char* status_names[] =
+{
+    "ok", "rejected by the target", "CRC mismatch", "size mismatch", "commit failed"
+} ;
+
+static const char* status_name( uint32_t status )
+{
+    return (status < sizeof( status_names ) / sizeof( status_names[0] )) ? status_names[status] : "unknown error" ;
+}
+
+static uint64_t now_ms( void )
+{
+    struct timeval tv ;
+
+    gettimeofday( &tv, NULL ) ;
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 ;
+}
+
+static speed_t baud_code( long baud )
+{
+    switch ( baud )
+    {
+        case 115200 : return B115200 ;
+        case 230400 : return B230400 ;
+        case 460800 : return B460800 ;
+        case 921600 : return B921600 ;
+    }
+    fprintf( stderr, "dload: unsupported baudrate %ld\n", baud ) ;
+    exit( 2 ) ;
+}
+
+static int open_tty( const char* path, long baud )
+{
+    struct termios tio ;
+    int fd = open( path, O_RDWR | O_NOCTTY ) ;
+
+    if ( fd < 0 )
+    {
+        perror( path ) ;
+        exit( 1 ) ;
+    }
+    if ( tcgetattr( fd, &tio ) == 0 )
+    {
+        cfmakeraw( &tio ) ;
+        cfsetispeed( &tio, baud_code( baud ) ) ;
+        cfsetospeed( &tio, baud_code( baud ) ) ;
+        tio.c_cflag |= CLOCAL | CREAD ;
+        tio.c_cflag &= ~CRTSCTS ;
+        tcsetattr( fd, TCSANOW, &tio ) ;
+        tcflush( fd, TCIOFLUSH ) ;
+    }
+
+    return fd ;
+}
+
+static void write_all( int fd, const uint8_t* p, size_t n )
+{
+    ssize_t done ;
+
+    while ( n )
+    {
+        done = write( fd, p, n ) ;
+        if ( done < 0 )
+        {
+            if ( errno == EINTR || errno == EAGAIN )
+            {
+                continue ;
+            }
+            perror( "dload: write" ) ;
+            exit( 1 ) ;
+        }
+        p += done ;
+        n -= done ;
+    }
+}
+
+/* Send a frame, dropping bytes when asked to */
+static void send_frame( int fd, const uint8_t* p, size_t n )
+{
+    size_t i ;
+
+    if ( drop_rate == 0 )
+    {
+        write_all( fd, p, n ) ;
+        return ;
+    }
+    for ( i = 0 ; i < n ; i++ )
+    {
+        if ( rand() % drop_rate )
+        {
+            write_all( fd, p + i, 1 ) ;
+        }
+    }
+}
+
+static uint8_t* read_file( const char* path, uint32_t* size )
+{
+    FILE* f = fopen( path, "rb" ) ;
+    uint8_t* data ;
+    long n ;
+
+    if ( !f || fseek( f, 0, SEEK_END ) || (n = ftell( f )) < 0 )
+    {
+        perror( path ) ;
+        exit( 1 ) ;
+    }
+    rewind( f ) ;
+    data = malloc( n ? n : 1 ) ;
+    if ( !data || fread( data, 1, n, f ) != (size_t)n )
+    {
+        perror( path ) ;
+        exit( 1 ) ;
+    }
+    fclose( f ) ;
+    *size = (uint32_t)n ;
+
+    return data ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Sender
+ *----------------------------------------------------------------------------*/
+
+static uint32_t build_slot( uint8_t* frame, const Slot* slot, const Image* images, uint32_t k )
+{
+    const Image* image = &images[slot->image] ;
+    uint8_t hello[DOWNLOAD_HELLO_SIZE] ;
+    uint8_t flags = (k == 0) ? DOWNLOAD_FLAG_START : 0 ;
+
+    switch ( slot->type )
+    {
+        case DOWNLOAD_TYPE_HELLO :
+            return Download_BuildFrame( frame, slot->type, flags, (uint16_t)k, 0,
+                                        hello, Download_BuildHello( hello, &image->desc ) ) ;
+        case DOWNLOAD_TYPE_DATA :
+            return Download_BuildFrame( frame, slot->type, flags, (uint16_t)k, slot->offset,
+                                        image->data + slot->offset, slot->length ) ;
+        default :
+            return Download_BuildFrame( frame, slot->type, flags, (uint16_t)k, 0, NULL, 0 ) ;
+    }
+}
+
+static int send_images( int fd, long baud, Image* images, int count, uint32_t window )
+{
+    static DownloadParser parser ;
+    uint8_t frame[DOWNLOAD_MAX_FRAME] ;
+    uint8_t rx[256] ;
+    DownloadFrame answer ;
+    Slot* slots ;
+    uint32_t total = 0, base = 0, next = 0, sent = 0, k, ack ;
+    uint32_t retries = 0, resent = 0 ;
+    uint64_t bytes = 0, start, deadline ;
+    int i, timeout_ms ;
+    ssize_t n, used ;
+
+    /* Frame list of the session */
+    for ( i = 0 ; i < count ; i++ )
+    {
+        total += 2 + (images[i].desc.dwSize + DOWNLOAD_MAX_PAYLOAD - 1) / DOWNLOAD_MAX_PAYLOAD ;
+        bytes += images[i].desc.dwSize ;
+    }
+    slots = calloc( total + 1, sizeof( Slot ) ) ;
+    total = 0 ;
+    for ( i = 0 ; i < count ; i++ )
+    {
+        slots[total].type = DOWNLOAD_TYPE_HELLO ;
+        slots[total++].image = i ;
+        for ( k = 0 ; k < images[i].desc.dwSize ; k += DOWNLOAD_MAX_PAYLOAD )
+        {
+            slots[total].type = DOWNLOAD_TYPE_DATA ;
+            slots[total].image = i ;
+            slots[total].offset = k ;
+            slots[total++].length = (images[i].desc.dwSize - k < DOWNLOAD_MAX_PAYLOAD) ? images[i].desc.dwSize - k : DOWNLOAD_MAX_PAYLOAD ;
+        }
+        slots[total].type = DOWNLOAD_TYPE_END ;
+        slots[total++].image = i ;
+    }
+    slots[total++].type = DOWNLOAD_TYPE_BYE ;
+
+    /* Time for the window to go through the line, and back */
+    timeout_ms = (int)((uint64_t)window * DOWNLOAD_MAX_FRAME * 10 * 2 * 1000 / baud) + 200 ;
+
+    start = now_ms() ;
+    deadline = start + timeout_ms ;
+    while ( base < total )
+    {
+        while ( (next < total) && (next < base + window) )
+        {
+            if ( next == sent && slots[next].type == DOWNLOAD_TYPE_HELLO )
+            {
+                fprintf( stderr, "dload: sending %s (%u bytes)\n", images[slots[next].image].desc.pName,
+                         (unsigned)images[slots[next].image].desc.dwSize ) ;
+            }
+            send_frame( fd, frame, build_slot( frame, &slots[next], images, next ) ) ;
+            next++ ;
+            if ( next > sent )
+            {
+                sent = next ;
+            }
+        }
+
+        /* An END is answered once the image is written to the media */
+        if ( slots[base].type == DOWNLOAD_TYPE_END && deadline < now_ms() + DLOAD_COMMIT_TIMEOUT_MS / DLOAD_RETRIES )
+        {
+            deadline = now_ms() + DLOAD_COMMIT_TIMEOUT_MS / DLOAD_RETRIES ;
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 } ;
+        int wait = (int)(deadline > now_ms() ? deadline - now_ms() : 0) ;
+        if ( poll( &pfd, 1, wait ) <= 0 )
+        {
+            if ( ++retries > DLOAD_RETRIES )
+            {
+                fprintf( stderr, "dload: no answer from the target\n" ) ;
+                return 1 ;
+            }
+            resent += next - base ;
+            next = base ;
+            deadline = now_ms() + timeout_ms ;
+            continue ;
+        }
+
+        n = read( fd, rx, sizeof( rx ) ) ;
+        if ( n <= 0 )
+        {
+            continue ;
+        }
+        for ( used = 0 ; used < n ; )
+        {
+            used += Download_Parse( &parser, rx + used, n - used, &answer ) ;
+            if ( answer.bType == 0 )
+            {
+                continue ;
+            }
+            /* Sequence numbers are 16-bit, the window is far smaller */
+            ack = base + (int16_t)(answer.wSeq - (uint16_t)base) ;
+            if ( answer.dwArg != DOWNLOAD_STATUS_OK && ack > base && ack <= next )
+            {
+                fprintf( stderr, "dload: %s: %s\n", images[slots[ack - 1].image].desc.pName, status_name( answer.dwArg ) ) ;
+                return 1 ;
+            }
+            if ( answer.bType == DOWNLOAD_TYPE_ACK && ack > base && ack <= next )
+            {
+                base = ack ;
+                retries = 0 ;
+                deadline = now_ms() + timeout_ms ;
+            }
+            else if ( answer.bType == DOWNLOAD_TYPE_NAK && ack >= base && ack < next )
+            {
+                base = ack ;
+                resent += next - ack ;
+                next = ack ;
+                deadline = now_ms() + timeout_ms ;
+            }
+        }
+    }
+
+    k = (uint32_t)(now_ms() - start) ;
+    fprintf( stderr, "dload: %llu bytes in %u ms (%llu bytes/s), %u frames sent again, %u bad answers\n",
+             (unsigned long long)bytes, (unsigned)k, (unsigned long long)(bytes * 1000 / (k ? k : 1)),
+             (unsigned)resent, (unsigned)parser.dwErrors ) ;
+    free( slots ) ;
+
+    return 0 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Simulated target
+ *----------------------------------------------------------------------------*/
+
+static uint8_t* target_open( void* arg, const DownloadImage* image )
+{
+    (void)arg ;
+    if ( image->pName[0] == 0 || strchr( image->pName, '/' ) )
+    {
+        return NULL ;
+    }
+
+    return malloc( image->dwSize ? image->dwSize : 1 ) ;
+}
+
+static uint32_t target_close( void* arg, const DownloadImage* image, uint8_t* data )
+{
+    char path[512] ;
+    FILE* f ;
+    int ok ;
+
+    (void)arg ;
+    snprintf( path, sizeof( path ), "%s/%s", out_dir, image->pName ) ;
+    f = fopen( path, "wb" ) ;
+    ok = f && fwrite( data, 1, image->dwSize, f ) == image->dwSize ;
+    if ( f )
+    {
+        fclose( f ) ;
+    }
+    free( data ) ;
+    fprintf( stderr, "dload: received %s (%u bytes, CRC %08X, commit %u)\n", image->pName,
+             (unsigned)image->dwSize, (unsigned)image->dwCrc, (unsigned)image->bCommit ) ;
+
+    return ok ? DOWNLOAD_STATUS_OK : DOWNLOAD_STATUS_COMMIT ;
+}
+
+static void target_send( void* arg, const uint8_t* frame, uint32_t size )
+{
+    if ( drop_rate >= 16 && rand() % (drop_rate / 16) == 0 )
+    {
+        return ;
+    }
+    write_all( *(int*)arg, frame, size ) ;
+}
+
+static int run_target( int fd )
+{
+    static DownloadReceiver receiver ;
+    uint8_t rx[4096] ;
+    ssize_t n, i, j ;
+
+    Download_InitReceiver( &receiver, target_open, target_close, target_send, &fd ) ;
+    while ( 1 )
+    {
+        n = read( fd, rx, sizeof( rx ) ) ;
+        if ( n < 0 && errno != EINTR && errno != EAGAIN )
+        {
+            perror( "dload: read" ) ;
+            return 1 ;
+        }
+        /* Line noise: drop bytes */
+        for ( i = j = 0 ; i < n ; i++ )
+        {
+            if ( drop_rate == 0 || rand() % drop_rate )
+            {
+                rx[j++] = rx[i] ;
+            }
+        }
+        if ( j > 0 && Download_Input( &receiver, rx, (uint32_t)j ) )
+        {
+            break ;
+        }
+    }
+    /* Let the last ACK go out */
+    tcdrain( fd ) ;
+    fprintf( stderr, "dload: session done, %u frames, %u bad, %u NAKs, %u duplicates\n",
+             (unsigned)receiver.dwFrames, (unsigned)receiver.parser.dwErrors,
+             (unsigned)receiver.dwNaks, (unsigned)receiver.dwDuplicates ) ;
+
+    return 0 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Main
+ *----------------------------------------------------------------------------*/
+
+static void usage( void )
+{
+    fprintf( stderr, "usage: dload [-b baud] [-c none|sd|nand] [-w window] [-e n] <tty> <name>=<file>...\n"
+                     "       dload -t [-o dir] [-e n] <tty>\n" ) ;
+    exit( 2 ) ;
+}
+
+int main( int argc, char** argv )
+{
+    Image images[16] ;
+    long baud = 921600 ;
+    uint32_t window = DOWNLOAD_WINDOW ;
+    uint8_t commit = DOWNLOAD_COMMIT_NONE ;
+    int target = 0, count = 0, fd, c ;
+    char* eq ;
+
+    while ( (c = getopt( argc, argv, "b:c:w:e:to:" )) != -1 )
+    {
+        switch ( c )
+        {
+            case 'b' : baud = strtol( optarg, NULL, 0 ) ; break ;
+            case 'w' : window = (uint32_t)strtoul( optarg, NULL, 0 ) ; break ;
+            case 'e' : drop_rate = atoi( optarg ) ; break ;
+            case 't' : target = 1 ; break ;
+            case 'o' : out_dir = optarg ; break ;
+            case 'c' :
+                if ( !strcmp( optarg, "sd" ) ) commit = DOWNLOAD_COMMIT_SD ;
+                else if ( !strcmp( optarg, "nand" ) ) commit = DOWNLOAD_COMMIT_NAND ;
+                else if ( strcmp( optarg, "none" ) ) usage() ;
+            break ;
+            default : usage() ;
+        }
+    }
+    if ( optind >= argc || window == 0 || window > 0x7FFF )
+    {
+        usage() ;
+    }
+    srand( 1 ) ;
+    fd = open_tty( argv[optind++], baud ) ;
+
+    if ( target )
+    {
+        mkdir( out_dir, 0777 ) ;
+        return run_target( fd ) ;
+    }
+
+    for ( ; optind < argc && count < 16 ; optind++, count++ )
+    {
+        eq = strchr( argv[optind], '=' ) ;
+        if ( !eq || eq == argv[optind] || eq - argv[optind] > DOWNLOAD_NAME_SIZE )
+        {
+            usage() ;
+        }
+        memset( &images[count], 0, sizeof( Image ) ) ;
+        memcpy( images[count].desc.pName, argv[optind], eq - argv[optind] ) ;
+        images[count].path = eq + 1 ;
+        images[count].data = read_file( eq + 1, &images[count].desc.dwSize ) ;
+        images[count].desc.dwCrc = Download_Crc32( 0, images[count].data, images[count].desc.dwSize ) ;
+        images[count].desc.bCommit = commit ;
+    }
+    if ( count == 0 )
+    {
+        usage() ;
+    }
+
+    return send_images( fd, baud, images, count, window ) ;
+}
@@ -0,0 +1,561 @@
+/**
+ * \file
+ *
+ * Host test bench of the DMA memory copy/fill service (see inc/dma_mem.h).
+ *
+ * Build with "make dmasim", then:
+ *
+ *   dmasim
+ *       Run DMA_Memcpy() and DMA_Memset() over a set of sizes and alignments:
+ *       CPU-only requests, one descriptor, one full chain of DMAMEM_NUM_LLI
+ *       descriptors and ranges of several chains that the handler re-arms on
+ *       each Chained Buffer Transfer Completed interrupt. Each result is
+ *       compared with a reference, with guard bytes around the destination.
+ *       Then an AHB error is injected on the second chain of a transfer and
+ *       a request is made while the channel is busy.
+ *
+ * The DMAC is replaced by a model of the channel behind the DMA_xxx
+ * functions: it fetches the descriptors like the controller, checks them
+ * (transfer size, widths, alignment, flow control, chaining, chain length),
+ * moves the data, and raises CBTC (or ERR) to DMA_MemHandler() as the
+ * interrupt handler does. A channel reprogrammed while enabled, a chain
+ * started without its interrupt enabled, or a transfer that never completes
+ * fails the run.
+ *
+ * The image is linked at 0x20000000 and the buffers are mapped at
+ * SIM_MEMORY_ADDR, inside the DMAC range of the service and below 4 GB, the
+ * descriptors holding 32-bit addresses.
+ */
+
+#include "board.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE     MAP_FIXED
+#endif
+
+/* Memory standing for the SDRAM of the board */
+#define SIM_MEMORY_ADDR         0x60000000
+#define SIM_MEMORY_SIZE         (16 * 1024 * 1024)
+#define SIM_SRC_OFFSET          0
+#define SIM_DST_OFFSET          (8 * 1024 * 1024)
+#define SIM_GUARD               64
+
+/* Bytes moved by one descriptor and by one chain */
+#define SIM_LLI_BYTES           (DMAMEM_LLI_WORDS * 4)
+#define SIM_CHAIN_BYTES         (DMAMEM_NUM_LLI * SIM_LLI_BYTES)
+
+/* Interrupt sources of the memory channel */
+#define SIM_CBTC                (DMAC_EBCISR_CBTC0 << BOARD_MEM_DMA_CHANNEL)
+#define SIM_ERR                 (DMAC_EBCISR_ERR0 << BOARD_MEM_DMA_CHANNEL)
+
+typedef struct
+{
+    uint32_t saddr ;
+    uint32_t daddr ;
+    uint32_t dscr ;
+    uint32_t cfg ;
+    uint32_t enabled ;
+    uint32_t configured ;
+} SimChannel ;
+
+typedef struct
+{
+    SimChannel channel ;
+    uint32_t it_mask ;
+
+    /* Chain of the transfer (1-based) ending with an AHB error, 0 for none */
+    uint32_t error_chain ;
+
+    /* Statistics */
+    uint32_t chains ;
+    uint32_t llis ;
+    uint32_t words ;
+    uint32_t violations ;
+} Sim ;
+
+typedef struct
+{
+    uint32_t calls ;
+    uint32_t status ;
+} Completion ;
+
+typedef struct
+{
+    /* DMA_Memset() of value, else DMA_Memcpy() */
+    uint32_t fill ;
+    uint32_t value ;
+    uint32_t dst ;
+    uint32_t src ;
+    uint32_t size ;
+} Case ;
+
+static Sim sim ;
+static uint8_t* memory ;
+static uint8_t* reference ;
+
+static void violation( const char* text )
+{
+    fprintf( stderr, "dmasim: %s\n", text ) ;
+    sim.violations++ ;
+}
+
+static void* to_pointer( uint32_t address )
+{
+    return (void*)(uintptr_t)address ;
+}
+
+/*----------------------------------------------------------------------------
+ *        DMAC model
+ *----------------------------------------------------------------------------*/
+
+static void check_channel( Dmac* pDmac, uint32_t dwChannel )
+{
+    if ( (pDmac != DMAC) || (dwChannel != BOARD_MEM_DMA_CHANNEL) )
+    {
+        violation( "access to another channel" ) ;
+    }
+}
+
+static void check_disabled( Dmac* pDmac, uint32_t dwChannel )
+{
+    check_channel( pDmac, dwChannel ) ;
+    if ( sim.channel.enabled )
+    {
+        violation( "channel reprogrammed while enabled" ) ;
+    }
+    sim.channel.configured = 1 ;
+}
+
+extern void DMAD_Initialize( uint32_t dwChannel, uint32_t defaultHandler )
+{
+    check_channel( DMAC, dwChannel ) ;
+    memset( &sim.channel, 0, sizeof( sim.channel ) ) ;
+}
+
+extern void DMA_EnableIt( Dmac* pDmac, uint32_t dwFlag )
+{
+    sim.it_mask |= dwFlag ;
+}
+
+extern void DMA_DisableIt( Dmac* pDmac, uint32_t dwFlag )
+{
+    sim.it_mask &= ~dwFlag ;
+}
+
+extern void DMA_EnableChannel( Dmac* pDmac, uint32_t dwChannel )
+{
+    check_channel( pDmac, dwChannel ) ;
+    if ( !sim.channel.configured )
+    {
+        violation( "channel enabled before it is programmed" ) ;
+    }
+    if ( (sim.it_mask & (SIM_CBTC | SIM_ERR)) != (SIM_CBTC | SIM_ERR) )
+    {
+        violation( "channel enabled without its CBTC and ERR interrupts" ) ;
+    }
+    sim.channel.enabled = 1 ;
+}
+
+extern void DMA_DisableChannel( Dmac* pDmac, uint32_t dwChannel )
+{
+    check_channel( pDmac, dwChannel ) ;
+    sim.channel.enabled = 0 ;
+}
+
+extern void DMA_SetSourceAddr( Dmac* pDmac, uint32_t dwChannel, uint32_t dwAddress )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    sim.channel.saddr = dwAddress ;
+}
+
+extern void DMA_SetDestinationAddr( Dmac* pDmac, uint32_t dwChannel, uint32_t dwAddress )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    sim.channel.daddr = dwAddress ;
+}
+
+extern void DMA_SetDescriptorAddr( Dmac* pDmac, uint32_t dwChannel, uint32_t dwAddress )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    sim.channel.dscr = dwAddress ;
+}
+
+extern void DMA_SetSourceBufferMode( Dmac* pDmac, uint32_t dwChannel, uint32_t dwTransferMode, uint32_t dwAddressingType )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    if ( dwTransferMode != DMA_TRANSFER_LLI )
+    {
+        violation( "source not in linked list mode" ) ;
+    }
+}
+
+extern void DMA_SetDestBufferMode( Dmac* pDmac, uint32_t dwChannel, uint32_t dwTransferMode, uint32_t dwAddressingType )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    if ( dwTransferMode != DMA_TRANSFER_LLI )
+    {
+        violation( "destination not in linked list mode" ) ;
+    }
+}
+
+extern void DMA_SetFlowControl( Dmac* pDmac, uint32_t dwChannel, uint32_t dwFlow )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    if ( dwFlow != (DMAC_CTRLB_FC_MEM2MEM_DMA_FC >> 21) )
+    {
+        violation( "flow control is not memory to memory" ) ;
+    }
+}
+
+extern void DMA_SetConfiguration( Dmac* pDmac, uint32_t dwChannel, uint32_t dwValue )
+{
+    check_disabled( pDmac, dwChannel ) ;
+    if ( (dwValue & (DMAC_CFG_SRC_H2SEL | DMAC_CFG_DST_H2SEL)) != (DMAC_CFG_SRC_H2SEL_SW | DMAC_CFG_DST_H2SEL_SW) )
+    {
+        violation( "hardware handshaking on a memory transfer" ) ;
+    }
+    sim.channel.cfg = dwValue ;
+}
+
+/* Checks one descriptor fetched by the controller */
+static void check_lli( const DmaLinkList* pLli )
+{
+    uint32_t dwWords = pLli->controlA & DMAC_CTRLA_BTSIZE_Msk ;
+
+    if ( (dwWords == 0) || (dwWords > DMAMEM_LLI_WORDS) )
+    {
+        violation( "descriptor transfer size out of range" ) ;
+    }
+    if ( (pLli->controlA & (DMAC_CTRLA_SRC_WIDTH_Msk | DMAC_CTRLA_DST_WIDTH_Msk))
+         != (DMAC_CTRLA_SRC_WIDTH_WORD | DMAC_CTRLA_DST_WIDTH_WORD) )
+    {
+        violation( "descriptor widths are not words" ) ;
+    }
+    if ( (pLli->sourceAddress | pLli->destAddress) & 3 )
+    {
+        violation( "descriptor address not word aligned" ) ;
+    }
+    if ( (pLli->controlB & DMAC_CTRLB_FC_Msk) != DMAC_CTRLB_FC_MEM2MEM_DMA_FC )
+    {
+        violation( "descriptor flow control is not memory to memory" ) ;
+    }
+    if ( (pLli->controlB & (DMAC_CTRLB_SRC_DSCR | DMAC_CTRLB_DST_DSCR))
+         != (DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM) )
+    {
+        violation( "descriptor does not fetch the next one" ) ;
+    }
+    if ( (pLli->descriptor != 0) && (pLli->descriptor != (uint32_t)(uintptr_t)(pLli + 1)) )
+    {
+        violation( "descriptor not chained to the next table entry" ) ;
+    }
+}
+
+/*
+ * Runs the chain programmed on the channel, as the controller does, then
+ * calls the handler with the interrupt status. Returns 0 when the channel
+ * is not enabled.
+ */
+static int run_chain( void )
+{
+    const DmaLinkList* pLli ;
+    uint32_t dwStatus = SIM_CBTC ;
+    uint32_t dwLlis = 0 ;
+    uint32_t dwWords ;
+    uint32_t* pSrc ;
+    uint32_t* pDst ;
+    uint32_t i ;
+
+    if ( !sim.channel.enabled )
+    {
+        return 0 ;
+    }
+    sim.chains++ ;
+
+    for ( pLli = to_pointer( sim.channel.dscr ) ; pLli ; pLli = to_pointer( pLli->descriptor ) )
+    {
+        if ( ++dwLlis > DMAMEM_NUM_LLI )
+        {
+            violation( "chain longer than DMAMEM_NUM_LLI" ) ;
+            break ;
+        }
+        check_lli( pLli ) ;
+        if ( (dwLlis == 1) && ((pLli->sourceAddress != sim.channel.saddr) || (pLli->destAddress != sim.channel.daddr)) )
+        {
+            violation( "channel addresses differ from the first descriptor" ) ;
+        }
+
+        dwWords = pLli->controlA & DMAC_CTRLA_BTSIZE_Msk ;
+        pSrc = to_pointer( pLli->sourceAddress ) ;
+        pDst = to_pointer( pLli->destAddress ) ;
+        for ( i = 0 ; i < dwWords ; i++ )
+        {
+            pDst[i] = *pSrc ;
+            if ( (pLli->controlB & DMAC_CTRLB_SRC_INCR_Msk) != DMAC_CTRLB_SRC_INCR_FIXED )
+            {
+                pSrc++ ;
+            }
+        }
+        sim.llis++ ;
+        sim.words += dwWords ;
+
+        if ( sim.chains == sim.error_chain )
+        {
+            dwStatus = SIM_ERR ;
+            break ;
+        }
+    }
+
+    /* The channel stops at the end of the chain */
+    sim.channel.enabled = 0 ;
+
+    if ( (sim.it_mask & dwStatus) == 0 )
+    {
+        violation( "chain ended with its interrupt disabled" ) ;
+        return 0 ;
+    }
+    DMA_MemHandler( dwStatus ) ;
+
+    return 1 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Test cases
+ *----------------------------------------------------------------------------*/
+
+static void on_complete( void* pArg, uint32_t dwStatus )
+{
+    Completion* pCompletion = pArg ;
+
+    pCompletion->calls++ ;
+    pCompletion->status = dwStatus ;
+}
+
+static uint8_t pattern( uint32_t offset )
+{
+    return (uint8_t)((offset * 7) ^ (offset >> 8)) ;
+}
+
+/* Prepares the source, the destination and the expected destination */
+static void prepare( const Case* pCase )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < pCase->size + 2 * SIM_GUARD ; i++ )
+    {
+        memory[SIM_SRC_OFFSET + pCase->src + i] = pattern( i ) ;
+    }
+    memset( memory + SIM_DST_OFFSET, 0xA5, pCase->dst + pCase->size + 2 * SIM_GUARD ) ;
+    memset( reference, 0xA5, pCase->dst + pCase->size + 2 * SIM_GUARD ) ;
+    if ( pCase->fill )
+    {
+        memset( reference + SIM_GUARD + pCase->dst, pCase->value, pCase->size ) ;
+    }
+    else
+    {
+        memcpy( reference + SIM_GUARD + pCase->dst, memory + SIM_SRC_OFFSET + SIM_GUARD + pCase->src, pCase->size ) ;
+    }
+}
+
+/* Waits for the transfer like DMA_MemWait(), running the chains */
+static int wait_transfer( void )
+{
+    while ( !DMA_MemIsFinished() )
+    {
+        if ( !run_chain() )
+        {
+            violation( "transfer pending without a chain to run" ) ;
+            return 1 ;
+        }
+    }
+    if ( sim.channel.enabled )
+    {
+        violation( "channel left enabled after the transfer" ) ;
+    }
+
+    return 0 ;
+}
+
+static int run_case( const Case* pCase )
+{
+    uint8_t* pDst = memory + SIM_DST_OFFSET + SIM_GUARD + pCase->dst ;
+    const uint8_t* pSrc = memory + SIM_SRC_OFFSET + SIM_GUARD + pCase->src ;
+    Completion completion = { 0, 0xFF } ;
+    uint32_t dwDma ;
+    uint32_t dwHead ;
+    uint32_t dwBody = 0 ;
+    uint32_t dwChains = 0 ;
+    uint32_t dwLlis = 0 ;
+    int errors = 0 ;
+
+    prepare( pCase ) ;
+    sim.chains = sim.llis = sim.words = 0 ;
+
+    if ( pCase->fill )
+    {
+        dwDma = DMA_Memset( pDst, pCase->value, pCase->size, on_complete, &completion ) ;
+    }
+    else
+    {
+        dwDma = DMA_Memcpy( pDst, pSrc, pCase->size, on_complete, &completion ) ;
+    }
+    errors += wait_transfer() ;
+
+    /* Expected work of the controller */
+    if ( (pCase->size >= DMAMEM_CPU_THRESHOLD) && (pCase->fill || (((pCase->dst ^ pCase->src) & 3) == 0)) )
+    {
+        dwHead = (4 - ((uint32_t)(uintptr_t)pDst & 3)) & 3 ;
+        dwBody = (pCase->size - dwHead) / 4 ;
+        dwLlis = (dwBody + DMAMEM_LLI_WORDS - 1) / DMAMEM_LLI_WORDS ;
+        dwChains = (dwLlis + DMAMEM_NUM_LLI - 1) / DMAMEM_NUM_LLI ;
+    }
+    if ( (dwDma != (dwBody != 0)) || (sim.words != dwBody) || (sim.llis != dwLlis) || (sim.chains != dwChains) )
+    {
+        fprintf( stderr, "dmasim: expected %u words in %u descriptor(s), %u chain(s); got %u, %u, %u\n",
+                 dwBody, dwLlis, dwChains, sim.words, sim.llis, sim.chains ) ;
+        errors++ ;
+    }
+    if ( (completion.calls != 1) || (completion.status != DMAMEM_STATUS_SUCCESS) )
+    {
+        fprintf( stderr, "dmasim: callback called %u time(s), status %u\n", completion.calls, completion.status ) ;
+        errors++ ;
+    }
+    if ( DMA_MemWait() != DMAMEM_STATUS_SUCCESS )
+    {
+        fprintf( stderr, "dmasim: DMA_MemWait() reports an error\n" ) ;
+        errors++ ;
+    }
+    if ( memcmp( memory + SIM_DST_OFFSET, reference, pCase->dst + pCase->size + 2 * SIM_GUARD ) )
+    {
+        fprintf( stderr, "dmasim: destination differs from the reference\n" ) ;
+        errors++ ;
+    }
+
+    printf( "dmasim: %s %8u bytes dst+%u src+%u: %s, %u words, %u descriptor(s), %u chain(s)%s\n",
+            pCase->fill ? "fill" : "copy", pCase->size, pCase->dst, pCase->src,
+            dwDma ? "DMA" : "CPU", sim.words, sim.llis, sim.chains, errors ? " FAILED" : "" ) ;
+
+    return errors ;
+}
+
+/* AHB error on the second chain: the transfer ends once with the error */
+static int run_error( void )
+{
+    Case error = { 0, 0, 0, 0, 3 * SIM_CHAIN_BYTES } ;
+    Completion completion = { 0, 0xFF } ;
+    int errors = 0 ;
+
+    prepare( &error ) ;
+    sim.chains = sim.llis = sim.words = 0 ;
+    sim.error_chain = 2 ;
+    DMA_Memcpy( memory + SIM_DST_OFFSET + SIM_GUARD, memory + SIM_SRC_OFFSET + SIM_GUARD, error.size, on_complete, &completion ) ;
+    errors += wait_transfer() ;
+    sim.error_chain = 0 ;
+
+    if ( (completion.calls != 1) || (completion.status != DMAMEM_STATUS_ERROR) || (sim.chains != 2) )
+    {
+        fprintf( stderr, "dmasim: AHB error: callback called %u time(s), status %u, %u chain(s)\n",
+                 completion.calls, completion.status, sim.chains ) ;
+        errors++ ;
+    }
+    if ( sim.it_mask & (SIM_CBTC | SIM_ERR) )
+    {
+        fprintf( stderr, "dmasim: AHB error: interrupts left enabled\n" ) ;
+        errors++ ;
+    }
+    if ( DMA_MemWait() != DMAMEM_STATUS_ERROR )
+    {
+        fprintf( stderr, "dmasim: AHB error: DMA_MemWait() reports success\n" ) ;
+        errors++ ;
+    }
+    /* The next transfer starts with a clean status */
+    DMA_Memset( memory + SIM_DST_OFFSET, 0, DMAMEM_CPU_THRESHOLD - 1, NULL, NULL ) ;
+    if ( DMA_MemWait() != DMAMEM_STATUS_SUCCESS )
+    {
+        fprintf( stderr, "dmasim: AHB error: status kept by the next transfer\n" ) ;
+        errors++ ;
+    }
+    printf( "dmasim: AHB error on chain 2 reported after %u descriptor(s)%s\n", sim.llis, errors ? " FAILED" : "" ) ;
+
+    return errors ;
+}
+
+/* A request made while the channel is busy is done by the CPU at once */
+static int run_busy( void )
+{
+    Case first = { 0, 0, 0, 0, 2 * SIM_CHAIN_BYTES } ;
+    Completion completion = { 0, 0xFF } ;
+    Completion second = { 0, 0xFF } ;
+    uint8_t* pOther = memory + SIM_DST_OFFSET + 2 * SIM_GUARD + first.size ;
+    int errors = 0 ;
+
+    prepare( &first ) ;
+    sim.chains = sim.llis = sim.words = 0 ;
+    DMA_Memcpy( memory + SIM_DST_OFFSET + SIM_GUARD, memory + SIM_SRC_OFFSET + SIM_GUARD, first.size, on_complete, &completion ) ;
+    if ( DMA_Memset( pOther, 0x3C, 4096, on_complete, &second ) || (second.calls != 1) || (pOther[4095] != 0x3C) )
+    {
+        fprintf( stderr, "dmasim: busy channel: request not done by the CPU\n" ) ;
+        errors++ ;
+    }
+    errors += wait_transfer() ;
+    if ( (completion.calls != 1) || (sim.chains != 2)
+         || memcmp( memory + SIM_DST_OFFSET, reference, first.size + 2 * SIM_GUARD ) )
+    {
+        fprintf( stderr, "dmasim: busy channel: first transfer disturbed\n" ) ;
+        errors++ ;
+    }
+    printf( "dmasim: request on a busy channel done by the CPU%s\n", errors ? " FAILED" : "" ) ;
+
+    return errors ;
+}
+
+int main( int argc, char** argv )
+{
+    static const Case cases[] =
+    {
+        { 0, 0,    0, 0, DMAMEM_CPU_THRESHOLD - 1 },
+        { 0, 0,    0, 0, DMAMEM_CPU_THRESHOLD },
+        { 0, 0,    1, 1, DMAMEM_CPU_THRESHOLD + 1 },
+        { 0, 0,    2, 1, 4096 },
+        { 0, 0,    0, 0, SIM_LLI_BYTES },
+        { 0, 0,    3, 3, SIM_LLI_BYTES + 4 },
+        { 0, 0,    0, 0, SIM_CHAIN_BYTES - 4 },
+        { 0, 0,    0, 0, SIM_CHAIN_BYTES },
+        { 0, 0,    0, 0, SIM_CHAIN_BYTES + 4 },
+        { 0, 0,    1, 1, SIM_CHAIN_BYTES + 1 },
+        { 0, 0,    1, 1, 3 * SIM_CHAIN_BYTES + 7 },
+        { 1, 0x5A, 0, 0, DMAMEM_CPU_THRESHOLD - 1 },
+        { 1, 0x5A, 2, 0, 4097 },
+        { 1, 0x00, 0, 0, SIM_CHAIN_BYTES },
+        { 1, 0xFF, 3, 0, 2 * SIM_CHAIN_BYTES + 5 },
+    } ;
+    uint32_t i ;
+    int errors = 0 ;
+
+    memory = mmap( to_pointer( SIM_MEMORY_ADDR ), SIM_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 ) ;
+    reference = malloc( SIM_MEMORY_SIZE - SIM_DST_OFFSET ) ;
+    if ( (memory != to_pointer( SIM_MEMORY_ADDR )) || !reference )
+    {
+        fprintf( stderr, "dmasim: cannot map the memory at 0x%08X\n", SIM_MEMORY_ADDR ) ;
+        return 1 ;
+    }
+
+    DMA_MemInitialize() ;
+    for ( i = 0 ; i < sizeof( cases ) / sizeof( cases[0] ) ; i++ )
+    {
+        errors += run_case( &cases[i] ) ;
+    }
+    errors += run_error() ;
+    errors += run_busy() ;
+
+    printf( "dmasim: %u errors, %u violations\n", errors, sim.violations ) ;
+    munmap( memory, SIM_MEMORY_SIZE ) ;
+    free( reference ) ;
+
+    return (errors || sim.violations) ? 1 : 0 ;
+}
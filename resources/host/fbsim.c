@@ -0,0 +1,409 @@
+/**
+ * \file
+ *
+ * Host golden-image test of the software frame buffer (see frame_buffer.c).
+ *
+ * Build with "make fbsim", then:
+ *
+ *   fbsim [-n primitives] [-s seed]
+ *       Draw <primitives> random primitives (3000 by default): pixels, lines,
+ *       rectangles, filled rectangles, circles, filled circles and pictures,
+ *       partly or wholly outside of a frame buffer of odd width that starts on
+ *       a half word. Each primitive is also drawn by a per-pixel reference
+ *       rasteriser (the algorithms of frame_buffer.c before the span
+ *       rasteriser, with every pixel clipped on its own) in a golden image,
+ *       and the frame buffer is compared with it after each primitive.
+ *
+ *       FB_Flush() is called at random points. After each flush the window
+ *       of the panel model (see lcdsim.h) must show the golden image, and the
+ *       panel outside of the window must be untouched.
+ *
+ * The run reports the pixels sent by the flushes against a flush of the
+ * whole frame buffer, and fails on the first primitive that differs from the
+ * golden image, on a flush that leaves the panel wrong, or when the panel
+ * model reports a bus violation.
+ */
+
+#include "lcdsim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Frame buffer size and position on the panel */
+#define SIM_WIDTH               203
+#define SIM_HEIGHT              151
+#define SIM_PANEL_X             60
+#define SIM_PANEL_Y             40
+
+/* Primitives may start that far outside of the frame buffer */
+#define SIM_MARGIN              40
+#define SIM_MAX_PICTURE         64
+#define SIM_MAX_RADIUS          80
+
+#define SIM_PANEL_COLOR         0x5AA5
+
+/* Frame buffer, one half word off a word boundary, and its golden image */
+static LcdColor_t storage[SIM_WIDTH * SIM_HEIGHT + 2] __attribute__((aligned(4))) ;
+static LcdColor_t* const pFb = &storage[1] ;
+static LcdColor_t ref[SIM_HEIGHT][SIM_WIDTH] ;
+static LcdColor_t refColor ;
+
+static LcdColor_t picture[SIM_MAX_PICTURE * SIM_MAX_PICTURE] ;
+
+static uint32_t errors ;
+
+/*----------------------------------------------------------------------------
+ *        Reference rasteriser
+ *----------------------------------------------------------------------------*/
+
+static void ref_pixel( int32_t x, int32_t y )
+{
+    if ( (x >= 0) && (y >= 0) && (x < SIM_WIDTH) && (y < SIM_HEIGHT) )
+    {
+        ref[y][x] = refColor ;
+    }
+}
+
+static void ref_filled_rectangle( int32_t x1, int32_t y1, int32_t x2, int32_t y2 )
+{
+    int32_t x, y ;
+
+    for ( y = (y1 < y2 ? y1 : y2) ; y <= (y1 < y2 ? y2 : y1) ; y++ )
+    {
+        for ( x = (x1 < x2 ? x1 : x2) ; x <= (x1 < x2 ? x2 : x1) ; x++ )
+        {
+            ref_pixel( x, y ) ;
+        }
+    }
+}
+
+static void ref_line( int32_t x1, int32_t y1, int32_t x2, int32_t y2 )
+{
+    int32_t dx, dy ;
+    int32_t i ;
+    int32_t xinc, yinc, cumul ;
+    int32_t x = x1, y = y1 ;
+
+    if ( (x1 == x2) || (y1 == y2) )
+    {
+        ref_filled_rectangle( x1, y1, x2, y2 ) ;
+        return ;
+    }
+
+    dx = x2 - x1 ;
+    dy = y2 - y1 ;
+    xinc = ( dx > 0 ) ? 1 : -1 ;
+    yinc = ( dy > 0 ) ? 1 : -1 ;
+    dx = ( dx > 0 ) ? dx : -dx ;
+    dy = ( dy > 0 ) ? dy : -dy ;
+
+    ref_pixel( x, y ) ;
+    if ( dx > dy )
+    {
+        cumul = dx / 2 ;
+        for ( i = 1 ; i <= dx ; i++ )
+        {
+            x += xinc ;
+            cumul += dy ;
+            if ( cumul >= dx )
+            {
+                cumul -= dx ;
+                y += yinc ;
+            }
+            ref_pixel( x, y ) ;
+        }
+    }
+    else
+    {
+        cumul = dy / 2 ;
+        for ( i = 1 ; i <= dy ; i++ )
+        {
+            y += yinc ;
+            cumul += dx ;
+            if ( cumul >= dy )
+            {
+                cumul -= dy ;
+                x += xinc ;
+            }
+            ref_pixel( x, y ) ;
+        }
+    }
+}
+
+static void ref_circle( int32_t x, int32_t y, int32_t r, int filled )
+{
+    int32_t d = 3 - (r << 1) ;
+    int32_t curX = 0 ;
+    int32_t curY = r ;
+    int32_t i ;
+
+    if ( r == 0 )
+    {
+        return ;
+    }
+
+    while ( curX <= curY )
+    {
+        if ( filled )
+        {
+            for ( i = -curX ; i <= curX ; i++ )
+            {
+                ref_pixel( x + i, y - curY ) ;
+                ref_pixel( x + i, y + curY ) ;
+            }
+            for ( i = -curY ; i <= curY ; i++ )
+            {
+                ref_pixel( x + i, y - curX ) ;
+                ref_pixel( x + i, y + curX ) ;
+            }
+        }
+        else
+        {
+            ref_pixel( x + curX, y + curY ) ;
+            ref_pixel( x + curX, y - curY ) ;
+            ref_pixel( x - curX, y + curY ) ;
+            ref_pixel( x - curX, y - curY ) ;
+            ref_pixel( x + curY, y + curX ) ;
+            ref_pixel( x + curY, y - curX ) ;
+            ref_pixel( x - curY, y + curX ) ;
+            ref_pixel( x - curY, y - curX ) ;
+        }
+
+        if ( d < 0 )
+        {
+            d += (curX << 2) + 6 ;
+        }
+        else
+        {
+            d += ((curX - curY) << 2) + 10 ;
+            curY-- ;
+        }
+        curX++ ;
+    }
+}
+
+/* The picture covers the box, whatever the order of the corners */
+static void ref_picture( int32_t x1, int32_t y1, int32_t x2, int32_t y2 )
+{
+    int32_t px = (x1 < x2) ? x1 : x2 ;
+    int32_t py = (y1 < y2) ? y1 : y2 ;
+    int32_t pw = ((x1 < x2) ? x2 - x1 : x1 - x2) + 1 ;
+    int32_t ph = ((y1 < y2) ? y2 - y1 : y1 - y2) + 1 ;
+    int32_t x, y ;
+
+    for ( y = 0 ; y < ph ; y++ )
+    {
+        for ( x = 0 ; x < pw ; x++ )
+        {
+            if ( (px + x >= 0) && (py + y >= 0) && (px + x < SIM_WIDTH) && (py + y < SIM_HEIGHT) )
+            {
+                ref[py + y][px + x] = picture[y * pw + x] ;
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Checks
+ *----------------------------------------------------------------------------*/
+
+static int32_t coordinate( int32_t size )
+{
+    return (rand() % (size + 2 * SIM_MARGIN)) - SIM_MARGIN ;
+}
+
+static int check_fb( uint32_t n, const char* name )
+{
+    uint32_t x, y ;
+
+    for ( y = 0 ; y < SIM_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < SIM_WIDTH ; x++ )
+        {
+            if ( pFb[y * SIM_WIDTH + x] != ref[y][x] )
+            {
+                fprintf( stderr, "fbsim: primitive %u (%s): pixel (%u, %u) is %04X instead of %04X\n",
+                         n, name, x, y, pFb[y * SIM_WIDTH + x], ref[y][x] ) ;
+                errors++ ;
+                return 1 ;
+            }
+        }
+    }
+
+    return 0 ;
+}
+
+static int check_panel( uint32_t n )
+{
+    uint32_t x, y ;
+    LcdColor_t wExpected ;
+
+    for ( y = 0 ; y < BOARD_LCD_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < BOARD_LCD_WIDTH ; x++ )
+        {
+            if ( (x >= SIM_PANEL_X) && (y >= SIM_PANEL_Y) && (x < SIM_PANEL_X + SIM_WIDTH) && (y < SIM_PANEL_Y + SIM_HEIGHT) )
+            {
+                wExpected = ref[y - SIM_PANEL_Y][x - SIM_PANEL_X] ;
+            }
+            else
+            {
+                wExpected = SIM_PANEL_COLOR ;
+            }
+            if ( lcdsim.gram[y][x] != wExpected )
+            {
+                fprintf( stderr, "fbsim: flush after primitive %u: panel pixel (%u, %u) is %04X instead of %04X\n",
+                         n, x, y, lcdsim.gram[y][x], wExpected ) ;
+                errors++ ;
+                return 1 ;
+            }
+        }
+    }
+
+    return 0 ;
+}
+
+int main( int argc, char** argv )
+{
+    static const char* names[] =
+    {
+        "pixel", "line", "rectangle", "filled rectangle", "circle", "filled circle", "picture"
+    } ;
+    uint32_t primitives = 3000 ;
+    uint32_t seed = 1 ;
+    uint32_t flushes = 0 ;
+    uint32_t rects = 0 ;
+    uint32_t counts[7] = { 0 } ;
+    uint32_t n, x, y, kind ;
+    uint32_t color ;
+    int32_t x1, y1, x2, y2, r ;
+    int i ;
+
+    /* getopt() is not at hand: unistd.h conflicts with syscalls.h of board.h */
+    for ( i = 1 ; i < argc ; i += 2 )
+    {
+        if ( (i + 1 < argc) && (strcmp( argv[i], "-n" ) == 0) )
+        {
+            primitives = strtoul( argv[i + 1], NULL, 0 ) ;
+        }
+        else if ( (i + 1 < argc) && (strcmp( argv[i], "-s" ) == 0) )
+        {
+            seed = strtoul( argv[i + 1], NULL, 0 ) ;
+        }
+        else
+        {
+            fprintf( stderr, "usage: fbsim [-n primitives] [-s seed]\n" ) ;
+            return 1 ;
+        }
+    }
+    srand( seed ) ;
+
+    /* Same random picture in the frame buffer, the golden image and the panel window */
+    LCDSIM_Reset( SIM_PANEL_COLOR ) ;
+    for ( y = 0 ; y < SIM_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < SIM_WIDTH ; x++ )
+        {
+            ref[y][x] = pFb[y * SIM_WIDTH + x] = lcdsim.gram[SIM_PANEL_Y + y][SIM_PANEL_X + x] = (LcdColor_t)rand() ;
+        }
+    }
+    FB_SetFrameBuffer( pFb, SIM_WIDTH, SIM_HEIGHT ) ;
+    FB_SetPosition( SIM_PANEL_X, SIM_PANEL_Y ) ;
+
+    for ( n = 0 ; (n < primitives) && !errors ; n++ )
+    {
+        color = (((uint32_t)rand() << 8) ^ (uint32_t)rand()) & 0xFFFFFF ;
+        FB_SetColor( color ) ;
+        refColor = RGB24ToRGB16( color ) ;
+
+        x1 = coordinate( SIM_WIDTH ) ;
+        y1 = coordinate( SIM_HEIGHT ) ;
+        x2 = coordinate( SIM_WIDTH ) ;
+        y2 = coordinate( SIM_HEIGHT ) ;
+        r = rand() % (SIM_MAX_RADIUS + 1) ;
+
+        kind = rand() % 7 ;
+        switch ( kind )
+        {
+            case 0 :
+                FB_DrawPixel( x1, y1 ) ;
+                ref_pixel( x1, y1 ) ;
+            break ;
+
+            case 1 :
+                /* One line in four horizontal or vertical */
+                if ( (rand() & 3) == 0 )
+                {
+                    if ( rand() & 1 ) y2 = y1 ; else x2 = x1 ;
+                }
+                FB_DrawLine( x1, y1, x2, y2 ) ;
+                ref_line( x1, y1, x2, y2 ) ;
+            break ;
+
+            case 2 :
+                FB_DrawRectangle( x1, y1, x2, y2 ) ;
+                ref_filled_rectangle( x1, y1, x2, y1 ) ;
+                ref_filled_rectangle( x1, y2, x2, y2 ) ;
+                ref_filled_rectangle( x1, y1, x1, y2 ) ;
+                ref_filled_rectangle( x2, y1, x2, y2 ) ;
+            break ;
+
+            case 3 :
+                FB_DrawFilledRectangle( x1, y1, x2, y2 ) ;
+                ref_filled_rectangle( x1, y1, x2, y2 ) ;
+            break ;
+
+            case 4 :
+            case 5 :
+                if ( kind == 4 )
+                {
+                    FB_DrawCircle( x1, y1, r ) ;
+                }
+                else
+                {
+                    FB_DrawFilledCircle( x1, y1, r ) ;
+                }
+                ref_circle( x1, y1, r, kind == 5 ) ;
+            break ;
+
+            case 6 :
+                x2 = x1 + (rand() % (2 * SIM_MAX_PICTURE - 1)) - (SIM_MAX_PICTURE - 1) ;
+                y2 = y1 + (rand() % (2 * SIM_MAX_PICTURE - 1)) - (SIM_MAX_PICTURE - 1) ;
+                for ( x = 0 ; x < SIM_MAX_PICTURE * SIM_MAX_PICTURE ; x++ )
+                {
+                    picture[x] = (LcdColor_t)rand() ;
+                }
+                FB_DrawPicture( x1, y1, x2, y2, picture ) ;
+                ref_picture( x1, y1, x2, y2 ) ;
+            break ;
+        }
+        counts[kind]++ ;
+
+        if ( check_fb( n, names[kind] ) )
+        {
+            break ;
+        }
+
+        /* Flush about every eight primitives, and after the last one */
+        if ( ((rand() & 7) == 0) || (n + 1 == primitives) )
+        {
+            rects += FB_Flush() ;
+            flushes++ ;
+            LCD_Wait() ;
+            check_panel( n ) ;
+        }
+    }
+
+    for ( kind = 0 ; kind < 7 ; kind++ )
+    {
+        printf( "fbsim: %5u %s\n", counts[kind], names[kind] ) ;
+    }
+    printf( "fbsim: %u flushes sent %u rectangles, %u pixels (%.1f%% of full flushes), %u bus writes\n",
+            flushes, rects, lcdsim.pixels + lcdsim.dma_pixels,
+            flushes ? 100.0 * (lcdsim.pixels + lcdsim.dma_pixels) / ((double)flushes * SIM_WIDTH * SIM_HEIGHT) : 0.0,
+            LCDSIM_BusWrites() ) ;
+    printf( "fbsim: %u errors, %u violations\n", errors, lcdsim.violations ) ;
+
+    return (errors || lcdsim.violations) ? 1 : 0 ;
+}
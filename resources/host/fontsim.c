@@ -0,0 +1,284 @@
+/**
+ * \file
+ *
+ * Host golden-image test and benchmark of the LCD font (see lcd_font.c).
+ *
+ * Build with "make fontsim", then:
+ *
+ *   fontsim [-n chars] [-o image.ppm]
+ *       Draw the 96 glyphs of pCharset10x14 on a model of the panel (see
+ *       lcdsim.h) with LCDD_DrawChar() and LCDD_DrawCharWithBGColor(), at
+ *       even, odd and edge positions and partly off the panel, and compare
+ *       the panel pixel for pixel with the golden image drawn by the per-pixel
+ *       reference (the loops lcd_font.c used before the glyphs were
+ *       pre-expanded). The background of the panel is a gradient, so that a
+ *       pixel written in the transparent mode shows.
+ *
+ *       Then draw <chars> characters (20000 by default) with each renderer
+ *       and mode and report the bus writes per character, the characters per
+ *       second the panel bus allows (one write per BOARD_LCD_CYCLE) and the
+ *       characters per second of the renderer on the host.
+ *
+ *   -o writes the panel of the last golden screen to a binary PPM file.
+ *
+ * The run fails when a screen differs from its golden image or when the
+ * model reports a bus violation.
+ */
+
+#include "lcdsim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Glyph pitch on the panel, as LCDD_DrawString() */
+#define SIM_PITCH_X             (FONT_WIDTH + 2)
+#define SIM_PITCH_Y             (FONT_HEIGHT + 2)
+#define FONT_WIDTH              10
+#define FONT_HEIGHT             14
+
+#define SIM_FONT_COLOR          0x20C040
+#define SIM_BG_COLOR            0x101080
+
+typedef struct
+{
+    const char* name ;
+    void (*draw)( uint32_t x, uint32_t y, uint8_t c ) ;
+} Renderer ;
+
+static LcdColor_t golden[BOARD_LCD_HEIGHT][BOARD_LCD_WIDTH] ;
+
+/*----------------------------------------------------------------------------
+ *        Reference renderer
+ *----------------------------------------------------------------------------*/
+
+static void ref_pixel( uint32_t x, uint32_t y, uint32_t color )
+{
+    LCD_SetCursor( x, y ) ;
+    LCD_WriteRAM_Prepare() ;
+    LCD_WriteRAM( RGB24ToRGB16( color ) ) ;
+}
+
+/* Per-pixel loops, with the clipping of lcd_font.c (whole glyphs only) */
+static void ref_char( uint32_t x, uint32_t y, uint8_t c, uint32_t color, uint32_t bgColor, int bg )
+{
+    uint32_t row, col ;
+    uint32_t bits ;
+
+    if ( (x + FONT_WIDTH > BOARD_LCD_WIDTH) || (y + FONT_HEIGHT > BOARD_LCD_HEIGHT) )
+    {
+        return ;
+    }
+
+    for ( col = 0 ; col < 10 ; col++ )
+    {
+        for ( row = 0 ; row < 14 ; row++ )
+        {
+            bits = pCharset10x14[((c - 0x20) * 20) + col * 2 + (row >> 3)] ;
+            if ( (bits >> (7 - (row & 7))) & 0x1 )
+            {
+                ref_pixel( x + col, y + row, color ) ;
+            }
+            else if ( bg )
+            {
+                ref_pixel( x + col, y + row, bgColor ) ;
+            }
+        }
+    }
+}
+
+static void ref_draw( uint32_t x, uint32_t y, uint8_t c )
+{
+    ref_char( x, y, c, SIM_FONT_COLOR, 0, 0 ) ;
+}
+
+static void ref_draw_bg( uint32_t x, uint32_t y, uint8_t c )
+{
+    ref_char( x, y, c, SIM_FONT_COLOR, SIM_BG_COLOR, 1 ) ;
+}
+
+static void new_draw( uint32_t x, uint32_t y, uint8_t c )
+{
+    LCDD_DrawChar( x, y, c, SIM_FONT_COLOR ) ;
+}
+
+static void new_draw_bg( uint32_t x, uint32_t y, uint8_t c )
+{
+    LCDD_DrawCharWithBGColor( x, y, c, SIM_FONT_COLOR, SIM_BG_COLOR ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Screens
+ *----------------------------------------------------------------------------*/
+
+/* Panel with a gradient, so that every pixel written shows */
+static void reset_panel( void )
+{
+    uint32_t violations = lcdsim.violations ;
+    uint32_t x, y ;
+
+    LCDSIM_Reset( 0 ) ;
+    lcdsim.violations = violations ;
+    for ( y = 0 ; y < BOARD_LCD_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < BOARD_LCD_WIDTH ; x++ )
+        {
+            lcdsim.gram[y][x] = (LcdColor_t)((x * 0x41) ^ (y * 0x107)) ;
+        }
+    }
+}
+
+/* Every glyph on a grid from (x0, y0), then glyphs on and across the edges */
+static void draw_screen( const Renderer* pRenderer, uint32_t x0, uint32_t y0 )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < 96 ; i++ )
+    {
+        pRenderer->draw( x0 + (i % 24) * SIM_PITCH_X + (i & 1), y0 + (i / 24) * SIM_PITCH_Y, 0x20 + i ) ;
+    }
+    pRenderer->draw( 0, BOARD_LCD_HEIGHT - FONT_HEIGHT, 'A' ) ;
+    pRenderer->draw( BOARD_LCD_WIDTH - FONT_WIDTH, BOARD_LCD_HEIGHT - FONT_HEIGHT, 'W' ) ;
+    pRenderer->draw( BOARD_LCD_WIDTH - FONT_WIDTH + 1, 100, 'X' ) ;
+    pRenderer->draw( 100, BOARD_LCD_HEIGHT - FONT_HEIGHT + 1, 'Y' ) ;
+    pRenderer->draw( BOARD_LCD_WIDTH, 0, 'Z' ) ;
+    LCD_Wait() ;
+}
+
+static void write_ppm( const char* path )
+{
+    FILE* pFile = fopen( path, "wb" ) ;
+    uint32_t x, y ;
+    LcdColor_t w ;
+
+    if ( !pFile )
+    {
+        perror( path ) ;
+        return ;
+    }
+    fprintf( pFile, "P6\n%u %u\n255\n", BOARD_LCD_WIDTH, BOARD_LCD_HEIGHT ) ;
+    for ( y = 0 ; y < BOARD_LCD_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < BOARD_LCD_WIDTH ; x++ )
+        {
+            w = lcdsim.gram[y][x] ;
+            fputc( (w >> 8) & 0xF8, pFile ) ;
+            fputc( (w >> 3) & 0xFC, pFile ) ;
+            fputc( (w << 3) & 0xF8, pFile ) ;
+        }
+    }
+    fclose( pFile ) ;
+}
+
+static int golden_test( const Renderer* pRef, const Renderer* pNew, uint32_t x0, uint32_t y0 )
+{
+    uint32_t x, y ;
+    uint32_t diffs = 0 ;
+
+    reset_panel() ;
+    draw_screen( pRef, x0, y0 ) ;
+    memcpy( golden, lcdsim.gram, sizeof( golden ) ) ;
+
+    reset_panel() ;
+    draw_screen( pNew, x0, y0 ) ;
+    for ( y = 0 ; y < BOARD_LCD_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < BOARD_LCD_WIDTH ; x++ )
+        {
+            if ( lcdsim.gram[y][x] != golden[y][x] )
+            {
+                if ( diffs++ == 0 )
+                {
+                    fprintf( stderr, "fontsim: %s: pixel (%u, %u) is %04X instead of %04X\n",
+                             pNew->name, x, y, lcdsim.gram[y][x], golden[y][x] ) ;
+                }
+            }
+        }
+    }
+    printf( "fontsim: %-14s at (%u, %u): %u pixel(s) differ from the golden image\n", pNew->name, x0, y0, diffs ) ;
+
+    return diffs ? 1 : 0 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Benchmark
+ *----------------------------------------------------------------------------*/
+
+static void benchmark( const Renderer* pRenderer, uint32_t chars )
+{
+    struct timespec start, end ;
+    double seconds ;
+    double writes ;
+    uint32_t i ;
+
+    reset_panel() ;
+    clock_gettime( CLOCK_MONOTONIC, &start ) ;
+    for ( i = 0 ; i < chars ; i++ )
+    {
+        pRenderer->draw( (i % 26) * SIM_PITCH_X, ((i / 26) % 14) * SIM_PITCH_Y, 0x20 + (i * 7) % 96 ) ;
+    }
+    LCD_Wait() ;
+    clock_gettime( CLOCK_MONOTONIC, &end ) ;
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9 ;
+    writes = (double)LCDSIM_BusWrites() / chars ;
+    printf( "fontsim: %-14s %7.1f bus writes/char (%5.1f%% by the DMAC), %8.0f chars/s on the bus, %10.0f chars/s on the host\n",
+            pRenderer->name, writes, 100.0 * lcdsim.dma_pixels / LCDSIM_BusWrites(),
+            1e9 / (writes * LCDSIM_WRITE_NS), chars / seconds ) ;
+}
+
+int main( int argc, char** argv )
+{
+    static const Renderer renderers[] =
+    {
+        { "reference",    ref_draw },
+        { "LCDD_DrawChar", new_draw },
+        { "reference/bg", ref_draw_bg },
+        { "DrawCharWithBG", new_draw_bg },
+    } ;
+    const char* image = NULL ;
+    uint32_t chars = 20000 ;
+    int errors = 0 ;
+    int i ;
+
+    /* getopt() is not at hand: unistd.h conflicts with syscalls.h of board.h */
+    for ( i = 1 ; i < argc ; i += 2 )
+    {
+        if ( (i + 1 < argc) && (strcmp( argv[i], "-n" ) == 0) )
+        {
+            chars = strtoul( argv[i + 1], NULL, 0 ) ;
+        }
+        else if ( (i + 1 < argc) && (strcmp( argv[i], "-o" ) == 0) )
+        {
+            image = argv[i + 1] ;
+        }
+        else
+        {
+            fprintf( stderr, "usage: fontsim [-n chars] [-o image.ppm]\n" ) ;
+            return 1 ;
+        }
+    }
+    if ( chars == 0 )
+    {
+        chars = 1 ;
+    }
+
+    errors += golden_test( &renderers[0], &renderers[1], 0, 0 ) ;
+    errors += golden_test( &renderers[0], &renderers[1], 7, 21 ) ;
+    errors += golden_test( &renderers[2], &renderers[3], 0, 0 ) ;
+    errors += golden_test( &renderers[2], &renderers[3], 7, 21 ) ;
+    if ( image )
+    {
+        write_ppm( image ) ;
+    }
+
+    benchmark( &renderers[0], chars ) ;
+    benchmark( &renderers[1], chars ) ;
+    benchmark( &renderers[2], chars ) ;
+    benchmark( &renderers[3], chars ) ;
+
+    printf( "fontsim: %u errors, %u violations\n", errors, lcdsim.violations ) ;
+
+    return (errors || lcdsim.violations) ? 1 : 0 ;
+}
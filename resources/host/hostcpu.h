@@ -0,0 +1,25 @@
+/**
+ * \file
+ *
+ * Cortex-M3 intrinsics for the host test benches that build driver code
+ * (sdsim.c, nandsim.c, medsim.c).
+ *
+ * The sources are built with "-include hostcpu.h": board.h pulls in the
+ * CMSIS inline functions first, then the macros below replace the calls
+ * that would assemble Thumb instructions or write the NVIC. The benches run
+ * on one thread without interrupts, so masking them does nothing.
+ */
+
+#ifndef _HOSTCPU_
+#define _HOSTCPU_
+
+#include "board.h"
+
+#define __disable_irq()         ((void)0)
+#define __enable_irq()          ((void)0)
+#define __get_PRIMASK()         (0u)
+#define __set_PRIMASK( mask )   ((void)(mask))
+#define NVIC_EnableIRQ( irq )   ((void)(irq))
+#define NVIC_DisableIRQ( irq )  ((void)(irq))
+
+#endif /* #ifndef _HOSTCPU_ */
@@ -0,0 +1,238 @@
+/**
+ * \file
+ *
+ * Model of the HX8347 panel for the host test benches (see lcdsim.h).
+ */
+
+#include "lcdsim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+LcdSim lcdsim ;
+
+static void violation( const char* text )
+{
+    fprintf( stderr, "lcdsim: %s\n", text ) ;
+    lcdsim.violations++ ;
+}
+
+/* Writes one pixel under the cursor, then moves the cursor in the window */
+static LcdColor_t* next_cell( void )
+{
+    LcdColor_t* pCell ;
+
+    if ( (lcdsim.cx >= BOARD_LCD_WIDTH) || (lcdsim.cy >= BOARD_LCD_HEIGHT) )
+    {
+        violation( "cursor outside of the panel" ) ;
+        lcdsim.cx = lcdsim.cy = 0 ;
+    }
+    pCell = &lcdsim.gram[lcdsim.cy][lcdsim.cx] ;
+
+    if ( lcdsim.cx++ == lcdsim.x2 )
+    {
+        lcdsim.cx = lcdsim.x1 ;
+        if ( lcdsim.cy++ == lcdsim.y2 )
+        {
+            lcdsim.cy = lcdsim.y1 ;
+        }
+    }
+
+    return pCell ;
+}
+
+/* Runs the pending DMA transfer, then resets the window like LCD_DmaHandler() */
+static void complete_dma( void )
+{
+    const LcdColor_t* pBuffer = lcdsim.dma_buffer ;
+    LcdDmaCallback fCallback = lcdsim.dma_callback ;
+    uint32_t row, col ;
+
+    if ( !pBuffer )
+    {
+        return ;
+    }
+    lcdsim.dma_buffer = 0 ;
+
+    for ( row = 0 ; row < lcdsim.dma_height ; row++ )
+    {
+        for ( col = 0 ; col < lcdsim.dma_width ; col++ )
+        {
+            *next_cell() = pBuffer[row * lcdsim.dma_stride + col] ;
+        }
+    }
+    lcdsim.dma_pixels += lcdsim.dma_width * lcdsim.dma_height ;
+    LCD_SetWindow( 0, 0, BOARD_LCD_WIDTH - 1, BOARD_LCD_HEIGHT - 1 ) ;
+
+    if ( fCallback )
+    {
+        fCallback( lcdsim.dma_arg, LCD_DMA_STATUS_SUCCESS ) ;
+    }
+}
+
+/* Index register write: waits for the DMAC like WriteCmd() */
+static void command( uint32_t gram )
+{
+    complete_dma() ;
+    lcdsim.commands++ ;
+    lcdsim.gram_mode = gram ;
+}
+
+static void write_reg( void )
+{
+    command( 0 ) ;
+    lcdsim.data++ ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Model API
+ *----------------------------------------------------------------------------*/
+
+extern void LCDSIM_Reset( LcdColor_t wColor )
+{
+    uint32_t x, y ;
+
+    memset( &lcdsim, 0, sizeof( lcdsim ) ) ;
+    for ( y = 0 ; y < BOARD_LCD_HEIGHT ; y++ )
+    {
+        for ( x = 0 ; x < BOARD_LCD_WIDTH ; x++ )
+        {
+            lcdsim.gram[y][x] = wColor ;
+        }
+    }
+    lcdsim.x2 = BOARD_LCD_WIDTH - 1 ;
+    lcdsim.y2 = BOARD_LCD_HEIGHT - 1 ;
+}
+
+extern LcdColor_t* LCDSIM_Data( void )
+{
+    if ( lcdsim.dma_buffer )
+    {
+        violation( "pixel written while the DMAC owns the bus" ) ;
+        complete_dma() ;
+    }
+    if ( !lcdsim.gram_mode )
+    {
+        violation( "pixel written without the GRAM command" ) ;
+    }
+    lcdsim.data++ ;
+    lcdsim.pixels++ ;
+
+    return next_cell() ;
+}
+
+extern uint32_t LCDSIM_BusWrites( void )
+{
+    return lcdsim.commands + lcdsim.data + lcdsim.dma_pixels ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Functions of hx8347.c
+ *----------------------------------------------------------------------------*/
+
+extern void LCD_SetWindow( uint32_t dwX, uint32_t dwY, uint32_t dwWidth, uint32_t dwHeight )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < 8 ; i++ )
+    {
+        write_reg() ;
+    }
+    lcdsim.x1 = dwX ;
+    lcdsim.y1 = dwY ;
+    lcdsim.x2 = dwWidth ;
+    lcdsim.y2 = dwHeight ;
+}
+
+extern void LCD_SetCursor( uint32_t dwX, uint32_t dwY )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < 4 ; i++ )
+    {
+        write_reg() ;
+    }
+    lcdsim.cx = dwX ;
+    lcdsim.cy = dwY ;
+}
+
+extern void LCD_WriteRAM_Prepare( void )
+{
+    command( 1 ) ;
+}
+
+extern void LCD_WriteRAM( uint32_t colour )
+{
+    LCD_D = colour ;
+}
+
+extern uint32_t LCD_DrawPictureStrideAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer,
+                                            uint32_t dwStride, LcdDmaCallback fCallback, void* pArg )
+{
+    uint32_t width, height, row, col ;
+
+    if ( (dwX1 > dwX2) || (dwY1 > dwY2) || (dwX2 >= BOARD_LCD_WIDTH) || (dwY2 >= BOARD_LCD_HEIGHT) )
+    {
+        violation( "picture outside of the panel" ) ;
+        return 0 ;
+    }
+
+    LCD_SetWindow( dwX1, dwY1, dwX2, dwY2 ) ;
+    LCD_SetCursor( dwX1, dwY1 ) ;
+    LCD_WriteRAM_Prepare() ;
+
+    width = dwX2 - dwX1 + 1 ;
+    height = dwY2 - dwY1 + 1 ;
+    if ( dwStride == 0 )
+    {
+        dwStride = width ;
+    }
+    lcdsim.transfers++ ;
+
+    if ( width * height >= LCDSIM_DMA_MIN_PIXELS )
+    {
+        lcdsim.dma_buffer = pBuffer ;
+        lcdsim.dma_width = width ;
+        lcdsim.dma_height = height ;
+        lcdsim.dma_stride = dwStride ;
+        lcdsim.dma_callback = fCallback ;
+        lcdsim.dma_arg = pArg ;
+
+        return 1 ;
+    }
+
+    for ( row = 0 ; row < height ; row++ )
+    {
+        for ( col = 0 ; col < width ; col++ )
+        {
+            LCD_D = pBuffer[row * dwStride + col] ;
+        }
+    }
+    LCD_SetWindow( 0, 0, BOARD_LCD_WIDTH - 1, BOARD_LCD_HEIGHT - 1 ) ;
+
+    if ( fCallback )
+    {
+        fCallback( pArg, LCD_DMA_STATUS_SUCCESS ) ;
+    }
+
+    return 0 ;
+}
+
+extern uint32_t LCD_DrawPictureAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer,
+                                      LcdDmaCallback fCallback, void* pArg )
+{
+    return LCD_DrawPictureStrideAsync( dwX1, dwY1, dwX2, dwY2, pBuffer, 0, fCallback, pArg ) ;
+}
+
+/* A polling loop sees the transfer done at once */
+extern uint32_t LCD_IsFinished( void )
+{
+    complete_dma() ;
+
+    return 1 ;
+}
+
+extern void LCD_Wait( void )
+{
+    complete_dma() ;
+}
@@ -0,0 +1,65 @@
+/**
+ * \file
+ *
+ * Model of the HX8347 panel for the host test benches of the LCD drawing
+ * code (fontsim.c, fbsim.c).
+ *
+ * The drivers are built with "-include lcdsim.h": the data port LCD_D then
+ * writes to the GRAM cell under the cursor of the model, and lcdsim.c
+ * replaces the LCD_xxx functions of hx8347.c used by the drivers. The model
+ * keeps the GRAM, the window and the cursor with the auto-increment of the
+ * controller, counts the bus accesses, and streams the pictures of
+ * LCDSIM_DMA_MIN_PIXELS pixels or more like the DMAC: the buffer is read
+ * when the transfer completes, at the next command or LCD_Wait(), so a
+ * buffer reused too early shows on the panel.
+ */
+
+#ifndef _LCDSIM_
+#define _LCDSIM_
+
+#include "board.h"
+
+/* The data port of the panel is the GRAM cell under the cursor */
+#undef LCD_D
+#define LCD_D                   (*LCDSIM_Data())
+
+/* Smallest picture streamed by the DMAC, as LCD_DMA_MIN_PIXELS in hx8347.c */
+#define LCDSIM_DMA_MIN_PIXELS   64
+
+/* Bus write cycle of the panel (BOARD_LCD_CYCLE) */
+#define LCDSIM_WRITE_NS         100
+
+typedef struct
+{
+    LcdColor_t gram[BOARD_LCD_HEIGHT][BOARD_LCD_WIDTH] ;
+
+    /* Window (corners included) and cursor */
+    uint32_t x1, y1, x2, y2 ;
+    uint32_t cx, cy ;
+    /* Set by the GRAM command, until the next register write */
+    uint32_t gram_mode ;
+
+    /* Picture streamed by the DMAC */
+    const LcdColor_t* dma_buffer ;
+    uint32_t dma_width ;
+    uint32_t dma_height ;
+    uint32_t dma_stride ;
+    LcdDmaCallback dma_callback ;
+    void* dma_arg ;
+
+    /* Bus accesses: index and data writes, pixels written by the CPU and by the DMAC */
+    uint32_t commands ;
+    uint32_t data ;
+    uint32_t pixels ;
+    uint32_t dma_pixels ;
+    uint32_t transfers ;
+    uint32_t violations ;
+} LcdSim ;
+
+extern LcdSim lcdsim ;
+
+extern void LCDSIM_Reset( LcdColor_t wColor ) ;
+extern LcdColor_t* LCDSIM_Data( void ) ;
+extern uint32_t LCDSIM_BusWrites( void ) ;
+
+#endif /* #ifndef _LCDSIM_ */
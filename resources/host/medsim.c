@@ -0,0 +1,456 @@
+/**
+ * \file
+ *
+ * Host test bench of the Media request queue (see Media.c) and of the diskio
+ * functions that go through it (see diskio.c).
+ *
+ * Build with "make medsim", then run "medsim".
+ *
+ * A media model records the driver calls. It completes them inline, as
+ * MEDSdcard and MEDNandFlash do, or later from MED_Handler(), as MEDSdusb
+ * does from its interrupt. The bench checks that:
+ *
+ * - requests queued together (MED_Plug()) with adjacent media ranges are
+ *   serviced in order as one run, in one driver call when their buffers
+ *   follow each other in memory;
+ * - a request of the other direction, or not adjacent, starts a new run;
+ * - requests submitted while an asynchronous run is in progress extend it;
+ * - a driver error fails the requests of its run, and the next runs go on;
+ * - disk_read(), disk_write() and disk_readv() move the right data, and an
+ *   image read as load_image() does (fragments located with f_extent(), then
+ *   one disk_readv() with the last sector in a sector buffer) costs one media
+ *   command per fragment.
+ *
+ * Each case reports the requests, the driver calls and the media commands
+ * (driver calls that do not continue the previous one, which is what a new
+ * CMD18/CMD25 costs on a SD card).
+ */
+
+#include "hostcpu.h"
+#include "memories.h"
+#include "diskio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Media geometry, in 512-byte blocks */
+#define SIM_BLOCKS              4096
+#define SIM_BLOCK_SIZE          512
+
+/* Driver calls recorded per case */
+#define SIM_MAX_CALLS           64
+
+typedef struct
+{
+    uint32_t address ;
+    uint32_t length ;
+    uint8_t* data ;
+    uint8_t write ;
+} Call ;
+
+typedef struct
+{
+    /* Content: one stamp per block */
+    uint32_t stamp[SIM_BLOCKS] ;
+
+    /* Complete the calls from MED_Handler() */
+    int async ;
+    /* Block whose access fails, SIM_BLOCKS for none */
+    uint32_t failBlock ;
+
+    /* Call in progress when asynchronous */
+    MediaCallback callback ;
+    void* argument ;
+    uint8_t status ;
+    uint32_t bytes ;
+
+    /* Calls of the case */
+    Call calls[SIM_MAX_CALLS] ;
+    uint32_t numCalls ;
+    uint32_t commands ;
+    uint32_t next ;
+    uint8_t nextWrite ;
+} Model ;
+
+/* diskio.c drives medias[drv] */
+Media medias[DRV_NOR + 1] ;
+
+static Model model ;
+static uint8_t buffer[64 * SIM_BLOCK_SIZE] __attribute__((aligned(4))) ;
+static uint32_t errors ;
+
+static void check( int condition, const char* text )
+{
+    if ( !condition && (errors++ < 20) )
+    {
+        fprintf( stderr, "medsim: %s\n", text ) ;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Media model
+ *----------------------------------------------------------------------------*/
+
+static uint8_t sim_access( Media* pMedia, uint32_t address, void* data, uint32_t length, MediaCallback callback,
+                           void* argument, uint8_t write )
+{
+    uint32_t* pWords = (uint32_t*)data ;
+    uint8_t status = MED_STATUS_SUCCESS ;
+    uint32_t i ;
+
+    if ( pMedia->state != MED_STATE_READY )
+    {
+        return MED_STATUS_BUSY ;
+    }
+    if ( model.numCalls < SIM_MAX_CALLS )
+    {
+        model.calls[model.numCalls].address = address ;
+        model.calls[model.numCalls].length = length ;
+        model.calls[model.numCalls].data = data ;
+        model.calls[model.numCalls].write = write ;
+    }
+    model.numCalls++ ;
+    if ( (address != model.next) || (write != model.nextWrite) )
+    {
+        model.commands++ ;
+    }
+    model.next = address + length ;
+    model.nextWrite = write ;
+
+    for ( i = 0 ; i < length ; i++, pWords += SIM_BLOCK_SIZE / 4 )
+    {
+        if ( address + i == model.failBlock )
+        {
+            status = MED_STATUS_ERROR ;
+            break ;
+        }
+        if ( write )
+        {
+            model.stamp[address + i] = pWords[0] ;
+        }
+        else
+        {
+            pWords[0] = model.stamp[address + i] ;
+        }
+    }
+
+    if ( model.async )
+    {
+        pMedia->state = MED_STATE_BUSY ;
+        model.callback = callback ;
+        model.argument = argument ;
+        model.status = status ;
+        model.bytes = length * SIM_BLOCK_SIZE ;
+
+        return MED_STATUS_SUCCESS ;
+    }
+    if ( callback )
+    {
+        callback( argument, status, (status == MED_STATUS_SUCCESS) ? length * SIM_BLOCK_SIZE : 0,
+                  (status == MED_STATUS_SUCCESS) ? 0 : length * SIM_BLOCK_SIZE ) ;
+    }
+
+    return status ;
+}
+
+static uint8_t sim_read( Media* pMedia, uint32_t address, void* data, uint32_t length, MediaCallback callback,
+                         void* argument )
+{
+    return sim_access( pMedia, address, data, length, callback, argument, 0 ) ;
+}
+
+static uint8_t sim_write( Media* pMedia, uint32_t address, void* data, uint32_t length, MediaCallback callback,
+                          void* argument )
+{
+    return sim_access( pMedia, address, data, length, callback, argument, 1 ) ;
+}
+
+/* Interrupt of an asynchronous driver: completes the call in progress */
+static void sim_handler( Media* pMedia )
+{
+    if ( pMedia->state == MED_STATE_BUSY )
+    {
+        pMedia->state = MED_STATE_READY ;
+        if ( model.callback )
+        {
+            model.callback( model.argument, model.status, model.bytes, 0 ) ;
+        }
+    }
+}
+
+static Media* reset_media( int async )
+{
+    Media* pMedia = &medias[DRV_MMC] ;
+    uint32_t i ;
+
+    memset( &model, 0, sizeof( model ) ) ;
+    for ( i = 0 ; i < SIM_BLOCKS ; i++ )
+    {
+        model.stamp[i] = i ;
+    }
+    model.async = async ;
+    model.failBlock = SIM_BLOCKS ;
+    model.next = SIM_BLOCKS ;
+
+    memset( pMedia, 0, sizeof( Media ) ) ;
+    pMedia->read = sim_read ;
+    pMedia->write = sim_write ;
+    pMedia->handler = sim_handler ;
+    pMedia->blockSize = SIM_BLOCK_SIZE ;
+    pMedia->size = SIM_BLOCKS ;
+    pMedia->state = MED_STATE_READY ;
+    MED_InitQueue( pMedia ) ;
+
+    return pMedia ;
+}
+
+/* GET_BLOCK_SIZE of the SD drive in disk_ioctl(), not used here */
+extern uint32_t SD_GetAuSizeBlocks( SdCard *pSd )
+{
+    return 1 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Requests
+ *----------------------------------------------------------------------------*/
+
+typedef struct
+{
+    MEDRequest request ;
+    MEDIovec iov ;
+    uint32_t done ;
+    uint8_t status ;
+} Sim_Request ;
+
+static void request_done( void* argument, uint8_t status, uint32_t transferred, uint32_t remaining )
+{
+    Sim_Request* pRequest = (Sim_Request*)argument ;
+
+    pRequest->done++ ;
+    pRequest->status = status ;
+}
+
+static uint32_t submit( Media* pMedia, Sim_Request* pRequest, uint32_t address, uint8_t* data, uint32_t length,
+                        uint8_t write )
+{
+    memset( pRequest, 0, sizeof( Sim_Request ) ) ;
+    pRequest->iov.data = data ;
+    pRequest->iov.length = length ;
+    pRequest->request.address = address ;
+    pRequest->request.pIov = &pRequest->iov ;
+    pRequest->request.bNumIov = 1 ;
+    pRequest->request.bWrite = write ;
+    pRequest->request.callback = request_done ;
+    pRequest->request.argument = pRequest ;
+
+    return MED_Submit( pMedia, &pRequest->request ) ;
+}
+
+/* Blocks of the buffer read from <address> on */
+static int data_ok( const uint8_t* data, uint32_t address, uint32_t length )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < length ; i++ )
+    {
+        if ( *(const uint32_t*)(data + i * SIM_BLOCK_SIZE) != address + i )
+        {
+            return 0 ;
+        }
+    }
+
+    return 1 ;
+}
+
+static void report( const char* name, uint32_t requests )
+{
+    printf( "medsim: %-22s %3u requests %3u driver calls %3u commands\n", name, requests, model.numCalls,
+            model.commands ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Cases
+ *----------------------------------------------------------------------------*/
+
+/* Eight adjacent reads into consecutive buffers: one run, one driver call */
+static void case_adjacent( void )
+{
+    Media* pMedia = reset_media( 0 ) ;
+    Sim_Request requests[MED_QUEUE_SIZE + 1] ;
+    uint32_t i ;
+
+    MED_Plug( pMedia ) ;
+    for ( i = 0 ; i < MED_QUEUE_SIZE ; i++ )
+    {
+        check( submit( pMedia, &requests[i], 100 + 4 * i, buffer + 4 * i * SIM_BLOCK_SIZE, 4, MED_REQUEST_READ )
+               == MED_STATUS_SUCCESS, "adjacent: request rejected" ) ;
+    }
+    check( model.numCalls == 0, "adjacent: request serviced while plugged" ) ;
+    check( submit( pMedia, &requests[MED_QUEUE_SIZE], 0, buffer, 1, MED_REQUEST_READ ) == MED_STATUS_BUSY,
+           "adjacent: full queue accepted a request" ) ;
+    MED_Unplug( pMedia ) ;
+
+    for ( i = 0 ; i < MED_QUEUE_SIZE ; i++ )
+    {
+        check( (requests[i].done == 1) && (requests[i].status == MED_STATUS_SUCCESS), "adjacent: request not done" ) ;
+    }
+    check( model.numCalls == 1, "adjacent: not merged into one driver call" ) ;
+    check( data_ok( buffer, 100, 4 * MED_QUEUE_SIZE ), "adjacent: wrong data" ) ;
+    report( "adjacent", MED_QUEUE_SIZE ) ;
+}
+
+/* Adjacent on the media, scattered in memory: one run of driver calls that
+   continue each other */
+static void case_scattered( void )
+{
+    Media* pMedia = reset_media( 0 ) ;
+    Sim_Request requests[4] ;
+    uint32_t i ;
+
+    MED_Plug( pMedia ) ;
+    for ( i = 0 ; i < 4 ; i++ )
+    {
+        submit( pMedia, &requests[i], 200 + 2 * i, buffer + (3 - i) * 8 * SIM_BLOCK_SIZE, 2, MED_REQUEST_READ ) ;
+    }
+    MED_Unplug( pMedia ) ;
+
+    for ( i = 0 ; i < 4 ; i++ )
+    {
+        check( data_ok( buffer + (3 - i) * 8 * SIM_BLOCK_SIZE, 200 + 2 * i, 2 ), "scattered: wrong data" ) ;
+    }
+    check( (model.numCalls == 4) && (model.commands == 1), "scattered: not serviced as one run" ) ;
+    report( "scattered buffers", 4 ) ;
+}
+
+/* Direction change and gap: three runs, in submission order */
+static void case_runs( void )
+{
+    Media* pMedia = reset_media( 0 ) ;
+    Sim_Request requests[4] ;
+
+    memset( buffer, 0, 4 * SIM_BLOCK_SIZE ) ;
+    *(uint32_t*)(buffer + 2 * SIM_BLOCK_SIZE) = 0xA5A5 ;
+    MED_Plug( pMedia ) ;
+    submit( pMedia, &requests[0], 300, buffer, 2, MED_REQUEST_READ ) ;
+    submit( pMedia, &requests[1], 302, buffer + 2 * SIM_BLOCK_SIZE, 1, MED_REQUEST_WRITE ) ;
+    submit( pMedia, &requests[2], 400, buffer + 3 * SIM_BLOCK_SIZE, 1, MED_REQUEST_READ ) ;
+    MED_Unplug( pMedia ) ;
+
+    check( model.numCalls == 3, "runs: wrong number of driver calls" ) ;
+    check( (model.calls[0].address == 300) && !model.calls[0].write
+           && (model.calls[1].address == 302) && model.calls[1].write
+           && (model.calls[2].address == 400), "runs: not serviced in order" ) ;
+    check( model.stamp[302] == 0xA5A5, "runs: write lost" ) ;
+    report( "direction and gap", 3 ) ;
+}
+
+/* Asynchronous driver: the requests submitted while the run is in progress
+   join it, and are issued from the completion */
+static void case_async( void )
+{
+    Media* pMedia = reset_media( 1 ) ;
+    Sim_Request requests[3] ;
+
+    submit( pMedia, &requests[0], 500, buffer, 4, MED_REQUEST_READ ) ;
+    check( model.numCalls == 1, "async: first request not started" ) ;
+    submit( pMedia, &requests[1], 504, buffer + 4 * SIM_BLOCK_SIZE, 4, MED_REQUEST_READ ) ;
+    submit( pMedia, &requests[2], 508, buffer + 8 * SIM_BLOCK_SIZE, 4, MED_REQUEST_READ ) ;
+    check( model.numCalls == 1, "async: driver called while busy" ) ;
+
+    MED_Handler( pMedia ) ;
+    check( (requests[0].done == 1) && !requests[1].done, "async: wrong completion" ) ;
+    check( (model.numCalls == 2) && (model.calls[1].length == 8), "async: queued requests not merged" ) ;
+    MED_Handler( pMedia ) ;
+    check( requests[1].done && requests[2].done, "async: requests not done" ) ;
+    check( data_ok( buffer, 500, 12 ), "async: wrong data" ) ;
+    report( "asynchronous driver", 3 ) ;
+}
+
+/* Driver error: the run fails, the next run goes on */
+static void case_error( void )
+{
+    Media* pMedia = reset_media( 0 ) ;
+    Sim_Request requests[3] ;
+
+    model.failBlock = 601 ;
+    MED_Plug( pMedia ) ;
+    submit( pMedia, &requests[0], 600, buffer, 1, MED_REQUEST_READ ) ;
+    submit( pMedia, &requests[1], 601, buffer + SIM_BLOCK_SIZE, 1, MED_REQUEST_READ ) ;
+    submit( pMedia, &requests[2], 700, buffer + 2 * SIM_BLOCK_SIZE, 1, MED_REQUEST_READ ) ;
+    MED_Unplug( pMedia ) ;
+
+    check( requests[0].done && (requests[0].status != MED_STATUS_SUCCESS)
+           && requests[1].done && (requests[1].status != MED_STATUS_SUCCESS), "error: failed run reported done" ) ;
+    check( requests[2].done && (requests[2].status == MED_STATUS_SUCCESS), "error: next run not serviced" ) ;
+    check( disk_read( DRV_MMC, buffer, 601, 1 ) == RES_ERROR, "error: disk_read() missed the error" ) ;
+
+    pMedia->state = MED_STATE_NOT_READY ;
+    check( disk_read( DRV_MMC, buffer, 0, 1 ) == RES_ERROR, "error: disk_read() on a media not ready" ) ;
+    report( "driver error", 5 ) ;
+}
+
+/* disk_write() then disk_read() through the queue */
+static void case_diskio( void )
+{
+    uint32_t i ;
+
+    reset_media( 0 ) ;
+    for ( i = 0 ; i < 8 ; i++ )
+    {
+        *(uint32_t*)(buffer + i * SIM_BLOCK_SIZE) = 1000 + i ;
+    }
+    check( disk_write( DRV_MMC, buffer, 1000, 8 ) == RES_OK, "diskio: disk_write() failed" ) ;
+    memset( buffer, 0, 8 * SIM_BLOCK_SIZE ) ;
+    check( disk_read( DRV_MMC, buffer, 1000, 8 ) == RES_OK, "diskio: disk_read() failed" ) ;
+    check( data_ok( buffer, 1000, 8 ), "diskio: wrong data" ) ;
+    report( "disk_write/disk_read", 2 ) ;
+}
+
+/* Image of three fragments and a last partial sector, read as load_image()
+   does: one disk_readv() of the fragments, the last sector in a sector
+   buffer, adjacent to the last fragment */
+static void case_image( void )
+{
+    static const DWORD fragments[][2] = { { 2048, 16 }, { 2080, 8 }, { 2100, 20 } } ;
+    static uint8_t tail[SIM_BLOCK_SIZE] __attribute__((aligned(4))) ;
+    DISKVEC vec[4] ;
+    uint8_t* da = buffer ;
+    uint32_t i ;
+
+    reset_media( 0 ) ;
+    for ( i = 0 ; i < 3 ; i++ )
+    {
+        vec[i].buff = da ;
+        vec[i].sector = fragments[i][0] ;
+        vec[i].count = fragments[i][1] - (i == 2) ;
+        da += vec[i].count * SIM_BLOCK_SIZE ;
+    }
+    vec[3].buff = tail ;
+    vec[3].sector = fragments[2][0] + fragments[2][1] - 1 ;
+    vec[3].count = 1 ;
+
+    check( disk_readv( DRV_MMC, vec, 4 ) == RES_OK, "image: disk_readv() failed" ) ;
+    for ( i = 0 ; i < 3 ; i++ )
+    {
+        check( data_ok( vec[i].buff, vec[i].sector, vec[i].count ), "image: wrong data" ) ;
+    }
+    check( data_ok( tail, vec[3].sector, 1 ), "image: wrong last sector" ) ;
+    check( model.commands == 3, "image: not one command per fragment" ) ;
+    report( "image of 3 fragments", 4 ) ;
+}
+
+int main( int argc, char** argv )
+{
+    case_adjacent() ;
+    case_scattered() ;
+    case_runs() ;
+    case_async() ;
+    case_error() ;
+    case_diskio() ;
+    case_image() ;
+
+    printf( "medsim: %u errors\n", errors ) ;
+
+    return errors ? 1 : 0 ;
+}
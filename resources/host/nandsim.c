@@ -0,0 +1,970 @@
+/**
+ * \file
+ *
+ * Host test bench of the NAND translation layer (see TranslatedNandFlash.c).
+ *
+ * Build with "make nandsim" for the block-mapped translation, or with
+ * "make nandsimlog" for the hybrid translation with 4 log blocks
+ * (TranslatedNandFlash_NUMLOGBLOCKS), then:
+ *
+ *   nandsim [-n writes]
+ *       Run FatFs-style workloads of <writes> writes each (20000 by default)
+ *       through MED_Write()/MED_Flush()/MED_Trim() on MEDNandFlash, over the
+ *       Translated, Mapped, Managed and Ecc layers of the tree and a model of
+ *       a 64MB chip. The workloads are:
+ *
+ *       - fat-seq: one file appended with 4KB writes, synced every 128 writes
+ *         (FAT, FSINFO and directory sectors, then CTRL_SYNC);
+ *       - fat-2files: two pre-allocated files appended in turn;
+ *       - fat-rand: 4KB writes at random in a pre-allocated 16MB file.
+ *
+ *       A file that reaches the end of its area is deleted (CTRL_TRIM) and
+ *       written again. Every 1000 writes, the last range written and a random
+ *       cluster are read back through MED_Read() and compared with the last
+ *       data written. At the end of each run, the layers are initialized again
+ *       from the chip, as after a reset, resuming the block scan until it is
+ *       done as the boot task does, and the whole volume is read back.
+ *
+ *       Each workload runs twice: without idle-time collection, then with
+ *       SIM_IDLE_ERASES blocks erased by MEDNandFlash_CollectGarbage() after
+ *       each CTRL_SYNC, as an application would do when idle.
+ *
+ * The chip model replaces the functions of NfcRawNandFlash.c and the ECC
+ * functions of smc.c. Programming only clears bits and a data area is
+ * programmed once per erase; the ECC is a checksum of each 256 bytes, all
+ * ones for erased data, so that data copied without its ECC, or ECC read
+ * with other data, fails the check of EccNandFlash. Each sector written
+ * carries its address and a version stamp. The time of the chip follows the
+ * SIM_xxx_US costs below, with the data transferred on the 8-bit bus. A
+ * copy-back moves a page inside the chip without the bus; a copy without
+ * copy-back is a read and a write through RAM. Each page command also costs
+ * the CPU setup of its address, which RawNandFlash_CopyBackPages() hides
+ * behind the program of the previous page.
+ *
+ * Each run reports the pages programmed (data areas, copies included),
+ * the blocks erased, the write amplification (pages programmed for each page
+ * of data written by the workload) and the throughput of the chip, without
+ * the time spent at the idle points. The page writes of MEDNandFlash are
+ * timed (TranslatedNandFlash_WritePage() is wrapped at link time) for the
+ * p50, p99 and longest latency, with the most blocks erased by one write,
+ * and so are the block merges (ManagedNandFlash_MergePages()).
+ *
+ * After the workloads, one block written through the ECC layer (fully, then
+ * half of its pages) is merged into a new block page by page with
+ * ManagedNandFlash_CopyPage(), as TranslatedNandFlash_Flush() did before
+ * ManagedNandFlash_MergePages(), then with ManagedNandFlash_MergePages(), then
+ * with it on the same chip without copy-back, and the merged pages are read
+ * back through the ECC layer. The copy-back batch reads the ECC bytes out of
+ * the page register and does not program the pages found erased.
+ *
+ * The run fails when a sector reads back wrong, on a chip access the layers
+ * should not make, or when a page write takes longer than SIM_MAX_WRITE_US.
+ */
+
+#include "hostcpu.h"
+#include "memories.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Chip geometry: 64MB, 128KB blocks of 64 2KB pages */
+#define SIM_BLOCKS              512
+#define SIM_BLOCK_PAGES         64
+#define SIM_PAGE_SIZE           2048
+#define SIM_SPARE_SIZE          64
+
+/* Chip costs in us: command and address cycles, page read, page program,
+   block erase, and one byte on the bus */
+#define SIM_CMD_US              1.0
+#define SIM_READ_US             25.0
+#define SIM_PROGRAM_US          250.0
+#define SIM_ERASE_US            2000.0
+#define SIM_BYTE_US             0.025
+
+/* CPU time to compute the address cycles of a page and start its command;
+   RawNandFlash_CopyBackPages() does it while the previous page programs */
+#define SIM_SETUP_US            2.0
+
+/* Volume layout, in 512-byte sectors */
+#define SIM_SECTOR_SIZE         512
+#define SIM_FSINFO_SECTOR       1
+#define SIM_FAT_BASE            32
+#define SIM_DIR_SECTOR          2048
+#define SIM_DATA_BASE           4096
+#define SIM_CLUSTER_SECTORS     8
+#define SIM_RAND_FILE_SECTORS   (16 * 2048)
+#define SIM_MAX_SECTORS         ((SIM_BLOCKS - 33) * SIM_BLOCK_PAGES * (SIM_PAGE_SIZE / SIM_SECTOR_SIZE))
+
+/* Blocks erased at each idle point (after CTRL_SYNC) when it is enabled */
+#define SIM_IDLE_ERASES         8
+
+/* Page writes recorded for the latency percentiles */
+#define SIM_MAX_SAMPLES         (1 << 20)
+
+/* Longest page write allowed: the flush of the previous block and one block
+   switched for wear levelling or merged from its log block, both copied
+   through RAM, two erases (CollectOnWrite) and the page itself */
+#define SIM_BLOCK_COPY_US       (SIM_BLOCK_PAGES * (2 * SIM_CMD_US + SIM_READ_US + SIM_PROGRAM_US \
+                                                    + 2 * (SIM_PAGE_SIZE + SIM_SPARE_SIZE) * SIM_BYTE_US))
+#define SIM_MAX_WRITE_US        (2 * SIM_BLOCK_COPY_US + 2 * SIM_ERASE_US + 2 * SIM_PROGRAM_US)
+
+/* Version of a sector deleted by CTRL_TRIM: any content, as a sector never written */
+#define SIM_TRIMMED             0xFFFFFFFF
+
+typedef struct
+{
+    uint8_t data[SIM_BLOCKS][SIM_BLOCK_PAGES][SIM_PAGE_SIZE] ;
+    uint8_t spare[SIM_BLOCKS][SIM_BLOCK_PAGES][SIM_SPARE_SIZE] ;
+    uint8_t programmed[SIM_BLOCKS][SIM_BLOCK_PAGES] ;
+
+    /* ECC of the last data area transferred */
+    uint8_t ecc[NandCommon_MAXSPAREECCBYTES] ;
+
+    /* Statistics */
+    uint32_t reads ;
+    uint32_t programs ;
+    uint32_t copies ;
+    uint32_t erases ;
+    double us ;
+} Chip ;
+
+static Chip chip ;
+static uint32_t ref[SIM_MAX_SECTORS] ;
+static uint32_t stamp ;
+static uint32_t sectors ;
+static uint32_t lastAddress ;
+static uint32_t lastLength ;
+static uint32_t errors ;
+static uint32_t violations ;
+
+/* Latency of each page write, and idle-time collection */
+static float samples[SIM_MAX_SAMPLES] ;
+static uint32_t numSamples ;
+static uint32_t maxWriteErases ;
+static int idleCollect ;
+static double idleUs ;
+
+/* Block merges of the translation layer */
+static uint32_t merges ;
+static uint32_t mergedPages ;
+static double mergeUs ;
+
+static uint8_t buffer[SIM_CLUSTER_SECTORS * SIM_SECTOR_SIZE] __attribute__((aligned(4))) ;
+
+static const struct NandFlashModel simModel =
+{
+    0xF1, NandFlashModel_DATABUS8 | NandFlashModel_COPYBACK, SIM_PAGE_SIZE, 64, 128, &nandSpareScheme2048
+} ;
+/* The same chip without copy-back: pages are copied through RAM */
+static const struct NandFlashModel simModelNoCopyBack =
+{
+    0xF1, NandFlashModel_DATABUS8, SIM_PAGE_SIZE, 64, 128, &nandSpareScheme2048
+} ;
+static const Pin simPin ;
+
+static struct TranslatedNandFlash translated ;
+static Media media ;
+
+static void violation( const char* text, uint32_t block, uint32_t page )
+{
+    if ( violations++ < 10 )
+    {
+        fprintf( stderr, "nandsim: %s (block %u, page %u)\n", text, block, page ) ;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Chip model
+ *----------------------------------------------------------------------------*/
+
+/* 24-bit checksum of each 256 bytes, stored inverted: all ones when erased */
+static void compute_ecc( const uint8_t* pData )
+{
+    uint32_t sum ;
+    uint32_t i, j ;
+
+    for ( i = 0 ; i < SIM_PAGE_SIZE / 256 ; i++ )
+    {
+        sum = 0 ;
+        for ( j = 0 ; j < 256 ; j++ )
+        {
+            sum = sum * 31 + (pData[i * 256 + j] ^ 0xFF) ;
+        }
+        chip.ecc[i * 3] = ~sum ;
+        chip.ecc[i * 3 + 1] = ~sum >> 8 ;
+        chip.ecc[i * 3 + 2] = ~sum >> 16 ;
+    }
+}
+
+static int check_address( uint32_t block, uint32_t page )
+{
+    if ( (block >= SIM_BLOCKS) || (page >= SIM_BLOCK_PAGES) )
+    {
+        violation( "page outside of the chip", block, page ) ;
+        return 0 ;
+    }
+
+    return 1 ;
+}
+
+/* Programming clears bits: the data area is programmed once per erase, and
+   a spare byte programmed again (0xFF leaves it) must only clear bits */
+static void program( uint32_t block, uint32_t page, const uint8_t* pData, const uint8_t* pSpare )
+{
+    uint8_t* pCell ;
+    uint32_t i ;
+
+    if ( pData )
+    {
+        if ( chip.programmed[block][page] )
+        {
+            violation( "data area programmed twice", block, page ) ;
+        }
+        chip.programmed[block][page] = 1 ;
+        pCell = chip.data[block][page] ;
+        for ( i = 0 ; i < SIM_PAGE_SIZE ; i++ )
+        {
+            pCell[i] &= pData[i] ;
+        }
+    }
+    if ( pSpare )
+    {
+        pCell = chip.spare[block][page] ;
+        for ( i = 0 ; i < SIM_SPARE_SIZE ; i++ )
+        {
+            if ( (pSpare[i] != 0xFF) && ((pCell[i] & pSpare[i]) != pSpare[i]) )
+            {
+                violation( "spare byte programmed with a bit set again", block, page ) ;
+            }
+            pCell[i] &= pSpare[i] ;
+        }
+    }
+}
+
+static void reset_chip( void )
+{
+    memset( &chip, 0xFF, sizeof( chip.data ) + sizeof( chip.spare ) ) ;
+    memset( chip.programmed, 0, sizeof( chip ) - sizeof( chip.data ) - sizeof( chip.spare ) ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Functions of NfcRawNandFlash.c and smc.c
+ *----------------------------------------------------------------------------*/
+
+extern unsigned char RawNandFlash_Initialize( struct RawNandFlash *raw, const struct NandFlashModel *model,
+                                              unsigned int commandAddress, unsigned int addressAddress,
+                                              unsigned int dataAddress, const Pin pinChipEnable, const Pin pinReadyBusy )
+{
+    if ( !model )
+    {
+        violation( "no model given", 0, 0 ) ;
+        return NandCommon_ERROR_UNKNOWNMODEL ;
+    }
+    raw->model = *model ;
+
+    return 0 ;
+}
+
+extern void RawNandFlash_Reset( const struct RawNandFlash *raw )
+{
+}
+
+extern unsigned int RawNandFlash_ReadId( const struct RawNandFlash *raw )
+{
+    return simModel.deviceId << 8 ;
+}
+
+extern unsigned char RawNandFlash_EraseBlock( const struct RawNandFlash *raw, unsigned short block )
+{
+    if ( !check_address( block, 0 ) )
+    {
+        return NandCommon_ERROR_CANNOTERASE ;
+    }
+    memset( chip.data[block], 0xFF, sizeof( chip.data[block] ) ) ;
+    memset( chip.spare[block], 0xFF, sizeof( chip.spare[block] ) ) ;
+    memset( chip.programmed[block], 0, sizeof( chip.programmed[block] ) ) ;
+    chip.erases++ ;
+    chip.us += SIM_SETUP_US + SIM_CMD_US + SIM_ERASE_US ;
+
+    return 0 ;
+}
+
+extern unsigned char RawNandFlash_ReadPage( const struct RawNandFlash *raw, unsigned short block, unsigned short page,
+                                            void *data, void *spare )
+{
+    if ( !check_address( block, page ) )
+    {
+        return NandCommon_ERROR_CANNOTREAD ;
+    }
+    chip.reads++ ;
+    chip.us += SIM_SETUP_US + SIM_CMD_US + SIM_READ_US ;
+    if ( data )
+    {
+        memcpy( data, chip.data[block][page], SIM_PAGE_SIZE ) ;
+        compute_ecc( data ) ;
+        chip.us += SIM_PAGE_SIZE * SIM_BYTE_US ;
+    }
+    if ( spare )
+    {
+        memcpy( spare, chip.spare[block][page], SIM_SPARE_SIZE ) ;
+        chip.us += SIM_SPARE_SIZE * SIM_BYTE_US ;
+    }
+
+    return 0 ;
+}
+
+extern unsigned char RawNandFlash_WritePage( const struct RawNandFlash *raw, unsigned short block, unsigned short page,
+                                             void *data, void *spare )
+{
+    if ( !check_address( block, page ) )
+    {
+        return NandCommon_ERROR_CANNOTWRITE ;
+    }
+    program( block, page, data, spare ) ;
+    chip.us += SIM_SETUP_US + SIM_CMD_US + SIM_PROGRAM_US ;
+    if ( data )
+    {
+        compute_ecc( data ) ;
+        chip.programs++ ;
+        chip.us += SIM_PAGE_SIZE * SIM_BYTE_US ;
+    }
+    if ( spare )
+    {
+        chip.us += SIM_SPARE_SIZE * SIM_BYTE_US ;
+    }
+
+    return 0 ;
+}
+
+/* Copy-back of a page inside the chip, data and spare (ECC included): nothing
+   crosses the bus. The address setup is hidden when <pipelined> */
+static unsigned char copy_page( const struct RawNandFlash *raw, unsigned short sourceBlock, unsigned short sourcePage,
+                                unsigned short destBlock, unsigned short destPage, int pipelined )
+{
+    if ( !check_address( sourceBlock, sourcePage ) || !check_address( destBlock, destPage ) )
+    {
+        return NandCommon_ERROR_CANNOTCOPY ;
+    }
+    if ( (sourcePage & 1) != (destPage & 1) )
+    {
+        violation( "page copied to the other plane", destBlock, destPage ) ;
+    }
+    program( destBlock, destPage, chip.data[sourceBlock][sourcePage], chip.spare[sourceBlock][sourcePage] ) ;
+    chip.copies++ ;
+    chip.us += 2 * SIM_CMD_US + SIM_READ_US + SIM_PROGRAM_US ;
+    if ( !pipelined )
+    {
+        chip.us += 2 * SIM_SETUP_US ;
+    }
+
+    return 0 ;
+}
+
+/* Copy-back when the model has it, otherwise a read and a write through RAM */
+extern unsigned char RawNandFlash_CopyPage( const struct RawNandFlash *raw, unsigned short sourceBlock,
+                                            unsigned short sourcePage, unsigned short destBlock, unsigned short destPage )
+{
+    uint8_t data[SIM_PAGE_SIZE] ;
+    uint8_t spare[SIM_SPARE_SIZE] ;
+
+    if ( NandFlashModel_SupportsCopyBack( &raw->model ) )
+    {
+        return copy_page( raw, sourceBlock, sourcePage, destBlock, destPage, 0 ) ;
+    }
+
+    if ( RawNandFlash_ReadPage( raw, sourceBlock, sourcePage, data, spare ) )
+    {
+        return NandCommon_ERROR_CANNOTREAD ;
+    }
+
+    return RawNandFlash_WritePage( raw, destBlock, destPage, data, spare ) ;
+}
+
+/* Copy-back read and check of the ECC bytes out of the page register: 1 when
+   they are all erased, and the page is not programmed */
+static int copy_back_erased( const struct RawNandFlash *raw, unsigned short sourceBlock, unsigned short sourcePage,
+                             int pipelined )
+{
+    const struct NandSpareScheme* pScheme = NandFlashModel_GetScheme( &raw->model ) ;
+    uint32_t i ;
+    int erased = 1 ;
+
+    for ( i = 0 ; i < pScheme->numEccBytes ; i++ )
+    {
+        if ( chip.spare[sourceBlock][sourcePage][pScheme->eccBytesPositions[i]] != 0xFF )
+        {
+            erased = 0 ;
+        }
+    }
+    chip.us += SIM_CMD_US + pScheme->numEccBytes * SIM_BYTE_US ;
+    if ( erased )
+    {
+        chip.us += SIM_CMD_US + SIM_READ_US + (pipelined ? 0 : SIM_SETUP_US) ;
+    }
+
+    return erased ;
+}
+
+extern unsigned char RawNandFlash_CopyBackPages( const struct RawNandFlash *raw, unsigned short sourceBlock,
+                                                 unsigned short destBlock, const unsigned char *pageMask )
+{
+    unsigned char error ;
+    uint32_t page ;
+    int pipelined = 0 ;
+
+    if ( !NandFlashModel_SupportsCopyBack( &raw->model ) )
+    {
+        return NandCommon_ERROR_CANNOTCOPY ;
+    }
+    for ( page = 0 ; page < SIM_BLOCK_PAGES ; page++ )
+    {
+        if ( ((pageMask[page / 8] >> (page % 8)) & 1)
+             && !copy_back_erased( raw, sourceBlock, page, pipelined ) )
+        {
+            error = copy_page( raw, sourceBlock, page, destBlock, page, pipelined ) ;
+            if ( error )
+            {
+                return error ;
+            }
+            pipelined = 1 ;
+        }
+    }
+
+    return 0 ;
+}
+
+extern unsigned char RawNandFlash_CopyBlock( const struct RawNandFlash *raw, unsigned short sourceBlock,
+                                             unsigned short destBlock )
+{
+    unsigned char error ;
+    uint32_t page ;
+
+    for ( page = 0 ; page < SIM_BLOCK_PAGES ; page++ )
+    {
+        error = RawNandFlash_CopyPage( raw, sourceBlock, page, destBlock, page ) ;
+        if ( error )
+        {
+            return error ;
+        }
+    }
+
+    return 0 ;
+}
+
+extern void SMC_NFC_Configure( Smc* pSmc, uint32_t mode )
+{
+}
+
+extern void SMC_ECC_Configure( Smc* pSmc, uint32_t type, uint32_t pageSize )
+{
+}
+
+extern void SMC_ECC_GetEccParity( uint32_t pageDataSize, uint8_t *code, uint8_t dataPath )
+{
+    memcpy( code, chip.ecc, pageDataSize / 256 * 3 ) ;
+}
+
+extern uint8_t SMC_ECC_VerifyHsiao( uint8_t *data, uint32_t size, const uint8_t *originalCode,
+                                    const uint8_t *verifyCode, uint8_t dataPath )
+{
+    return memcmp( originalCode, verifyCode, size / 256 * 3 ) ? Hsiao_ERROR_MULTIPLEBITS : 0 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Page write latency and block merges
+ *----------------------------------------------------------------------------*/
+
+extern unsigned char __real_TranslatedNandFlash_WritePage( struct TranslatedNandFlash *translated, unsigned short block,
+                                                           unsigned short page, void *data, void *spare ) ;
+
+/* The page writes of MEDNandFlash come here first (-Wl,--wrap) */
+extern unsigned char __wrap_TranslatedNandFlash_WritePage( struct TranslatedNandFlash *translated, unsigned short block,
+                                                           unsigned short page, void *data, void *spare )
+{
+    double start = chip.us ;
+    uint32_t erases = chip.erases ;
+    unsigned char error ;
+
+    error = __real_TranslatedNandFlash_WritePage( translated, block, page, data, spare ) ;
+    if ( numSamples < SIM_MAX_SAMPLES )
+    {
+        samples[numSamples++] = chip.us - start ;
+    }
+    if ( chip.us - start > SIM_MAX_WRITE_US )
+    {
+        violation( "page write longer than SIM_MAX_WRITE_US", block, page ) ;
+    }
+    if ( chip.erases - erases > maxWriteErases )
+    {
+        maxWriteErases = chip.erases - erases ;
+    }
+
+    return error ;
+}
+
+static int compare_samples( const void* pA, const void* pB )
+{
+    float a = *(const float*)pA ;
+    float b = *(const float*)pB ;
+
+    return (a > b) - (a < b) ;
+}
+
+/* Latency in us below which <permille> of the page writes completed */
+static double percentile( uint32_t permille )
+{
+    if ( numSamples == 0 )
+    {
+        return 0 ;
+    }
+
+    return samples[(uint64_t)(numSamples - 1) * permille / 1000] ;
+}
+
+extern uint8_t __real_ManagedNandFlash_MergePages( const struct ManagedNandFlash *managed, uint16_t sourceBlock,
+                                                   uint16_t destBlock, const uint8_t *pageMask ) ;
+
+/* The block merges of TranslatedNandFlash come here first (-Wl,--wrap) */
+extern uint8_t __wrap_ManagedNandFlash_MergePages( const struct ManagedNandFlash *managed, uint16_t sourceBlock,
+                                                   uint16_t destBlock, const uint8_t *pageMask )
+{
+    double start = chip.us ;
+    uint32_t page ;
+    uint8_t error ;
+
+    error = __real_ManagedNandFlash_MergePages( managed, sourceBlock, destBlock, pageMask ) ;
+    merges++ ;
+    mergeUs += chip.us - start ;
+    for ( page = 0 ; page < SIM_BLOCK_PAGES ; page++ )
+    {
+        mergedPages += (pageMask[page / 8] >> (page % 8)) & 1 ;
+    }
+
+    return error ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Workloads
+ *----------------------------------------------------------------------------*/
+
+static void fill_sector( uint32_t* pWords, uint32_t sector, uint32_t version )
+{
+    uint32_t i ;
+
+    pWords[0] = sector ;
+    pWords[1] = version ;
+    for ( i = 2 ; i < SIM_SECTOR_SIZE / 4 ; i++ )
+    {
+        pWords[i] = version * 0x9E3779B9 + i ;
+    }
+}
+
+static void sim_write( uint32_t address, uint32_t length )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < length ; i++ )
+    {
+        ref[address + i] = ++stamp ;
+        fill_sector( (uint32_t*)(buffer + i * SIM_SECTOR_SIZE), address + i, stamp ) ;
+    }
+    lastAddress = address ;
+    lastLength = length ;
+    if ( MED_Write( &media, address * SIM_SECTOR_SIZE, buffer, length * SIM_SECTOR_SIZE, 0, 0 ) != MED_STATUS_SUCCESS )
+    {
+        violation( "MED_Write() failed", address, 0 ) ;
+    }
+}
+
+static void sim_sync( void )
+{
+    double start ;
+
+    if ( MED_Flush( &media ) != MED_STATUS_SUCCESS )
+    {
+        violation( "MED_Flush() failed", 0, 0 ) ;
+    }
+    if ( idleCollect )
+    {
+        start = chip.us ;
+        MEDNandFlash_CollectGarbage( &media, SIM_IDLE_ERASES ) ;
+        idleUs += chip.us - start ;
+    }
+}
+
+static void sim_trim( uint32_t address, uint32_t length )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < length ; i++ )
+    {
+        ref[address + i] = SIM_TRIMMED ;
+    }
+    if ( MED_Trim( &media, address * SIM_SECTOR_SIZE, length * SIM_SECTOR_SIZE ) != MED_STATUS_SUCCESS )
+    {
+        violation( "MED_Trim() failed", address, 0 ) ;
+    }
+}
+
+static void sim_read( uint32_t address, uint32_t length )
+{
+    uint32_t expected[SIM_SECTOR_SIZE / 4] ;
+    uint32_t i ;
+
+    memset( buffer, 0, length * SIM_SECTOR_SIZE ) ;
+    if ( MED_Read( &media, address * SIM_SECTOR_SIZE, buffer, length * SIM_SECTOR_SIZE, 0, 0 ) != MED_STATUS_SUCCESS )
+    {
+        violation( "MED_Read() failed", address, 0 ) ;
+    }
+
+    for ( i = 0 ; i < length ; i++ )
+    {
+        if ( (ref[address + i] == 0) || (ref[address + i] == SIM_TRIMMED) )
+        {
+            continue ;
+        }
+        fill_sector( expected, address + i, ref[address + i] ) ;
+        if ( memcmp( buffer + i * SIM_SECTOR_SIZE, expected, SIM_SECTOR_SIZE ) != 0 )
+        {
+            if ( errors++ < 10 )
+            {
+                fprintf( stderr, "nandsim: sector %u reads version %u instead of %u\n", address + i,
+                         ((uint32_t*)buffer)[i * SIM_SECTOR_SIZE / 4 + 1], ref[address + i] ) ;
+            }
+        }
+    }
+}
+
+/* The last range written, likely still in the page buffer, and a random cluster */
+static void check_reads( uint32_t base, uint32_t clusters )
+{
+    sim_read( lastAddress, lastLength ) ;
+    sim_read( base + (rand() % clusters) * SIM_CLUSTER_SECTORS, SIM_CLUSTER_SECTORS ) ;
+}
+
+static void check_volume( void )
+{
+    uint32_t sector ;
+
+    for ( sector = 0 ; sector + SIM_CLUSTER_SECTORS <= sectors ; sector += SIM_CLUSTER_SECTORS )
+    {
+        sim_read( sector, SIM_CLUSTER_SECTORS ) ;
+    }
+}
+
+/* FatFs f_sync: FAT sector of the last cluster, FSINFO, directory entry */
+static void file_sync( uint32_t cluster )
+{
+    sim_write( SIM_FAT_BASE + cluster / 128, 1 ) ;
+    sim_write( SIM_FSINFO_SECTOR, 1 ) ;
+    sim_write( SIM_DIR_SECTOR, 1 ) ;
+    sim_sync() ;
+}
+
+static void fat_seq( uint32_t writes )
+{
+    uint32_t clusters = (sectors - SIM_DATA_BASE) / SIM_CLUSTER_SECTORS ;
+    uint32_t cluster = 0 ;
+    uint32_t n ;
+
+    for ( n = 0 ; n < writes ; n++ )
+    {
+        if ( cluster == clusters )
+        {
+            sim_trim( SIM_DATA_BASE, clusters * SIM_CLUSTER_SECTORS ) ;
+            cluster = 0 ;
+        }
+        sim_write( SIM_DATA_BASE + cluster * SIM_CLUSTER_SECTORS, SIM_CLUSTER_SECTORS ) ;
+        cluster++ ;
+        if ( (n % 128) == 127 )
+        {
+            file_sync( cluster ) ;
+        }
+        if ( (n % 1000) == 999 )
+        {
+            check_reads( SIM_DATA_BASE, cluster ) ;
+        }
+    }
+    file_sync( cluster ) ;
+}
+
+static void fat_2files( uint32_t writes )
+{
+    uint32_t clusters = (sectors - SIM_DATA_BASE) / SIM_CLUSTER_SECTORS / 2 ;
+    uint32_t base[2] = { SIM_DATA_BASE, SIM_DATA_BASE + clusters * SIM_CLUSTER_SECTORS } ;
+    uint32_t cluster[2] = { 0, 0 } ;
+    uint32_t n, f ;
+
+    for ( n = 0 ; n < writes ; n++ )
+    {
+        f = n & 1 ;
+        if ( cluster[f] == clusters )
+        {
+            sim_trim( base[f], clusters * SIM_CLUSTER_SECTORS ) ;
+            cluster[f] = 0 ;
+        }
+        sim_write( base[f] + cluster[f] * SIM_CLUSTER_SECTORS, SIM_CLUSTER_SECTORS ) ;
+        cluster[f]++ ;
+        if ( (n % 32) == 31 )
+        {
+            sim_write( SIM_DIR_SECTOR, 1 ) ;
+            sim_sync() ;
+        }
+        if ( ((n % 1000) == 999) && cluster[f] )
+        {
+            check_reads( base[f], cluster[f] ) ;
+        }
+    }
+    sim_write( SIM_DIR_SECTOR, 1 ) ;
+    sim_sync() ;
+}
+
+static void fat_rand( uint32_t writes )
+{
+    uint32_t clusters = SIM_RAND_FILE_SECTORS / SIM_CLUSTER_SECTORS ;
+    uint32_t n ;
+
+    for ( n = 0 ; n < writes ; n++ )
+    {
+        sim_write( SIM_DATA_BASE + (rand() % clusters) * SIM_CLUSTER_SECTORS, SIM_CLUSTER_SECTORS ) ;
+        if ( (n % 64) == 63 )
+        {
+            sim_write( SIM_DIR_SECTOR, 1 ) ;
+            sim_sync() ;
+        }
+        if ( (n % 1000) == 999 )
+        {
+            check_reads( SIM_DATA_BASE, clusters ) ;
+        }
+    }
+    sim_write( SIM_DIR_SECTOR, 1 ) ;
+    sim_sync() ;
+}
+
+/* Initializes the layers from the content of the chip */
+static int mount( const struct NandFlashModel* pModel )
+{
+    unsigned char error ;
+
+    memset( &translated, 0, sizeof( translated ) ) ;
+    do
+    {
+        error = TranslatedNandFlash_Initialize( &translated, pModel, 0, 0, 0, simPin, simPin, 0, SIM_BLOCKS ) ;
+    }
+    while ( error == NandCommon_ERROR_SCANPENDING ) ;
+    if ( error )
+    {
+        violation( "TranslatedNandFlash_Initialize() failed", 0, 0 ) ;
+        return 0 ;
+    }
+    MEDNandFlash_Initialize( &media, &translated ) ;
+
+    return 1 ;
+}
+
+static void run( const char* name, void (*workload)( uint32_t ), uint32_t writes, int withIdleCollect )
+{
+    double hostPages ;
+    double us ;
+
+    reset_chip() ;
+    memset( ref, 0, sizeof( ref ) ) ;
+    stamp = 0 ;
+    srand( 1 ) ;
+    if ( !mount( &simModel ) )
+    {
+        return ;
+    }
+    sectors = media.size / SIM_SECTOR_SIZE ;
+    if ( sectors > SIM_MAX_SECTORS )
+    {
+        sectors = SIM_MAX_SECTORS ;
+    }
+    chip.reads = chip.programs = chip.copies = chip.erases = 0 ;
+    chip.us = 0 ;
+    numSamples = 0 ;
+    maxWriteErases = 0 ;
+    idleCollect = withIdleCollect ;
+    idleUs = 0 ;
+    merges = mergedPages = 0 ;
+    mergeUs = 0 ;
+
+    workload( writes ) ;
+
+    /* Payload of the workload: one stamp per sector written; the idle
+       points are not part of its time */
+    hostPages = (double)stamp * SIM_SECTOR_SIZE / SIM_PAGE_SIZE ;
+    us = chip.us - idleUs ;
+    printf( "nandsim: %-10s %u log blocks, %s: %7u pages programmed %7u copied %6u erases, amplification %5.2f, %6.1f s %5.2f MB/s\n",
+            name, TranslatedNandFlash_NUMLOGBLOCKS, idleCollect ? "idle GC" : "no idle GC",
+            chip.programs, chip.copies, chip.erases, (chip.programs + chip.copies) / hostPages,
+            us * 1e-6, stamp * (double)SIM_SECTOR_SIZE / us ) ;
+
+    qsort( samples, numSamples, sizeof( samples[0] ), compare_samples ) ;
+    printf( "nandsim: %-10s %u log blocks, %s: %u page writes, p50 %6.2f ms, p99 %6.2f ms, max %7.2f ms (%u erases), %6.1f s at idle points\n",
+            name, TranslatedNandFlash_NUMLOGBLOCKS, idleCollect ? "idle GC" : "no idle GC", numSamples,
+            percentile( 500 ) * 1e-3, percentile( 990 ) * 1e-3, percentile( 1000 ) * 1e-3, maxWriteErases,
+            idleUs * 1e-6 ) ;
+    printf( "nandsim: %-10s %u log blocks, %s: %u block merges of %.1f pages, %.2f ms each, %6.1f s in merges\n",
+            name, TranslatedNandFlash_NUMLOGBLOCKS, idleCollect ? "idle GC" : "no idle GC", merges,
+            merges ? (double)mergedPages / merges : 0.0, merges ? mergeUs * 1e-3 / merges : 0.0, mergeUs * 1e-6 ) ;
+
+    /* As after a reset: the data synced last must be found again */
+    if ( mount( &simModel ) )
+    {
+        check_volume() ;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Block merge benchmark
+ *----------------------------------------------------------------------------*/
+
+/* Writes the first <written> pages of a block through the ECC layer and merges
+   the whole block into a new block, with ManagedNandFlash_MergePages() or page
+   by page with ManagedNandFlash_CopyPage() as TranslatedNandFlash_Flush() did
+   before. Returns the time of the merge in us */
+static double merge_block( const struct NandFlashModel* pModel, int batched, uint32_t written )
+{
+    struct ManagedNandFlash* pManaged = (struct ManagedNandFlash*)&translated ;
+    uint8_t pageMask[SIM_BLOCK_PAGES / 8] ;
+    uint16_t blocks[2] ;
+    uint32_t* pWords ;
+    uint32_t page, i ;
+    uint8_t error = 0 ;
+    double us ;
+
+    reset_chip() ;
+    if ( !mount( pModel ) )
+    {
+        return 0 ;
+    }
+    for ( i = 0 ; i < 2 ; i++ )
+    {
+        if ( ManagedNandFlash_FindYoungestBlock( pManaged, NandBlockStatus_FREE, &blocks[i] )
+             || ManagedNandFlash_AllocateBlock( pManaged, blocks[i] ) )
+        {
+            violation( "no block to merge", 0, 0 ) ;
+            return 0 ;
+        }
+    }
+    for ( page = 0 ; page < written ; page++ )
+    {
+        for ( i = 0 ; i < SIM_PAGE_SIZE / SIM_SECTOR_SIZE ; i++ )
+        {
+            fill_sector( (uint32_t*)(buffer + i * SIM_SECTOR_SIZE), page, i + 1 ) ;
+        }
+        if ( ManagedNandFlash_WritePage( pManaged, blocks[0], page, buffer, 0 ) )
+        {
+            violation( "ManagedNandFlash_WritePage() failed", blocks[0], page ) ;
+        }
+    }
+
+    memset( pageMask, 0xFF, sizeof( pageMask ) ) ;
+    us = chip.us ;
+    if ( batched )
+    {
+        error = ManagedNandFlash_MergePages( pManaged, blocks[0], blocks[1], pageMask ) ;
+    }
+    for ( page = 0 ; !batched && !error && (page < SIM_BLOCK_PAGES) ; page++ )
+    {
+        error = ManagedNandFlash_CopyPage( pManaged, blocks[0], page, blocks[1], page ) ;
+    }
+    us = chip.us - us ;
+    if ( error )
+    {
+        violation( "block merge failed", blocks[1], 0 ) ;
+    }
+
+    /* The merged pages must pass the ECC check; the copy-back batch leaves the
+       others erased */
+    for ( page = 0 ; page < SIM_BLOCK_PAGES ; page++ )
+    {
+        if ( page >= written )
+        {
+            if ( batched && NandFlashModel_SupportsCopyBack( pModel )
+                 && chip.programmed[pManaged->baseBlock + blocks[1]][page] )
+            {
+                violation( "erased page programmed by the merge", blocks[1], page ) ;
+            }
+            continue ;
+        }
+        memset( buffer, 0, SIM_PAGE_SIZE ) ;
+        error = ManagedNandFlash_ReadPage( pManaged, blocks[1], page, buffer, 0 ) ;
+        for ( i = 0 ; i < SIM_PAGE_SIZE / SIM_SECTOR_SIZE ; i++ )
+        {
+            pWords = (uint32_t*)(buffer + i * SIM_SECTOR_SIZE) ;
+            if ( error || (pWords[0] != page) || (pWords[1] != i + 1) )
+            {
+                if ( errors++ < 10 )
+                {
+                    fprintf( stderr, "nandsim: merged page %u reads wrong\n", page ) ;
+                }
+                break ;
+            }
+        }
+    }
+
+    return us ;
+}
+
+static void bench_merge( void )
+{
+    static const uint32_t written[] = { SIM_BLOCK_PAGES, SIM_BLOCK_PAGES / 2 } ;
+    double pageByPage, batched, noCopyBack ;
+    uint32_t i ;
+
+    for ( i = 0 ; i < sizeof( written ) / sizeof( written[0] ) ; i++ )
+    {
+        pageByPage = merge_block( &simModel, 0, written[i] ) ;
+        batched = merge_block( &simModel, 1, written[i] ) ;
+        noCopyBack = merge_block( &simModelNoCopyBack, 1, written[i] ) ;
+
+        printf( "nandsim: merge of %u pages, %u written: %.2f ms page by page, %.2f ms batched (x%.2f), "
+                "%.2f ms without copy-back (x%.2f)\n",
+                SIM_BLOCK_PAGES, written[i], pageByPage * 1e-3, batched * 1e-3, pageByPage / batched,
+                noCopyBack * 1e-3, noCopyBack / batched ) ;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    static const struct
+    {
+        const char* name ;
+        void (*workload)( uint32_t ) ;
+    } workloads[] =
+    {
+        { "fat-seq", fat_seq },
+        { "fat-2files", fat_2files },
+        { "fat-rand", fat_rand },
+    } ;
+    uint32_t writes = 20000 ;
+    uint32_t i ;
+
+    /* getopt() is not at hand: unistd.h conflicts with syscalls.h of board.h */
+    for ( i = 1 ; i < (uint32_t)argc ; i += 2 )
+    {
+        if ( (i + 1 < (uint32_t)argc) && (strcmp( argv[i], "-n" ) == 0) )
+        {
+            writes = strtoul( argv[i + 1], NULL, 0 ) ;
+        }
+        else
+        {
+            fprintf( stderr, "usage: nandsim [-n writes]\n" ) ;
+            return 1 ;
+        }
+    }
+
+    for ( i = 0 ; i < sizeof( workloads ) / sizeof( workloads[0] ) ; i++ )
+    {
+        run( workloads[i].name, workloads[i].workload, writes, 0 ) ;
+        run( workloads[i].name, workloads[i].workload, writes, 1 ) ;
+    }
+    bench_merge() ;
+
+    printf( "nandsim: %u errors, %u violations\n", errors, violations ) ;
+
+    return (errors || violations) ? 1 : 0 ;
+}
@@ -0,0 +1,507 @@
+/**
+ * \file
+ *
+ * Host test bench of the network boot client (see inc/netboot.h).
+ *
+ * Build with "make netsim", then:
+ *
+ *   netsim [-p port] [-e n] [-s n] [-o dir] <name>...
+ *       Fetch the files from a TFTP server on 127.0.0.1:<port> (69 by
+ *       default) with the client of the bootloader, writing them to <dir>.
+ *       The EMAC is simulated: it stores the frames from the server in the
+ *       descriptor ring of the client, 128-byte buffers and 2 bytes of
+ *       offset, and drops them when no buffer is available. The frames of
+ *       the client go to the server over UDP once their checksums checked.
+ *
+ *   -e <n> drops about one frame in <n> in each direction to exercise the
+ *   retransmissions; -s <n> inserts a stray frame (ARP request, frame of
+ *   another protocol) before about one frame in <n>, which moves the frames
+ *   off their slots in the ring.
+ *
+ * The memory given to the client is mapped below 4 GB, the descriptors
+ * holding 32-bit addresses.
+ */
+
+#define _GNU_SOURCE
+
+#include "netboot.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef MAP_32BIT
+#define MAP_32BIT               0
+#endif
+
+/* Addresses of the simulated network */
+#define SIM_BOARD_IP            NETBOOT_ADDRESS( 192, 168, 1, 10 )
+#define SIM_SERVER_IP           NETBOOT_ADDRESS( 192, 168, 1, 1 )
+#define SIM_OTHER_IP            NETBOOT_ADDRESS( 192, 168, 1, 20 )
+
+/* Memory standing for the SDRAM of the board */
+#define SIM_MEMORY_SIZE         (32 * 1024 * 1024)
+
+/* Frames waiting to be stored by the simulated EMAC */
+#define SIM_QUEUE_SIZE          64
+
+typedef struct
+{
+    uint8_t data[NETBOOT_MAX_FRAME] ;
+    uint32_t size ;
+} Frame ;
+
+typedef struct
+{
+    NetbootRxDescriptor* ring ;
+    uint32_t index ;
+    int enabled ;
+    int sock ;
+    uint16_t server_port ;
+    uint16_t board_port ;
+    uint16_t ip_id ;
+
+    Frame queue[SIM_QUEUE_SIZE] ;
+    uint32_t queue_head ;
+    uint32_t queue_count ;
+
+    /* Statistics */
+    uint32_t stored ;
+    uint32_t no_buffer ;
+    uint32_t paused ;
+    uint32_t dropped ;
+    uint32_t strays ;
+    uint32_t arp_replies ;
+    uint32_t bad_frames ;
+} Sim ;
+
+static const uint8_t board_mac[6] = { 0x00, 0x04, 0x25, 0x1C, 0xA0, 0x02 } ;
+static const uint8_t server_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 } ;
+static const uint8_t other_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 } ;
+
+static int drop_rate ;
+static int stray_rate ;
+
+static uint32_t now_ms( void )
+{
+    struct timeval tv ;
+
+    gettimeofday( &tv, NULL ) ;
+    return (uint32_t)((uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000) ;
+}
+
+static uint32_t get16( const uint8_t* p )
+{
+    return ((uint32_t)p[0] << 8) | p[1] ;
+}
+
+static uint32_t get32( const uint8_t* p )
+{
+    return (get16( p ) << 16) | get16( p + 2 ) ;
+}
+
+static void put16( uint8_t* p, uint32_t v )
+{
+    p[0] = (uint8_t)(v >> 8) ;
+    p[1] = (uint8_t)v ;
+}
+
+static void put32( uint8_t* p, uint32_t v )
+{
+    put16( p, v >> 16 ) ;
+    put16( p + 2, v ) ;
+}
+
+static uint32_t checksum( const uint8_t* p, uint32_t n, uint32_t sum )
+{
+    for ( ; n > 1 ; n -= 2, p += 2 )
+    {
+        sum += get16( p ) ;
+    }
+    if ( n )
+    {
+        sum += (uint32_t)p[0] << 8 ;
+    }
+    while ( sum >> 16 )
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16) ;
+    }
+
+    return sum ;
+}
+
+static int chance( int rate )
+{
+    return rate && (rand() % rate == 0) ;
+}
+
+/* Store a frame in the ring the way the EMAC does */
+static void emac_store( Sim* sim, const uint8_t* frame, uint32_t size )
+{
+    NetbootRxDescriptor* ring = sim->ring ;
+    uint32_t units = (size + NETBOOT_RX_OFFSET + NETBOOT_RX_UNITSIZE - 1) / NETBOOT_RX_UNITSIZE ;
+    uint32_t offset = NETBOOT_RX_OFFSET ;
+    uint32_t done = 0 ;
+    uint32_t index ;
+    uint32_t chunk ;
+    uint32_t i ;
+
+    if ( !sim->enabled )
+    {
+        sim->paused++ ;
+        return ;
+    }
+
+    index = sim->index ;
+    for ( i = 0 ; i < units ; i++ )
+    {
+        if ( ring[index].dwAddress & NETBOOT_RX_OWNERSHIP )
+        {
+            sim->no_buffer++ ;
+            return ;
+        }
+        index = (ring[index].dwAddress & NETBOOT_RX_WRAP) ? 0 : index + 1 ;
+    }
+
+    index = sim->index ;
+    for ( i = 0 ; i < units ; i++ )
+    {
+        chunk = NETBOOT_RX_UNITSIZE - offset ;
+        if ( chunk > size - done )
+        {
+            chunk = size - done ;
+        }
+        memcpy( (uint8_t*)(uintptr_t)(ring[index].dwAddress & NETBOOT_RX_ADDRESS) + offset, frame + done, chunk ) ;
+        done += chunk ;
+        offset = 0 ;
+
+        ring[index].dwStatus = ((i == 0) ? NETBOOT_RX_SOF : 0) | ((i == units - 1) ? (NETBOOT_RX_EOF | size) : 0) ;
+        ring[index].dwAddress |= NETBOOT_RX_OWNERSHIP ;
+        index = (ring[index].dwAddress & NETBOOT_RX_WRAP) ? 0 : index + 1 ;
+    }
+    sim->index = index ;
+    sim->stored++ ;
+}
+
+/* Queue a frame for the board */
+static void queue_frame( Sim* sim, const uint8_t* frame, uint32_t size )
+{
+    Frame* slot ;
+
+    if ( sim->queue_count == SIM_QUEUE_SIZE )
+    {
+        sim->dropped++ ;
+        return ;
+    }
+    slot = &sim->queue[(sim->queue_head + sim->queue_count) % SIM_QUEUE_SIZE] ;
+    memcpy( slot->data, frame, size ) ;
+    slot->size = (size < 60) ? 60 : size ;
+    if ( size < 60 )
+    {
+        memset( slot->data + size, 0, 60 - size ) ;
+    }
+    sim->queue_count++ ;
+}
+
+static uint32_t build_ethernet( uint8_t* frame, const uint8_t* dst, const uint8_t* src, uint32_t type )
+{
+    memcpy( frame, dst, 6 ) ;
+    memcpy( frame + 6, src, 6 ) ;
+    put16( frame + 12, type ) ;
+
+    return 14 ;
+}
+
+static uint32_t build_arp( uint8_t* frame, uint32_t op, const uint8_t* sha, uint32_t spa, const uint8_t* tha, uint32_t tpa )
+{
+    static const uint8_t broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } ;
+    uint8_t* arp = frame + build_ethernet( frame, (op == 1) ? broadcast : tha, sha, 0x0806 ) ;
+
+    put16( arp, 1 ) ;
+    put16( arp + 2, 0x0800 ) ;
+    arp[4] = 6 ;
+    arp[5] = 4 ;
+    put16( arp + 6, op ) ;
+    memcpy( arp + 8, sha, 6 ) ;
+    put32( arp + 14, spa ) ;
+    memcpy( arp + 18, tha, 6 ) ;
+    put32( arp + 24, tpa ) ;
+
+    return 42 ;
+}
+
+static uint32_t build_udp( Sim* sim, uint8_t* frame, uint32_t src_ip, uint32_t src_port, uint32_t dst_port,
+                           const uint8_t* payload, uint32_t size )
+{
+    uint8_t* ip = frame + build_ethernet( frame, board_mac, server_mac, 0x0800 ) ;
+    uint8_t* udp = ip + 20 ;
+
+    ip[0] = 0x45 ;
+    ip[1] = 0 ;
+    put16( ip + 2, 28 + size ) ;
+    put16( ip + 4, sim->ip_id++ ) ;
+    put16( ip + 6, 0x4000 ) ;
+    ip[8] = 64 ;
+    ip[9] = 17 ;
+    put16( ip + 10, 0 ) ;
+    put32( ip + 12, src_ip ) ;
+    put32( ip + 16, SIM_BOARD_IP ) ;
+    put16( ip + 10, ~checksum( ip, 20, 0 ) ) ;
+    put16( udp, src_port ) ;
+    put16( udp + 2, dst_port ) ;
+    put16( udp + 4, 8 + size ) ;
+    put16( udp + 6, 0 ) ;
+    memcpy( udp + 8, payload, size ) ;
+
+    return 42 + size ;
+}
+
+/* Frame for somebody else, or for the board but not for its transfer */
+static void queue_stray( Sim* sim )
+{
+    static const uint8_t zero[6] = { 0 } ;
+    uint8_t frame[NETBOOT_MAX_FRAME] ;
+    uint8_t junk[1472] ;
+    uint32_t size ;
+
+    switch ( rand() % 3 )
+    {
+        case 0 :
+            size = build_arp( frame, 1, other_mac, SIM_OTHER_IP, zero, SIM_SERVER_IP ) ;
+        break ;
+
+        case 1 :
+            /* The server checks the board is still there */
+            size = build_arp( frame, 1, server_mac, SIM_SERVER_IP, zero, SIM_BOARD_IP ) ;
+        break ;
+
+        default :
+            memset( junk, 0xA5, sizeof( junk ) ) ;
+            size = build_udp( sim, frame, SIM_OTHER_IP, 5000, 5001, junk, 64 + rand() % (sizeof( junk ) - 64) ) ;
+        break ;
+    }
+    queue_frame( sim, frame, size ) ;
+    sim->strays++ ;
+}
+
+/* Frame sent by the client */
+static void sim_send( void* arg, const uint8_t* frame, uint32_t size )
+{
+    Sim* sim = (Sim*)arg ;
+    const uint8_t* ip = frame + 14 ;
+    const uint8_t* udp = ip + 20 ;
+    uint8_t reply[64] ;
+    struct sockaddr_in to ;
+    uint32_t udp_size ;
+    uint32_t port ;
+
+    if ( (size < 60) || memcmp( frame + 6, board_mac, 6 ) )
+    {
+        sim->bad_frames++ ;
+        return ;
+    }
+
+    if ( get16( frame + 12 ) == 0x0806 )
+    {
+        if ( (get16( ip + 6 ) == 1) && (get32( ip + 24 ) == SIM_SERVER_IP) )
+        {
+            queue_frame( sim, reply, build_arp( reply, 2, server_mac, SIM_SERVER_IP, ip + 8, get32( ip + 14 ) ) ) ;
+        }
+        else if ( (get16( ip + 6 ) == 2) && !memcmp( frame, server_mac, 6 ) && (get32( ip + 14 ) == SIM_BOARD_IP) )
+        {
+            sim->arp_replies++ ;
+        }
+        return ;
+    }
+
+    udp_size = get16( udp + 4 ) ;
+    if ( (get16( frame + 12 ) != 0x0800) || memcmp( frame, server_mac, 6 ) || (ip[9] != 17)
+      || (get32( ip + 12 ) != SIM_BOARD_IP) || (get32( ip + 16 ) != SIM_SERVER_IP)
+      || (checksum( ip, 20, 0 ) != 0xFFFF) || (20 + udp_size > size - 14)
+      || (checksum( udp, udp_size, checksum( ip + 12, 8, 17 + udp_size ) ) != 0xFFFF) )
+    {
+        sim->bad_frames++ ;
+        return ;
+    }
+    if ( chance( drop_rate ) )
+    {
+        sim->dropped++ ;
+        return ;
+    }
+
+    sim->board_port = get16( udp ) ;
+    port = get16( udp + 2 ) ;
+    memset( &to, 0, sizeof( to ) ) ;
+    to.sin_family = AF_INET ;
+    to.sin_addr.s_addr = htonl( INADDR_LOOPBACK ) ;
+    to.sin_port = htons( (port == 69) ? sim->server_port : port ) ;
+    sendto( sim->sock, udp + 8, udp_size - 8, 0, (struct sockaddr*)&to, sizeof( to ) ) ;
+}
+
+static void sim_rx_start( void* arg, NetbootRxDescriptor* ring )
+{
+    Sim* sim = (Sim*)arg ;
+
+    sim->ring = ring ;
+    sim->index = 0 ;
+    sim->enabled = 1 ;
+}
+
+static uint32_t sim_rx_enable( void* arg, uint8_t enable )
+{
+    Sim* sim = (Sim*)arg ;
+
+    sim->enabled = enable ;
+    return sim->index ;
+}
+
+/* Datagrams from the server, frames queued for the board */
+static void sim_idle( void* arg )
+{
+    Sim* sim = (Sim*)arg ;
+    struct pollfd pfd = { sim->sock, POLLIN, 0 } ;
+    struct sockaddr_in from ;
+    socklen_t from_size ;
+    uint8_t payload[65536] ;
+    uint8_t frame[NETBOOT_MAX_FRAME] ;
+    ssize_t size ;
+    uint32_t port ;
+
+    while ( poll( &pfd, 1, sim->queue_count ? 0 : 1 ) > 0 )
+    {
+        from_size = sizeof( from ) ;
+        size = recvfrom( sim->sock, payload, sizeof( payload ), 0, (struct sockaddr*)&from, &from_size ) ;
+        if ( (size < 0) || (size > NETBOOT_MAX_FRAME - 42) )
+        {
+            continue ;
+        }
+        if ( chance( stray_rate ) )
+        {
+            queue_stray( sim ) ;
+        }
+        if ( chance( drop_rate ) )
+        {
+            sim->dropped++ ;
+            continue ;
+        }
+        port = ntohs( from.sin_port ) ;
+        queue_frame( sim, frame, build_udp( sim, frame, SIM_SERVER_IP, (port == sim->server_port) ? 69 : port,
+                                            sim->board_port, payload, (uint32_t)size ) ) ;
+    }
+
+    /* The EMAC takes them in as they come */
+    while ( sim->queue_count )
+    {
+        emac_store( sim, sim->queue[sim->queue_head].data, sim->queue[sim->queue_head].size ) ;
+        sim->queue_head = (sim->queue_head + 1) % SIM_QUEUE_SIZE ;
+        sim->queue_count-- ;
+    }
+}
+
+static void usage( void )
+{
+    fprintf( stderr, "usage: netsim [-p port] [-e n] [-s n] [-o dir] <name>...\n" ) ;
+    exit( 2 ) ;
+}
+
+int main( int argc, char** argv )
+{
+    static Sim sim ;
+    NetbootDevice device = { sim_send, sim_rx_start, sim_rx_enable, now_ms, sim_idle, &sim } ;
+    const char* out_dir = "." ;
+    struct sockaddr_in local ;
+    Netboot* net ;
+    uint8_t* memory ;
+    uint32_t memory_size = (sizeof( Netboot ) + 0xFFFF) / 0x10000 * 0x10000 + SIM_MEMORY_SIZE ;
+    uint32_t offset ;
+    uint32_t size ;
+    uint32_t start ;
+    uint32_t ms ;
+    uint32_t result ;
+    int failed = 0 ;
+    char path[1024] ;
+    FILE* file ;
+    int opt ;
+
+    sim.server_port = 69 ;
+    while ( (opt = getopt( argc, argv, "p:e:s:o:" )) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'p' : sim.server_port = (uint16_t)atoi( optarg ) ; break ;
+            case 'e' : drop_rate = atoi( optarg ) ; break ;
+            case 's' : stray_rate = atoi( optarg ) ; break ;
+            case 'o' : out_dir = optarg ; break ;
+            default : usage() ;
+        }
+    }
+    if ( optind >= argc )
+    {
+        usage() ;
+    }
+    srand( 1 ) ;
+
+    memory = mmap( NULL, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0 ) ;
+    if ( (memory == MAP_FAILED) || ((uintptr_t)memory + memory_size > 0xFFFFFFFFu) )
+    {
+        fprintf( stderr, "netsim: no memory below 4 GB\n" ) ;
+        return 1 ;
+    }
+    net = (Netboot*)memory ;
+    offset = memory_size - SIM_MEMORY_SIZE ;
+
+    sim.sock = socket( AF_INET, SOCK_DGRAM, 0 ) ;
+    memset( &local, 0, sizeof( local ) ) ;
+    local.sin_family = AF_INET ;
+    local.sin_addr.s_addr = htonl( INADDR_LOOPBACK ) ;
+    if ( (sim.sock < 0) || bind( sim.sock, (struct sockaddr*)&local, sizeof( local ) ) )
+    {
+        perror( "netsim: socket" ) ;
+        return 1 ;
+    }
+
+    Netboot_Initialize( net, &device, board_mac, SIM_BOARD_IP, SIM_SERVER_IP ) ;
+    for ( ; optind < argc ; optind++ )
+    {
+        memset( &net->stats, 0, sizeof( net->stats ) ) ;
+        start = now_ms() ;
+        result = Netboot_Fetch( net, argv[optind], memory + offset, memory_size - offset, &size ) ;
+        ms = now_ms() - start ;
+        if ( result != NETBOOT_OK )
+        {
+            fprintf( stderr, "netsim: %s failed (%u)\n", argv[optind], result ) ;
+            failed = 1 ;
+            continue ;
+        }
+
+        printf( "netsim: %s, %u bytes in %u ms (%u KB/s), %u blocks in place, %u gathered, %u frames, %u dropped, %u resent\n",
+                argv[optind], size, ms, (unsigned int)((uint64_t)size / (ms ? ms : 1)), net->stats.dwDirect,
+                net->stats.dwGathered, net->stats.dwFrames, net->stats.dwDropped, net->stats.dwResent ) ;
+        snprintf( path, sizeof( path ), "%s/%s", out_dir, argv[optind] ) ;
+        file = fopen( path, "wb" ) ;
+        if ( !file || (fwrite( memory + offset, 1, size, file ) != size) )
+        {
+            perror( path ) ;
+            failed = 1 ;
+        }
+        if ( file )
+        {
+            fclose( file ) ;
+        }
+        /* Next image after this one, word aligned */
+        offset = (offset + size + 0xFFF) & ~0xFFFu ;
+    }
+
+    printf( "netsim: EMAC stored %u frames, %u without buffer, %u while paused; %u dropped, %u strays, "
+            "%u ARP replies, %u bad frames from the client\n",
+            sim.stored, sim.no_buffer, sim.paused, sim.dropped, sim.strays, sim.arp_replies, sim.bad_frames ) ;
+
+    return failed || sim.bad_frames ;
+}
@@ -0,0 +1,379 @@
+/**
+ * \file
+ *
+ * Host test bench of the cooperative boot scheduler (see inc/sched.h).
+ *
+ * Build with "make schedsim", then:
+ *
+ *   schedsim
+ *       Run the boot tasks of main.c, reduced to their waits and their CPU
+ *       time, on a simulated clock: the NAND initialization runs on the
+ *       CPU, yielding after each group of blocks scanned, the SD card is
+ *       polled once per slice until it has powered up, the LCD waits for the
+ *       SD card, draws the splash screen and waits for the interrupt of its
+ *       DMA with SCHED_WAIT_EVENTS(), and the load task waits for the SD card
+ *       and the splash screen, then reads the images in chunks, each ended
+ *       by an interrupt. The idle hook erases dirty NAND blocks once the
+ *       NAND is up, like _Idle(), and otherwise sleeps until the next
+ *       interrupt. The run is made with the clock starting at 0, then with
+ *       the clock wrapping during the boot, and prints the report of each.
+ *
+ * The run fails when a task waiting for events is called before all of them
+ * are posted, when the idle hook is called while a task is ready, when the
+ * accounting of a task (calls, busy and completion cycles) differs from the
+ * model, when the two runs differ, or when the tasks deadlock.
+ */
+
+#include "sched.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Simulated core clock (BOARD_MCK) */
+#define SIM_CYCLES_PER_US       84
+#define SIM_US( us )            ((uint32_t)(us) * SIM_CYCLES_PER_US)
+
+/* NAND block scan, in groups of blocks */
+#define SIM_NAND_GROUPS         8
+#define SIM_NAND_GROUP_US       3750
+
+/* SD card power-up, polled with one ACMD41 per slice */
+#define SIM_SD_POWERUP_US       25000
+#define SIM_SD_POLL_US          150
+
+/* Pending interrupts */
+#define SIM_MAX_IRQ             4
+
+/* Dirty NAND blocks erased by the idle hook, one per call */
+#define SIM_DIRTY_BLOCKS        12
+#define SIM_ERASE_US            1500
+
+/* Boot events, as in main.c */
+#define EVENT_NAND_DONE         (1 << 0)
+#define EVENT_SD_DONE           (1 << 1)
+#define EVENT_LCD_DONE          (1 << 2)
+#define EVENT_SPLASH_DONE       (1 << 3)
+#define EVENT_LCD_FILL          (1 << 4)
+/* Interrupt events of the simulated peripherals */
+#define EVENT_READ_DONE         (1 << 9)
+
+/* Image chunks read by the load task */
+#define SIM_CHUNKS              8
+
+typedef struct
+{
+    uint32_t deadline ;
+    uint32_t events ;
+} Irq ;
+
+/* Model of a task: what the scheduler should account for it */
+typedef struct
+{
+    uint32_t calls ;
+    uint32_t busy ;
+    uint32_t done ;
+    uint32_t waiting ;
+} Model ;
+
+typedef struct
+{
+    uint32_t now ;
+    uint32_t start ;
+    Irq irq[SIM_MAX_IRQ] ;
+    uint32_t irqs ;
+    uint32_t dirty ;
+    uint32_t idles ;
+    uint32_t sd_powered ;
+} Sim ;
+
+static Sim sim ;
+static uint32_t violations ;
+
+static SchedTask lcdTask ;
+static SchedTask nandTask ;
+static SchedTask sdTask ;
+static SchedTask loadTask ;
+static SchedTask* tasks[] = { &sdTask, &loadTask, &lcdTask, &nandTask } ;
+
+static void violation( const char* task, const char* text )
+{
+    fprintf( stderr, "schedsim: %s: %s\n", task, text ) ;
+    violations++ ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Simulated clock and interrupts
+ *----------------------------------------------------------------------------*/
+
+/* Runs the handlers of the interrupts due by now */
+static void deliver( void )
+{
+    uint32_t i = 0 ;
+
+    while ( i < sim.irqs )
+    {
+        if ( (int32_t)(sim.now - sim.irq[i].deadline) >= 0 )
+        {
+            Sched_PostEvent( sim.irq[i].events ) ;
+            sim.irq[i] = sim.irq[--sim.irqs] ;
+        }
+        else
+        {
+            i++ ;
+        }
+    }
+}
+
+static void advance( uint32_t cycles )
+{
+    sim.now += cycles ;
+    deliver() ;
+}
+
+/* Starts a peripheral operation ending with an interrupt */
+static void start_irq( uint32_t us, uint32_t events )
+{
+    if ( sim.irqs == SIM_MAX_IRQ )
+    {
+        violation( "sim", "too many pending interrupts" ) ;
+        return ;
+    }
+    sim.irq[sim.irqs].deadline = sim.now + SIM_US( us ) ;
+    sim.irq[sim.irqs].events = events ;
+    sim.irqs++ ;
+}
+
+static uint32_t get_cycles( void )
+{
+    return sim.now ;
+}
+
+/* CPU time spent by a task body */
+static void work( SchedTask* pTask, uint32_t us )
+{
+    ((Model*)pTask->pArg)->busy += SIM_US( us ) ;
+    advance( SIM_US( us ) ) ;
+}
+
+/* Entry of every task body: counts the call and checks the events waited for */
+static void enter( SchedTask* pTask )
+{
+    Model* pModel = pTask->pArg ;
+
+    pModel->calls++ ;
+    if ( (Sched_GetEvents() & pModel->waiting) != pModel->waiting )
+    {
+        violation( pTask->pName, "called before its events are posted" ) ;
+    }
+    pModel->waiting = 0 ;
+}
+
+/* Waits for events, recording them for the check made by enter() */
+#define WAIT_EVENTS( pTask, dwMask ) \
+    do { ((Model*)(pTask)->pArg)->waiting = (dwMask) ; SCHED_WAIT_EVENTS( pTask, dwMask ) ; } while ( 0 )
+
+static void leave( SchedTask* pTask )
+{
+    ((Model*)pTask->pArg)->done = sim.now ;
+}
+
+/* Idle hook: erases a dirty NAND block once the NAND is up, else sleeps */
+static void idle( void )
+{
+    uint32_t next ;
+    uint32_t i ;
+
+    sim.idles++ ;
+    for ( i = 0 ; i < sizeof( tasks ) / sizeof( tasks[0] ) ; i++ )
+    {
+        if ( tasks[i]->bState == SCHED_STATE_READY )
+        {
+            violation( tasks[i]->pName, "ready while the idle hook is called" ) ;
+        }
+    }
+
+    if ( (Sched_GetEvents() & EVENT_NAND_DONE) && sim.dirty )
+    {
+        sim.dirty-- ;
+        advance( SIM_US( SIM_ERASE_US ) ) ;
+        return ;
+    }
+
+    if ( sim.irqs == 0 )
+    {
+        fprintf( stderr, "schedsim: deadlock, every task waits and no interrupt is pending\n" ) ;
+        exit( 1 ) ;
+    }
+    next = sim.irq[0].deadline ;
+    for ( i = 1 ; i < sim.irqs ; i++ )
+    {
+        if ( (int32_t)(sim.irq[i].deadline - next) < 0 )
+        {
+            next = sim.irq[i].deadline ;
+        }
+    }
+    advance( next - sim.now ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Boot tasks
+ *----------------------------------------------------------------------------*/
+
+static uint8_t lcd_task( SchedTask* pTask )
+{
+    enter( pTask ) ;
+    SCHED_BEGIN( pTask ) ;
+
+    work( pTask, 800 ) ;
+    SCHED_YIELD( pTask ) ;
+
+    WAIT_EVENTS( pTask, EVENT_SD_DONE ) ;
+    work( pTask, 4000 ) ;
+    Sched_PostEvent( EVENT_SPLASH_DONE ) ;
+
+    Sched_ClearEvent( EVENT_LCD_FILL ) ;
+    start_irq( 6000, EVENT_LCD_FILL ) ;
+    WAIT_EVENTS( pTask, EVENT_LCD_FILL ) ;
+    Sched_PostEvent( EVENT_LCD_DONE ) ;
+
+    leave( pTask ) ;
+    SCHED_END( pTask ) ;
+}
+
+static uint8_t nand_task( SchedTask* pTask )
+{
+    static uint32_t group ;
+
+    enter( pTask ) ;
+    SCHED_BEGIN( pTask ) ;
+
+    for ( group = 0 ; group < SIM_NAND_GROUPS ; group++ )
+    {
+        work( pTask, SIM_NAND_GROUP_US ) ;
+        SCHED_YIELD( pTask ) ;
+    }
+    Sched_PostEvent( EVENT_NAND_DONE ) ;
+
+    leave( pTask ) ;
+    SCHED_END( pTask ) ;
+}
+
+static uint8_t sd_task( SchedTask* pTask )
+{
+    enter( pTask ) ;
+    SCHED_BEGIN( pTask ) ;
+
+    work( pTask, 1000 ) ;
+    sim.sd_powered = sim.now + SIM_US( SIM_SD_POWERUP_US ) ;
+    do
+    {
+        SCHED_YIELD( pTask ) ;
+        work( pTask, SIM_SD_POLL_US ) ;
+    }
+    while ( (int32_t)(sim.now - sim.sd_powered) < 0 ) ;
+    work( pTask, 2000 ) ;
+    Sched_PostEvent( EVENT_SD_DONE ) ;
+
+    leave( pTask ) ;
+    SCHED_END( pTask ) ;
+}
+
+static uint8_t load_task( SchedTask* pTask )
+{
+    static uint32_t chunk ;
+
+    enter( pTask ) ;
+    SCHED_BEGIN( pTask ) ;
+
+    WAIT_EVENTS( pTask, EVENT_SD_DONE | EVENT_SPLASH_DONE ) ;
+
+    for ( chunk = 0 ; chunk < SIM_CHUNKS ; chunk++ )
+    {
+        /* The event is sticky: clear it before starting the next read */
+        Sched_ClearEvent( EVENT_READ_DONE ) ;
+        start_irq( 5000, EVENT_READ_DONE ) ;
+        WAIT_EVENTS( pTask, EVENT_READ_DONE ) ;
+        work( pTask, 300 ) ;
+    }
+
+    leave( pTask ) ;
+    SCHED_END( pTask ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Runs
+ *----------------------------------------------------------------------------*/
+
+/* Boots once from the given clock value, returns the accounting of the tasks */
+static int run( uint32_t start, Model* models )
+{
+    static const char* names[] = { "sdcard", "load", "lcd", "nand" } ;
+    static const SchedTaskFunc bodies[] = { sd_task, load_task, lcd_task, nand_task } ;
+    uint32_t serial = 0 ;
+    uint32_t elapsed ;
+    uint32_t i ;
+    int errors = 0 ;
+
+    memset( &sim, 0, sizeof( sim ) ) ;
+    memset( models, 0, 4 * sizeof( Model ) ) ;
+    sim.now = sim.start = start ;
+    sim.dirty = SIM_DIRTY_BLOCKS ;
+
+    Sched_Initialize( get_cycles, idle ) ;
+    for ( i = 0 ; i < 4 ; i++ )
+    {
+        Sched_AddTask( tasks[i], names[i], bodies[i], &models[i] ) ;
+    }
+    Sched_Run() ;
+
+    printf( "schedsim: clock starting at 0x%08X\n", start ) ;
+    Sched_PrintReport( SIM_CYCLES_PER_US ) ;
+
+    for ( i = 0 ; i < 4 ; i++ )
+    {
+        if ( (tasks[i]->bState != SCHED_STATE_DONE)
+             || (tasks[i]->dwRuns != models[i].calls)
+             || (tasks[i]->dwBusyCycles != models[i].busy)
+             || (tasks[i]->dwEndCycle != models[i].done) )
+        {
+            fprintf( stderr, "schedsim: %s: accounted %u calls, %u busy, done at %u; model %u, %u, %u\n",
+                     tasks[i]->pName, tasks[i]->dwRuns, tasks[i]->dwBusyCycles, tasks[i]->dwEndCycle - start,
+                     models[i].calls, models[i].busy, models[i].done - start ) ;
+            errors++ ;
+        }
+        serial += models[i].busy ;
+        models[i].done -= start ;
+    }
+
+    /* The waits overlap: the boot is shorter than the tasks run one by one */
+    elapsed = sim.now - start ;
+    if ( (elapsed >= serial + SIM_US( SIM_SD_POWERUP_US + 6000 + SIM_CHUNKS * 5000 )) || sim.dirty )
+    {
+        fprintf( stderr, "schedsim: waits not overlapped or NAND not cleaned (%u dirty blocks)\n", sim.dirty ) ;
+        errors++ ;
+    }
+    printf( "schedsim: boot in %u us, %u us of CPU, %u idle calls\n",
+            elapsed / SIM_CYCLES_PER_US, serial / SIM_CYCLES_PER_US, sim.idles ) ;
+
+    return errors ;
+}
+
+int main( int argc, char** argv )
+{
+    Model first[4] ;
+    Model wrapped[4] ;
+    int errors = 0 ;
+
+    errors += run( 0, first ) ;
+    errors += run( 0u - SIM_US( 20000 ), wrapped ) ;
+    if ( memcmp( first, wrapped, sizeof( first ) ) )
+    {
+        fprintf( stderr, "schedsim: the run differs when the clock wraps\n" ) ;
+        errors++ ;
+    }
+
+    printf( "schedsim: %u errors, %u violations\n", errors, violations ) ;
+
+    return (errors || violations) ? 1 : 0 ;
+}
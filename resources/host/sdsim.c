@@ -0,0 +1,721 @@
+/**
+ * \file
+ *
+ * Host test bench of the SD write-back windows (see MEDSdcard.c).
+ *
+ * Build with "make sdsim", then:
+ *
+ *   sdsim [-n writes] [-a au_kb]
+ *       Run FatFs-style workloads of <writes> writes each (200000 by
+ *       default) on a model of a SD card with allocation units (AU) of
+ *       <au_kb> KB (512 by default), first straight to the card as
+ *       MEDSdcard_Write() did before the windows (one SD_Write() per request,
+ *       no flush, no trim), then through MED_Write()/MED_Flush()/MED_Trim() on
+ *       MEDSdcard. The workloads are:
+ *
+ *       - fat-seq: one file appended with 4KB writes, synced every 128 writes
+ *         (FAT, FSINFO and directory sectors, then CTRL_SYNC);
+ *       - fat-2files: two pre-allocated files appended in turn;
+ *       - fat-rand: writes at random in a pre-allocated 16MB file, 4KB ones
+ *         and one 1MB every 64 writes.
+ *
+ *       A file that reaches the end of its area is deleted (CTRL_TRIM) and
+ *       written again. Every 1000 writes, the last range written and a random
+ *       range are read back through the same path and compared with the last
+ *       data written, and the whole card is compared at the end of each run.
+ *
+ * The card model replaces the functions of sdmmc.c used by MEDSdcard. Each
+ * block written carries its address and a version stamp, and the card keeps
+ * the versions. The cost model is the one of the flash translation of low-end
+ * cards: data is programmed in 16KB pages and a page partly written in one
+ * command is read, merged and programmed again; SIM_OPEN_AUS AUs are open at
+ * a time, and closing one (to open another one, or to write again a page
+ * already written since it was opened) copies the pages of the AU holding data
+ * that were not written again. Erased (trimmed) pages are not copied. The
+ * run reports the card commands, the pages programmed, merged and copied, and
+ * the time and throughput of the card with the SIM_xxx_US costs below.
+ *
+ * The run fails when a block reads back wrong or lands at the wrong address,
+ * or on a card access the driver should not make.
+ */
+
+#include "hostcpu.h"
+#include "memories.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE     MAP_FIXED
+#endif
+
+/* Card geometry: 64MB, 16KB pages */
+#define SIM_BLOCKS              (64 * 2048)
+#define SIM_PAGE_BLOCKS         32
+#define SIM_PAGES               (SIM_BLOCKS / SIM_PAGE_BLOCKS)
+#define SIM_OPEN_AUS            2
+
+/* Card costs in us: command and busy, 512 bytes on a 25MB/s bus, page
+   program and page read */
+#define SIM_CMD_US              100
+#define SIM_XFER_US             21
+#define SIM_PROGRAM_US          400
+#define SIM_READ_US             60
+
+/* Volume layout, in blocks */
+#define SIM_FSINFO_BLOCK        1
+#define SIM_FAT_BASE            32
+#define SIM_DIR_BLOCK           2048
+#define SIM_DATA_BASE           4096
+#define SIM_CLUSTER_BLOCKS      8
+#define SIM_RAND_FILE_BLOCKS    (16 * 2048)
+
+/* Longest request of the workloads */
+#define SIM_MAX_BLOCKS          2048
+
+/* ACMD41 polls the card answers busy after the power-on */
+#define SIM_POWERUP_POLLS       3
+
+/* Version of a block deleted by CTRL_TRIM: any content */
+#define SIM_TRIMMED             0xFFFFFFFF
+
+typedef struct
+{
+    /* Version stamp of each block, and state of each page */
+    uint32_t version[SIM_BLOCKS] ;
+    uint8_t valid[SIM_PAGES] ;
+    uint8_t written[SIM_PAGES] ;
+    uint32_t au_blocks ;
+
+    /* Open AUs, least recently used first */
+    uint32_t open[SIM_OPEN_AUS] ;
+    uint32_t num_open ;
+
+    /* Open-ended transfer: 0, 'r' or 'w', next block and page being received */
+    int stream ;
+    uint32_t next ;
+    uint32_t page ;
+    uint32_t page_mask ;
+
+    /* Statistics */
+    uint32_t commands ;
+    uint32_t pre_erases ;
+    uint32_t programs ;
+    uint32_t merges ;
+    uint32_t copies ;
+    double us ;
+} Card ;
+
+static Card card ;
+static uint32_t ref[SIM_BLOCKS] ;
+static uint32_t stamp ;
+static uint32_t lastAddress ;
+static uint32_t lastLength ;
+static uint32_t errors ;
+static uint32_t violations ;
+
+static uint8_t buffer[SIM_MAX_BLOCKS * SD_BLOCK_SIZE] __attribute__((aligned(4))) ;
+
+static Media media ;
+static int useMedia ;
+static uint32_t powerUpPolls ;
+
+static void violation( const char* text, uint32_t block )
+{
+    if ( violations++ < 10 )
+    {
+        fprintf( stderr, "sdsim: %s (block %u)\n", text, block ) ;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Card model
+ *----------------------------------------------------------------------------*/
+
+/* Copies the pages of an AU holding data that were not written since it opened */
+static void close_au( uint32_t au )
+{
+    uint32_t pages = card.au_blocks / SIM_PAGE_BLOCKS ;
+    uint32_t page ;
+
+    for ( page = au * pages ; page < (au + 1) * pages ; page++ )
+    {
+        if ( card.valid[page] && !card.written[page] )
+        {
+            card.copies++ ;
+            card.us += SIM_READ_US + SIM_PROGRAM_US ;
+        }
+        card.written[page] = 0 ;
+    }
+}
+
+static void open_au( uint32_t au )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < card.num_open ; i++ )
+    {
+        if ( card.open[i] == au )
+        {
+            memmove( &card.open[i], &card.open[i + 1], (card.num_open - i - 1) * sizeof( uint32_t ) ) ;
+            card.open[card.num_open - 1] = au ;
+            return ;
+        }
+    }
+    if ( card.num_open == SIM_OPEN_AUS )
+    {
+        close_au( card.open[0] ) ;
+        memmove( &card.open[0], &card.open[1], (SIM_OPEN_AUS - 1) * sizeof( uint32_t ) ) ;
+        card.num_open-- ;
+    }
+    card.open[card.num_open++] = au ;
+}
+
+static void program_page( uint32_t page, uint32_t mask )
+{
+    uint32_t au = page * SIM_PAGE_BLOCKS / card.au_blocks ;
+
+    open_au( au ) ;
+    if ( card.written[page] )
+    {
+        /* The page is programmed once per AU cycle */
+        close_au( au ) ;
+    }
+    if ( (mask != 0xFFFFFFFF) && card.valid[page] )
+    {
+        card.merges++ ;
+        card.us += SIM_READ_US ;
+    }
+    card.programs++ ;
+    card.us += SIM_PROGRAM_US ;
+    card.written[page] = 1 ;
+    card.valid[page] = 1 ;
+}
+
+static void flush_page( void )
+{
+    if ( card.page_mask )
+    {
+        program_page( card.page, card.page_mask ) ;
+        card.page_mask = 0 ;
+    }
+}
+
+/* CMD12: the card programs the last page received */
+static void stop( void )
+{
+    if ( card.stream )
+    {
+        card.commands++ ;
+        card.us += SIM_CMD_US ;
+        flush_page() ;
+        card.stream = 0 ;
+    }
+}
+
+static void open_stream( int stream, uint32_t address )
+{
+    if ( (card.stream != stream) || (card.next != address) )
+    {
+        stop() ;
+        card.stream = stream ;
+        card.commands++ ;
+        card.us += SIM_CMD_US ;
+    }
+}
+
+static void reset_card( uint32_t au_blocks )
+{
+    memset( &card, 0, sizeof( card ) ) ;
+    card.au_blocks = au_blocks ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Functions of sdmmc.c and of the MCI and PIO drivers
+ *----------------------------------------------------------------------------*/
+
+extern uint8_t SD_InitStart( SdCard *pSd, void *pSdDriver )
+{
+    powerUpPolls = 0 ;
+
+    return 0 ;
+}
+
+extern uint8_t SD_InitStep( SdCard *pSd )
+{
+    if ( powerUpPolls++ < SIM_POWERUP_POLLS )
+    {
+        return SDMMC_ERROR_BUSY ;
+    }
+    pSd->blockNr = SIM_BLOCKS ;
+
+    return 0 ;
+}
+
+extern uint8_t SD_Init( SdCard *pSd, void *pSdDriver )
+{
+    uint8_t error ;
+
+    SD_InitStart( pSd, pSdDriver ) ;
+    do
+    {
+        error = SD_InitStep( pSd ) ;
+    }
+    while ( error == SDMMC_ERROR_BUSY ) ;
+
+    return error ;
+}
+
+extern uint32_t SD_GetTotalSizeKB( SdCard *pSd )
+{
+    return SIM_BLOCKS / 2 ;
+}
+
+extern uint8_t SD_Read( SdCard *pSd, uint32_t address, void *pData, uint32_t length, SdmmcCallback pCallback, void *pArgs )
+{
+    uint32_t* pWords = (uint32_t*)pData ;
+    uint32_t i ;
+
+    if ( (address + length > SIM_BLOCKS) || pCallback )
+    {
+        violation( "bad read", address ) ;
+        return SDMMC_ERROR ;
+    }
+    open_stream( 'r', address ) ;
+    for ( i = 0 ; i < length ; i++, pWords += SD_BLOCK_SIZE / 4 )
+    {
+        pWords[0] = address + i ;
+        pWords[1] = card.version[address + i] ;
+        card.us += SIM_XFER_US ;
+    }
+    card.next = address + length ;
+
+    return 0 ;
+}
+
+extern uint8_t SD_Write( SdCard *pSd, uint32_t address, void *pData, uint32_t length, SdmmcCallback pCallback, void *pArgs )
+{
+    const uint32_t* pWords = (const uint32_t*)pData ;
+    uint32_t block, page ;
+
+    if ( (address + length > SIM_BLOCKS) || pCallback )
+    {
+        violation( "bad write", address ) ;
+        return SDMMC_ERROR ;
+    }
+    open_stream( 'w', address ) ;
+    for ( block = address ; block < address + length ; block++, pWords += SD_BLOCK_SIZE / 4 )
+    {
+        if ( pWords[0] != block )
+        {
+            violation( "block written at the wrong address", block ) ;
+        }
+        card.version[block] = pWords[1] ;
+
+        page = block / SIM_PAGE_BLOCKS ;
+        if ( page != card.page )
+        {
+            flush_page() ;
+            card.page = page ;
+        }
+        card.page_mask |= 1u << (block % SIM_PAGE_BLOCKS) ;
+        card.us += SIM_XFER_US ;
+    }
+    card.next = address + length ;
+
+    return 0 ;
+}
+
+extern uint8_t SD_WritePreErased( SdCard *pSd, uint32_t address, void *pData, uint32_t length )
+{
+    /* CMD12, ACMD23 and a new CMD25 */
+    stop() ;
+    card.pre_erases++ ;
+    card.commands++ ;
+    card.us += SIM_CMD_US ;
+    open_stream( 'w', address ) ;
+
+    return SD_Write( pSd, address, pData, length, 0, 0 ) ;
+}
+
+extern uint8_t SD_StopTransfer( SdCard *pSd )
+{
+    stop() ;
+
+    return 0 ;
+}
+
+extern uint32_t SD_GetAuSizeBlocks( SdCard *pSd )
+{
+    return card.au_blocks ;
+}
+
+extern uint32_t SD_GetEraseUnitBlocks( SdCard *pSd )
+{
+    return card.au_blocks ;
+}
+
+extern uint8_t SD_Erase( SdCard *pSd, uint32_t start, uint32_t end )
+{
+    uint32_t block ;
+
+    if ( (start > end) || (end >= SIM_BLOCKS) || (start % card.au_blocks) || ((end + 1) % card.au_blocks) )
+    {
+        violation( "erase not aligned on the AU", start ) ;
+        return SDMMC_ERROR ;
+    }
+    stop() ;
+
+    /* CMD32, CMD33 and CMD38 */
+    card.commands += 3 ;
+    card.us += 3 * SIM_CMD_US ;
+    for ( block = start ; block <= end ; block++ )
+    {
+        card.version[block] = 0 ;
+        card.valid[block / SIM_PAGE_BLOCKS] = 0 ;
+        card.written[block / SIM_PAGE_BLOCKS] = 0 ;
+    }
+
+    return 0 ;
+}
+
+extern uint8_t SD_WriteBlock( SdCard *pSd, uint32_t address, uint16_t nbBlocks, uint8_t *pData )
+{
+    violation( "unexpected SD_WriteBlock()", address ) ;
+
+    return SDMMC_ERROR ;
+}
+
+extern uint8_t SD_WriteBlocks( SdCard *pSd, uint32_t address, uint16_t nbBlocks, uint8_t *pData )
+{
+    violation( "unexpected SD_WriteBlocks()", address ) ;
+
+    return SDMMC_ERROR ;
+}
+
+extern void MCI_Init( Mcid *pMci, Hsmci *pMciHw, uint8_t mciId, uint32_t dwMCk )
+{
+}
+
+extern uint32_t MCI_SetSpeed( Mcid *pMci, uint32_t mciSpeed, uint32_t mck )
+{
+    return mciSpeed ;
+}
+
+extern void MCI_SetBusyFix( Mcid *pMci, const Pin * pDAT0 )
+{
+}
+
+extern void Sdmmc_Handler( Mcid *pMci )
+{
+}
+
+extern void DMAD_Initialize( uint32_t dwChannel, uint32_t defaultHandler )
+{
+}
+
+extern uint8_t PIO_Configure( const Pin *list, uint32_t size )
+{
+    return 1 ;
+}
+
+/* Card present, not write protected */
+extern uint8_t PIO_Get( const Pin *pin )
+{
+    return 0 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Workloads
+ *----------------------------------------------------------------------------*/
+
+static void sim_write( uint32_t address, uint32_t length )
+{
+    uint32_t* pWords = (uint32_t*)buffer ;
+    uint32_t i ;
+
+    for ( i = 0 ; i < length ; i++, pWords += SD_BLOCK_SIZE / 4 )
+    {
+        pWords[0] = address + i ;
+        pWords[1] = ref[address + i] = ++stamp ;
+    }
+    lastAddress = address ;
+    lastLength = length ;
+    if ( useMedia )
+    {
+        if ( MED_Write( &media, address, buffer, length, 0, 0 ) != MED_STATUS_SUCCESS )
+        {
+            violation( "MED_Write() failed", address ) ;
+        }
+    }
+    else
+    {
+        SD_Write( 0, address, buffer, length, 0, 0 ) ;
+    }
+}
+
+/* CTRL_SYNC: nothing to do without the windows */
+static void sim_sync( void )
+{
+    if ( useMedia && (MED_Flush( &media ) != MED_STATUS_SUCCESS) )
+    {
+        violation( "MED_Flush() failed", 0 ) ;
+    }
+}
+
+/* CTRL_TRIM: not sent to the card without the windows */
+static void sim_trim( uint32_t address, uint32_t length )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < length ; i++ )
+    {
+        ref[address + i] = SIM_TRIMMED ;
+    }
+    if ( useMedia && (MED_Trim( &media, address, length ) != MED_STATUS_SUCCESS) )
+    {
+        violation( "MED_Trim() failed", address ) ;
+    }
+}
+
+static void sim_read( uint32_t address, uint32_t length )
+{
+    const uint32_t* pWords = (const uint32_t*)buffer ;
+    uint32_t i ;
+
+    memset( buffer, 0, length * SD_BLOCK_SIZE ) ;
+    if ( useMedia )
+    {
+        if ( MED_Read( &media, address, buffer, length, 0, 0 ) != MED_STATUS_SUCCESS )
+        {
+            violation( "MED_Read() failed", address ) ;
+        }
+    }
+    else
+    {
+        SD_Read( 0, address, buffer, length, 0, 0 ) ;
+    }
+
+    for ( i = 0 ; i < length ; i++, pWords += SD_BLOCK_SIZE / 4 )
+    {
+        if ( (pWords[0] != address + i) || ((ref[address + i] != SIM_TRIMMED) && (pWords[1] != ref[address + i])) )
+        {
+            if ( errors++ < 10 )
+            {
+                fprintf( stderr, "sdsim: block %u reads version %u instead of %u\n", address + i, pWords[1], ref[address + i] ) ;
+            }
+        }
+    }
+}
+
+/* The last range written, likely still in a window, and a random cluster */
+static void check_reads( uint32_t base, uint32_t clusters )
+{
+    sim_read( lastAddress, lastLength ) ;
+    sim_read( base + (rand() % clusters) * SIM_CLUSTER_BLOCKS, SIM_CLUSTER_BLOCKS ) ;
+}
+
+static void check_card( void )
+{
+    uint32_t block ;
+
+    for ( block = 0 ; block < SIM_BLOCKS ; block++ )
+    {
+        if ( (ref[block] != SIM_TRIMMED) && (card.version[block] != ref[block]) )
+        {
+            if ( errors++ < 10 )
+            {
+                fprintf( stderr, "sdsim: block %u holds version %u instead of %u\n", block, card.version[block], ref[block] ) ;
+            }
+        }
+    }
+}
+
+/* FatFs f_sync: FAT sector of the last cluster, FSINFO, directory entry */
+static void file_sync( uint32_t cluster )
+{
+    sim_write( SIM_FAT_BASE + cluster / 128, 1 ) ;
+    sim_write( SIM_FSINFO_BLOCK, 1 ) ;
+    sim_write( SIM_DIR_BLOCK, 1 ) ;
+    sim_sync() ;
+}
+
+static void fat_seq( uint32_t writes )
+{
+    uint32_t clusters = (SIM_BLOCKS - SIM_DATA_BASE) / SIM_CLUSTER_BLOCKS ;
+    uint32_t cluster = 0 ;
+    uint32_t n ;
+
+    for ( n = 0 ; n < writes ; n++ )
+    {
+        if ( cluster == clusters )
+        {
+            sim_trim( SIM_DATA_BASE, SIM_BLOCKS - SIM_DATA_BASE ) ;
+            cluster = 0 ;
+        }
+        sim_write( SIM_DATA_BASE + cluster * SIM_CLUSTER_BLOCKS, SIM_CLUSTER_BLOCKS ) ;
+        cluster++ ;
+        if ( (n % 128) == 127 )
+        {
+            file_sync( cluster ) ;
+        }
+        if ( (n % 1000) == 999 )
+        {
+            check_reads( SIM_DATA_BASE, cluster ) ;
+        }
+    }
+    file_sync( cluster ) ;
+}
+
+static void fat_2files( uint32_t writes )
+{
+    uint32_t clusters = (SIM_BLOCKS - SIM_DATA_BASE) / SIM_CLUSTER_BLOCKS / 2 ;
+    uint32_t base[2] = { SIM_DATA_BASE, SIM_DATA_BASE + clusters * SIM_CLUSTER_BLOCKS } ;
+    uint32_t cluster[2] = { 0, 0 } ;
+    uint32_t n, f ;
+
+    for ( n = 0 ; n < writes ; n++ )
+    {
+        f = n & 1 ;
+        if ( cluster[f] == clusters )
+        {
+            sim_trim( base[f], clusters * SIM_CLUSTER_BLOCKS ) ;
+            cluster[f] = 0 ;
+        }
+        sim_write( base[f] + cluster[f] * SIM_CLUSTER_BLOCKS, SIM_CLUSTER_BLOCKS ) ;
+        cluster[f]++ ;
+        if ( (n % 32) == 31 )
+        {
+            sim_write( SIM_DIR_BLOCK, 1 ) ;
+            sim_sync() ;
+        }
+        if ( ((n % 1000) == 999) && cluster[f] )
+        {
+            check_reads( base[f], cluster[f] ) ;
+        }
+    }
+    sim_write( SIM_DIR_BLOCK, 1 ) ;
+    sim_sync() ;
+}
+
+static void fat_rand( uint32_t writes )
+{
+    uint32_t clusters = SIM_RAND_FILE_BLOCKS / SIM_CLUSTER_BLOCKS ;
+    uint32_t n ;
+
+    for ( n = 0 ; n < writes ; n++ )
+    {
+        if ( (n % 64) == 32 )
+        {
+            /* Covers whole windows, some of them holding 4KB writes */
+            sim_write( SIM_DATA_BASE + (rand() % (clusters - SIM_MAX_BLOCKS / SIM_CLUSTER_BLOCKS)) * SIM_CLUSTER_BLOCKS, SIM_MAX_BLOCKS ) ;
+        }
+        else
+        {
+            sim_write( SIM_DATA_BASE + (rand() % clusters) * SIM_CLUSTER_BLOCKS, SIM_CLUSTER_BLOCKS ) ;
+        }
+        if ( (n % 64) == 63 )
+        {
+            sim_write( SIM_DIR_BLOCK, 1 ) ;
+            sim_sync() ;
+        }
+        if ( (n % 1000) == 999 )
+        {
+            check_reads( SIM_DATA_BASE, clusters ) ;
+        }
+    }
+    sim_write( SIM_DIR_BLOCK, 1 ) ;
+    sim_sync() ;
+}
+
+static void run( const char* name, void (*workload)( uint32_t ), uint32_t writes, uint32_t au_blocks, int withMedia )
+{
+    uint64_t bytes ;
+    uint32_t block ;
+
+    reset_card( au_blocks ) ;
+    for ( block = 0 ; block < SIM_BLOCKS ; block++ )
+    {
+        ref[block] = 0 ;
+    }
+    stamp = 0 ;
+    srand( 1 ) ;
+    useMedia = withMedia ;
+    if ( useMedia && !MEDSdcard_Initialize( &media, 0 ) )
+    {
+        violation( "MEDSdcard_Initialize() failed", 0 ) ;
+        return ;
+    }
+
+    workload( writes ) ;
+    stop() ;
+    check_card() ;
+
+    /* Payload of the workload: one stamp per block written */
+    bytes = (uint64_t)stamp * SD_BLOCK_SIZE ;
+    printf( "sdsim: %-10s %-7s %7u cmds %6u pre-erase %7u programs %6u merges %7u copies %8.1f s %6.2f MB/s\n",
+            name, withMedia ? "windows" : "direct", card.commands, card.pre_erases, card.programs, card.merges,
+            card.copies, card.us * 1e-6, bytes / card.us ) ;
+}
+
+int main( int argc, char** argv )
+{
+    static const struct
+    {
+        const char* name ;
+        void (*workload)( uint32_t ) ;
+    } workloads[] =
+    {
+        { "fat-seq", fat_seq },
+        { "fat-2files", fat_2files },
+        { "fat-rand", fat_rand },
+    } ;
+    uint32_t writes = 200000 ;
+    uint32_t au_blocks = 1024 ;
+    void* pMemory ;
+    uint32_t i ;
+
+    /* getopt() is not at hand: unistd.h conflicts with syscalls.h of board.h */
+    for ( i = 1 ; i < (uint32_t)argc ; i += 2 )
+    {
+        if ( (i + 1 < (uint32_t)argc) && (strcmp( argv[i], "-n" ) == 0) )
+        {
+            writes = strtoul( argv[i + 1], NULL, 0 ) ;
+        }
+        else if ( (i + 1 < (uint32_t)argc) && (strcmp( argv[i], "-a" ) == 0) )
+        {
+            au_blocks = strtoul( argv[i + 1], NULL, 0 ) * 2 ;
+        }
+        else
+        {
+            fprintf( stderr, "usage: sdsim [-n writes] [-a au_kb]\n" ) ;
+            return 1 ;
+        }
+    }
+    if ( (au_blocks < SIM_PAGE_BLOCKS) || (au_blocks & (au_blocks - 1)) || (au_blocks > SIM_BLOCKS / 16) )
+    {
+        fprintf( stderr, "sdsim: the AU must be a power of 2 from 16KB to 4MB\n" ) ;
+        return 1 ;
+    }
+
+    /* Window buffers of MEDSdcard, at their place in the SDRAM map */
+    pMemory = mmap( (void*)BOARD_SDRAM_WCACHE_ADDR, BOARD_SDRAM_WCACHE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 ) ;
+    if ( pMemory != (void*)BOARD_SDRAM_WCACHE_ADDR )
+    {
+        perror( "sdsim: mmap" ) ;
+        return 1 ;
+    }
+
+    for ( i = 0 ; i < sizeof( workloads ) / sizeof( workloads[0] ) ; i++ )
+    {
+        run( workloads[i].name, workloads[i].workload, writes, au_blocks, 0 ) ;
+        run( workloads[i].name, workloads[i].workload, writes, au_blocks, 1 ) ;
+    }
+
+    printf( "sdsim: %u errors, %u violations\n", errors, violations ) ;
+
+    return (errors || violations) ? 1 : 0 ;
+}
@@ -0,0 +1,466 @@
+/**
+ * \file
+ *
+ * Host test bench of the AT26 serial flash driver (see at26.h and at26d.h).
+ *
+ * Build with "make sflashsim", then:
+ *
+ *   sflashsim [-s size] [-o offset] [-w]
+ *       Detect a simulated AT26DF081A, unprotect it, erase the blocks
+ *       covering <size> bytes (512 KB by default) at <offset> (0x1234 by
+ *       default), program a pattern there, read it back with a single fast
+ *       read and compare, then read a few unaligned slices.
+ *
+ *   -w asserts the write protect pin: the unprotect must fail and the
+ *   erase must be refused without touching the array.
+ *
+ * The SPI command driver is replaced by a model of the device behind the
+ * SPID_xxx functions: each command is checked against the datasheet
+ * (direction of the data phase, write enable latch, busy device, fast read
+ * dummy byte, page wrap) and any violation fails the run. The number of
+ * bytes clocked on the bus gives the efficiency of the reads.
+ */
+
+#include "at26d.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Simulated device */
+#define SIM_JEDEC_ID            0x0001451F
+#define SIM_SIZE                (1024 * 1024)
+#define SIM_PAGE_SIZE           256
+
+/* Status reads answered busy after a program or an erase */
+#define SIM_PROGRAM_BUSY        3
+#define SIM_ERASE_BUSY          20
+
+/* Chip select of the serial flash */
+#define SIM_CS                  1
+
+typedef struct
+{
+    uint8_t array[SIM_SIZE] ;
+    uint8_t status ;
+    uint32_t busy ;
+    int wp ;
+
+    /* Statistics */
+    uint32_t commands ;
+    uint32_t bus_bytes ;
+    uint32_t data_bytes ;
+    uint32_t violations ;
+} Sim ;
+
+static Sim sim ;
+
+static void violation( const char* text, uint8_t cmd )
+{
+    fprintf( stderr, "sflashsim: command %02X: %s\n", cmd, text ) ;
+    sim.violations++ ;
+}
+
+static uint32_t get_address( const SpidCmd* command )
+{
+    return ((uint32_t)command->pCmd[1] << 16) | ((uint32_t)command->pCmd[2] << 8) | command->pCmd[3] ;
+}
+
+static int is_protected( void )
+{
+    return (sim.status & AT26_STATUS_SWP) != AT26_STATUS_SWP_PROTNONE ;
+}
+
+/* Checks the common requirements of a program or erase command */
+static int start_write( const SpidCmd* command, uint8_t cmd )
+{
+    if ( (sim.status & AT26_STATUS_WEL) == 0 )
+    {
+        violation( "write enable latch not set", cmd ) ;
+        return 0 ;
+    }
+    sim.status &= ~AT26_STATUS_WEL ;
+    if ( is_protected() )
+    {
+        /* The device ignores the command, as the driver should have known */
+        violation( "array protected", cmd ) ;
+        return 0 ;
+    }
+
+    return 1 ;
+}
+
+static void erase( uint32_t address, uint32_t size )
+{
+    address &= ~(size - 1) ;
+    memset( &sim.array[address % SIM_SIZE], 0xFF, size ) ;
+    sim.busy = SIM_ERASE_BUSY ;
+}
+
+static void execute( SpidCmd* command )
+{
+    uint8_t cmd = command->pCmd[0] ;
+    uint32_t address = 0 ;
+    uint32_t i ;
+
+    if ( command->cmdSize >= 4 )
+    {
+        address = get_address( command ) % SIM_SIZE ;
+    }
+    if ( sim.busy && (cmd != AT26_READ_STATUS) )
+    {
+        violation( "device busy", cmd ) ;
+        return ;
+    }
+
+    switch ( cmd )
+    {
+        case AT26_READ_JEDEC_ID :
+            for ( i = 0 ; i < command->dataSize ; i++ )
+            {
+                command->pData[i] = (i < 3) ? (uint8_t)(SIM_JEDEC_ID >> (8 * i)) : 0 ;
+            }
+            break ;
+
+        case AT26_READ_STATUS :
+            for ( i = 0 ; i < command->dataSize ; i++ )
+            {
+                command->pData[i] = sim.status | (sim.busy ? AT26_STATUS_RDYBSY_BUSY : 0) ;
+                if ( sim.busy )
+                {
+                    sim.busy-- ;
+                }
+            }
+            break ;
+
+        case AT26_WRITE_ENABLE :
+            sim.status |= AT26_STATUS_WEL ;
+            break ;
+
+        case AT26_WRITE_DISABLE :
+            sim.status &= ~AT26_STATUS_WEL ;
+            break ;
+
+        case AT26_WRITE_STATUS :
+            if ( (sim.status & AT26_STATUS_WEL) == 0 )
+            {
+                violation( "write enable latch not set", cmd ) ;
+                break ;
+            }
+            sim.status &= ~AT26_STATUS_WEL ;
+            if ( command->dataSize == 0 )
+            {
+                break ;
+            }
+            if ( (sim.status & AT26_STATUS_SPRL) && sim.wp )
+            {
+                break ;
+            }
+            if ( sim.status & AT26_STATUS_SPRL )
+            {
+                /* A locked register only accepts the SPRL bit */
+                sim.status &= ~AT26_STATUS_SPRL ;
+                sim.status |= command->pData[0] & AT26_STATUS_SPRL ;
+                break ;
+            }
+            sim.status &= ~(AT26_STATUS_SWP | AT26_STATUS_SPRL) ;
+            sim.status |= command->pData[0] & (AT26_STATUS_SWP | AT26_STATUS_SPRL) ;
+            break ;
+
+        case AT26_READ_ARRAY :
+            if ( command->cmdSize != 5 )
+            {
+                violation( "fast read without its dummy byte", cmd ) ;
+                break ;
+            }
+            /* no break */
+        case AT26_READ_ARRAY_LF :
+            for ( i = 0 ; i < command->dataSize ; i++ )
+            {
+                command->pData[i] = sim.array[(address + i) % SIM_SIZE] ;
+            }
+            sim.data_bytes += command->dataSize ;
+            break ;
+
+        case AT26_BYTE_PAGE_PROGRAM :
+            if ( !start_write( command, cmd ) )
+            {
+                break ;
+            }
+            if ( (address % SIM_PAGE_SIZE) + command->dataSize > SIM_PAGE_SIZE )
+            {
+                violation( "page program wraps around the page", cmd ) ;
+            }
+            for ( i = 0 ; i < command->dataSize ; i++ )
+            {
+                /* Programming only clears bits */
+                sim.array[(address & ~(SIM_PAGE_SIZE - 1)) + ((address + i) % SIM_PAGE_SIZE)] &= command->pData[i] ;
+            }
+            sim.busy = SIM_PROGRAM_BUSY ;
+            break ;
+
+        case AT26_BLOCK_ERASE_4K :
+            if ( start_write( command, cmd ) )
+            {
+                erase( address, 4 * 1024 ) ;
+            }
+            break ;
+
+        case AT26_BLOCK_ERASE_32K :
+            if ( start_write( command, cmd ) )
+            {
+                erase( address, 32 * 1024 ) ;
+            }
+            break ;
+
+        case AT26_BLOCK_ERASE_64K :
+            if ( start_write( command, cmd ) )
+            {
+                erase( address, 64 * 1024 ) ;
+            }
+            break ;
+
+        case AT26_CHIP_ERASE_1 :
+        case AT26_CHIP_ERASE_2 :
+            if ( start_write( command, cmd ) )
+            {
+                erase( 0, SIM_SIZE ) ;
+            }
+            break ;
+
+        default :
+            violation( "not supported", cmd ) ;
+    }
+}
+
+/*
+ * SPI command driver model
+ */
+
+void SPID_Configure( Spid* pSpid, void* pSpiHw, uint8_t bSpiId )
+{
+    memset( pSpid, 0, sizeof( *pSpid ) ) ;
+    pSpid->pSpiHw = pSpiHw ;
+    pSpid->spiId = bSpiId ;
+}
+
+void SPID_ConfigureCS( Spid* pSpid, uint32_t dwCs, uint32_t dwCsr )
+{
+}
+
+uint32_t SPID_SendCommand( Spid* pSpid, SpidCmd* pCommand )
+{
+    uint8_t cmd = pCommand->pCmd[0] ;
+    int in ;
+
+    if ( pSpid->semaphore )
+    {
+        return SPID_ERROR_LOCK ;
+    }
+    pSpid->semaphore = 1 ;
+    pSpid->pCurrentCommand = pCommand ;
+
+    if ( pCommand->spiCs != SIM_CS )
+    {
+        violation( "wrong chip select", cmd ) ;
+    }
+    in = (cmd == AT26_READ_ARRAY) || (cmd == AT26_READ_ARRAY_LF) || (cmd == AT26_READ_STATUS)
+         || (cmd == AT26_READ_JEDEC_ID) ;
+    if ( pCommand->dataSize && (pCommand->dataIn != in) )
+    {
+        violation( "data phase in the wrong direction", cmd ) ;
+    }
+
+    sim.commands++ ;
+    sim.bus_bytes += pCommand->cmdSize + pCommand->dataSize ;
+    execute( pCommand ) ;
+
+    pSpid->semaphore = 0 ;
+    if ( pCommand->callback )
+    {
+        pCommand->callback( 0, pCommand->pArgument ) ;
+    }
+
+    return 0 ;
+}
+
+uint32_t SPID_IsBusy( const Spid* pSpid )
+{
+    return pSpid->semaphore ;
+}
+
+void SPID_DmaHandler( uint32_t dwStatus )
+{
+}
+
+/*
+ * Test
+ */
+
+static uint8_t pattern( uint32_t i )
+{
+    return (uint8_t)((i * 7) ^ (i >> 9)) ;
+}
+
+static int check( const uint8_t* data, uint32_t offset, uint32_t size )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < size ; i++ )
+    {
+        if ( data[i] != pattern( offset + i ) )
+        {
+            fprintf( stderr, "sflashsim: byte %u of the image is %02X instead of %02X\n",
+                     offset + i, data[i], pattern( offset + i ) ) ;
+            return 1 ;
+        }
+    }
+
+    return 0 ;
+}
+
+static void usage( void )
+{
+    fprintf( stderr, "usage: sflashsim [-s size] [-o offset] [-w]\n" ) ;
+    exit( 2 ) ;
+}
+
+int main( int argc, char** argv )
+{
+    static const uint32_t slices[][2] = { { 0, 1 }, { 3, 31 }, { 255, 2 }, { 1000, 33 }, { 4093, 4099 } } ;
+    Spid spid ;
+    At26 at26 ;
+    uint8_t* image ;
+    uint8_t* data ;
+    uint32_t size = 512 * 1024 ;
+    uint32_t offset = 0x1234 ;
+    uint32_t address ;
+    uint32_t bus_bytes ;
+    uint32_t commands ;
+    uint32_t i ;
+    int errors = 0 ;
+    int opt ;
+
+    while ( (opt = getopt( argc, argv, "s:o:w" )) != -1 )
+    {
+        switch ( opt )
+        {
+            case 's' : size = strtoul( optarg, NULL, 0 ) ; break ;
+            case 'o' : offset = strtoul( optarg, NULL, 0 ) ; break ;
+            case 'w' : sim.wp = 1 ; break ;
+            default : usage() ;
+        }
+    }
+    if ( (size == 0) || (offset >= SIM_SIZE) || (size > SIM_SIZE - offset) )
+    {
+        usage() ;
+    }
+
+    /* Power-up state: all sectors protected, registers locked by WP */
+    memset( sim.array, 0x5A, sizeof( sim.array ) ) ;
+    sim.status = AT26_STATUS_SWP_PROTALL | (sim.wp ? (AT26_STATUS_SPRL_LOCKED | AT26_STATUS_WPP_ASSERTED) : 0) ;
+
+    image = malloc( size ) ;
+    data = malloc( size ) ;
+    if ( !image || !data )
+    {
+        fprintf( stderr, "sflashsim: out of memory\n" ) ;
+        return 1 ;
+    }
+    for ( i = 0 ; i < size ; i++ )
+    {
+        image[i] = pattern( i ) ;
+    }
+
+    SPID_Configure( &spid, NULL, 0 ) ;
+    AT26_Configure( &at26, &spid, SIM_CS ) ;
+    if ( AT26_FindDevice( &at26, AT26D_ReadJedecId( &at26 ) ) == 0 )
+    {
+        fprintf( stderr, "sflashsim: device not detected\n" ) ;
+        return 1 ;
+    }
+    printf( "sflashsim: %s, %u bytes, %u-byte pages, %u-byte erase blocks\n",
+            AT26_Name( &at26 ), AT26_Size( &at26 ), AT26_PageSize( &at26 ), AT26_BlockSize( &at26 ) ) ;
+
+    if ( sim.wp )
+    {
+        if ( AT26D_Unprotect( &at26 ) != AT26_ERROR_PROTECTED )
+        {
+            fprintf( stderr, "sflashsim: unprotected with the write protect pin asserted\n" ) ;
+            errors++ ;
+        }
+        if ( AT26D_EraseBlock( &at26, offset ) != AT26_ERROR_PROTECTED || sim.array[offset] != 0x5A )
+        {
+            fprintf( stderr, "sflashsim: erase not refused on a protected device\n" ) ;
+            errors++ ;
+        }
+        printf( "sflashsim: protected device refused, %u violations\n", sim.violations ) ;
+        return (errors || sim.violations) ? 1 : 0 ;
+    }
+
+    if ( AT26D_Unprotect( &at26 ) )
+    {
+        fprintf( stderr, "sflashsim: unprotect failed\n" ) ;
+        return 1 ;
+    }
+
+    /* Erase and program */
+    for ( address = offset & ~(AT26_BlockSize( &at26 ) - 1) ; address < offset + size ; address += AT26_BlockSize( &at26 ) )
+    {
+        if ( AT26D_EraseBlock( &at26, address ) )
+        {
+            fprintf( stderr, "sflashsim: erase at 0x%X failed\n", address ) ;
+            return 1 ;
+        }
+    }
+    if ( AT26D_Write( &at26, image, size, offset ) )
+    {
+        fprintf( stderr, "sflashsim: write failed\n" ) ;
+        return 1 ;
+    }
+    if ( (offset > 0) && (sim.array[offset - 1] != 0xFF) )
+    {
+        fprintf( stderr, "sflashsim: byte before the image programmed\n" ) ;
+        errors++ ;
+    }
+
+    /* Whole image in one read */
+    memset( data, 0, size ) ;
+    commands = sim.commands ;
+    bus_bytes = sim.bus_bytes ;
+    if ( AT26D_Read( &at26, data, size, offset ) )
+    {
+        fprintf( stderr, "sflashsim: read failed\n" ) ;
+        return 1 ;
+    }
+    errors += check( data, 0, size ) ;
+    commands = sim.commands - commands ;
+    bus_bytes = sim.bus_bytes - bus_bytes ;
+    printf( "sflashsim: read %u bytes in %u command(s), %u bytes on the bus (%u.%02u%% data)\n",
+            size, commands, bus_bytes,
+            (unsigned int)(((uint64_t)size * 100) / bus_bytes),
+            (unsigned int)(((uint64_t)size * 10000) / bus_bytes % 100) ) ;
+
+    /* Unaligned slices */
+    for ( i = 0 ; i < sizeof( slices ) / sizeof( slices[0] ) ; i++ )
+    {
+        if ( slices[i][0] + slices[i][1] > size )
+        {
+            continue ;
+        }
+        memset( data, 0, slices[i][1] ) ;
+        if ( AT26D_Read( &at26, data, slices[i][1], offset + slices[i][0] ) )
+        {
+            fprintf( stderr, "sflashsim: read of %u bytes at +%u failed\n", slices[i][1], slices[i][0] ) ;
+            return 1 ;
+        }
+        errors += check( data, slices[i][0], slices[i][1] ) ;
+    }
+
+    printf( "sflashsim: %u commands, %u errors, %u violations\n", sim.commands, errors, sim.violations ) ;
+    free( image ) ;
+    free( data ) ;
+
+    return (errors || sim.violations) ? 1 : 0 ;
+}
@@ -0,0 +1,267 @@
+/**
+ * \file
+ *
+ * Implementation of the storage benchmark.
+ *
+ * Each transfer of a workload is timed with the cycle counter given to
+ * Bench_Initialize(); the samples are sorted at the end of the workload to
+ * extract the latency percentiles. Random offsets are aligned on the transfer
+ * size and drawn from a linear congruential generator reseeded for every
+ * workload, so every run (and the host build) issues the same sequence.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "bench.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Seed of the random offsets */
+#define BENCH_SEED              0x2545F491
+
+/*----------------------------------------------------------------------------
+ *        Exported variables
+ *----------------------------------------------------------------------------*/
+
+/** Workloads; the writes come first so that the reads find written data */
+const BenchWorkload gBenchWorkloads[] =
+{
+    { "seq-wr", BENCH_WRITE, BENCH_SEQUENTIAL, 0,         512, 1024 },
+    { "seq-wr", BENCH_WRITE, BENCH_SEQUENTIAL, 0,        4096, 1024 },
+    { "seq-wr", BENCH_WRITE, BENCH_SEQUENTIAL, 0,   64 * 1024,   64 },
+    { "seq-wr", BENCH_WRITE, BENCH_SEQUENTIAL, 0, 1024 * 1024,    4 },
+    { "seq-rd", BENCH_READ,  BENCH_SEQUENTIAL, 0,         512, 1024 },
+    { "seq-rd", BENCH_READ,  BENCH_SEQUENTIAL, 0,        4096, 1024 },
+    { "seq-rd", BENCH_READ,  BENCH_SEQUENTIAL, 0,   64 * 1024,   64 },
+    { "seq-rd", BENCH_READ,  BENCH_SEQUENTIAL, 0, 1024 * 1024,    4 },
+    { "rnd-wr", BENCH_WRITE, BENCH_RANDOM,     0,         512, 1024 },
+    { "rnd-wr", BENCH_WRITE, BENCH_RANDOM,     0,        4096,  512 },
+    { "rnd-wr", BENCH_WRITE, BENCH_RANDOM,     0,   64 * 1024,   64 },
+    { "rnd-rd", BENCH_READ,  BENCH_RANDOM,     0,         512, 1024 },
+    { "rnd-rd", BENCH_READ,  BENCH_RANDOM,     0,        4096,  512 },
+    { "rnd-rd", BENCH_READ,  BENCH_RANDOM,     0,   64 * 1024,   64 },
+} ;
+
+/** Number of workloads */
+const uint32_t gdwBenchNumWorkloads = sizeof( gBenchWorkloads ) / sizeof( gBenchWorkloads[0] ) ;
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Cycle counter */
+static BenchClockFunc gfBenchClock ;
+
+/** Cycle counter frequency in MHz */
+static uint32_t gdwBenchCyclesPerUs ;
+
+/** Transfer buffer */
+static uint8_t* gpBenchBuffer ;
+static uint32_t gdwBenchBufferSize ;
+
+/** Random generator state */
+static uint32_t gdwBenchSeed ;
+
+/** Latency of each transfer, in cycles */
+static uint32_t gdwBenchSamples[BENCH_MAXOPS] ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Next pseudo-random number.
+ */
+static uint32_t _Random( void )
+{
+    gdwBenchSeed = gdwBenchSeed * 1664525 + 1013904223 ;
+
+    return gdwBenchSeed >> 8 ;
+}
+
+/**
+ * \brief Sort the latency samples (shell sort).
+ *
+ * \param dwCount  Number of samples.
+ */
+static void _SortSamples( uint32_t dwCount )
+{
+    uint32_t dwGap ;
+    uint32_t i, j ;
+    uint32_t dwValue ;
+
+    for ( dwGap = dwCount / 2 ; dwGap > 0 ; dwGap /= 2 )
+    {
+        for ( i = dwGap ; i < dwCount ; i++ )
+        {
+            dwValue = gdwBenchSamples[i] ;
+            for ( j = i ; (j >= dwGap) && (gdwBenchSamples[j - dwGap] > dwValue) ; j -= dwGap )
+            {
+                gdwBenchSamples[j] = gdwBenchSamples[j - dwGap] ;
+            }
+            gdwBenchSamples[j] = dwValue ;
+        }
+    }
+}
+
+/**
+ * \brief Return a percentile of the sorted samples in microseconds.
+ *
+ * \param dwCount    Number of samples.
+ * \param dwPercent  Percentile (0 to 100).
+ */
+static uint32_t _Percentile( uint32_t dwCount, uint32_t dwPercent )
+{
+    uint32_t dwIndex = (dwCount * dwPercent + 99) / 100 ;
+
+    if ( dwIndex > 0 )
+    {
+        dwIndex-- ;
+    }
+
+    return gdwBenchSamples[dwIndex] / gdwBenchCyclesPerUs ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the benchmark.
+ *
+ * \param fClock         Free running cycle counter.
+ * \param dwCyclesPerUs  Cycle counter frequency in MHz.
+ * \param pBuffer        Transfer buffer, at least as large as the largest
+ *                       transfer to run.
+ * \param dwBufferSize   Size of the transfer buffer in bytes.
+ */
+extern void Bench_Initialize( BenchClockFunc fClock, uint32_t dwCyclesPerUs, uint8_t* pBuffer, uint32_t dwBufferSize )
+{
+    uint32_t i ;
+
+    gfBenchClock = fClock ;
+    gdwBenchCyclesPerUs = dwCyclesPerUs ? dwCyclesPerUs : 1 ;
+    gpBenchBuffer = pBuffer ;
+    gdwBenchBufferSize = dwBufferSize ;
+
+    /* Recognizable pattern for the writes */
+    for ( i = 0 ; i < dwBufferSize ; i++ )
+    {
+        pBuffer[i] = (uint8_t)(i ^ (i >> 8)) ;
+    }
+}
+
+/**
+ * \brief Run a workload on a target.
+ *
+ * \param pTarget    Target to test.
+ * \param pWorkload  Workload to run.
+ * \param pResult    Filled with the result.
+ * \return 0 if successful, 1 if the workload does not fit the buffer or the
+ * test area, 2 if a transfer failed.
+ */
+extern uint32_t Bench_Run( const BenchTarget* pTarget, const BenchWorkload* pWorkload, BenchResult* pResult )
+{
+    uint32_t dwSlots ;
+    uint32_t dwCount ;
+    uint32_t dwOffset ;
+    uint32_t dwStart ;
+    uint32_t i ;
+    uint64_t qwTotal = 0 ;
+
+    pResult->dwBytes = 0 ;
+    pResult->dwOps = 0 ;
+
+    dwSlots = pTarget->dwCapacity / pWorkload->dwSize ;
+    dwCount = (pWorkload->dwCount > BENCH_MAXOPS) ? BENCH_MAXOPS : pWorkload->dwCount ;
+    if ( (pWorkload->dwSize > gdwBenchBufferSize) || (dwSlots == 0) || (dwCount == 0) )
+    {
+        return 1 ;
+    }
+
+    gdwBenchSeed = BENCH_SEED ;
+    for ( i = 0 ; i < dwCount ; i++ )
+    {
+        if ( pWorkload->bRandom == BENCH_RANDOM )
+        {
+            dwOffset = (_Random() % dwSlots) * pWorkload->dwSize ;
+        }
+        else
+        {
+            dwOffset = (i % dwSlots) * pWorkload->dwSize ;
+        }
+
+        dwStart = gfBenchClock() ;
+        if ( pTarget->fIo( pTarget->pArg, dwOffset, gpBenchBuffer, pWorkload->dwSize, pWorkload->bWrite ) )
+        {
+            printf( "-E- %s %s: transfer #%u failed\n\r", pTarget->pName, pWorkload->pName, (unsigned int)i ) ;
+            return 2 ;
+        }
+        gdwBenchSamples[i] = gfBenchClock() - dwStart ;
+        qwTotal += gdwBenchSamples[i] ;
+    }
+
+    /* The data written must have reached the media */
+    if ( (pWorkload->bWrite == BENCH_WRITE) && pTarget->fSync )
+    {
+        dwStart = gfBenchClock() ;
+        if ( pTarget->fSync( pTarget->pArg ) )
+        {
+            printf( "-E- %s %s: sync failed\n\r", pTarget->pName, pWorkload->pName ) ;
+            return 2 ;
+        }
+        qwTotal += gfBenchClock() - dwStart ;
+    }
+
+    _SortSamples( dwCount ) ;
+
+    pResult->dwBytes = dwCount * pWorkload->dwSize ;
+    pResult->dwOps = dwCount ;
+    pResult->dwTotalUs = (uint32_t)(qwTotal / gdwBenchCyclesPerUs) ;
+    pResult->dwP50Us = _Percentile( dwCount, 50 ) ;
+    pResult->dwP90Us = _Percentile( dwCount, 90 ) ;
+    pResult->dwP99Us = _Percentile( dwCount, 99 ) ;
+    pResult->dwMaxUs = gdwBenchSamples[dwCount - 1] / gdwBenchCyclesPerUs ;
+
+    return 0 ;
+}
+
+/**
+ * \brief Print the header of the result table.
+ */
+extern void Bench_PrintHeader( void )
+{
+    printf( "-I- Target     Workload    Size     MB/s    IOPS   p50(us)  p90(us)  p99(us)  max(us)\n\r" ) ;
+}
+
+/**
+ * \brief Print the result of a workload (1 MB = 1000000 bytes).
+ *
+ * \param pTarget    Target tested.
+ * \param pWorkload  Workload run.
+ * \param pResult    Result of Bench_Run().
+ */
+extern void Bench_PrintResult( const BenchTarget* pTarget, const BenchWorkload* pWorkload, const BenchResult* pResult )
+{
+    uint32_t dwUs = pResult->dwTotalUs ? pResult->dwTotalUs : 1 ;
+    uint32_t dwRate = (uint32_t)(((uint64_t)pResult->dwBytes * 100) / dwUs) ;
+    uint32_t dwIops = (uint32_t)(((uint64_t)pResult->dwOps * 1000000) / dwUs) ;
+
+    printf( "-I- %-10s %-8s %7u %5u.%02u %7u %9u %8u %8u %8u\n\r",
+            pTarget->pName,
+            pWorkload->pName,
+            (unsigned int)pWorkload->dwSize,
+            (unsigned int)(dwRate / 100), (unsigned int)(dwRate % 100),
+            (unsigned int)dwIops,
+            (unsigned int)pResult->dwP50Us,
+            (unsigned int)pResult->dwP90Us,
+            (unsigned int)pResult->dwP99Us,
+            (unsigned int)pResult->dwMaxUs ) ;
+}
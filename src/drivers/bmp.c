@@ -40,6 +40,14 @@
 //-----------------------------------------------------------------------------
 /// BMP offset for header
 #define  IMAGE_OFFSET       0x100
+/// Size of the chunks read by BMP_DrawStream()
+#define  BMP_CHUNK_SIZE     512
+/// RLE8 escape codes (second byte of a zero count pair)
+#define  BMP_RLE_EOL        0
+#define  BMP_RLE_EOB        1
+#define  BMP_RLE_DELTA      2
+/// Convert 8-bit components to a RGB565 LCD pixel
+#define  BMP_RGB565(r, g, b) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3))
 //#define BOARD_LCD_RGB565
 
 //------------------------------------------------------------------------------
@@ -66,6 +74,251 @@ typedef struct _BMPPaletteEntry
     uint8_t filler;
 } BMPPaletteEntry ;
 
+//------------------------------------------------------------------------------
+//         Internal variables
+//------------------------------------------------------------------------------
+
+/// Read function of the image being drawn and its argument
+static BmpReadFunc bmpRead;
+static void* bmpReadArg;
+
+/// Chunk of the file being decoded
+static uint8_t bmpChunk[BMP_CHUNK_SIZE] __attribute__ ((aligned (4)));
+static uint32_t bmpChunkPos;
+static uint32_t bmpChunkLen;
+
+/// Palette converted to the LCD format
+static LcdColor_t bmpPalette[256];
+
+/// Raw row of an uncompressed image
+static uint8_t bmpLine[(BOARD_LCD_WIDTH * 3 + 3) & ~3] __attribute__ ((aligned (4)));
+
+/// Decoded rows: the DMAC streams one to the LCD while the next one is decoded
+static uint32_t bmpRows[2][(BOARD_LCD_WIDTH + 1) / 2];
+static uint32_t bmpRow;
+
+//------------------------------------------------------------------------------
+//         Internal functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Copy the next bytes of the file, reading a new chunk when needed.
+/// \param pDst  Destination buffer, 0 to skip the bytes.
+/// \param size  Number of bytes.
+/// \return the number of bytes copied, less than size at the end of the file.
+//------------------------------------------------------------------------------
+static uint32_t ReadStream( uint8_t *pDst, uint32_t size )
+{
+    uint32_t done = 0;
+    uint32_t n;
+
+    while ( done < size )
+    {
+        if ( bmpChunkPos == bmpChunkLen )
+        {
+            bmpChunkPos = 0;
+            bmpChunkLen = bmpRead( bmpReadArg, bmpChunk, BMP_CHUNK_SIZE );
+            if ( bmpChunkLen == 0 )
+            {
+                break;
+            }
+        }
+
+        n = bmpChunkLen - bmpChunkPos;
+        if ( n > size - done )
+        {
+            n = size - done;
+        }
+        if ( pDst )
+        {
+            memcpy( pDst + done, &bmpChunk[bmpChunkPos], n );
+        }
+        bmpChunkPos += n;
+        done += n;
+    }
+
+    return done;
+}
+
+//------------------------------------------------------------------------------
+/// Return the next byte of the file, or -1 at the end of the file.
+//------------------------------------------------------------------------------
+static int32_t GetStreamByte( void )
+{
+    if ( bmpChunkPos == bmpChunkLen )
+    {
+        bmpChunkPos = 0;
+        bmpChunkLen = bmpRead( bmpReadArg, bmpChunk, BMP_CHUNK_SIZE );
+        if ( bmpChunkLen == 0 )
+        {
+            return -1;
+        }
+    }
+
+    return bmpChunk[bmpChunkPos++];
+}
+
+//------------------------------------------------------------------------------
+/// Fill the current decoded row with the first palette color (pixels left
+/// undefined by a RLE8 image).
+/// \param width  Row width in pixels.
+//------------------------------------------------------------------------------
+static void ClearRow( uint32_t width )
+{
+    uint32_t *pOut = bmpRows[bmpRow];
+    uint32_t color = bmpPalette[0] | ((uint32_t) bmpPalette[0] << 16);
+    uint32_t i;
+
+    for ( i = 0 ; i < (width + 1) / 2 ; i++ )
+    {
+        *pOut++ = color;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Send the current decoded row to the LCD and switch to the other row
+/// buffer. Rows outside the panel are dropped.
+/// \param x  X-coordinate of the first pixel on LCD.
+/// \param y  Y-coordinate of the row on LCD.
+/// \param width  Row width in pixels.
+//------------------------------------------------------------------------------
+static void EmitRow( uint32_t x, uint32_t y, uint32_t width )
+{
+    if ( y < BOARD_LCD_HEIGHT )
+    {
+        // Starting the transfer waits for the previous row, so the other
+        // buffer is free on return
+        LCD_DrawPictureAsync( x, y, x + width - 1, y, (const LcdColor_t *) bmpRows[bmpRow], 0, 0 );
+        bmpRow ^= 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Decode a row of 24-bit BGR pixels, two pixels per word store.
+/// \param pIn  Raw row.
+/// \param width  Row width in pixels.
+//------------------------------------------------------------------------------
+static void DecodeRow24( const uint8_t *pIn, uint32_t width )
+{
+    uint32_t *pOut = bmpRows[bmpRow];
+    uint32_t i;
+
+    for ( i = 0 ; i + 1 < width ; i += 2, pIn += 6 )
+    {
+        *pOut++ = BMP_RGB565( pIn[2], pIn[1], pIn[0] )
+                | ((uint32_t) BMP_RGB565( pIn[5], pIn[4], pIn[3] ) << 16);
+    }
+    if ( i < width )
+    {
+        *(LcdColor_t *) pOut = BMP_RGB565( pIn[2], pIn[1], pIn[0] );
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Decode a row of 8-bit palette indexes, two pixels per word store.
+/// \param pIn  Raw row.
+/// \param width  Row width in pixels.
+//------------------------------------------------------------------------------
+static void DecodeRow8( const uint8_t *pIn, uint32_t width )
+{
+    uint32_t *pOut = bmpRows[bmpRow];
+    uint32_t i;
+
+    for ( i = 0 ; i + 1 < width ; i += 2, pIn += 2 )
+    {
+        *pOut++ = bmpPalette[pIn[0]] | ((uint32_t) bmpPalette[pIn[1]] << 16);
+    }
+    if ( i < width )
+    {
+        *(LcdColor_t *) pOut = bmpPalette[pIn[0]];
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Decode the RLE8 data of a bottom-up image and draw it.
+/// \param x  X-coordinate of the image on LCD.
+/// \param bottom  Y-coordinate of the last row of the image on LCD.
+/// \param width  Image width in pixels.
+/// \param height  Image height in pixels.
+/// \return 0 if the image has been drawn, 5 if the file is truncated.
+//------------------------------------------------------------------------------
+static uint8_t DecodeRle8( uint32_t x, uint32_t bottom, uint32_t width, uint32_t height )
+{
+    uint32_t row = 0;
+    uint32_t col = 0;
+    int32_t count, value, dx, dy;
+
+    ClearRow( width );
+    while ( row < height )
+    {
+        count = GetStreamByte();
+        value = GetStreamByte();
+        if ( value < 0 )
+        {
+            return 5;
+        }
+
+        if ( count > 0 )
+        {
+            // Encoded run, pixels past the end of the row are dropped
+            for ( ; (count > 0) && (col < width) ; count--, col++ )
+            {
+                ((LcdColor_t *) bmpRows[bmpRow])[col] = bmpPalette[value];
+            }
+        }
+        else if ( value == BMP_RLE_EOL )
+        {
+            EmitRow( x, bottom - row, width );
+            ClearRow( width );
+            row++;
+            col = 0;
+        }
+        else if ( value == BMP_RLE_EOB )
+        {
+            EmitRow( x, bottom - row, width );
+            break;
+        }
+        else if ( value == BMP_RLE_DELTA )
+        {
+            dx = GetStreamByte();
+            dy = GetStreamByte();
+            if ( dy < 0 )
+            {
+                return 5;
+            }
+            for ( ; (dy > 0) && (row < height) ; dy-- )
+            {
+                EmitRow( x, bottom - row, width );
+                ClearRow( width );
+                row++;
+            }
+            col += dx;
+        }
+        else
+        {
+            // Absolute run, padded to a 16-bit boundary
+            for ( count = 0 ; count < value ; count++, col++ )
+            {
+                dx = GetStreamByte();
+                if ( dx < 0 )
+                {
+                    return 5;
+                }
+                if ( col < width )
+                {
+                    ((LcdColor_t *) bmpRows[bmpRow])[col] = bmpPalette[dx];
+                }
+            }
+            if ( (value & 1) && (GetStreamByte() < 0) )
+            {
+                return 5;
+            }
+        }
+    }
+
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 //         Exported functions
 //------------------------------------------------------------------------------
@@ -178,7 +431,7 @@ void BMP_displayHeader( uint32_t* pAddressHeader )
 uint8_t BMP_Decode( void *file, uint8_t *buffer, uint32_t width, uint32_t height, uint8_t bpp )
 {
     BMPHeader *header;
-    uint32_t i, j, paddingBytes;
+    uint32_t i, j, paddingBytes = 0;
     uint8_t r, g, b;
     uint8_t *image;
     uint8_t *pIterator;
@@ -299,6 +552,121 @@ uint8_t BMP_Decode( void *file, uint8_t *buffer, uint32_t width, uint32_t height
     return 0 ;
 }
 
+//------------------------------------------------------------------------------
+/// Reads a BMP image through a read function and draws it on the LCD, one
+/// row at a time, without staging the image in memory. Uncompressed 24-bit,
+/// uncompressed 8-bit and RLE8 images are supported; the rows are converted
+/// to RGB565 and streamed to the panel by the DMAC while the next row is
+/// decoded. The last row may still be in flight on return (see LCD_Wait()).
+/// \param fRead  Function reading the next bytes of the file.
+/// \param pArg  Argument of the read function.
+/// \param dwX  X-coordinate of the upper-left corner of the image on LCD.
+/// \param dwY  Y-coordinate of the upper-left corner of the image on LCD.
+/// \return 0 if the image has been drawn; otherwise returns an error code
+/// (1 not a BMP file, 2 format not supported, 4 input resolution not
+/// supported, 5 truncated file).
+//------------------------------------------------------------------------------
+uint8_t BMP_DrawStream( BmpReadFunc fRead, void* pArg, uint32_t dwX, uint32_t dwY )
+{
+    BMPHeader header;
+    BMPPaletteEntry entry;
+    uint32_t width, height, rowSize, colors, consumed, i;
+    uint8_t topDown;
+    PROF_SCOPE(PROF_BMP_DRAW);
+
+    bmpRead = fRead;
+    bmpReadArg = pArg;
+    bmpChunkPos = 0;
+    bmpChunkLen = 0;
+
+    if ( (ReadStream( (uint8_t *) &header, sizeof( header ) ) != sizeof( header ))
+      || (header.type != BMP_TYPE) )
+    {
+        TRACE_ERROR("BMP_DrawStream: File type is not 'BM'\n\r");
+
+        return 1;
+    }
+
+    width = header.width;
+    height = header.height;
+    topDown = ((int32_t) height < 0);
+    if ( topDown )
+    {
+        height = -(int32_t) height;
+    }
+
+    // Check that the image fits the panel row buffers
+    if ( (header.headerSize < BITMAPINFOHEADER) || (width == 0) || (dwX + width > BOARD_LCD_WIDTH)
+      || ((header.compression != BMP_RGB) && ((header.compression != BMP_RLE8) || (header.bits != 8) || topDown)) )
+    {
+        TRACE_ERROR("BMP_DrawStream: File format not supported\n\r");
+        TRACE_ERROR(" -> .compression = %u\n\r", (unsigned int)header.compression);
+        TRACE_ERROR(" -> .width = %u\n\r", (unsigned int)width);
+        TRACE_ERROR(" -> .height = %u\n\r", (unsigned int)height);
+
+        return 2;
+    }
+
+    if ( (header.bits != 24) && (header.bits != 8) )
+    {
+        TRACE_ERROR("BMP_DrawStream: Input resolution not supported\n\r");
+        TRACE_INFO("header.bits 0x%X \n\r", header.bits);
+
+        return 4;
+    }
+
+    // Skip the end of a larger info header
+    consumed = sizeof( header ) - BITMAPINFOHEADER + header.headerSize;
+    ReadStream( 0, consumed - sizeof( header ) );
+
+    // Convert the palette once, the rows are then decoded with table lookups
+    if ( header.bits == 8 )
+    {
+        colors = (header.ncolours && (header.ncolours < 256)) ? header.ncolours : 256;
+        memset( bmpPalette, 0, sizeof( bmpPalette ) );
+        for ( i = 0 ; i < colors ; i++ )
+        {
+            if ( ReadStream( (uint8_t *) &entry, sizeof( entry ) ) != sizeof( entry ) )
+            {
+                return 5;
+            }
+            bmpPalette[i] = BMP_RGB565( entry.r, entry.g, entry.b );
+        }
+        consumed += colors * sizeof( entry );
+    }
+
+    if ( (header.offset < consumed) || (ReadStream( 0, header.offset - consumed ) != header.offset - consumed) )
+    {
+        return 5;
+    }
+
+    if ( header.compression == BMP_RLE8 )
+    {
+        return DecodeRle8( dwX, dwY + height - 1, width, height );
+    }
+
+    // Rows are padded to a multiple of 4 bytes
+    rowSize = ((width * header.bits / 8) + 3) & ~3;
+    for ( i = 0 ; i < height ; i++ )
+    {
+        if ( ReadStream( bmpLine, rowSize ) != rowSize )
+        {
+            return 5;
+        }
+        if ( header.bits == 24 )
+        {
+            DecodeRow24( bmpLine, width );
+        }
+        else
+        {
+            DecodeRow8( bmpLine, width );
+        }
+        EmitRow( dwX, topDown ? (dwY + i) : (dwY + height - 1 - i), width );
+    }
+
+    return 0 ;
+}
+
 //------------------------------------------------------------------------------
 /// Convert RGB 565 to RGB 555 (RGB 555 is adapted to LCD)
 /// \param fileSource  Buffer which holds the RGB file
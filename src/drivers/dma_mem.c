@@ -0,0 +1,392 @@
+/**
+ * \file
+ *
+ * Implementation of the DMA memory copy/fill service.
+ *
+ * The service owns BOARD_MEM_DMA_CHANNEL. A request is split into an
+ * unaligned head and tail, copied by the CPU, and a word aligned body which
+ * is described by a chain of DmaLinkList descriptors and moved by the DMAC
+ * (memory-to-memory, software handshaking). The chain is at most
+ * DMAMEM_NUM_LLI descriptors long; when the body is larger, the handler
+ * builds and starts the next chain on each Chained Buffer Transfer Completed
+ * interrupt until the whole body has been moved.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "board.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Lowest address the DMAC can reach (internal flash and ROM are excluded) */
+#define DMAMEM_MIN_ADDRESS      0x20000000
+
+/** Channel interrupt sources used by the service */
+#define DMAMEM_IT_MASK          ((DMAC_EBCIER_CBTC0 | DMAC_EBCIER_ERR0) << BOARD_MEM_DMA_CHANNEL)
+
+/*----------------------------------------------------------------------------
+ *        Local types
+ *----------------------------------------------------------------------------*/
+
+/** State of the transfer in progress on the memory channel */
+typedef struct _DmaMemTransfer
+{
+    /** Set while the DMAC owns the transfer */
+    volatile uint8_t ucBusy ;
+    /** Status of the last transfer (DMAMEM_STATUS_xxx) */
+    volatile uint8_t ucStatus ;
+    /** Source address is fixed (fill) */
+    uint8_t ucFixedSrc ;
+    /** Next destination address of the body */
+    uint32_t dwDest ;
+    /** Next source address of the body */
+    uint32_t dwSrc ;
+    /** Words of the body not yet handed to the DMAC */
+    uint32_t dwRemaining ;
+    /** Completion callback */
+    DmaMemCallback fCallback ;
+    /** Completion callback argument */
+    void* pArg ;
+} DmaMemTransfer ;
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Descriptor chain fetched by the DMAC */
+static DmaLinkList gDmaMemLli[DMAMEM_NUM_LLI] ;
+
+/** Fill pattern read by the DMAC with a fixed source address */
+static volatile uint32_t gdwDmaMemPattern ;
+
+/** Current transfer */
+static DmaMemTransfer gDmaMemXfr ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Build and start the next descriptor chain of the current transfer.
+ */
+static void _StartChain( void )
+{
+    uint32_t dwWords ;
+
+    dwWords = DMA_MemBuildChain( gDmaMemLli, DMAMEM_NUM_LLI, gDmaMemXfr.dwDest, gDmaMemXfr.dwSrc,
+                                 gDmaMemXfr.dwRemaining, gDmaMemXfr.ucFixedSrc ) ;
+
+    gDmaMemXfr.dwRemaining -= dwWords ;
+    gDmaMemXfr.dwDest += dwWords * 4 ;
+    if ( !gDmaMemXfr.ucFixedSrc )
+    {
+        gDmaMemXfr.dwSrc += dwWords * 4 ;
+    }
+
+    DMA_DisableChannel( DMAC, BOARD_MEM_DMA_CHANNEL ) ;
+
+    DMA_SetSourceAddr( DMAC, BOARD_MEM_DMA_CHANNEL, gDmaMemLli[0].sourceAddress ) ;
+    DMA_SetDestinationAddr( DMAC, BOARD_MEM_DMA_CHANNEL, gDmaMemLli[0].destAddress ) ;
+    DMA_SetDescriptorAddr( DMAC, BOARD_MEM_DMA_CHANNEL, (uint32_t)&gDmaMemLli[0] ) ;
+    DMA_SetSourceBufferMode( DMAC, BOARD_MEM_DMA_CHANNEL, DMA_TRANSFER_LLI,
+                             (gDmaMemXfr.ucFixedSrc ? DMAC_CTRLB_SRC_INCR_FIXED : DMAC_CTRLB_SRC_INCR_INCREMENTING) >> 24 ) ;
+    DMA_SetDestBufferMode( DMAC, BOARD_MEM_DMA_CHANNEL, DMA_TRANSFER_LLI, DMAC_CTRLB_DST_INCR_INCREMENTING >> 28 ) ;
+    DMA_SetFlowControl( DMAC, BOARD_MEM_DMA_CHANNEL, DMAC_CTRLB_FC_MEM2MEM_DMA_FC >> 21 ) ;
+    DMA_SetConfiguration( DMAC, BOARD_MEM_DMA_CHANNEL, DMAC_CFG_SRC_H2SEL_SW
+                                                     | DMAC_CFG_DST_H2SEL_SW
+                                                     | DMAC_CFG_SOD_DISABLE
+                                                     | DMAC_CFG_AHB_PROT( 1 )
+                                                     | DMAC_CFG_FIFOCFG_ALAP_CFG ) ;
+
+    DMA_EnableIt( DMAC, DMAMEM_IT_MASK ) ;
+    DMA_EnableChannel( DMAC, BOARD_MEM_DMA_CHANNEL ) ;
+}
+
+/**
+ * \brief Terminate the current transfer and invoke its callback.
+ *
+ * \param dwStatus  Completion status passed to the callback.
+ */
+static void _Complete( uint32_t dwStatus )
+{
+    DmaMemCallback fCallback = gDmaMemXfr.fCallback ;
+    void* pArg = gDmaMemXfr.pArg ;
+
+    DMA_DisableIt( DMAC, DMAMEM_IT_MASK ) ;
+    DMA_DisableChannel( DMAC, BOARD_MEM_DMA_CHANNEL ) ;
+
+    gDmaMemXfr.fCallback = 0 ;
+    gDmaMemXfr.ucStatus = (uint8_t)dwStatus ;
+    gDmaMemXfr.ucBusy = 0 ;
+
+    if ( fCallback )
+    {
+        fCallback( pArg, dwStatus ) ;
+    }
+}
+
+/**
+ * \brief Record a transfer done by the CPU as the last transfer.
+ *
+ * Left alone while the DMAC owns a transfer, so that DMA_MemWait() still
+ * reports the status of that transfer.
+ */
+static void _CpuDone( void )
+{
+    if ( !gDmaMemXfr.ucBusy )
+    {
+        gDmaMemXfr.ucStatus = DMAMEM_STATUS_SUCCESS ;
+    }
+}
+
+/**
+ * \brief Check whether the DMAC may be used for the given range.
+ *
+ * \return 1 if the DMAC can be used, 0 if the CPU must do the work.
+ */
+static uint32_t _UseDma( uint32_t dwDest, uint32_t dwSrc, uint32_t dwSize )
+{
+    if ( dwSize < DMAMEM_CPU_THRESHOLD || gDmaMemXfr.ucBusy )
+    {
+        return 0 ;
+    }
+
+    if ( dwDest < DMAMEM_MIN_ADDRESS || dwSrc < DMAMEM_MIN_ADDRESS )
+    {
+        return 0 ;
+    }
+
+    return 1 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the DMA memory service and its DMAC channel.
+ */
+extern void DMA_MemInitialize( void )
+{
+    DMAD_Initialize( BOARD_MEM_DMA_CHANNEL, DMAD_USE_DEFAULT_IT ) ;
+
+    memset( &gDmaMemXfr, 0, sizeof( gDmaMemXfr ) ) ;
+}
+
+/**
+ * \brief Fill a descriptor chain for a word aligned memory-to-memory move.
+ *
+ * This function only writes the descriptors, it does not touch the DMAC.
+ *
+ * \param pLli        Descriptor table to fill.
+ * \param dwNumLli    Number of descriptors available in pLli.
+ * \param dwDest      Word aligned destination address.
+ * \param dwSrc       Word aligned source address.
+ * \param dwWords     Number of words to move.
+ * \param dwFixedSrc  1 to read every word from dwSrc (fill), 0 to increment.
+ *
+ * \return Number of words described by the chain (at most
+ * dwNumLli * DMAMEM_LLI_WORDS).
+ */
+extern uint32_t DMA_MemBuildChain( DmaLinkList* pLli, uint32_t dwNumLli, uint32_t dwDest, uint32_t dwSrc,
+                                   uint32_t dwWords, uint32_t dwFixedSrc )
+{
+    uint32_t dwDone = 0 ;
+    uint32_t dwChunk ;
+    uint32_t i ;
+
+    for ( i = 0 ; (i < dwNumLli) && (dwDone < dwWords) ; i++ )
+    {
+        dwChunk = dwWords - dwDone ;
+        if ( dwChunk > DMAMEM_LLI_WORDS )
+        {
+            dwChunk = DMAMEM_LLI_WORDS ;
+        }
+
+        pLli[i].sourceAddress = dwFixedSrc ? dwSrc : (dwSrc + dwDone * 4) ;
+        pLli[i].destAddress = dwDest + dwDone * 4 ;
+        pLli[i].controlA = DMAC_CTRLA_BTSIZE( dwChunk )
+                         | DMAC_CTRLA_SCSIZE_CHK_1
+                         | DMAC_CTRLA_DCSIZE_CHK_1
+                         | DMAC_CTRLA_SRC_WIDTH_WORD
+                         | DMAC_CTRLA_DST_WIDTH_WORD ;
+        pLli[i].controlB = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM
+                         | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM
+                         | DMAC_CTRLB_FC_MEM2MEM_DMA_FC
+                         | (dwFixedSrc ? DMAC_CTRLB_SRC_INCR_FIXED : DMAC_CTRLB_SRC_INCR_INCREMENTING)
+                         | DMAC_CTRLB_DST_INCR_INCREMENTING ;
+        pLli[i].descriptor = 0 ;
+        if ( i > 0 )
+        {
+            pLli[i - 1].descriptor = (uint32_t)&pLli[i] ;
+        }
+
+        dwDone += dwChunk ;
+    }
+
+    return dwDone ;
+}
+
+/**
+ * \brief Copy a memory area, using the DMAC for large aligned ranges.
+ *
+ * The unaligned head and tail bytes are copied by the CPU before the
+ * function returns. The areas must not overlap.
+ *
+ * \param pDest      Destination address.
+ * \param pSrc       Source address.
+ * \param dwSize     Number of bytes to copy.
+ * \param fCallback  Optional completion callback.
+ * \param pArg       Callback argument.
+ *
+ * \return 1 if the DMAC is moving the data, 0 if the copy is already done.
+ */
+extern uint32_t DMA_Memcpy( void* pDest, const void* pSrc, uint32_t dwSize, DmaMemCallback fCallback, void* pArg )
+{
+    uint32_t dwDest = (uint32_t)pDest ;
+    uint32_t dwSrc = (uint32_t)pSrc ;
+    uint32_t dwHead ;
+    uint32_t dwTail ;
+
+    /* Source and destination must share the same word alignment */
+    if ( ((dwDest ^ dwSrc) & 3) || !_UseDma( dwDest, dwSrc, dwSize ) )
+    {
+        memcpy( pDest, pSrc, dwSize ) ;
+        _CpuDone() ;
+        if ( fCallback )
+        {
+            fCallback( pArg, DMAMEM_STATUS_SUCCESS ) ;
+        }
+        return 0 ;
+    }
+
+    dwHead = (4 - (dwDest & 3)) & 3 ;
+    dwTail = (dwSize - dwHead) & 3 ;
+    memcpy( pDest, pSrc, dwHead ) ;
+    memcpy( (uint8_t*)pDest + dwSize - dwTail, (const uint8_t*)pSrc + dwSize - dwTail, dwTail ) ;
+
+    gDmaMemXfr.ucBusy = 1 ;
+    gDmaMemXfr.ucStatus = DMAMEM_STATUS_SUCCESS ;
+    gDmaMemXfr.ucFixedSrc = 0 ;
+    gDmaMemXfr.dwDest = dwDest + dwHead ;
+    gDmaMemXfr.dwSrc = dwSrc + dwHead ;
+    gDmaMemXfr.dwRemaining = (dwSize - dwHead - dwTail) / 4 ;
+    gDmaMemXfr.fCallback = fCallback ;
+    gDmaMemXfr.pArg = pArg ;
+
+    _StartChain() ;
+
+    return 1 ;
+}
+
+/**
+ * \brief Fill a memory area with a byte value, using the DMAC for large ranges.
+ *
+ * \param pDest      Destination address.
+ * \param ucValue    Fill value.
+ * \param dwSize     Number of bytes to fill.
+ * \param fCallback  Optional completion callback.
+ * \param pArg       Callback argument.
+ *
+ * \return 1 if the DMAC is filling the area, 0 if the fill is already done.
+ */
+extern uint32_t DMA_Memset( void* pDest, uint8_t ucValue, uint32_t dwSize, DmaMemCallback fCallback, void* pArg )
+{
+    uint32_t dwDest = (uint32_t)pDest ;
+    uint32_t dwHead ;
+    uint32_t dwTail ;
+
+    if ( !_UseDma( dwDest, (uint32_t)&gdwDmaMemPattern, dwSize ) )
+    {
+        memset( pDest, ucValue, dwSize ) ;
+        _CpuDone() ;
+        if ( fCallback )
+        {
+            fCallback( pArg, DMAMEM_STATUS_SUCCESS ) ;
+        }
+        return 0 ;
+    }
+
+    dwHead = (4 - (dwDest & 3)) & 3 ;
+    dwTail = (dwSize - dwHead) & 3 ;
+    memset( pDest, ucValue, dwHead ) ;
+    memset( (uint8_t*)pDest + dwSize - dwTail, ucValue, dwTail ) ;
+
+    gdwDmaMemPattern = ucValue * 0x01010101u ;
+
+    gDmaMemXfr.ucBusy = 1 ;
+    gDmaMemXfr.ucStatus = DMAMEM_STATUS_SUCCESS ;
+    gDmaMemXfr.ucFixedSrc = 1 ;
+    gDmaMemXfr.dwDest = dwDest + dwHead ;
+    gDmaMemXfr.dwSrc = (uint32_t)&gdwDmaMemPattern ;
+    gDmaMemXfr.dwRemaining = (dwSize - dwHead - dwTail) / 4 ;
+    gDmaMemXfr.fCallback = fCallback ;
+    gDmaMemXfr.pArg = pArg ;
+
+    _StartChain() ;
+
+    return 1 ;
+}
+
+/**
+ * \brief Return 1 if no DMA memory transfer is pending, 0 otherwise.
+ */
+extern uint32_t DMA_MemIsFinished( void )
+{
+    return (gDmaMemXfr.ucBusy == 0) ;
+}
+
+/**
+ * \brief Wait until the pending DMA memory transfer (if any) is done.
+ *
+ * \return DMAMEM_STATUS_ERROR if the last transfer ended on an AHB error
+ * (the destination range is then only partly written), DMAMEM_STATUS_SUCCESS
+ * otherwise.
+ */
+extern uint32_t DMA_MemWait( void )
+{
+    while ( gDmaMemXfr.ucBusy ) ;
+
+    return gDmaMemXfr.ucStatus ;
+}
+
+/**
+ * \brief Memory channel part of the DMAC interrupt handler.
+ *
+ * Called by DMAC_IrqHandler() with the (read-to-clear) interrupt status.
+ *
+ * \param dwStatus  Value read from DMAC_EBCISR.
+ */
+extern void DMA_MemHandler( uint32_t dwStatus )
+{
+    if ( !gDmaMemXfr.ucBusy )
+    {
+        return ;
+    }
+
+    if ( dwStatus & (DMAC_EBCISR_ERR0 << BOARD_MEM_DMA_CHANNEL) )
+    {
+        TRACE_ERROR( "DMA_Mem: AHB error at 0x%x\n\r", (unsigned int)gDmaMemXfr.dwDest ) ;
+        _Complete( DMAMEM_STATUS_ERROR ) ;
+        return ;
+    }
+
+    if ( dwStatus & (DMAC_EBCISR_CBTC0 << BOARD_MEM_DMA_CHANNEL) )
+    {
+        if ( gDmaMemXfr.dwRemaining )
+        {
+            _StartChain() ;
+        }
+        else
+        {
+            _Complete( DMAMEM_STATUS_SUCCESS ) ;
+        }
+    }
+}
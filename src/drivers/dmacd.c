@@ -92,7 +92,7 @@ extern void DMAC_IrqHandler( void )
         // Scan each dwChannel status.
         for ( dwChannel = 0 ; dwChannel < DMA_CHANNEL_NUM ; dwChannel++ )
         {
-            if ( !(dwStatus & (DMAC_EBCISR_BTC0 << dwChannel)) )
+            if ( !(dwStatus & (DMAC_EBCISR_BTC0 << dwChannel)) || (dmad.transfers[dwChannel].transferSize == 0) )
             {
                 continue ;
             }
@@ -109,7 +109,10 @@ extern void DMAC_IrqHandler( void )
             if ( dmad.transfers[dwChannel].transferSize == 0 )
             {
                 pTransfer = &(dmad.transfers[dwChannel]) ;
-                pTransfer->callback() ;
+                if ( pTransfer->callback )
+                {
+                    pTransfer->callback() ;
+                }
                 DMA_DisableIt( DMAC, DMAC_EBCIDR_BTC0 << dwChannel ) ;
                 DMA_DisableChannel( DMAC, dwChannel ) ;
             }
@@ -120,6 +123,24 @@ extern void DMAC_IrqHandler( void )
             }
         }
     }
+
+    // Chained transfers of the memory copy service.
+    if ( dwStatus & ((DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << BOARD_MEM_DMA_CHANNEL) )
+    {
+        DMA_MemHandler( dwStatus ) ;
+    }
+
+    // Pixel streaming of the LCD driver.
+    if ( dwStatus & ((DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << BOARD_LCD_DMA_CHANNEL) )
+    {
+        LCD_DmaHandler( dwStatus ) ;
+    }
+
+    // Data phase of the SPI command driver.
+    if ( dwStatus & ((DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << BOARD_SPI_DMA_RX_CHANNEL) )
+    {
+        SPID_DmaHandler( dwStatus ) ;
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -140,14 +161,16 @@ extern void DMAD_Initialize( uint32_t dwChannel, uint32_t defaultHandler )
     TRACE_INFO( "DMAD_Initialize dwChannel %x  \n\r", dwChannel ) ;
     assert( (dwStatus & (1 << dwChannel)) == 0 ) ;
 
-    /* Clear any pending interrupts on the channel */
-    DMA_GetStatus( DMAC ) ;
+    /* DMAC_EBCISR is not read here: the read clears the flags of every
+       channel, including the ones of transfers still running on the other
+       channels. A stale flag of this channel is ignored by its handler,
+       which only acts while a transfer of its own is in progress. */
 
     /* Disable the channel */
     DMA_DisableChannel( DMAC, dwChannel ) ;
 
-    /* Disable the interrupt */
-    dwFlag = 0x3FFFFF ;
+    /* Disable the interrupts of this channel only */
+    dwFlag = (DMAC_EBCIDR_BTC0 | DMAC_EBCIDR_CBTC0 | DMAC_EBCIDR_ERR0) << dwChannel ;
     DMA_DisableIt( DMAC, dwFlag ) ;
     /* Enable DMA */
     DMA_Enable( DMAC ) ;
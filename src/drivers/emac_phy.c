@@ -0,0 +1,117 @@
+/**
+ * \file
+ *
+ * Implementation of the EMAC link bring-up.
+ *
+ * The PHY is looked for at the address given, then at the following ones,
+ * by reading its identifier over MDIO: a PHY which is not there reads back
+ * all zeros or all ones. The auto-negotiation is restarted and the status
+ * register polled until both the link and the negotiation are reported
+ * complete; the EMAC is then set to the best mode that the link partner
+ * advertises, 100 Mbit/s first.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "board.h"
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Find the first PHY answering on the MDIO bus.
+ *
+ * \param pEmac         EMAC instance, with its MDIO interface enabled.
+ * \param pdwPhyAddress Address tried first, replaced by the address found.
+ * \return 1 if a PHY is found, 0 otherwise.
+ */
+static uint32_t _FindPhy( Emac* pEmac, uint32_t* pdwPhyAddress )
+{
+    uint32_t dwPhy = *pdwPhyAddress ;
+    uint32_t dwValue ;
+    uint32_t i ;
+
+    for ( i = 0 ; i < 32 ; i++, dwPhy = (dwPhy + 1) % 32 )
+    {
+        if ( (EMAC_ReadPhy( pEmac, dwPhy, MII_PHYID1, &dwValue, EMAC_PHY_MDIO_RETRY ) == 0)
+             && (dwValue != 0) && (dwValue != 0xFFFF) )
+        {
+            *pdwPhyAddress = dwPhy ;
+            return 1 ;
+        }
+    }
+
+    return 0 ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Bring the EMAC up and wait for the PHY to negotiate the link.
+ *
+ * \param pEmac         EMAC instance.
+ * \param dwId          EMAC peripheral identifier.
+ * \param pMac          MAC address.
+ * \param dwPhyAddress  Strapped address of the PHY, tried first.
+ * \param fClock        Millisecond clock.
+ * \param dwTimeoutMs   Longest wait for the link.
+ * \return EMAC_PHY_OK if the link is up, EMAC_PHY_NOPHY or EMAC_PHY_NOLINK.
+ */
+extern uint32_t EMAC_PhyLinkUp( Emac* pEmac, uint32_t dwId, const uint8_t* pMac, uint32_t dwPhyAddress,
+                                EmacPhyClockFunc fClock, uint32_t dwTimeoutMs )
+{
+    uint32_t dwValue = 0 ;
+    uint32_t dwStart ;
+    uint32_t dwRc = EMAC_PHY_OK ;
+
+    EMAC_Init( pEmac, dwId, pMac, EMAC_CAF_DISABLE | EMAC_NBC_DISABLE ) ;
+    EMAC_SetMdcClock( pEmac, BOARD_MCK ) ;
+    EMAC_EnableRMII( pEmac ) ;
+    EMAC_EnableMdio( pEmac ) ;
+
+    if ( !_FindPhy( pEmac, &dwPhyAddress ) )
+    {
+        TRACE_ERROR( "EMAC_PhyLinkUp: no PHY\n\r" ) ;
+        dwRc = EMAC_PHY_NOPHY ;
+    }
+    else
+    {
+        EMAC_WritePhy( pEmac, dwPhyAddress, MII_BMCR, MII_BMCR_ANENABLE | MII_BMCR_ANRESTART, EMAC_PHY_MDIO_RETRY ) ;
+        dwStart = fClock() ;
+        do
+        {
+            if ( fClock() - dwStart > dwTimeoutMs )
+            {
+                TRACE_ERROR( "EMAC_PhyLinkUp: no link on PHY %u\n\r", (unsigned int)dwPhyAddress ) ;
+                dwRc = EMAC_PHY_NOLINK ;
+                break ;
+            }
+            EMAC_ReadPhy( pEmac, dwPhyAddress, MII_BMSR, &dwValue, EMAC_PHY_MDIO_RETRY ) ;
+        } while ( (dwValue & (MII_BMSR_LINK | MII_BMSR_ANCOMPLETE)) != (MII_BMSR_LINK | MII_BMSR_ANCOMPLETE) ) ;
+    }
+
+    if ( dwRc == EMAC_PHY_OK )
+    {
+        /* Best mode common to both ends */
+        EMAC_ReadPhy( pEmac, dwPhyAddress, MII_ANLPAR, &dwValue, EMAC_PHY_MDIO_RETRY ) ;
+        if ( dwValue & (MII_ANLPAR_100FD | MII_ANLPAR_100HD) )
+        {
+            EMAC_SetLinkSpeed( pEmac, 1, (dwValue & MII_ANLPAR_100FD) != 0 ) ;
+        }
+        else
+        {
+            EMAC_SetLinkSpeed( pEmac, 0, (dwValue & MII_ANLPAR_10FD) != 0 ) ;
+        }
+        TRACE_INFO( "EMAC_PhyLinkUp: PHY %u, link up\n\r", (unsigned int)dwPhyAddress ) ;
+    }
+    EMAC_DisableMdio( pEmac ) ;
+
+    return dwRc ;
+}
@@ -30,6 +30,12 @@
 /**
  * \file
  *
+ * Implementation of the software frame buffer.
+ *
+ * The primitives are rasterised into horizontal spans, clipped to the frame
+ * buffer and written with word stores. Each primitive records its bounding
+ * box in a short list of dirty rectangles; FB_Flush() sends only those
+ * rectangles to the panel, each through one LCD window.
  */
 
 /*----------------------------------------------------------------------------
@@ -39,9 +45,23 @@
 #include "board.h"
 #include <stdint.h>
 #include <string.h>
+#include <assert.h>
+
+/** Number of dirty rectangles tracked before they are merged */
+#define FB_MAX_DIRTY 4
+
+/*----------------------------------------------------------------------------
+ *        Local types
+ *----------------------------------------------------------------------------*/
+
+/** Rectangle in frame buffer coordinates, corners included */
+typedef struct _FbRect {
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+} FbRect;
 
-/** Frame buffer color cache size used to optimize memcpy */
-#define FB_COLOR_CACHE_SIZE 8
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
@@ -50,38 +70,94 @@
 */
 static LcdColor_t *gpBuffer;
 /** Frame buffer width */
-static uint8_t gucWidth;
+static int32_t gdwWidth;
 /** Frame buffer height */
-static uint8_t gucHeight;
-/* Pixel color cache */
-static LcdColor_t gFbPixelCache[FB_COLOR_CACHE_SIZE];
+static int32_t gdwHeight;
+/** Panel position of the frame buffer upper-left corner */
+static uint32_t gdwPanelX;
+static uint32_t gdwPanelY;
+/** Current color, alone and twice in a word for the row stores */
+static LcdColor_t gwColor;
+static uint32_t gdwColor2;
+/** Areas modified since the last FB_Flush() */
+static FbRect gDirty[FB_MAX_DIRTY];
+static uint32_t gdwNumDirty;
 
 /*----------------------------------------------------------------------------
  *        Static functions
  *----------------------------------------------------------------------------*/
+
 /**
- * \brief Check Box coordinates. Return upper left and bottom right coordinates.
- *
- * \param pX1      X-coordinate of upper-left corner on LCD.
- * \param pY1      Y-coordinate of upper-left corner on LCD.
- * \param pX2      X-coordinate of lower-right corner on LCD.
- * \param pY2      Y-coordinate of lower-right corner on LCD.
+ * \brief Wait until the panel has read the frame buffer sent by FB_Flush().
  */
-static void CheckBoxCoordinates( uint32_t *pX1, uint32_t *pY1, uint32_t *pX2, uint32_t *pY2 )
+static inline void WaitFlush( void )
 {
-    uint32_t dw;
+    LCD_Wait();
+}
 
-    if ( *pX1 >= gucWidth )
-        *pX1=gucWidth-1 ;
+/**
+ * \brief Record a modified area (already clipped).
+ *
+ * The area is merged with a tracked rectangle it overlaps or touches. When
+ * the list is full, it is merged with the rectangle that grows the least.
+ */
+static void AddDirty( int32_t x1, int32_t y1, int32_t x2, int32_t y2 )
+{
+    FbRect *pRect;
+    FbRect *pBest = 0;
+    uint32_t dwGrowth, dwBestGrowth = 0xFFFFFFFF;
+    int32_t ux1, uy1, ux2, uy2;
+    uint32_t i;
+
+    for (i = 0; i < gdwNumDirty; i++) {
+        pRect = &gDirty[i];
+        ux1 = (x1 < pRect->x1) ? x1 : pRect->x1;
+        uy1 = (y1 < pRect->y1) ? y1 : pRect->y1;
+        ux2 = (x2 > pRect->x2) ? x2 : pRect->x2;
+        uy2 = (y2 > pRect->y2) ? y2 : pRect->y2;
+
+        if ((x1 <= pRect->x2 + 1) && (x2 + 1 >= pRect->x1)
+         && (y1 <= pRect->y2 + 1) && (y2 + 1 >= pRect->y1)) {
+            dwGrowth = 0;
+        }
+        else {
+            dwGrowth = (ux2 - ux1 + 1) * (uy2 - uy1 + 1)
+                     - (pRect->x2 - pRect->x1 + 1) * (pRect->y2 - pRect->y1 + 1);
+        }
+        if (dwGrowth < dwBestGrowth) {
+            dwBestGrowth = dwGrowth;
+            pBest = pRect;
+        }
+    }
 
-    if ( *pX2 >= gucWidth )
-        *pX2=gucWidth-1 ;
+    if ((pBest == 0) || ((dwBestGrowth != 0) && (gdwNumDirty < FB_MAX_DIRTY))) {
+        pRect = &gDirty[gdwNumDirty++];
+        pRect->x1 = x1;
+        pRect->y1 = y1;
+        pRect->x2 = x2;
+        pRect->y2 = y2;
+        return;
+    }
 
-    if ( *pY1 >= gucHeight )
-        *pY1=gucHeight-1 ;
+    if (x1 < pBest->x1) pBest->x1 = x1;
+    if (y1 < pBest->y1) pBest->y1 = y1;
+    if (x2 > pBest->x2) pBest->x2 = x2;
+    if (y2 > pBest->y2) pBest->y2 = y2;
+}
 
-    if ( *pY2 >= gucHeight )
-        *pY2=gucHeight-1 ;
+/**
+ * \brief Order box coordinates and clip them to the frame buffer.
+ *
+ * \param pX1      X-coordinate of upper-left corner.
+ * \param pY1      Y-coordinate of upper-left corner.
+ * \param pX2      X-coordinate of lower-right corner.
+ * \param pY2      Y-coordinate of lower-right corner.
+ *
+ * \return 1 if part of the box is in the frame buffer, 0 otherwise.
+ */
+static uint32_t ClipBox( int32_t *pX1, int32_t *pY1, int32_t *pX2, int32_t *pY2 )
+{
+    int32_t dw;
 
     if (*pX1 > *pX2) {
         dw = *pX1;
@@ -93,54 +169,127 @@ static void CheckBoxCoordinates( uint32_t *pX1, uint32_t *pY1, uint32_t *pX2, ui
         *pY1 = *pY2;
         *pY2 = dw;
     }
+
+    if ((*pX2 < 0) || (*pY2 < 0) || (*pX1 >= gdwWidth) || (*pY1 >= gdwHeight))
+        return 0;
+
+    if (*pX1 < 0)
+        *pX1 = 0;
+    if (*pY1 < 0)
+        *pY1 = 0;
+    if (*pX2 >= gdwWidth)
+        *pX2 = gdwWidth - 1;
+    if (*pY2 >= gdwHeight)
+        *pY2 = gdwHeight - 1;
+
+    return 1;
+}
+
+/**
+ * \brief Fill a horizontal span with the current color, clipped to the
+ * frame buffer. The dirty area is recorded by the caller.
+ *
+ * \param x1  X-coordinate of the span start.
+ * \param x2  X-coordinate of the span end (included).
+ * \param y   Y-coordinate of the span.
+ */
+static void FillSpan( int32_t x1, int32_t x2, int32_t y )
+{
+    LcdColor_t *pPixel;
+    uint32_t *pWord;
+    int32_t n;
+
+    if ((y < 0) || (y >= gdwHeight))
+        return;
+    if (x1 < 0)
+        x1 = 0;
+    if (x2 >= gdwWidth)
+        x2 = gdwWidth - 1;
+    if (x1 > x2)
+        return;
+
+    pPixel = &gpBuffer[y * gdwWidth + x1];
+    n = x2 - x1 + 1;
+
+    /* Align on a word, then store two pixels at a time */
+    if ((uint32_t)pPixel & 2) {
+        *pPixel++ = gwColor;
+        n--;
+    }
+    pWord = (uint32_t *)pPixel;
+    for (; n >= 2; n -= 2)
+        *pWord++ = gdwColor2;
+    if (n)
+        *(LcdColor_t *)pWord = gwColor;
+}
+
+/**
+ * \brief Set a pixel to the current color, if it is in the frame buffer.
+ */
+static inline void PutPixel( int32_t x, int32_t y )
+{
+    if ((x >= 0) && (y >= 0) && (x < gdwWidth) && (y < gdwHeight))
+        gpBuffer[y * gdwWidth + x] = gwColor;
+}
+
+/**
+ * \brief Record the clipped bounding box of a primitive as dirty.
+ */
+static void AddDirtyBox( int32_t x1, int32_t y1, int32_t x2, int32_t y2 )
+{
+    if (ClipBox(&x1, &y1, &x2, &y2))
+        AddDirty(x1, y1, x2, y2);
 }
 
 /*
  * \brief Draw a line on LCD, which is not horizontal or vertical.
  *
- * \param x         X-coordinate of line start.
- * \param y         Y-coordinate of line start.
- * \param length    line length.
- * \param direction line direction: 0 - horizontal, 1 - vertical.
- * \param color     Pixel color.
+ * Pixels of the same row are written as one span.
+ *
+ * \param x1        X-coordinate of line start.
+ * \param y1        Y-coordinate of line start.
+ * \param x2        X-coordinate of line end.
+ * \param y2        Y-coordinate of line end.
  */
-static uint32_t DrawLineBresenham( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 )
+static uint32_t DrawLineBresenham( int32_t x1, int32_t y1, int32_t x2, int32_t y2 )
 {
-    int dx, dy ;
-    int i ;
-    int xinc, yinc, cumul ;
-    int x, y ;
+    int32_t dx, dy ;
+    int32_t i ;
+    int32_t xinc, yinc, cumul ;
+    int32_t x, y, xstart ;
 
-    x = dwX1 ;
-    y = dwY1 ;
-    dx = dwX2 - dwX1 ;
-    dy = dwY2 - dwY1 ;
+    x = x1 ;
+    y = y1 ;
+    dx = x2 - x1 ;
+    dy = y2 - y1 ;
 
     xinc = ( dx > 0 ) ? 1 : -1 ;
     yinc = ( dy > 0 ) ? 1 : -1 ;
     dx = ( dx > 0 ) ? dx : -dx ;
     dy = ( dy > 0 ) ? dy : -dy ;
 
-    FB_DrawPixel(x, y);
-
     if ( dx > dy )
     {
-      cumul = dx / 2 ;
-      for ( i = 1 ; i <= dx ; i++ )
-      {
-        x += xinc ;
-        cumul += dy ;
-
-        if ( cumul >= dx )
+        xstart = x ;
+        cumul = dx / 2 ;
+        for ( i = 1 ; i <= dx ; i++ )
         {
-          cumul -= dx ;
-          y += yinc ;
+            x += xinc ;
+            cumul += dy ;
+
+            if ( cumul >= dx )
+            {
+                cumul -= dx ;
+                FillSpan( (xinc > 0) ? xstart : x - xinc, (xinc > 0) ? x - xinc : xstart, y ) ;
+                xstart = x ;
+                y += yinc ;
+            }
         }
-        FB_DrawPixel(x, y);
-      }
+        FillSpan( (xinc > 0) ? xstart : x, (xinc > 0) ? x : xstart, y ) ;
     }
     else
     {
+        PutPixel( x, y ) ;
         cumul = dy / 2 ;
         for ( i = 1 ; i <= dy ; i++ )
         {
@@ -153,7 +302,7 @@ static uint32_t DrawLineBresenham( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2,
                 x += xinc ;
             }
 
-            FB_DrawPixel(x, y);
+            PutPixel( x, y ) ;
         }
     }
 
@@ -167,21 +316,35 @@ static uint32_t DrawLineBresenham( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2,
 /**
  * \brief Configure the current frame buffer.
  * Next frame buffer operations will take place in this frame buffer area.
- * \param pBuffer 16 bit aligned sram buffer. PDC shall be able to access this
- *        memory area.
- * \param ucWidth frame buffer width
- * \param ucHeight frame buffer height
+ * \param pBuffer 16 bit aligned sram buffer. The DMAC shall be able to
+ *        access this memory area.
+ * \param dwWidth frame buffer width
+ * \param dwHeight frame buffer height
  */
-extern void FB_SetFrameBuffer(LcdColor_t *pBuffer, uint8_t ucWidth, uint8_t ucHeight)
+extern void FB_SetFrameBuffer(LcdColor_t *pBuffer, uint32_t dwWidth, uint32_t dwHeight)
 {
     /* Sanity check */
     assert(pBuffer != NULL);
 
+    WaitFlush();
+
     gpBuffer = pBuffer;
-    gucWidth = ucWidth;
-    gucHeight = ucHeight;
+    gdwWidth = dwWidth;
+    gdwHeight = dwHeight;
+    gdwNumDirty = 0;
 }
 
+/**
+ * \brief Set the panel position of the frame buffer, used by FB_Flush().
+ *
+ * \param dwX  X-coordinate of the frame buffer upper-left corner on LCD.
+ * \param dwY  Y-coordinate of the frame buffer upper-left corner on LCD.
+ */
+extern void FB_SetPosition(uint32_t dwX, uint32_t dwY)
+{
+    gdwPanelX = dwX;
+    gdwPanelY = dwY;
+}
 
 /**
  * \brief Configure the current color that will be used in the next graphical operations.
@@ -190,18 +353,12 @@ extern void FB_SetFrameBuffer(LcdColor_t *pBuffer, uint8_t ucWidth, uint8_t ucHe
  */
 extern void FB_SetColor(uint32_t dwRgb24Bits)
 {
-    uint16_t i;
-    LcdColor_t wColor;
-
-    wColor = (dwRgb24Bits & 0xF80000) >> 8 |
-             (dwRgb24Bits & 0x00FC00) >> 5 |
-             (dwRgb24Bits & 0x0000F8) >> 3;
-
-    /* Fill the cache with selected color */
-    for (i = 0; i < FB_COLOR_CACHE_SIZE; ++i) {
-        gFbPixelCache[i] = wColor ;
-    }
+    gwColor = (dwRgb24Bits & 0xF80000) >> 8 |
+              (dwRgb24Bits & 0x00FC00) >> 5 |
+              (dwRgb24Bits & 0x0000F8) >> 3;
+    gdwColor2 = gwColor | ((uint32_t)gwColor << 16);
 }
+
 /**
  * \brief Draw a pixel on FB of given color.
  *
@@ -214,10 +371,12 @@ extern uint32_t FB_DrawPixel(
     uint32_t dwX,
     uint32_t dwY)
 {
-    if ((dwX >= gucWidth) || (dwY >= gucHeight)) {
+    if ((dwX >= (uint32_t)gdwWidth) || (dwY >= (uint32_t)gdwHeight)) {
         return 1;
     }
-    gpBuffer[dwX + dwY * gucWidth] = gFbPixelCache[0];
+    WaitFlush();
+    gpBuffer[dwX + dwY * gdwWidth] = gwColor;
+    AddDirty(dwX, dwY, dwX, dwY);
 
     return 0;
 }
@@ -225,9 +384,8 @@ extern uint32_t FB_DrawPixel(
 /**
  * \brief Write several pixels with the same color to FB.
  *
- * Pixel color is set by the LCD_SetColor() function.
- * This function is optimized using an sram buffer to transfer block instead of
- * individual pixels in order to limit the number of SPI interrupts.
+ * Pixel color is set by the FB_SetColor() function. The rectangle is
+ * clipped to the frame buffer.
  * \param dwX1      X-coordinate of upper-left corner on LCD.
  * \param dwY1      Y-coordinate of upper-left corner on LCD.
  * \param dwX2      X-coordinate of lower-right corner on LCD.
@@ -237,27 +395,16 @@ extern uint32_t FB_DrawPixel(
  */
 extern uint32_t FB_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 )
 {
-    LcdColor_t *pFbBuffer, *pDestFbBuffer;
-    uint32_t dwY, blocks, bytes;
-
-    /* Swap coordinates if necessary */
-    CheckBoxCoordinates(&dwX1, &dwY1, &dwX2, &dwY2);
-
-    blocks  = ((dwX2 - dwX1 + 1) / FB_COLOR_CACHE_SIZE);
-    bytes   = ((dwX2 - dwX1 + 1) % FB_COLOR_CACHE_SIZE);
+    int32_t x1 = dwX1, y1 = dwY1, x2 = dwX2, y2 = dwY2;
+    int32_t y;
 
-    /* Each row is sent by block to benefit from memcpy optimizations */
-    pFbBuffer = &(gpBuffer[dwY1 * gucWidth + dwX1]);
-    for (dwY = dwY1; dwY <= dwY2; ++dwY) {
-        pDestFbBuffer = pFbBuffer;
-        while (blocks--) {
-            memcpy(pDestFbBuffer, gFbPixelCache, FB_COLOR_CACHE_SIZE * sizeof(LcdColor_t));
-            pDestFbBuffer += FB_COLOR_CACHE_SIZE;
+    if (!ClipBox(&x1, &y1, &x2, &y2))
+        return 0;
 
-        }
-       memcpy(pDestFbBuffer, gFbPixelCache, bytes * sizeof(LcdColor_t));
-       pFbBuffer += gucWidth;
-    }
+    WaitFlush();
+    for (y = y1; y <= y2; ++y)
+        FillSpan(x1, x2, y);
+    AddDirty(x1, y1, x2, y2);
 
     return 0;
 }
@@ -265,6 +412,7 @@ extern uint32_t FB_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t d
 /**
  * \brief Write several pixels pre-formatted in a bufer to FB.
  *
+ * The picture is clipped to the frame buffer.
  * \param dwX1      X-coordinate of upper-left corner on LCD.
  * \param dwY1      Y-coordinate of upper-left corner on LCD.
  * \param dwX2      X-coordinate of lower-right corner on LCD.
@@ -273,23 +421,35 @@ extern uint32_t FB_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t d
  */
 extern uint32_t FB_DrawPicture( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const void *pBuffer )
 {
+    int32_t x1 = dwX1, y1 = dwY1, x2 = dwX2, y2 = dwY2;
+    int32_t dwPicWidth, dwPicX, dwPicY;
+    const uint8_t *pSrc;
     LcdColor_t *pFbBuffer;
-    uint32_t dwY;
+    int32_t y;
+
+    /* Picture size and position before clipping */
+    dwPicX = (x1 < x2) ? x1 : x2;
+    dwPicY = (y1 < y2) ? y1 : y2;
+    dwPicWidth = ((x1 < x2) ? x2 - x1 : x1 - x2) + 1;
 
-    /* Swap coordinates if necessary */
-    CheckBoxCoordinates(&dwX1, &dwY1, &dwX2, &dwY2);
+    if (!ClipBox(&x1, &y1, &x2, &y2))
+        return 0;
 
-    pFbBuffer = &(gpBuffer[dwY1 * gucWidth + dwX1]);
-    for (dwY = dwY1; dwY <= dwY2; ++dwY) {
-       memcpy(pFbBuffer, pBuffer, (dwX2 - dwX1 + 1) * sizeof(LcdColor_t));
-       pFbBuffer += gucWidth;
+    WaitFlush();
+    pSrc = (const uint8_t *)pBuffer + ((y1 - dwPicY) * dwPicWidth + (x1 - dwPicX)) * sizeof(LcdColor_t);
+    pFbBuffer = &(gpBuffer[y1 * gdwWidth + x1]);
+    for (y = y1; y <= y2; ++y) {
+       memcpy(pFbBuffer, pSrc, (x2 - x1 + 1) * sizeof(LcdColor_t));
+       pFbBuffer += gdwWidth;
+       pSrc += dwPicWidth * sizeof(LcdColor_t);
     }
+    AddDirty(x1, y1, x2, y2);
 
     return 0 ;
 }
 
 /*
- * \brief Draw a line on LCD, horizontal and vertical line are supported.
+ * \brief Draw a line on FB.
  *
  * \param dwX1      X-coordinate of line start.
  * \param dwY1      Y-coordinate of line start.
@@ -305,7 +465,9 @@ extern uint32_t FB_DrawLine ( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint3
         FB_DrawFilledRectangle( dwX1, dwY1, dwX2, dwY2 );
     }
     else {
+        WaitFlush();
         DrawLineBresenham( dwX1, dwY1, dwX2, dwY2 ) ;
+        AddDirtyBox( dwX1, dwY1, dwX2, dwY2 ) ;
     }
 
     return 0 ;
@@ -325,26 +487,28 @@ extern uint32_t FB_DrawCircle(
         uint32_t dwY,
         uint32_t dwR)
 {
+    int32_t   x = dwX, y = dwY, r = dwR;
     int32_t   d;    /* Decision Variable */
-    uint32_t  curX; /* Current X Value */
-    uint32_t  curY; /* Current Y Value */
+    int32_t   curX; /* Current X Value */
+    int32_t   curY; /* Current Y Value */
 
     if (dwR == 0)
         return 0;
-    d = 3 - (dwR << 1);
+    WaitFlush();
+    d = 3 - (r << 1);
     curX = 0;
-    curY = dwR;
+    curY = r;
 
     while (curX <= curY)
     {
-        FB_DrawPixel(dwX + curX, dwY + curY);
-        FB_DrawPixel(dwX + curX, dwY - curY);
-        FB_DrawPixel(dwX - curX, dwY + curY);
-        FB_DrawPixel(dwX - curX, dwY - curY);
-        FB_DrawPixel(dwX + curY, dwY + curX);
-        FB_DrawPixel(dwX + curY, dwY - curX);
-        FB_DrawPixel(dwX - curY, dwY + curX);
-        FB_DrawPixel(dwX - curY, dwY - curX);
+        PutPixel(x + curX, y + curY);
+        PutPixel(x + curX, y - curY);
+        PutPixel(x - curX, y + curY);
+        PutPixel(x - curX, y - curY);
+        PutPixel(x + curY, y + curX);
+        PutPixel(x + curY, y - curX);
+        PutPixel(x - curY, y + curX);
+        PutPixel(x - curY, y - curX);
 
         if (d < 0) {
             d += (curX << 2) + 6;
@@ -355,12 +519,16 @@ extern uint32_t FB_DrawCircle(
         }
         curX++;
     }
+    AddDirtyBox(x - r, y - r, x + r, y + r);
+
     return 0;
 }
 
 /**
  * \brief Draws a filled circle in FB, at the given coordinates.
  *
+ * Each step of the midpoint algorithm fills four spans.
+ *
  * \param dwX      X-coordinate of circle center.
  * \param dwY      Y-coordinate of circle center.
  * \param dwR      circle radius.
@@ -369,48 +537,44 @@ extern uint32_t FB_DrawCircle(
 */
 extern uint32_t FB_DrawFilledCircle( uint32_t dwX, uint32_t dwY, uint32_t dwRadius)
 {
-    signed int d ; // Decision Variable
-    uint32_t dwCurX ; // Current X Value
-    uint32_t dwCurY ; // Current Y Value
-    uint32_t dwXmin, dwYmin;
+    int32_t x = dwX, y = dwY, r = dwRadius;
+    int32_t d ; // Decision Variable
+    int32_t curX ; // Current X Value
+    int32_t curY ; // Current Y Value
 
     if (dwRadius == 0)
         return 0;
-    d = 3 - (dwRadius << 1) ;
-    dwCurX = 0 ;
-    dwCurY = dwRadius ;
+    WaitFlush();
+    d = 3 - (r << 1) ;
+    curX = 0 ;
+    curY = r ;
 
-    while ( dwCurX <= dwCurY )
+    while ( curX <= curY )
     {
-        dwXmin = (dwCurX > dwX) ? 0 : dwX-dwCurX;
-        dwYmin = (dwCurY > dwY) ? 0 : dwY-dwCurY;
-        FB_DrawFilledRectangle( dwXmin, dwYmin, dwX+dwCurX, dwYmin ) ;
-        FB_DrawFilledRectangle( dwXmin, dwY+dwCurY, dwX+dwCurX, dwY+dwCurY ) ;
-        dwXmin = (dwCurY > dwX) ? 0 : dwX-dwCurY;
-        dwYmin = (dwCurX > dwY) ? 0 : dwY-dwCurX;
-        FB_DrawFilledRectangle( dwXmin, dwYmin, dwX+dwCurY, dwYmin ) ;
-        FB_DrawFilledRectangle( dwXmin, dwY+dwCurX, dwX+dwCurY, dwY+dwCurX ) ;
+        FillSpan( x - curX, x + curX, y - curY ) ;
+        FillSpan( x - curX, x + curX, y + curY ) ;
+        FillSpan( x - curY, x + curY, y - curX ) ;
+        FillSpan( x - curY, x + curY, y + curX ) ;
 
         if ( d < 0 )
         {
-            d += (dwCurX << 2) + 6 ;
+            d += (curX << 2) + 6 ;
         }
         else
         {
-            d += ((dwCurX - dwCurY) << 2) + 10;
-            dwCurY-- ;
+            d += ((curX - curY) << 2) + 10;
+            curY-- ;
         }
 
-        dwCurX++ ;
+        curX++ ;
     }
+    AddDirtyBox(x - r, y - r, x + r, y + r);
 
     return 0 ;
 }
 
 /**
-* Pixel color is set by the LCD_SetColor() function.
-* This function is optimized using an sram buffer to transfer block instead of
-* individual pixels in order to limit the number of SPI interrupts.
+* Pixel color is set by the FB_SetColor() function.
 * \param dwX1      X-coordinate of upper-left corner on LCD.
 * \param dwY1      Y-coordinate of upper-left corner on LCD.
 * \param dwX2      X-coordinate of lower-right corner on LCD.
@@ -420,8 +584,6 @@ extern uint32_t FB_DrawFilledCircle( uint32_t dwX, uint32_t dwY, uint32_t dwRadi
 */
 extern uint32_t FB_DrawRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 )
 {
-    CheckBoxCoordinates(&dwX1, &dwY1, &dwX2, &dwY2);
-
     FB_DrawFilledRectangle( dwX1, dwY1, dwX2, dwY1 ) ;
     FB_DrawFilledRectangle( dwX1, dwY2, dwX2, dwY2 ) ;
 
@@ -431,5 +593,28 @@ extern uint32_t FB_DrawRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, u
     return 0 ;
 }
 
+/**
+ * \brief Send the areas modified since the last flush to the panel.
+ *
+ * Each dirty rectangle is written through one LCD window, straight from the
+ * frame buffer. The last one may still be streamed by the DMAC when the
+ * function returns; the next drawing operation waits for it.
+ *
+ * \return Number of rectangles sent.
+ */
+extern uint32_t FB_Flush( void )
+{
+    FbRect *pRect;
+    uint32_t i;
+    uint32_t dwCount = gdwNumDirty;
+
+    for (i = 0; i < dwCount; i++) {
+        pRect = &gDirty[i];
+        LCD_DrawPictureStrideAsync(gdwPanelX + pRect->x1, gdwPanelY + pRect->y1,
+                                   gdwPanelX + pRect->x2, gdwPanelY + pRect->y2,
+                                   &gpBuffer[pRect->y1 * gdwWidth + pRect->x1], gdwWidth, 0, 0);
+    }
+    gdwNumDirty = 0;
 
-
+    return dwCount;
+}
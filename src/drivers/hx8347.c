@@ -52,6 +52,17 @@
 /// HX8347 ID code
 #define HX8347_HIMAXID_CODE    0x47
 
+/** Transfers below this number of pixels are written by the CPU */
+#define LCD_DMA_MIN_PIXELS      64
+/** Number of pixels moved by one descriptor (BTSIZE is 16-bit) */
+#define LCD_DMA_LLI_PIXELS      0x4000
+/** Number of descriptors in one chain */
+#define LCD_DMA_NUM_LLI         16
+/** Lowest address the DMAC can read (internal flash and ROM are excluded) */
+#define LCD_DMA_MIN_ADDRESS     0x20000000
+/** Channel interrupt sources used by the driver */
+#define LCD_DMA_IT_MASK         ((DMAC_EBCIER_CBTC0 | DMAC_EBCIER_ERR0) << BOARD_LCD_DMA_CHANNEL)
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
@@ -60,19 +71,55 @@
 /* Pixel cache used to speed up SPI communication */
 static LcdColor_t gLcdPixelCache[LCD_DATA_CACHE_SIZE];
 
+/* Descriptor chain streaming pixels to LCD_D */
+static DmaLinkList gLcdDmaLli[LCD_DMA_NUM_LLI];
+
+/* Transfer in progress: dwRows rows of dwRowPixels pixels, dwStride bytes apart */
+static struct
+{
+    uint32_t dwSrc ;
+    uint32_t dwStride ;
+    uint32_t dwRowPixels ;
+    uint32_t dwRowDone ;
+    uint32_t dwRows ;
+    uint8_t bFixedSrc ;
+} gLcdDmaXfr ;
+
+/* Fill color read by the DMAC with a fixed source address */
+static volatile LcdColor_t gwLcdDmaColor;
+
+/* Set while the DMAC owns the LCD bus */
+static volatile uint8_t gbLcdDmaBusy;
+
+/* Completion callback of the transfer in progress */
+static LcdDmaCallback gfLcdDmaCallback;
+static void* gpLcdDmaArg;
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
 
+/**
+ * \brief Wait until the DMAC has released the LCD bus.
+ */
+static inline void WaitDma( void )
+{
+    while ( gbLcdDmaBusy ) ;
+}
+
 /**
  * ----------------------------------------------------------------------------
  * \brief Send command to LCD controller.
  *
+ * Every access sequence starts with a command, so this is where a pending
+ * pixel transfer is waited for.
+ *
  * \param cmd   command.
  * ----------------------------------------------------------------------------
  */
 static inline void WriteCmd(uint8_t cmd)
 {
+    WaitDma() ;
     LCD_IR = cmd;
 }
 
@@ -85,6 +132,7 @@ static inline void WriteCmd(uint8_t cmd)
  */
 static inline uint32_t ReadCmd()
 {
+    WaitDma() ;
     return LCD_IR;
 }
 
@@ -126,6 +174,114 @@ static void WriteBuffer( const LcdColor_t *pBuf, uint32_t size )
     }
 }
 
+/**
+ * \brief Build and start the next descriptor chain of the current transfer.
+ *
+ * A descriptor never crosses a row, so rows of a strided source are chained
+ * one after the other; transfers longer than one chain are re-armed from the
+ * DMAC interrupt.
+ */
+static void StartChain( void )
+{
+    uint32_t dwChunk ;
+    uint32_t i ;
+
+    for ( i = 0 ; (i < LCD_DMA_NUM_LLI) && gLcdDmaXfr.dwRows ; i++ )
+    {
+        dwChunk = gLcdDmaXfr.dwRowPixels - gLcdDmaXfr.dwRowDone ;
+        if ( dwChunk > LCD_DMA_LLI_PIXELS )
+        {
+            dwChunk = LCD_DMA_LLI_PIXELS ;
+        }
+
+        gLcdDmaLli[i].sourceAddress = gLcdDmaXfr.dwSrc + (gLcdDmaXfr.bFixedSrc ? 0 : gLcdDmaXfr.dwRowDone * sizeof( LcdColor_t )) ;
+        gLcdDmaLli[i].destAddress = (uint32_t)&LCD_D ;
+        gLcdDmaLli[i].controlA = DMAC_CTRLA_BTSIZE( dwChunk )
+                               | DMAC_CTRLA_SCSIZE_CHK_1
+                               | DMAC_CTRLA_DCSIZE_CHK_1
+                               | DMAC_CTRLA_SRC_WIDTH_HALF_WORD
+                               | DMAC_CTRLA_DST_WIDTH_HALF_WORD ;
+        gLcdDmaLli[i].controlB = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM
+                               | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM
+                               | DMAC_CTRLB_FC_MEM2MEM_DMA_FC
+                               | (gLcdDmaXfr.bFixedSrc ? DMAC_CTRLB_SRC_INCR_FIXED : DMAC_CTRLB_SRC_INCR_INCREMENTING)
+                               | DMAC_CTRLB_DST_INCR_FIXED ;
+        gLcdDmaLli[i].descriptor = 0 ;
+        if ( i > 0 )
+        {
+            gLcdDmaLli[i - 1].descriptor = (uint32_t)&gLcdDmaLli[i] ;
+        }
+
+        gLcdDmaXfr.dwRowDone += dwChunk ;
+        if ( gLcdDmaXfr.dwRowDone == gLcdDmaXfr.dwRowPixels )
+        {
+            gLcdDmaXfr.dwRowDone = 0 ;
+            gLcdDmaXfr.dwRows-- ;
+            if ( !gLcdDmaXfr.bFixedSrc )
+            {
+                gLcdDmaXfr.dwSrc += gLcdDmaXfr.dwStride ;
+            }
+        }
+    }
+
+    DMA_DisableChannel( DMAC, BOARD_LCD_DMA_CHANNEL ) ;
+
+    DMA_SetSourceAddr( DMAC, BOARD_LCD_DMA_CHANNEL, gLcdDmaLli[0].sourceAddress ) ;
+    DMA_SetDestinationAddr( DMAC, BOARD_LCD_DMA_CHANNEL, gLcdDmaLli[0].destAddress ) ;
+    DMA_SetDescriptorAddr( DMAC, BOARD_LCD_DMA_CHANNEL, (uint32_t)&gLcdDmaLli[0] ) ;
+    DMA_SetSourceBufferMode( DMAC, BOARD_LCD_DMA_CHANNEL, DMA_TRANSFER_LLI,
+                             (gLcdDmaXfr.bFixedSrc ? DMAC_CTRLB_SRC_INCR_FIXED : DMAC_CTRLB_SRC_INCR_INCREMENTING) >> 24 ) ;
+    DMA_SetDestBufferMode( DMAC, BOARD_LCD_DMA_CHANNEL, DMA_TRANSFER_LLI, DMAC_CTRLB_DST_INCR_FIXED >> 28 ) ;
+    DMA_SetFlowControl( DMAC, BOARD_LCD_DMA_CHANNEL, DMAC_CTRLB_FC_MEM2MEM_DMA_FC >> 21 ) ;
+    DMA_SetConfiguration( DMAC, BOARD_LCD_DMA_CHANNEL, DMAC_CFG_SRC_H2SEL_SW
+                                                     | DMAC_CFG_DST_H2SEL_SW
+                                                     | DMAC_CFG_SOD_DISABLE
+                                                     | DMAC_CFG_AHB_PROT( 1 )
+                                                     | DMAC_CFG_FIFOCFG_ALAP_CFG ) ;
+
+    DMA_EnableIt( DMAC, LCD_DMA_IT_MASK ) ;
+    DMA_EnableChannel( DMAC, BOARD_LCD_DMA_CHANNEL ) ;
+}
+
+/**
+ * \brief Stream pixels to LCD GRAM with the DMAC (memory to SMC, halfwords).
+ *
+ * GRAM writing must have been prepared (window, cursor and R22H). The window
+ * is reset to the full screen and the callback invoked from the DMAC
+ * interrupt once the last pixel is written.
+ *
+ * \param pSrc        First pixel, or the fill color when dwFixedSrc is set.
+ * \param dwRowPixels Number of pixels per row.
+ * \param dwRows      Number of rows.
+ * \param dwStride    Distance between two source rows, in pixels.
+ * \param dwFixedSrc  1 to write *pSrc for every pixel (fill), 0 to increment.
+ * \param fCallback   Optional completion callback.
+ * \param pArg        Callback argument.
+ */
+static void StartDma( const LcdColor_t *pSrc, uint32_t dwRowPixels, uint32_t dwRows, uint32_t dwStride,
+                      uint32_t dwFixedSrc, LcdDmaCallback fCallback, void* pArg )
+{
+    /* Contiguous rows are moved as a single run */
+    if ( dwFixedSrc || (dwStride == dwRowPixels) )
+    {
+        dwRowPixels *= dwRows ;
+        dwRows = 1 ;
+    }
+
+    gLcdDmaXfr.dwSrc = (uint32_t)pSrc ;
+    gLcdDmaXfr.dwStride = dwStride * sizeof( LcdColor_t ) ;
+    gLcdDmaXfr.dwRowPixels = dwRowPixels ;
+    gLcdDmaXfr.dwRowDone = 0 ;
+    gLcdDmaXfr.dwRows = dwRows ;
+    gLcdDmaXfr.bFixedSrc = dwFixedSrc ;
+
+    gfLcdDmaCallback = fCallback ;
+    gpLcdDmaArg = pArg ;
+    gbLcdDmaBusy = 1 ;
+
+    StartChain() ;
+}
+
 /**
  * ----------------------------------------------------------------------------
  * \brief Write data to LCD Register.
@@ -269,6 +425,7 @@ extern uint32_t LCD_Initialize( void )
 
     const Pin pPins[] = {BOARD_LCD_PINS};
     SmcCs_number *pSmcCs = &(SMC->SMC_CS_NUMBER[BOARD_LCD_NCS]);
+    PROF_SCOPE( PROF_LCD_INIT ) ;
 
     // Enable pins
     PIO_Configure( pPins, PIO_LISTSIZE( pPins ) ) ;
@@ -282,6 +439,10 @@ extern uint32_t LCD_Initialize( void )
     pSmcCs->SMC_CYCLE = BOARD_LCD_CYCLE ;
     pSmcCs->SMC_MODE  = BOARD_LCD_MODE ;
 
+    /* DMAC channel streaming the pixels */
+    DMAD_Initialize( BOARD_LCD_DMA_CHANNEL, DMAD_USE_DEFAULT_IT ) ;
+    gbLcdDmaBusy = 0 ;
+
     /* Turn off LCD */
     LCD_Off() ;
 
@@ -446,20 +607,27 @@ extern uint32_t LCD_DrawPixel( uint32_t x, uint32_t y )
 
 /**
  * ----------------------------------------------------------------------------
- * \brief Write several pixels with the same color to LCD GRAM.
+ * \brief Start writing several pixels with the same color to LCD GRAM.
  *
- * LcdColor_t color is set by the LCD_SetColor() function.
- * This function is optimized using an sram buffer to transfer block instead of
- * individual pixels in order to limit the number of SPI interrupts.
+ * LcdColor_t color is set by the LCD_SetColor() function; it is latched when
+ * the transfer starts, so the color can be changed right after the call.
+ * Large areas are filled by the DMAC from a fixed source address and the
+ * function returns as soon as the transfer is started; the next LCD access
+ * waits for its end.
  * \param dwX1      X-coordinate of upper-left corner on LCD.
  * \param dwY1      Y-coordinate of upper-left corner on LCD.
  * \param dwX2      X-coordinate of lower-right corner on LCD.
  * \param dwY2      Y-coordinate of lower-right corner on LCD.
+ * \param fCallback Optional completion callback.
+ * \param pArg      Callback argument.
+ * \return 1 if the DMAC is filling the area, 0 if the fill is already done.
  * ----------------------------------------------------------------------------
  */
-extern uint32_t LCD_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 )
+extern uint32_t LCD_DrawFilledRectangleAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2,
+                                              LcdDmaCallback fCallback, void* pArg )
 {
-    uint32_t size, blocks ;
+    uint32_t size ;
+    PROF_SCOPE( PROF_LCD_FILL ) ;
 
     /* Swap coordinates if necessary */
     CheckBoundaries( &dwX1, &dwY1, &dwX2, &dwY2 ) ;
@@ -474,34 +642,72 @@ extern uint32_t LCD_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t
     WriteCmd( HX8347_R22H ) ;
 
     size = (dwX2 - dwX1 + 1) * (dwY2 - dwY1 + 1) ;
-    /* Send pixels blocks => one SPI IT / block */
-    blocks = size / LCD_DATA_CACHE_SIZE ;
-    while ( blocks-- )
+    if ( size >= LCD_DMA_MIN_PIXELS )
     {
-        WriteBuffer( gLcdPixelCache, LCD_DATA_CACHE_SIZE ) ;
+        gwLcdDmaColor = gLcdPixelCache[0] ;
+        StartDma( (const LcdColor_t*)&gwLcdDmaColor, size, 1, 0, 1, fCallback, pArg ) ;
+
+        return 1 ;
     }
-    /* Send remaining pixels */
-    WriteBuffer( gLcdPixelCache, size % LCD_DATA_CACHE_SIZE ) ;
+
+    WriteBuffer( gLcdPixelCache, size ) ;
 
     /* Reset the refresh window area */
     LCD_SetWindow( 0, 0, BOARD_LCD_WIDTH - 1, BOARD_LCD_HEIGHT - 1 ) ;
 
+    if ( fCallback )
+    {
+        fCallback( pArg, LCD_DMA_STATUS_SUCCESS ) ;
+    }
+
     return 0 ;
 }
 
 /**
- * \brief Write several pixels pre-formatted in a bufer to LCD GRAM.
+ * ----------------------------------------------------------------------------
+ * \brief Write several pixels with the same color to LCD GRAM.
  *
+ * LcdColor_t color is set by the LCD_SetColor() function.
  * \param dwX1      X-coordinate of upper-left corner on LCD.
  * \param dwY1      Y-coordinate of upper-left corner on LCD.
  * \param dwX2      X-coordinate of lower-right corner on LCD.
  * \param dwY2      Y-coordinate of lower-right corner on LCD.
- * \param pBuffer   LcdColor_t buffer area.
+ * ----------------------------------------------------------------------------
  */
-extern uint32_t LCD_DrawPicture( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer )
+extern uint32_t LCD_DrawFilledRectangle( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2 )
+{
+    LCD_DrawFilledRectangleAsync( dwX1, dwY1, dwX2, dwY2, 0, 0 ) ;
+    WaitDma() ;
+
+    return 0 ;
+}
+
+/**
+ * \brief Start writing a rectangle of a larger pixel buffer to LCD GRAM.
+ *
+ * The rows are read dwStride pixels apart, so a region of a frame buffer is
+ * sent through one LCD window without being copied first. Buffers in SRAM
+ * or SDRAM are streamed by the DMAC straight from their location and the
+ * function returns as soon as the transfer is started; the buffer must not
+ * be modified before the completion. Buffers in internal flash and small
+ * areas are written by the CPU before the function returns.
+ *
+ * \param dwX1      X-coordinate of upper-left corner on LCD.
+ * \param dwY1      Y-coordinate of upper-left corner on LCD.
+ * \param dwX2      X-coordinate of lower-right corner on LCD.
+ * \param dwY2      Y-coordinate of lower-right corner on LCD.
+ * \param pBuffer   First pixel of the rectangle.
+ * \param dwStride  Distance between two rows of pBuffer in pixels, 0 if the
+ *                  rows are contiguous.
+ * \param fCallback Optional completion callback.
+ * \param pArg      Callback argument.
+ * \return 1 if the DMAC is writing the pixels, 0 if they are already written.
+ */
+extern uint32_t LCD_DrawPictureStrideAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer,
+                                            uint32_t dwStride, LcdDmaCallback fCallback, void* pArg )
 {
-    uint32_t size, blocks ;
-    LcdColor_t currentColor ;
+    uint32_t width, height, row ;
+    PROF_SCOPE( PROF_LCD_PICTURE ) ;
 
     /* Swap coordinates if necessary */
     CheckBoundaries( &dwX1, &dwY1, &dwX2, &dwY2 ) ;
@@ -515,40 +721,132 @@ extern uint32_t LCD_DrawPicture( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, ui
     /* Prepare to write in GRAM */
     WriteCmd( HX8347_R22H ) ;
 
-    size = (dwX2 - dwX1 + 1) * (dwY2 - dwY1 + 1) ;
-    /* Check if the buffer is within the SRAM */
-    if ( (IRAM0_ADDR <= (uint32_t)pBuffer) && ((uint32_t)pBuffer < NFC_RAM_ADDR) )
+    width = dwX2 - dwX1 + 1 ;
+    height = dwY2 - dwY1 + 1 ;
+    if ( dwStride == 0 )
     {
-        WriteBuffer( pBuffer, size ) ;
+        dwStride = width ;
     }
-    /* If the buffer is not in SRAM, transfer it in SRAM first before transfer */
-    else
+
+    if ( (width * height >= LCD_DMA_MIN_PIXELS) && ((uint32_t)pBuffer >= LCD_DMA_MIN_ADDRESS) )
     {
-        /* Use color buffer as a cache */
-        currentColor = gLcdPixelCache[0];
-        /* Send pixels blocks => one SPI IT / block */
-        blocks = size / LCD_DATA_CACHE_SIZE;
-        while ( blocks-- )
-        {
-            memcpy( gLcdPixelCache, pBuffer, LCD_DATA_CACHE_SIZE * sizeof( LcdColor_t ) ) ;
-            WriteBuffer( gLcdPixelCache, LCD_DATA_CACHE_SIZE ) ;
-            pBuffer += LCD_DATA_CACHE_SIZE ;
-        }
+        StartDma( pBuffer, width, height, dwStride, 0, fCallback, pArg ) ;
 
-        /* Send remaining pixels */
-        memcpy( gLcdPixelCache, pBuffer, (size % LCD_DATA_CACHE_SIZE) * sizeof( LcdColor_t ) ) ;
-        WriteBuffer( gLcdPixelCache, size % LCD_DATA_CACHE_SIZE ) ;
+        return 1 ;
+    }
 
-        /* Restore the color cache */
-        LCD_SetColor( currentColor ) ;
+    for ( row = 0 ; row < height ; row++ )
+    {
+        WriteBuffer( pBuffer + row * dwStride, width ) ;
     }
 
     /* Reset the refresh window area */
     LCD_SetWindow( 0, 0, BOARD_LCD_WIDTH - 1, BOARD_LCD_HEIGHT - 1 ) ;
 
+    if ( fCallback )
+    {
+        fCallback( pArg, LCD_DMA_STATUS_SUCCESS ) ;
+    }
+
+    return 0 ;
+}
+
+/**
+ * \brief Start writing several pixels pre-formatted in a buffer to LCD GRAM.
+ *
+ * See LCD_DrawPictureStrideAsync(), with contiguous rows.
+ *
+ * \param dwX1      X-coordinate of upper-left corner on LCD.
+ * \param dwY1      Y-coordinate of upper-left corner on LCD.
+ * \param dwX2      X-coordinate of lower-right corner on LCD.
+ * \param dwY2      Y-coordinate of lower-right corner on LCD.
+ * \param pBuffer   LcdColor_t buffer area.
+ * \param fCallback Optional completion callback.
+ * \param pArg      Callback argument.
+ * \return 1 if the DMAC is writing the pixels, 0 if they are already written.
+ */
+extern uint32_t LCD_DrawPictureAsync( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer,
+                                      LcdDmaCallback fCallback, void* pArg )
+{
+    return LCD_DrawPictureStrideAsync( dwX1, dwY1, dwX2, dwY2, pBuffer, 0, fCallback, pArg ) ;
+}
+
+/**
+ * \brief Write several pixels pre-formatted in a bufer to LCD GRAM.
+ *
+ * \param dwX1      X-coordinate of upper-left corner on LCD.
+ * \param dwY1      Y-coordinate of upper-left corner on LCD.
+ * \param dwX2      X-coordinate of lower-right corner on LCD.
+ * \param dwY2      Y-coordinate of lower-right corner on LCD.
+ * \param pBuffer   LcdColor_t buffer area.
+ */
+extern uint32_t LCD_DrawPicture( uint32_t dwX1, uint32_t dwY1, uint32_t dwX2, uint32_t dwY2, const LcdColor_t *pBuffer )
+{
+    LCD_DrawPictureAsync( dwX1, dwY1, dwX2, dwY2, pBuffer, 0, 0 ) ;
+    WaitDma() ;
+
     return 0 ;
 }
 
+/**
+ * \brief Return 1 if no pixel transfer is pending, 0 otherwise.
+ */
+extern uint32_t LCD_IsFinished( void )
+{
+    return (gbLcdDmaBusy == 0) ;
+}
+
+/**
+ * \brief Wait until the pending pixel transfer (if any) is done.
+ */
+extern void LCD_Wait( void )
+{
+    WaitDma() ;
+}
+
+/**
+ * \brief LCD channel part of the DMAC interrupt handler.
+ *
+ * Called by DMAC_IrqHandler() with the (read-to-clear) interrupt status.
+ *
+ * \param dwStatus  Value read from DMAC_EBCISR.
+ */
+extern void LCD_DmaHandler( uint32_t dwStatus )
+{
+    LcdDmaCallback fCallback = gfLcdDmaCallback ;
+    uint32_t dwResult = LCD_DMA_STATUS_SUCCESS ;
+
+    if ( !gbLcdDmaBusy || !(dwStatus & LCD_DMA_IT_MASK) )
+    {
+        return ;
+    }
+
+    if ( dwStatus & (DMAC_EBCISR_ERR0 << BOARD_LCD_DMA_CHANNEL) )
+    {
+        TRACE_ERROR( "LCD: DMA AHB error\n\r" ) ;
+        dwResult = LCD_DMA_STATUS_ERROR ;
+    }
+    else if ( gLcdDmaXfr.dwRows )
+    {
+        StartChain() ;
+        return ;
+    }
+
+    DMA_DisableIt( DMAC, LCD_DMA_IT_MASK ) ;
+    DMA_DisableChannel( DMAC, BOARD_LCD_DMA_CHANNEL ) ;
+
+    gfLcdDmaCallback = 0 ;
+    gbLcdDmaBusy = 0 ;
+
+    /* Reset the refresh window area */
+    LCD_SetWindow( 0, 0, BOARD_LCD_WIDTH - 1, BOARD_LCD_HEIGHT - 1 ) ;
+
+    if ( fCallback )
+    {
+        fCallback( gpLcdDmaArg, dwResult ) ;
+    }
+}
+
 /*
  * \brief Draw a line on LCD, which is not horizontal or vertical.
  *
@@ -43,6 +43,17 @@
 #include <stdint.h>
 #include <assert.h>
 
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Glyph size in pixels */
+#define FONT_WIDTH          10
+#define FONT_HEIGHT         14
+/** Characters of pCharset10x14 (0x20 to 0x7F) */
+#define FONT_FIRST_CHAR     0x20
+#define FONT_NUM_CHARS      96
+
 /*----------------------------------------------------------------------------
  *        Local variables
  *----------------------------------------------------------------------------*/
@@ -50,6 +61,55 @@
 /** Global variable describing the font being instancied. */
 const Font gFont = {10, 14};
 
+/** Glyphs expanded to one row mask per row (bit FONT_WIDTH-1 is the left column) */
+static uint16_t gGlyphRows[FONT_NUM_CHARS][FONT_HEIGHT] ;
+static uint8_t gbGlyphsExpanded ;
+
+/** Glyph pixel buffers: one is streamed to the LCD while the next glyph is
+    expanded in the other */
+static LcdColor_t gGlyphPixels[2][FONT_WIDTH * FONT_HEIGHT] ;
+static uint32_t gdwGlyphBuffer ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Return the row masks of a character.
+ *
+ * pCharset10x14 is stored column by column (two bytes per column, MSB on
+ * top); it is transposed once into row masks so that a glyph can be written
+ * in the LCD scanning order.
+ *
+ * \param c  Character.
+ */
+static const uint16_t* GetGlyph( uint8_t c )
+{
+    uint32_t ch, row, col ;
+    uint32_t dwBits ;
+
+    if ( !gbGlyphsExpanded )
+    {
+        for ( ch = 0 ; ch < FONT_NUM_CHARS ; ch++ )
+        {
+            for ( col = 0 ; col < FONT_WIDTH ; col++ )
+            {
+                dwBits = (pCharset10x14[ch * 20 + col * 2] << 8) | pCharset10x14[ch * 20 + col * 2 + 1] ;
+                for ( row = 0 ; row < FONT_HEIGHT ; row++ )
+                {
+                    if ( (dwBits >> (15 - row)) & 0x1 )
+                    {
+                        gGlyphRows[ch][row] |= 1 << (FONT_WIDTH - 1 - col) ;
+                    }
+                }
+            }
+        }
+        gbGlyphsExpanded = 1 ;
+    }
+
+    return gGlyphRows[c - FONT_FIRST_CHAR] ;
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -57,32 +117,46 @@ const Font gFont = {10, 14};
 /**
  * \brief Draws an ASCII character on LCD.
  *
+ * The background is left untouched: each horizontal run of set pixels is
+ * written with one cursor setting. Characters not entirely on the screen
+ * are not drawn.
+ *
  * \param x  X-coordinate of character upper-left corner.
  * \param y  Y-coordinate of character upper-left corner.
  * \param c  Character to output.
- * \param color  Character color.
+ * \param color  Character color (24-bit RGB).
  */
 extern void LCDD_DrawChar( uint32_t x, uint32_t y, uint8_t c, uint32_t color )
 {
-    uint32_t row, col ;
+    const uint16_t* pRows ;
+    LcdColor_t wColor = RGB24ToRGB16( color ) ;
+    uint32_t row, col, end ;
 
     assert( (c >= 0x20) && (c <= 0x7F) ) ;
 
-    for ( col = 0 ; col < 10 ; col++ )
+    if ( (x + FONT_WIDTH > BOARD_LCD_WIDTH) || (y + FONT_HEIGHT > BOARD_LCD_HEIGHT) )
+    {
+        return ;
+    }
+
+    pRows = GetGlyph( c ) ;
+    for ( row = 0 ; row < FONT_HEIGHT ; row++ )
     {
-        for ( row = 0 ; row < 8 ; row++ )
+        for ( col = 0 ; col < FONT_WIDTH ; col = end )
         {
-            if ( (pCharset10x14[((c - 0x20) * 20) + col * 2] >> (7 - row)) & 0x1 )
+            /* Skip the background, then find the end of the run */
+            if ( !((pRows[row] >> (FONT_WIDTH - 1 - col)) & 0x1) )
             {
-                LCDD_DrawPixel( x+col, y+row, color ) ;
+                end = col + 1 ;
+                continue ;
             }
-        }
+            for ( end = col ; (end < FONT_WIDTH) && ((pRows[row] >> (FONT_WIDTH - 1 - end)) & 0x1) ; end++ ) ;
 
-        for (row = 0; row < 6; row++ )
-        {
-            if ((pCharset10x14[((c - 0x20) * 20) + col * 2 + 1] >> (7 - row)) & 0x1)
+            LCD_SetCursor( x + col, y + row ) ;
+            LCD_WriteRAM_Prepare() ;
+            while ( col++ < end )
             {
-                LCDD_DrawPixel( x+col, y+row+8, color ) ;
+                LCD_D = wColor ;
             }
         }
     }
@@ -91,43 +165,44 @@ extern void LCDD_DrawChar( uint32_t x, uint32_t y, uint8_t c, uint32_t color )
 /**
  * \brief Draws an ASCII character on LCD with given background color.
  *
+ * The glyph is expanded into a pixel buffer and written through one LCD
+ * window in a single burst. The burst is streamed by the DMAC: the function
+ * returns before it is done and the next character is expanded meanwhile.
+ * Characters not entirely on the screen are not drawn.
+ *
  * \param x          X-coordinate of character upper-left corner.
  * \param y          Y-coordinate of character upper-left corner.
  * \param c          Character to output.
- * \param fontColor  Character color.
- * \param bgColor    Background color.
+ * \param fontColor  Character color (24-bit RGB).
+ * \param bgColor    Background color (24-bit RGB).
  */
 extern void LCDD_DrawCharWithBGColor( uint32_t x, uint32_t y, uint8_t c, uint32_t fontColor, uint32_t bgColor )
 {
+    const uint16_t* pRows ;
+    LcdColor_t wFont = RGB24ToRGB16( fontColor ) ;
+    LcdColor_t wBg = RGB24ToRGB16( bgColor ) ;
+    LcdColor_t* pPixel ;
     uint32_t row, col ;
 
     assert( (c >= 0x20) && (c <= 0x7F) ) ;
 
-    for (col = 0; col < 10; col++)
+    if ( (x + FONT_WIDTH > BOARD_LCD_WIDTH) || (y + FONT_HEIGHT > BOARD_LCD_HEIGHT) )
     {
-        for (row = 0 ; row < 8 ; row++)
-        {
-            if ( (pCharset10x14[((c - 0x20) * 20) + col * 2] >> (7 - row)) & 0x1 )
-            {
-                LCDD_DrawPixel( x+col, y+row, fontColor ) ;
-            }
-            else
-            {
-                LCDD_DrawPixel( x+col, y+row, bgColor ) ;
-            }
-        }
+        return ;
+    }
 
-        for ( row = 0 ; row < 6 ; row++ )
+    /* The other buffer may still be streamed, this one is free */
+    gdwGlyphBuffer ^= 1 ;
+    pPixel = gGlyphPixels[gdwGlyphBuffer] ;
+
+    pRows = GetGlyph( c ) ;
+    for ( row = 0 ; row < FONT_HEIGHT ; row++ )
+    {
+        for ( col = 0 ; col < FONT_WIDTH ; col++ )
         {
-            if ( (pCharset10x14[((c - 0x20) * 20) + col * 2 + 1] >> (7 - row)) & 0x1 )
-            {
-                LCDD_DrawPixel( x+col, y+row+8, fontColor ) ;
-            }
-            else
-            {
-                LCDD_DrawPixel( x+col, y+row+8, bgColor ) ;
-            }
+            *pPixel++ = ((pRows[row] >> (FONT_WIDTH - 1 - col)) & 0x1) ? wFont : wBg ;
         }
     }
-}
 
+    LCD_DrawPictureAsync( x, y, x + FONT_WIDTH - 1, y + FONT_HEIGHT - 1, gGlyphPixels[gdwGlyphBuffer], 0, 0 ) ;
+}
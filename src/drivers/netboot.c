@@ -0,0 +1,924 @@
+/**
+ * \file
+ *
+ * Implementation of the network boot client.
+ *
+ * The client runs a single TFTP transfer at a time, in polling mode. The
+ * acknowledges are only sent with the receiver paused and every frame it
+ * stored taken in, so that the slots of the next window are laid out from
+ * the descriptor where the receiver resumes and are not touched while the
+ * EMAC may use them: a descriptor gets its own buffer back as soon as its
+ * frame has been read.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "netboot.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Ethernet */
+#define NETBOOT_ETH_HEADER      14
+#define NETBOOT_ETH_MIN_FRAME   60
+#define NETBOOT_ETH_IP          0x0800
+#define NETBOOT_ETH_ARP         0x0806
+
+/** ARP */
+#define NETBOOT_ARP_SIZE        28
+#define NETBOOT_ARP_REQUEST     1
+#define NETBOOT_ARP_REPLY       2
+
+/** IPv4 and UDP, without IP options */
+#define NETBOOT_IP_HEADER       20
+#define NETBOOT_IP_UDP          17
+#define NETBOOT_UDP_HEADER      8
+#define NETBOOT_UDP_OFFSET      (NETBOOT_ETH_HEADER + NETBOOT_IP_HEADER)
+#define NETBOOT_DATA_OFFSET     (NETBOOT_UDP_OFFSET + NETBOOT_UDP_HEADER)
+
+/** TFTP */
+#define NETBOOT_TFTP_PORT       69
+#define NETBOOT_TFTP_RRQ        1
+#define NETBOOT_TFTP_DATA       3
+#define NETBOOT_TFTP_ACK        4
+#define NETBOOT_TFTP_ERROR      5
+#define NETBOOT_TFTP_OACK       6
+#define NETBOOT_TFTP_HEADER     4
+#define NETBOOT_TFTP_DISK_FULL  3
+#define NETBOOT_TFTP_BLOCK_SIZE 512
+#define NETBOOT_MAX_NAME        128
+
+/** Data bytes of a DATA frame stored in its first buffer */
+#define NETBOOT_HEAD            (NETBOOT_RX_UNITSIZE - NETBOOT_RX_OFFSET - NETBOOT_DATA_OFFSET - NETBOOT_TFTP_HEADER)
+
+/** Slot tag of the descriptors pointing at the destination */
+#define NETBOOT_SLOT_DIRECT     0x80000000u
+
+/** Descriptors left to the other frames when the slots are laid out */
+#define NETBOOT_RX_SPARE        16
+
+/** Local ports, one per transfer */
+#define NETBOOT_PORT_BASE       49152
+#define NETBOOT_PORT_COUNT      16384
+
+/** Transfer states */
+#define NETBOOT_IDLE            0
+#define NETBOOT_REQUEST         1
+#define NETBOOT_DATA            2
+#define NETBOOT_DONE            3
+#define NETBOOT_FAILED          4
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static const uint8_t gpNetbootBroadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint32_t _Get16( const uint8_t* pData )
+{
+    return ((uint32_t)pData[0] << 8) | pData[1] ;
+}
+
+static uint32_t _Get32( const uint8_t* pData )
+{
+    return ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) | ((uint32_t)pData[2] << 8) | pData[3] ;
+}
+
+static void _Put16( uint8_t* pData, uint32_t dwValue )
+{
+    pData[0] = (uint8_t)(dwValue >> 8) ;
+    pData[1] = (uint8_t)dwValue ;
+}
+
+static void _Put32( uint8_t* pData, uint32_t dwValue )
+{
+    _Put16( pData, dwValue >> 16 ) ;
+    _Put16( pData + 2, dwValue ) ;
+}
+
+/**
+ * \brief Add 16-bit big endian words to a ones' complement sum.
+ */
+static uint32_t _Sum( const uint8_t* pData, uint32_t dwSize, uint32_t dwSum )
+{
+    for ( ; dwSize > 1 ; dwSize -= 2, pData += 2 )
+    {
+        dwSum += _Get16( pData ) ;
+    }
+    if ( dwSize )
+    {
+        dwSum += (uint32_t)pData[0] << 8 ;
+    }
+
+    return dwSum ;
+}
+
+/**
+ * \brief Fold a ones' complement sum into an Internet checksum.
+ */
+static uint32_t _Checksum( uint32_t dwSum )
+{
+    while ( dwSum >> 16 )
+    {
+        dwSum = (dwSum & 0xFFFF) + (dwSum >> 16) ;
+    }
+
+    return ~dwSum & 0xFFFF ;
+}
+
+/** Address of a buffer in a descriptor: the host build maps its memory below 4 GB */
+static uint32_t _DmaAddress( const void* pBuffer )
+{
+    return (uint32_t)(uintptr_t)pBuffer ;
+}
+
+static uint8_t* _DmaBuffer( uint32_t dwAddress )
+{
+    return (uint8_t*)(uintptr_t)(dwAddress & NETBOOT_RX_ADDRESS) ;
+}
+
+/**
+ * \brief Append a string and its terminating null to a TFTP packet.
+ *
+ * \return the number of bytes appended.
+ */
+static uint32_t _PutString( uint8_t* pData, const char* pString )
+{
+    uint32_t dwSize = strlen( pString ) + 1 ;
+
+    memcpy( pData, pString, dwSize ) ;
+
+    return dwSize ;
+}
+
+/**
+ * \brief Compare a TFTP option name, ignoring the case.
+ */
+static uint32_t _IsOption( const char* pName, const char* pOption )
+{
+    for ( ; *pOption ; pName++, pOption++ )
+    {
+        if ( (*pName | 0x20) != *pOption )
+        {
+            return 0 ;
+        }
+    }
+
+    return *pName == 0 ;
+}
+
+/**
+ * \brief Parse a decimal TFTP option value.
+ *
+ * \return the value, 0xFFFFFFFF if it is not a number.
+ */
+static uint32_t _ParseNumber( const char* pValue )
+{
+    uint32_t dwValue = 0 ;
+
+    if ( *pValue == 0 )
+    {
+        return 0xFFFFFFFF ;
+    }
+    for ( ; *pValue ; pValue++ )
+    {
+        if ( (*pValue < '0') || (*pValue > '9') || (dwValue > 0x0FFFFFFF) )
+        {
+            return 0xFFFFFFFF ;
+        }
+        dwValue = dwValue * 10 + (*pValue - '0') ;
+    }
+
+    return dwValue ;
+}
+
+/**
+ * \brief Send the frame built in pNet->pTx, the payload after the Ethernet header.
+ */
+static void _SendEthernet( Netboot* pNet, const uint8_t* pDest, uint32_t dwType, uint32_t dwSize )
+{
+    const NetbootDevice* pDevice = pNet->pDevice ;
+
+    memcpy( pNet->pTx, pDest, 6 ) ;
+    memcpy( pNet->pTx + 6, pNet->pMac, 6 ) ;
+    _Put16( pNet->pTx + 12, dwType ) ;
+    dwSize += NETBOOT_ETH_HEADER ;
+    if ( dwSize < NETBOOT_ETH_MIN_FRAME )
+    {
+        memset( pNet->pTx + dwSize, 0, NETBOOT_ETH_MIN_FRAME - dwSize ) ;
+        dwSize = NETBOOT_ETH_MIN_FRAME ;
+    }
+
+    pDevice->fSend( pDevice->pArg, pNet->pTx, dwSize ) ;
+}
+
+/**
+ * \brief Send an ARP request (to the broadcast address) or reply.
+ */
+static void _SendArp( Netboot* pNet, uint32_t dwOperation, const uint8_t* pTargetMac, uint32_t dwTargetIp )
+{
+    uint8_t* pArp = pNet->pTx + NETBOOT_ETH_HEADER ;
+
+    _Put16( pArp, 1 ) ;
+    _Put16( pArp + 2, NETBOOT_ETH_IP ) ;
+    pArp[4] = 6 ;
+    pArp[5] = 4 ;
+    _Put16( pArp + 6, dwOperation ) ;
+    memcpy( pArp + 8, pNet->pMac, 6 ) ;
+    _Put32( pArp + 14, pNet->dwIp ) ;
+    memcpy( pArp + 18, pTargetMac, 6 ) ;
+    _Put32( pArp + 24, dwTargetIp ) ;
+
+    _SendEthernet( pNet, (dwOperation == NETBOOT_ARP_REQUEST) ? gpNetbootBroadcast : pTargetMac, NETBOOT_ETH_ARP, NETBOOT_ARP_SIZE ) ;
+}
+
+/**
+ * \brief Send a UDP datagram to the server, the payload built at
+ * pNet->pTx + NETBOOT_DATA_OFFSET.
+ */
+static void _SendUdp( Netboot* pNet, uint32_t dwPort, uint32_t dwSize )
+{
+    uint8_t* pIp = pNet->pTx + NETBOOT_ETH_HEADER ;
+    uint8_t* pUdp = pNet->pTx + NETBOOT_UDP_OFFSET ;
+    uint32_t dwUdpSize = NETBOOT_UDP_HEADER + dwSize ;
+    uint32_t dwSum ;
+
+    pIp[0] = 0x45 ;
+    pIp[1] = 0 ;
+    _Put16( pIp + 2, NETBOOT_IP_HEADER + dwUdpSize ) ;
+    _Put16( pIp + 4, pNet->wIpId++ ) ;
+    _Put16( pIp + 6, 0x4000 ) ;
+    pIp[8] = 64 ;
+    pIp[9] = NETBOOT_IP_UDP ;
+    _Put16( pIp + 10, 0 ) ;
+    _Put32( pIp + 12, pNet->dwIp ) ;
+    _Put32( pIp + 16, pNet->dwServer ) ;
+    _Put16( pIp + 10, _Checksum( _Sum( pIp, NETBOOT_IP_HEADER, 0 ) ) ) ;
+
+    _Put16( pUdp, pNet->wPort ) ;
+    _Put16( pUdp + 2, dwPort ) ;
+    _Put16( pUdp + 4, dwUdpSize ) ;
+    _Put16( pUdp + 6, 0 ) ;
+    /* Pseudo header: addresses, protocol and length */
+    dwSum = _Sum( pIp + 12, 8, NETBOOT_IP_UDP + dwUdpSize ) ;
+    dwSum = _Checksum( _Sum( pUdp, dwUdpSize, dwSum ) ) ;
+    _Put16( pUdp + 6, dwSum ? dwSum : 0xFFFF ) ;
+
+    _SendEthernet( pNet, pNet->pServerMac, NETBOOT_ETH_IP, NETBOOT_IP_HEADER + dwUdpSize ) ;
+}
+
+/**
+ * \brief Send the read request of an image with the options.
+ */
+static void _SendRequest( Netboot* pNet, const char* pName )
+{
+    uint8_t* pTftp = pNet->pTx + NETBOOT_DATA_OFFSET ;
+    char pValue[12] ;
+    uint32_t dwSize = 2 ;
+
+    _Put16( pTftp, NETBOOT_TFTP_RRQ ) ;
+    dwSize += _PutString( pTftp + dwSize, pName ) ;
+    dwSize += _PutString( pTftp + dwSize, "octet" ) ;
+    dwSize += _PutString( pTftp + dwSize, "blksize" ) ;
+    sprintf( pValue, "%u", (unsigned int)NETBOOT_BLOCK_SIZE ) ;
+    dwSize += _PutString( pTftp + dwSize, pValue ) ;
+    dwSize += _PutString( pTftp + dwSize, "windowsize" ) ;
+    sprintf( pValue, "%u", (unsigned int)NETBOOT_WINDOW_SIZE ) ;
+    dwSize += _PutString( pTftp + dwSize, pValue ) ;
+    dwSize += _PutString( pTftp + dwSize, "tsize" ) ;
+    dwSize += _PutString( pTftp + dwSize, "0" ) ;
+
+    _SendUdp( pNet, NETBOOT_TFTP_PORT, dwSize ) ;
+}
+
+/**
+ * \brief Acknowledge the blocks received in sequence.
+ */
+static void _SendAck( Netboot* pNet )
+{
+    uint8_t* pTftp = pNet->pTx + NETBOOT_DATA_OFFSET ;
+
+    _Put16( pTftp, NETBOOT_TFTP_ACK ) ;
+    _Put16( pTftp + 2, pNet->dwBlock - 1 ) ;
+
+    _SendUdp( pNet, pNet->wServerPort, NETBOOT_TFTP_HEADER ) ;
+}
+
+/**
+ * \brief Abort the transfer on the server side.
+ */
+static void _SendError( Netboot* pNet, uint32_t dwCode, const char* pMessage )
+{
+    uint8_t* pTftp = pNet->pTx + NETBOOT_DATA_OFFSET ;
+
+    _Put16( pTftp, NETBOOT_TFTP_ERROR ) ;
+    _Put16( pTftp + 2, dwCode ) ;
+
+    _SendUdp( pNet, pNet->wServerPort, NETBOOT_TFTP_HEADER + _PutString( pTftp + NETBOOT_TFTP_HEADER, pMessage ) ) ;
+}
+
+/**
+ * \brief Give descriptors their own buffer back, free for the receiver.
+ */
+static void _Release( Netboot* pNet, uint32_t dwFirst, uint32_t dwCount )
+{
+    volatile NetbootRxDescriptor* pRing = pNet->pRing ;
+
+    for ( ; dwCount > 0 ; dwCount--, dwFirst = (dwFirst + 1) % NETBOOT_RX_BUFFERS )
+    {
+        pNet->pdwSlot[dwFirst] = 0 ;
+        pRing[dwFirst].dwStatus = 0 ;
+        pRing[dwFirst].dwAddress = _DmaAddress( pNet->pBuffers[dwFirst] )
+                                 | ((dwFirst == NETBOOT_RX_BUFFERS - 1) ? NETBOOT_RX_WRAP : 0) ;
+    }
+}
+
+/**
+ * \brief Copy a frame from the buffers it was received in to pNet->pGather.
+ */
+static const uint8_t* _Gather( Netboot* pNet, uint32_t dwFirst, uint32_t dwCount, uint32_t dwSize )
+{
+    volatile NetbootRxDescriptor* pRing = pNet->pRing ;
+    uint32_t dwDone = 0 ;
+    uint32_t dwOffset = NETBOOT_RX_OFFSET ;
+    uint32_t dwChunk ;
+
+    for ( ; (dwCount > 0) && (dwDone < dwSize) ; dwCount--, dwFirst = (dwFirst + 1) % NETBOOT_RX_BUFFERS )
+    {
+        dwChunk = NETBOOT_RX_UNITSIZE - dwOffset ;
+        if ( dwChunk > dwSize - dwDone )
+        {
+            dwChunk = dwSize - dwDone ;
+        }
+        memcpy( pNet->pGather + dwDone, _DmaBuffer( pRing[dwFirst].dwAddress ) + dwOffset, dwChunk ) ;
+        dwDone += dwChunk ;
+        dwOffset = 0 ;
+    }
+
+    return pNet->pGather ;
+}
+
+/**
+ * \brief Lay out the slots of the window expected after the next acknowledge,
+ * from the descriptor where the receiver resumes. The receiver is paused and
+ * all the descriptors are free.
+ */
+static void _Layout( Netboot* pNet )
+{
+    volatile NetbootRxDescriptor* pRing = pNet->pRing ;
+    uint32_t dwUnits = 1 + (pNet->dwBlockSize - NETBOOT_HEAD) / NETBOOT_RX_UNITSIZE ;
+    uint32_t dwIndex = pNet->dwRead ;
+    uint32_t dwBlock ;
+    uint32_t dwOffset ;
+    uint32_t i ;
+
+    /* Slots of the previous window not reached by the receiver */
+    for ( i = 0 ; i < NETBOOT_RX_BUFFERS ; i++ )
+    {
+        if ( pNet->pdwSlot[i] )
+        {
+            _Release( pNet, i, 1 ) ;
+        }
+    }
+
+    /* Blocks in place only for the sizes filling whole buffers after the head */
+    if ( (pNet->bState != NETBOOT_DATA) || (pNet->dwBlockSize < NETBOOT_HEAD + NETBOOT_RX_UNITSIZE)
+      || ((pNet->dwBlockSize - NETBOOT_HEAD) % NETBOOT_RX_UNITSIZE) || (_DmaAddress( pNet->pDest ) & 3) )
+    {
+        return ;
+    }
+
+    for ( dwBlock = pNet->dwBlock ; dwBlock < pNet->dwBlock + pNet->dwWindow ; dwBlock++ )
+    {
+        dwOffset = (dwBlock - 1) * pNet->dwBlockSize ;
+        if ( ((dwBlock - pNet->dwBlock + 1) * dwUnits > NETBOOT_RX_BUFFERS - NETBOOT_RX_SPARE)
+          || (dwOffset + pNet->dwBlockSize > pNet->dwMax)
+          || (pNet->dwTsize && (dwOffset >= pNet->dwTsize)) )
+        {
+            break ;
+        }
+
+        /* Headers and head of the block in the ring buffer, the rest in place */
+        pNet->pdwSlot[dwIndex] = dwBlock ;
+        dwIndex = (dwIndex + 1) % NETBOOT_RX_BUFFERS ;
+        for ( i = 0 ; i < dwUnits - 1 ; i++ )
+        {
+            pNet->pdwSlot[dwIndex] = dwBlock | NETBOOT_SLOT_DIRECT ;
+            pRing[dwIndex].dwAddress = _DmaAddress( pNet->pDest + dwOffset + NETBOOT_HEAD + i * NETBOOT_RX_UNITSIZE )
+                                     | ((dwIndex == NETBOOT_RX_BUFFERS - 1) ? NETBOOT_RX_WRAP : 0) ;
+            dwIndex = (dwIndex + 1) % NETBOOT_RX_BUFFERS ;
+        }
+    }
+}
+
+/**
+ * \brief Process an ARP packet: learn the server address, answer the requests
+ * for the board address.
+ */
+static uint32_t _Arp( Netboot* pNet, const uint8_t* pArp )
+{
+    uint32_t dwSenderIp = _Get32( pArp + 14 ) ;
+
+    if ( (_Get16( pArp ) != 1) || (_Get16( pArp + 2 ) != NETBOOT_ETH_IP) || (pArp[4] != 6) || (pArp[5] != 4) )
+    {
+        return 0 ;
+    }
+
+    if ( dwSenderIp == pNet->dwServer )
+    {
+        memcpy( pNet->pServerMac, pArp + 8, 6 ) ;
+        pNet->bServerMac = 1 ;
+    }
+    if ( (_Get16( pArp + 6 ) == NETBOOT_ARP_REQUEST) && (_Get32( pArp + 24 ) == pNet->dwIp) )
+    {
+        _SendArp( pNet, NETBOOT_ARP_REPLY, pArp + 8, dwSenderIp ) ;
+    }
+
+    return 1 ;
+}
+
+/**
+ * \brief Apply the options acknowledged by the server.
+ *
+ * \return 1 if they are acceptable.
+ */
+static uint32_t _Options( Netboot* pNet, const uint8_t* pData, uint32_t dwSize )
+{
+    const char* pName ;
+    const char* pValue ;
+    const char* pEnd = (const char*)pData + dwSize ;
+    uint32_t dwValue ;
+
+    /* The last string must be terminated */
+    if ( (dwSize == 0) || (pData[dwSize - 1] != 0) )
+    {
+        return 0 ;
+    }
+
+    for ( pName = (const char*)pData ; pName < pEnd ; pName = pValue + strlen( pValue ) + 1 )
+    {
+        pValue = pName + strlen( pName ) + 1 ;
+        if ( pValue >= pEnd )
+        {
+            return 0 ;
+        }
+        dwValue = _ParseNumber( pValue ) ;
+
+        if ( _IsOption( pName, "blksize" ) )
+        {
+            if ( (dwValue < 8) || (dwValue > NETBOOT_BLOCK_SIZE) )
+            {
+                return 0 ;
+            }
+            pNet->dwBlockSize = dwValue ;
+        }
+        else if ( _IsOption( pName, "windowsize" ) )
+        {
+            if ( (dwValue < 1) || (dwValue > NETBOOT_WINDOW_SIZE) )
+            {
+                return 0 ;
+            }
+            pNet->dwWindow = dwValue ;
+        }
+        else if ( _IsOption( pName, "tsize" ) )
+        {
+            pNet->dwTsize = dwValue ;
+        }
+    }
+
+    return 1 ;
+}
+
+/**
+ * \brief Process a DATA packet: only the next block in sequence is taken.
+ *
+ * \param pNet     Client.
+ * \param dwFirst  First descriptor of the frame.
+ * \param dwCount  Number of descriptors of the frame.
+ * \param pFrame   Start of the frame, in its first buffer.
+ * \param dwSize   Size of the data.
+ * \return 1 if the packet was expected.
+ */
+static uint32_t _Data( Netboot* pNet, uint32_t dwFirst, uint32_t dwCount, const uint8_t* pFrame, uint32_t dwSize )
+{
+    uint32_t dwBlock = _Get16( pFrame + NETBOOT_DATA_OFFSET + 2 ) ;
+    uint32_t dwOffset = (pNet->dwBlock - 1) * pNet->dwBlockSize ;
+    uint8_t* pDest = pNet->pDest + dwOffset ;
+
+    if ( dwBlock != (pNet->dwBlock & 0xFFFF) )
+    {
+        if ( dwBlock == ((pNet->dwBlock - 1) & 0xFFFF) )
+        {
+            /* End of a window sent again: the acknowledge was lost */
+            pNet->bAck = 1 ;
+        }
+        else if ( (((dwBlock - pNet->dwBlock) & 0xFFFF) < 0x8000) && !pNet->bGap )
+        {
+            /* A block was lost: the server restarts the window after it */
+            pNet->bGap = 1 ;
+            pNet->bAck = 1 ;
+            pNet->stats.dwResent++ ;
+        }
+        return 0 ;
+    }
+
+    if ( dwSize > pNet->dwBlockSize )
+    {
+        return 0 ;
+    }
+    if ( dwOffset + dwSize > pNet->dwMax )
+    {
+        printf( "-E- Netboot: image larger than %u bytes\n\r", (unsigned int)pNet->dwMax ) ;
+        _SendError( pNet, NETBOOT_TFTP_DISK_FULL, "image too large" ) ;
+        pNet->bError = NETBOOT_ERROR_SIZE ;
+        pNet->bState = NETBOOT_FAILED ;
+        return 1 ;
+    }
+
+    if ( pNet->pdwSlot[dwFirst] == pNet->dwBlock )
+    {
+        /* Landed in its slot: only the head is not in place */
+        memcpy( pDest, pFrame + NETBOOT_DATA_OFFSET + NETBOOT_TFTP_HEADER, (dwSize < NETBOOT_HEAD) ? dwSize : NETBOOT_HEAD ) ;
+        pNet->stats.dwDirect++ ;
+    }
+    else
+    {
+        _Gather( pNet, dwFirst, dwCount, NETBOOT_DATA_OFFSET + NETBOOT_TFTP_HEADER + dwSize ) ;
+        memcpy( pDest, pNet->pGather + NETBOOT_DATA_OFFSET + NETBOOT_TFTP_HEADER, dwSize ) ;
+        pNet->stats.dwGathered++ ;
+    }
+
+    pNet->dwBlock++ ;
+    pNet->dwInWindow++ ;
+    pNet->bGap = 0 ;
+    pNet->dwReceived = dwOffset + dwSize ;
+    pNet->dwLast = pNet->pDevice->fClock() ;
+    pNet->dwRetries = 0 ;
+
+    if ( dwSize < pNet->dwBlockSize )
+    {
+        pNet->bState = NETBOOT_DONE ;
+        pNet->bAck = 1 ;
+    }
+    else if ( pNet->dwInWindow >= pNet->dwWindow )
+    {
+        pNet->bAck = 1 ;
+    }
+
+    return 1 ;
+}
+
+/**
+ * \brief Process a TFTP packet from the server.
+ *
+ * \return 1 if the packet was expected.
+ */
+static uint32_t _Tftp( Netboot* pNet, uint32_t dwFirst, uint32_t dwCount, const uint8_t* pFrame, uint32_t dwSize )
+{
+    const uint8_t* pUdp = pFrame + NETBOOT_UDP_OFFSET ;
+    const uint8_t* pTftp ;
+    uint32_t dwPort = _Get16( pUdp ) ;
+
+    if ( (pNet->bState != NETBOOT_REQUEST) && (pNet->bState != NETBOOT_DATA) )
+    {
+        return 0 ;
+    }
+    /* The first answer gives the port of the transfer on the server */
+    if ( pNet->bState == NETBOOT_REQUEST )
+    {
+        pNet->wServerPort = dwPort ;
+    }
+    else if ( dwPort != pNet->wServerPort )
+    {
+        return 0 ;
+    }
+
+    switch ( _Get16( pUdp + NETBOOT_UDP_HEADER ) )
+    {
+        case NETBOOT_TFTP_DATA :
+            if ( pNet->bState == NETBOOT_REQUEST )
+            {
+                /* No options: 512-byte blocks acknowledged one by one */
+                pNet->bState = NETBOOT_DATA ;
+            }
+            return _Data( pNet, dwFirst, dwCount, pFrame, dwSize - NETBOOT_TFTP_HEADER ) ;
+
+        case NETBOOT_TFTP_OACK :
+            if ( pNet->bState != NETBOOT_REQUEST )
+            {
+                /* Acknowledge of the options lost */
+                pNet->bAck = (pNet->dwBlock == 1) ;
+                return 0 ;
+            }
+            pTftp = _Gather( pNet, dwFirst, dwCount, NETBOOT_DATA_OFFSET + dwSize ) + NETBOOT_DATA_OFFSET ;
+            if ( !_Options( pNet, pTftp + 2, dwSize - 2 ) )
+            {
+                printf( "-E- Netboot: options refused\n\r" ) ;
+                _SendError( pNet, 8, "bad options" ) ;
+                pNet->bError = NETBOOT_ERROR_SERVER ;
+                pNet->bState = NETBOOT_FAILED ;
+                return 1 ;
+            }
+            if ( pNet->dwTsize > pNet->dwMax )
+            {
+                printf( "-E- Netboot: image of %u bytes, larger than %u bytes\n\r", (unsigned int)pNet->dwTsize, (unsigned int)pNet->dwMax ) ;
+                _SendError( pNet, NETBOOT_TFTP_DISK_FULL, "image too large" ) ;
+                pNet->bError = NETBOOT_ERROR_SIZE ;
+                pNet->bState = NETBOOT_FAILED ;
+                return 1 ;
+            }
+            pNet->bState = NETBOOT_DATA ;
+            pNet->bAck = 1 ;
+            pNet->dwLast = pNet->pDevice->fClock() ;
+            pNet->dwRetries = 0 ;
+            return 1 ;
+
+        case NETBOOT_TFTP_ERROR :
+            pTftp = _Gather( pNet, dwFirst, dwCount, NETBOOT_DATA_OFFSET + dwSize ) + NETBOOT_DATA_OFFSET ;
+            printf( "-E- Netboot: server error %u: %.*s\n\r", (unsigned int)_Get16( pTftp + 2 ),
+                    (int)(dwSize - NETBOOT_TFTP_HEADER), (const char*)pTftp + NETBOOT_TFTP_HEADER ) ;
+            pNet->bError = NETBOOT_ERROR_SERVER ;
+            pNet->bState = NETBOOT_FAILED ;
+            return 1 ;
+    }
+
+    return 0 ;
+}
+
+/**
+ * \brief Process a frame; the headers are in its first buffer.
+ *
+ * \return 1 if the frame was for the board.
+ */
+static uint32_t _Input( Netboot* pNet, uint32_t dwFirst, uint32_t dwCount, uint32_t dwSize )
+{
+    const uint8_t* pFrame = _DmaBuffer( pNet->pRing[dwFirst].dwAddress ) + NETBOOT_RX_OFFSET ;
+    const uint8_t* pIp = pFrame + NETBOOT_ETH_HEADER ;
+    const uint8_t* pUdp = pFrame + NETBOOT_UDP_OFFSET ;
+    uint32_t dwIpSize ;
+
+    if ( (dwSize < NETBOOT_DATA_OFFSET + NETBOOT_TFTP_HEADER) || (dwSize > NETBOOT_MAX_FRAME) )
+    {
+        return 0 ;
+    }
+    if ( _Get16( pFrame + 12 ) == NETBOOT_ETH_ARP )
+    {
+        return _Arp( pNet, pIp ) ;
+    }
+
+    /* UDP from the server, not fragmented, without IP options */
+    if ( (_Get16( pFrame + 12 ) != NETBOOT_ETH_IP) || (pIp[0] != 0x45) || (pIp[9] != NETBOOT_IP_UDP)
+      || (_Get16( pIp + 6 ) & 0x3FFF) || (_Get32( pIp + 12 ) != pNet->dwServer) || (_Get32( pIp + 16 ) != pNet->dwIp)
+      || _Checksum( _Sum( pIp, NETBOOT_IP_HEADER, 0 ) ) )
+    {
+        return 0 ;
+    }
+    dwIpSize = _Get16( pIp + 2 ) ;
+    if ( (dwIpSize < NETBOOT_IP_HEADER + NETBOOT_UDP_HEADER + NETBOOT_TFTP_HEADER) || (dwIpSize > dwSize - NETBOOT_ETH_HEADER)
+      || (_Get16( pUdp + 2 ) != pNet->wPort) || (_Get16( pUdp + 4 ) != dwIpSize - NETBOOT_IP_HEADER) )
+    {
+        return 0 ;
+    }
+
+    /* The UDP checksum is not checked, the frame check sequence covers the link */
+    return _Tftp( pNet, dwFirst, dwCount, pFrame, dwIpSize - NETBOOT_IP_HEADER - NETBOOT_UDP_HEADER ) ;
+}
+
+/**
+ * \brief Process the next frame of the ring, if complete.
+ *
+ * \return 1 if descriptors were consumed.
+ */
+static uint32_t _Poll( Netboot* pNet )
+{
+    volatile NetbootRxDescriptor* pRing = pNet->pRing ;
+    uint32_t dwFirst = pNet->dwRead ;
+    uint32_t dwIndex = dwFirst ;
+    uint32_t dwCount = 0 ;
+    uint32_t dwStatus = 0 ;
+
+    while ( dwCount < NETBOOT_RX_BUFFERS )
+    {
+        if ( (pRing[dwIndex].dwAddress & NETBOOT_RX_OWNERSHIP) == 0 )
+        {
+            return 0 ;
+        }
+        dwStatus = pRing[dwIndex].dwStatus ;
+
+        /* Frame cut short (receiver paused, no buffer available): drop what was stored */
+        if ( (dwCount == 0) != ((dwStatus & NETBOOT_RX_SOF) != 0) )
+        {
+            dwCount = dwCount ? dwCount : 1 ;
+            _Release( pNet, dwFirst, dwCount ) ;
+            pNet->dwRead = (dwFirst + dwCount) % NETBOOT_RX_BUFFERS ;
+            pNet->stats.dwDropped++ ;
+            return 1 ;
+        }
+
+        dwCount++ ;
+        if ( dwStatus & NETBOOT_RX_EOF )
+        {
+            break ;
+        }
+        dwIndex = (dwIndex + 1) % NETBOOT_RX_BUFFERS ;
+    }
+
+    pNet->stats.dwFrames++ ;
+    if ( !(dwStatus & NETBOOT_RX_EOF) || !_Input( pNet, dwFirst, dwCount, dwStatus & NETBOOT_RX_LENGTH ) )
+    {
+        pNet->stats.dwDropped++ ;
+    }
+    _Release( pNet, dwFirst, dwCount ) ;
+    pNet->dwRead = (dwFirst + dwCount) % NETBOOT_RX_BUFFERS ;
+
+    return 1 ;
+}
+
+/**
+ * \brief Pause the receiver, take in the frames it stored and lay out the
+ * slots from where it resumes.
+ */
+static void _Resync( Netboot* pNet )
+{
+    const NetbootDevice* pDevice = pNet->pDevice ;
+    uint32_t dwNext ;
+
+    dwNext = pDevice->fRxEnable( pDevice->pArg, 0 ) % NETBOOT_RX_BUFFERS ;
+    while ( _Poll( pNet ) ) ;
+
+    /* What is left up to the receiver position is a frame cut short */
+    _Release( pNet, pNet->dwRead, (dwNext + NETBOOT_RX_BUFFERS - pNet->dwRead) % NETBOOT_RX_BUFFERS ) ;
+    pNet->dwRead = dwNext ;
+
+    _Layout( pNet ) ;
+    pNet->bAck = 0 ;
+    pNet->dwInWindow = 0 ;
+
+    pDevice->fRxEnable( pDevice->pArg, 1 ) ;
+}
+
+/**
+ * \brief Acknowledge the blocks received, the slots of the next window ready.
+ */
+static void _Acknowledge( Netboot* pNet )
+{
+    _Resync( pNet ) ;
+
+    if ( (pNet->bState == NETBOOT_DATA) || (pNet->bState == NETBOOT_DONE) )
+    {
+        _SendAck( pNet ) ;
+    }
+}
+
+/**
+ * \brief Wait for frames until a condition is met or a time is elapsed.
+ */
+static void _Wait( Netboot* pNet, const uint8_t* pbDone, uint32_t dwTimeout )
+{
+    const NetbootDevice* pDevice = pNet->pDevice ;
+    uint32_t dwStart = pDevice->fClock() ;
+
+    while ( !*pbDone && (pDevice->fClock() - dwStart < dwTimeout) )
+    {
+        if ( !_Poll( pNet ) && pDevice->fIdle )
+        {
+            pDevice->fIdle( pDevice->pArg ) ;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the client and start the receiver on its ring.
+ *
+ * \param pNet      Client, where the EMAC can reach it, aligned on 8 bytes.
+ * \param pDevice   Network interface.
+ * \param pMac      Board Ethernet address (6 bytes).
+ * \param dwIp      Board IPv4 address (NETBOOT_ADDRESS).
+ * \param dwServer  TFTP server IPv4 address, on the same network.
+ */
+extern void Netboot_Initialize( Netboot* pNet, const NetbootDevice* pDevice, const uint8_t* pMac, uint32_t dwIp, uint32_t dwServer )
+{
+    memset( pNet, 0, sizeof( Netboot ) ) ;
+    pNet->pDevice = pDevice ;
+    memcpy( pNet->pMac, pMac, 6 ) ;
+    pNet->dwIp = dwIp ;
+    pNet->dwServer = dwServer ;
+    pNet->wPort = NETBOOT_PORT_BASE + pDevice->fClock() % NETBOOT_PORT_COUNT ;
+
+    _Release( pNet, 0, NETBOOT_RX_BUFFERS ) ;
+    pDevice->fRxStart( pDevice->pArg, pNet->pRing ) ;
+}
+
+/**
+ * \brief Fetch an image from the server.
+ *
+ * \param pNet     Client.
+ * \param pName    File name on the server.
+ * \param pDest    Destination, aligned on 4 bytes for the blocks to land in place.
+ * \param dwMax    Size available at pDest.
+ * \param pdwSize  Filled with the image size.
+ * \return NETBOOT_OK if successful, else a NETBOOT_ERROR_xxx.
+ */
+extern uint32_t Netboot_Fetch( Netboot* pNet, const char* pName, uint8_t* pDest, uint32_t dwMax, uint32_t* pdwSize )
+{
+    const NetbootDevice* pDevice = pNet->pDevice ;
+    static const uint8_t pUnknown[6] = { 0 } ;
+    uint32_t dwTry ;
+
+    *pdwSize = 0 ;
+    if ( strlen( pName ) > NETBOOT_MAX_NAME )
+    {
+        return NETBOOT_ERROR_SERVER ;
+    }
+
+    for ( dwTry = 0 ; !pNet->bServerMac && (dwTry < NETBOOT_RETRIES) ; dwTry++ )
+    {
+        _SendArp( pNet, NETBOOT_ARP_REQUEST, pUnknown, pNet->dwServer ) ;
+        _Wait( pNet, &pNet->bServerMac, NETBOOT_TIMEOUT_MS ) ;
+    }
+    if ( !pNet->bServerMac )
+    {
+        printf( "-E- Netboot: no answer from the server\n\r" ) ;
+        return NETBOOT_ERROR_ARP ;
+    }
+
+    pNet->pDest = pDest ;
+    pNet->dwMax = dwMax ;
+    pNet->dwBlockSize = NETBOOT_TFTP_BLOCK_SIZE ;
+    pNet->dwWindow = 1 ;
+    pNet->dwTsize = 0 ;
+    pNet->dwBlock = 1 ;
+    pNet->dwReceived = 0 ;
+    pNet->dwRetries = 0 ;
+    pNet->bGap = 0 ;
+    pNet->bError = NETBOOT_OK ;
+    pNet->wPort = NETBOOT_PORT_BASE + (pNet->wPort + 1 - NETBOOT_PORT_BASE) % NETBOOT_PORT_COUNT ;
+    pNet->bState = NETBOOT_REQUEST ;
+    _Resync( pNet ) ;
+
+    _SendRequest( pNet, pName ) ;
+    pNet->dwLast = pDevice->fClock() ;
+    while ( (pNet->bState == NETBOOT_REQUEST) || (pNet->bState == NETBOOT_DATA) )
+    {
+        if ( _Poll( pNet ) )
+        {
+            if ( pNet->bAck )
+            {
+                _Acknowledge( pNet ) ;
+            }
+            continue ;
+        }
+        if ( pDevice->fIdle )
+        {
+            pDevice->fIdle( pDevice->pArg ) ;
+        }
+
+        /* Nothing new: ask again */
+        if ( pDevice->fClock() - pNet->dwLast >= NETBOOT_TIMEOUT_MS )
+        {
+            if ( ++pNet->dwRetries > NETBOOT_RETRIES )
+            {
+                printf( "-E- Netboot: %s timed out\n\r", pName ) ;
+                pNet->bError = NETBOOT_ERROR_TIMEOUT ;
+                pNet->bState = NETBOOT_FAILED ;
+                break ;
+            }
+            pNet->dwLast = pDevice->fClock() ;
+            pNet->stats.dwResent++ ;
+            if ( pNet->bState == NETBOOT_REQUEST )
+            {
+                _SendRequest( pNet, pName ) ;
+            }
+            else
+            {
+                _Acknowledge( pNet ) ;
+            }
+        }
+    }
+
+    /* No descriptor left pointing at the image */
+    _Resync( pNet ) ;
+    pNet->bState = NETBOOT_IDLE ;
+
+    if ( pNet->bError == NETBOOT_OK )
+    {
+        *pdwSize = pNet->dwReceived ;
+    }
+
+    return pNet->bError ;
+}
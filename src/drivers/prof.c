@@ -0,0 +1,301 @@
+/**
+ * \file
+ *
+ * Implementation of the boot profiler.
+ *
+ * The scopes are timed with the DWT cycle counter. The frame of every scope
+ * entered is linked to the frame of the enclosing one, so that on exit the
+ * time of the scope is added to the children time of its parent and the
+ * self time comes out without any fixed nesting depth.
+ *
+ * The SysTick interrupt fires every PROF_SAMPLE_CYCLES cycles and counts the
+ * PC stacked on exception entry in a histogram with two regions: the code in
+ * flash (.text) and the code copied to SRAM (.ramfunc). Each region is cut
+ * in buckets of a power of two bytes, as small as its size allows; the
+ * samples outside both regions (ROM, SDRAM) are only counted.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "board.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined( PROFILE )
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** DWT cycle counter, started by the application */
+#define PROF_CYCCNT             (*(volatile uint32_t*)0xE0001004)
+
+/** Saturated bucket */
+#define PROF_COUNT_MAX          0xFFFF
+
+/** Code region of the histogram */
+typedef struct _ProfRegion
+{
+    const char* pName ;
+    uint32_t dwBase ;
+    uint32_t dwSize ;
+    /** Log2 of the bucket size */
+    uint32_t dwShift ;
+    /** Buckets of the region */
+    uint16_t* pCounts ;
+    uint32_t dwBuckets ;
+} ProfRegion ;
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Linker script symbols */
+extern uint32_t _sfixed ;
+extern uint32_t _efixed ;
+extern uint32_t _sramfunc ;
+extern uint32_t _eramfunc ;
+
+/** Names of the PROF_xxx scopes */
+static const char* gpProfScopeNames[PROF_NUM_SCOPES] =
+{
+    "f_open", "f_read", "f_write", "f_lseek", "f_sync",
+    "disk_read", "disk_write",
+    "SD_Init", "SD_Read", "SD_Write",
+    "nand_read", "nand_write", "nand_flush",
+    "LCD_Initialize", "LCD_Fill", "LCD_Picture", "BMP_DrawStream"
+} ;
+
+/** Scope statistics */
+static ProfScope gProfScopes[PROF_NUM_SCOPES] ;
+
+/** Innermost scope being run */
+static ProfFrame* gpProfTop ;
+
+/** PC histogram */
+static uint16_t gwProfCounts[PROF_PC_BUCKETS] ;
+static ProfRegion gProfRegions[2] ;
+
+/** Samples taken, and the ones outside the regions */
+static volatile uint32_t gdwProfSamples ;
+static volatile uint32_t gdwProfOther ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Set a code region of the histogram up.
+ *
+ * \param pRegion    Region to set up.
+ * \param pName      Name printed in the dump.
+ * \param dwStart    First byte of the code.
+ * \param dwEnd      Byte following the code.
+ * \param pCounts    Buckets of the region.
+ * \param dwBuckets  Number of buckets.
+ */
+static void _InitRegion( ProfRegion* pRegion, const char* pName, uint32_t dwStart, uint32_t dwEnd,
+                         uint16_t* pCounts, uint32_t dwBuckets )
+{
+    pRegion->pName = pName ;
+    pRegion->dwBase = dwStart ;
+    pRegion->dwSize = dwEnd - dwStart ;
+    pRegion->pCounts = pCounts ;
+    pRegion->dwBuckets = dwBuckets ;
+
+    /* Thumb instructions are at least 2 bytes long */
+    pRegion->dwShift = 1 ;
+    while ( pRegion->dwSize > (dwBuckets << pRegion->dwShift) )
+    {
+        pRegion->dwShift++ ;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Clear the statistics and start the PC sampling.
+ *
+ * The DWT cycle counter must already run. SysTick gets the highest priority
+ * so that the interrupt handlers are sampled too.
+ */
+extern void Prof_Initialize( void )
+{
+    uint32_t i ;
+
+    for ( i = 0 ; i < PROF_NUM_SCOPES ; i++ )
+    {
+        gProfScopes[i].dwCalls = 0 ;
+        gProfScopes[i].dwMin = 0 ;
+        gProfScopes[i].dwMax = 0 ;
+        gProfScopes[i].qwTotal = 0 ;
+        gProfScopes[i].qwSelf = 0 ;
+    }
+    for ( i = 0 ; i < PROF_PC_BUCKETS ; i++ )
+    {
+        gwProfCounts[i] = 0 ;
+    }
+    gpProfTop = 0 ;
+    gdwProfSamples = 0 ;
+    gdwProfOther = 0 ;
+
+    _InitRegion( &gProfRegions[0], "flash", (uint32_t)&_sfixed, (uint32_t)&_efixed,
+                 gwProfCounts, PROF_PC_BUCKETS - PROF_PC_RAM_BUCKETS ) ;
+    _InitRegion( &gProfRegions[1], "sram", (uint32_t)&_sramfunc, (uint32_t)&_eramfunc,
+                 gwProfCounts + PROF_PC_BUCKETS - PROF_PC_RAM_BUCKETS, PROF_PC_RAM_BUCKETS ) ;
+
+    SysTick_Config( PROF_SAMPLE_CYCLES ) ;
+    NVIC_SetPriority( SysTick_IRQn, 0 ) ;
+}
+
+/**
+ * \brief Enter a scope.
+ *
+ * \param pFrame  Frame of the scope, on the stack of the caller.
+ * \param dwId    PROF_xxx.
+ */
+extern void Prof_Enter( ProfFrame* pFrame, uint32_t dwId )
+{
+    pFrame->pParent = gpProfTop ;
+    pFrame->dwChildren = 0 ;
+    pFrame->dwId = dwId ;
+    gpProfTop = pFrame ;
+
+    pFrame->dwStart = PROF_CYCCNT ;
+}
+
+/**
+ * \brief Leave a scope and account for the time spent.
+ *
+ * \param pFrame  Frame given to Prof_Enter().
+ */
+extern void Prof_Exit( ProfFrame* pFrame )
+{
+    uint32_t dwCycles = PROF_CYCCNT - pFrame->dwStart ;
+    ProfScope* pScope = &gProfScopes[pFrame->dwId] ;
+
+    if ( (pScope->dwCalls == 0) || (dwCycles < pScope->dwMin) )
+    {
+        pScope->dwMin = dwCycles ;
+    }
+    if ( dwCycles > pScope->dwMax )
+    {
+        pScope->dwMax = dwCycles ;
+    }
+    pScope->dwCalls++ ;
+    pScope->qwTotal += dwCycles ;
+    pScope->qwSelf += dwCycles - pFrame->dwChildren ;
+
+    if ( pFrame->pParent )
+    {
+        pFrame->pParent->dwChildren += dwCycles ;
+    }
+    gpProfTop = pFrame->pParent ;
+}
+
+/**
+ * \brief Count a PC sample in the histogram.
+ *
+ * \param dwPc  Address of the instruction interrupted.
+ */
+extern void Prof_Sample( uint32_t dwPc )
+{
+    ProfRegion* pRegion ;
+    uint16_t* pCount ;
+
+    gdwProfSamples++ ;
+    for ( pRegion = gProfRegions ; pRegion < &gProfRegions[2] ; pRegion++ )
+    {
+        if ( dwPc - pRegion->dwBase < pRegion->dwSize )
+        {
+            pCount = &pRegion->pCounts[(dwPc - pRegion->dwBase) >> pRegion->dwShift] ;
+            if ( *pCount != PROF_COUNT_MAX )
+            {
+                (*pCount)++ ;
+            }
+            return ;
+        }
+    }
+    gdwProfOther++ ;
+}
+
+/**
+ * \brief SysTick handler: give the stacked PC to Prof_Sample().
+ *
+ * The PC is at offset 24 of the exception frame, on the stack in use when
+ * the interrupt was taken. Prof_Sample() is tail-called with EXC_RETURN
+ * still in LR, so its return ends the exception.
+ */
+__attribute__((naked)) void SysTick_Handler( void )
+{
+    __asm volatile (
+        "tst    lr, #4          \n"
+        "ite    eq              \n"
+        "mrseq  r0, msp         \n"
+        "mrsne  r0, psp         \n"
+        "ldr    r0, [r0, #24]   \n"
+        "b      Prof_Sample     \n" ) ;
+}
+
+/**
+ * \brief Stop the sampling and print the scope statistics and the PC
+ * histogram (see prof.h for the format).
+ *
+ * \param dwCyclesPerUs  Cycle counter frequency in MHz.
+ */
+extern void Prof_Dump( uint32_t dwCyclesPerUs )
+{
+    const ProfScope* pScope ;
+    const ProfRegion* pRegion ;
+    uint32_t i ;
+
+    SysTick->CTRL = 0 ;
+
+    if ( dwCyclesPerUs == 0 )
+    {
+        dwCyclesPerUs = 1 ;
+    }
+
+    printf( "# prof: scopes, times in us\n\r" ) ;
+    printf( "# %-16s %8s %12s %12s %10s %10s\n\r", "scope", "calls", "total", "self", "min", "max" ) ;
+    for ( i = 0 ; i < PROF_NUM_SCOPES ; i++ )
+    {
+        pScope = &gProfScopes[i] ;
+        if ( pScope->dwCalls == 0 )
+        {
+            continue ;
+        }
+        printf( "# %-16s %8u %12u %12u %10u %10u\n\r",
+                gpProfScopeNames[i],
+                (unsigned int)pScope->dwCalls,
+                (unsigned int)(pScope->qwTotal / dwCyclesPerUs),
+                (unsigned int)(pScope->qwSelf / dwCyclesPerUs),
+                (unsigned int)(pScope->dwMin / dwCyclesPerUs),
+                (unsigned int)(pScope->dwMax / dwCyclesPerUs) ) ;
+    }
+
+    printf( "# prof: %u PC samples every %u cycles, %u outside the code\n\r",
+            (unsigned int)gdwProfSamples, PROF_SAMPLE_CYCLES, (unsigned int)gdwProfOther ) ;
+    for ( pRegion = gProfRegions ; pRegion < &gProfRegions[2] ; pRegion++ )
+    {
+        printf( "# prof: %s 0x%08x-0x%08x, %u bytes per bucket\n\r", pRegion->pName,
+                (unsigned int)pRegion->dwBase, (unsigned int)(pRegion->dwBase + pRegion->dwSize),
+                1u << pRegion->dwShift ) ;
+        for ( i = 0 ; i < pRegion->dwBuckets ; i++ )
+        {
+            if ( pRegion->pCounts[i] )
+            {
+                printf( "@ 0x%08x %u\n\r", (unsigned int)(pRegion->dwBase + (i << pRegion->dwShift)),
+                        (unsigned int)pRegion->pCounts[i] ) ;
+            }
+        }
+    }
+    printf( "# prof: end\n\r" ) ;
+}
+
+#endif /* PROFILE */
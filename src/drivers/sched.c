@@ -0,0 +1,245 @@
+/**
+ * \file
+ *
+ * Implementation of the cooperative boot scheduler.
+ *
+ * Tasks are kept in a singly linked list in registration order and called
+ * round-robin. A task waiting for events is not called until all of them
+ * have been posted; when no task can run, the idle hook is invoked so that
+ * the core sleeps until the next interrupt. Event flags are updated with
+ * atomic read-modify-write operations and may be posted from interrupt
+ * handlers.
+ *
+ * The time spent in every call of a task body is measured with the cycle
+ * counter given to Sched_Initialize() and accumulated per task, along with
+ * the cycle counts at the first call and at completion.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "sched.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Registered tasks */
+static SchedTask* gpSchedTasks ;
+
+/** Posted events */
+static volatile uint32_t gdwSchedEvents ;
+
+/** Cycle counter */
+static SchedClockFunc gfSchedClock ;
+
+/** Idle hook */
+static SchedIdleFunc gfSchedIdle ;
+
+/** Cycle counter when the scheduler was initialized */
+static uint32_t gdwSchedStartCycle ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Default cycle counter used when none is given: timing is disabled.
+ */
+static uint32_t _NoClock( void )
+{
+    return 0 ;
+}
+
+/**
+ * \brief Call a task body once and account for the time spent.
+ *
+ * \param pTask  Task to run.
+ */
+static void _RunTask( SchedTask* pTask )
+{
+    uint32_t dwStart ;
+    uint8_t bRc ;
+
+    dwStart = gfSchedClock() ;
+    if ( pTask->dwRuns++ == 0 )
+    {
+        pTask->dwStartCycle = dwStart ;
+    }
+
+    bRc = pTask->fRun( pTask ) ;
+
+    pTask->dwEndCycle = gfSchedClock() ;
+    pTask->dwBusyCycles += pTask->dwEndCycle - dwStart ;
+
+    if ( bRc == SCHED_RC_DONE )
+    {
+        pTask->bState = SCHED_STATE_DONE ;
+    }
+    else if ( pTask->dwWaitEvents )
+    {
+        pTask->bState = SCHED_STATE_WAITING ;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the scheduler, removing all tasks and events.
+ *
+ * \param fClock  Free running cycle counter (0 disables the timing).
+ * \param fIdle   Called when every task is waiting (optional).
+ */
+extern void Sched_Initialize( SchedClockFunc fClock, SchedIdleFunc fIdle )
+{
+    gpSchedTasks = 0 ;
+    gdwSchedEvents = 0 ;
+    gfSchedClock = fClock ? fClock : _NoClock ;
+    gfSchedIdle = fIdle ;
+    gdwSchedStartCycle = gfSchedClock() ;
+}
+
+/**
+ * \brief Register a task. Tasks are run in registration order.
+ *
+ * \param pTask  Task control block, must stay valid while the scheduler runs.
+ * \param pName  Name printed in the timing report.
+ * \param fRun   Task body.
+ * \param pArg   Task argument, available as pTask->pArg.
+ */
+extern void Sched_AddTask( SchedTask* pTask, const char* pName, SchedTaskFunc fRun, void* pArg )
+{
+    SchedTask** ppLast = &gpSchedTasks ;
+
+    pTask->pName = pName ;
+    pTask->fRun = fRun ;
+    pTask->pArg = pArg ;
+    pTask->wLine = 0 ;
+    pTask->bState = SCHED_STATE_READY ;
+    pTask->dwWaitEvents = 0 ;
+    pTask->dwRuns = 0 ;
+    pTask->dwBusyCycles = 0 ;
+    pTask->dwStartCycle = 0 ;
+    pTask->dwEndCycle = 0 ;
+    pTask->pNext = 0 ;
+
+    while ( *ppLast )
+    {
+        ppLast = &(*ppLast)->pNext ;
+    }
+    *ppLast = pTask ;
+}
+
+/**
+ * \brief Post events. May be called from an interrupt handler.
+ *
+ * \param dwEvents  Mask of the events to set.
+ */
+extern void Sched_PostEvent( uint32_t dwEvents )
+{
+    __sync_fetch_and_or( &gdwSchedEvents, dwEvents ) ;
+}
+
+/**
+ * \brief Clear events. May be called from an interrupt handler.
+ *
+ * \param dwEvents  Mask of the events to clear.
+ */
+extern void Sched_ClearEvent( uint32_t dwEvents )
+{
+    __sync_fetch_and_and( &gdwSchedEvents, ~dwEvents ) ;
+}
+
+/**
+ * \brief Return the events currently posted.
+ */
+extern uint32_t Sched_GetEvents( void )
+{
+    return gdwSchedEvents ;
+}
+
+/**
+ * \brief Run one round: call every task which is ready once.
+ *
+ * \return Number of tasks not done yet.
+ */
+extern uint32_t Sched_RunOnce( void )
+{
+    SchedTask* pTask ;
+    uint32_t dwPending = 0 ;
+    uint32_t dwRun = 0 ;
+
+    for ( pTask = gpSchedTasks ; pTask ; pTask = pTask->pNext )
+    {
+        if ( pTask->bState == SCHED_STATE_WAITING )
+        {
+            if ( (gdwSchedEvents & pTask->dwWaitEvents) != pTask->dwWaitEvents )
+            {
+                dwPending++ ;
+                continue ;
+            }
+            pTask->dwWaitEvents = 0 ;
+            pTask->bState = SCHED_STATE_READY ;
+        }
+
+        if ( pTask->bState == SCHED_STATE_READY )
+        {
+            _RunTask( pTask ) ;
+            dwRun++ ;
+            if ( pTask->bState != SCHED_STATE_DONE )
+            {
+                dwPending++ ;
+            }
+        }
+    }
+
+    if ( dwPending && !dwRun && gfSchedIdle )
+    {
+        gfSchedIdle() ;
+    }
+
+    return dwPending ;
+}
+
+/**
+ * \brief Run the tasks until they are all done.
+ */
+extern void Sched_Run( void )
+{
+    while ( Sched_RunOnce() )
+    {
+    }
+}
+
+/**
+ * \brief Print the timing of every task: number of calls, time spent in the
+ * task body and completion time since Sched_Initialize().
+ *
+ * \param dwCyclesPerUs  Cycle counter frequency in MHz.
+ */
+extern void Sched_PrintReport( uint32_t dwCyclesPerUs )
+{
+    SchedTask* pTask ;
+
+    if ( dwCyclesPerUs == 0 )
+    {
+        dwCyclesPerUs = 1 ;
+    }
+
+    printf( "-I- Task            Calls     Busy(us)     Done(us)\n\r" ) ;
+    for ( pTask = gpSchedTasks ; pTask ; pTask = pTask->pNext )
+    {
+        printf( "-I- %-12s %8u %12u %12u%s\n\r",
+                pTask->pName,
+                (unsigned int)pTask->dwRuns,
+                (unsigned int)(pTask->dwBusyCycles / dwCyclesPerUs),
+                (unsigned int)((pTask->dwEndCycle - gdwSchedStartCycle) / dwCyclesPerUs),
+                (pTask->bState == SCHED_STATE_DONE) ? "" : " (running)" ) ;
+    }
+}
@@ -0,0 +1,306 @@
+/**
+ * \file
+ *
+ * Implementation of the SPI command driver.
+ *
+ * The SPI works in fixed peripheral select mode with CSAAT set on the chip
+ * selects, so the chip select stays low while the CPU hands the bus over to
+ * the DMAC and between two descriptor chains; LASTXFER releases it once the
+ * last byte is out. WDRBT holds every transfer until the previous byte is
+ * read, so the receive channel never overruns, whatever the DMAC load.
+ *
+ * Both channels always run: the transmit channel reads the data to write,
+ * or a fixed dummy byte for a read, and the receive channel writes the data
+ * read, or a fixed scratch byte for a write. The end of the receive chain
+ * is then the end of the data phase in both directions.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "board.h"
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** DMAC hardware handshake interfaces of SPI0 */
+#define SPID_DMA_TX_PER         1
+#define SPID_DMA_RX_PER         2
+
+/** End of chain and error flags of the receive channel */
+#define SPID_DMA_IT_MASK        ((DMAC_EBCIER_CBTC0 | DMAC_EBCIER_ERR0) << BOARD_SPI_DMA_RX_CHANNEL)
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Descriptor chains of the transmit and receive channels */
+static DmaLinkList gSpidTxLli[SPID_NUM_LLI] ;
+static DmaLinkList gSpidRxLli[SPID_NUM_LLI] ;
+
+/** Dummy byte clocked out during a read, scratch byte received during a write */
+static const uint8_t gbSpidDummy = 0xFF ;
+static uint8_t gbSpidScratch ;
+
+/** Driver whose data phase is on the DMAC */
+static Spid* gpSpidActive ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Exchange one byte with the CPU.
+ */
+static uint8_t _Exchange( Spi* pSpi, uint8_t bData )
+{
+    while ( (pSpi->SPI_SR & SPI_SR_TDRE) == 0 ) ;
+    pSpi->SPI_TDR = bData ;
+    while ( (pSpi->SPI_SR & SPI_SR_RDRF) == 0 ) ;
+
+    return (uint8_t)pSpi->SPI_RDR ;
+}
+
+/**
+ * \brief Release the chip select and the driver, then invoke the callback.
+ */
+static void _Finish( Spid* pSpid, uint8_t bStatus )
+{
+    Spi* pSpi = (Spi*)pSpid->pSpiHw ;
+    SpidCmd* pCommand = pSpid->pCurrentCommand ;
+
+    while ( (pSpi->SPI_SR & SPI_SR_TXEMPTY) == 0 ) ;
+    pSpi->SPI_CR = SPI_CR_LASTXFER ;
+
+    pSpid->pCurrentCommand = 0 ;
+    pSpid->semaphore++ ;
+
+    if ( pCommand->callback )
+    {
+        pCommand->callback( bStatus, pCommand->pArgument ) ;
+    }
+}
+
+/**
+ * \brief Program the next part of the data phase, up to SPID_NUM_LLI
+ * descriptors on each channel.
+ */
+static void _StartChain( Spid* pSpid )
+{
+    Spi* pSpi = (Spi*)pSpid->pSpiHw ;
+    SpidCmd* pCommand = pSpid->pCurrentCommand ;
+    uint32_t dwData = (uint32_t)pCommand->pData ;
+    uint32_t dwSrcIncr = pCommand->dataIn ? DMAC_CTRLB_SRC_INCR_FIXED : DMAC_CTRLB_SRC_INCR_INCREMENTING ;
+    uint32_t dwDstIncr = pCommand->dataIn ? DMAC_CTRLB_DST_INCR_INCREMENTING : DMAC_CTRLB_DST_INCR_FIXED ;
+    uint32_t dwChunk ;
+    uint32_t i ;
+
+    for ( i = 0 ; (i < SPID_NUM_LLI) && (pSpid->dwArmed < pCommand->dataSize) ; i++ )
+    {
+        dwChunk = pCommand->dataSize - pSpid->dwArmed ;
+        if ( dwChunk > SPID_LLI_BYTES )
+        {
+            dwChunk = SPID_LLI_BYTES ;
+        }
+
+        gSpidTxLli[i].sourceAddress = pCommand->dataIn ? (uint32_t)&gbSpidDummy : dwData + pSpid->dwArmed ;
+        gSpidTxLli[i].destAddress = (uint32_t)&pSpi->SPI_TDR ;
+        gSpidTxLli[i].controlA = DMAC_CTRLA_BTSIZE( dwChunk )
+                               | DMAC_CTRLA_SCSIZE_CHK_1
+                               | DMAC_CTRLA_DCSIZE_CHK_1
+                               | DMAC_CTRLA_SRC_WIDTH_BYTE
+                               | DMAC_CTRLA_DST_WIDTH_BYTE ;
+        gSpidTxLli[i].controlB = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM
+                               | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM
+                               | DMAC_CTRLB_FC_MEM2PER_DMA_FC
+                               | dwSrcIncr
+                               | DMAC_CTRLB_DST_INCR_FIXED ;
+        gSpidTxLli[i].descriptor = 0 ;
+
+        gSpidRxLli[i].sourceAddress = (uint32_t)&pSpi->SPI_RDR ;
+        gSpidRxLli[i].destAddress = pCommand->dataIn ? dwData + pSpid->dwArmed : (uint32_t)&gbSpidScratch ;
+        gSpidRxLli[i].controlA = gSpidTxLli[i].controlA ;
+        gSpidRxLli[i].controlB = DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM
+                               | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM
+                               | DMAC_CTRLB_FC_PER2MEM_DMA_FC
+                               | DMAC_CTRLB_SRC_INCR_FIXED
+                               | dwDstIncr ;
+        gSpidRxLli[i].descriptor = 0 ;
+
+        if ( i > 0 )
+        {
+            gSpidTxLli[i - 1].descriptor = (uint32_t)&gSpidTxLli[i] ;
+            gSpidRxLli[i - 1].descriptor = (uint32_t)&gSpidRxLli[i] ;
+        }
+        pSpid->dwArmed += dwChunk ;
+    }
+
+    DMA_DisableChannels( DMAC, (1 << BOARD_SPI_DMA_TX_CHANNEL) | (1 << BOARD_SPI_DMA_RX_CHANNEL) ) ;
+
+    /* Receive channel first, so that it waits for the first byte */
+    DMA_SetSourceAddr( DMAC, BOARD_SPI_DMA_RX_CHANNEL, gSpidRxLli[0].sourceAddress ) ;
+    DMA_SetDestinationAddr( DMAC, BOARD_SPI_DMA_RX_CHANNEL, gSpidRxLli[0].destAddress ) ;
+    DMA_SetDescriptorAddr( DMAC, BOARD_SPI_DMA_RX_CHANNEL, (uint32_t)&gSpidRxLli[0] ) ;
+    DMA_SetSourceBufferMode( DMAC, BOARD_SPI_DMA_RX_CHANNEL, DMA_TRANSFER_LLI, DMAC_CTRLB_SRC_INCR_FIXED >> 24 ) ;
+    DMA_SetDestBufferMode( DMAC, BOARD_SPI_DMA_RX_CHANNEL, DMA_TRANSFER_LLI, dwDstIncr >> 28 ) ;
+    DMA_SetFlowControl( DMAC, BOARD_SPI_DMA_RX_CHANNEL, DMAC_CTRLB_FC_PER2MEM_DMA_FC >> 21 ) ;
+    DMA_SetConfiguration( DMAC, BOARD_SPI_DMA_RX_CHANNEL, DMAC_CFG_SRC_PER( SPID_DMA_RX_PER )
+                                                        | DMAC_CFG_SRC_H2SEL_HW
+                                                        | DMAC_CFG_DST_H2SEL_SW
+                                                        | DMAC_CFG_SOD_DISABLE
+                                                        | DMAC_CFG_AHB_PROT( 1 )
+                                                        | DMAC_CFG_FIFOCFG_ASAP_CFG ) ;
+
+    DMA_SetSourceAddr( DMAC, BOARD_SPI_DMA_TX_CHANNEL, gSpidTxLli[0].sourceAddress ) ;
+    DMA_SetDestinationAddr( DMAC, BOARD_SPI_DMA_TX_CHANNEL, gSpidTxLli[0].destAddress ) ;
+    DMA_SetDescriptorAddr( DMAC, BOARD_SPI_DMA_TX_CHANNEL, (uint32_t)&gSpidTxLli[0] ) ;
+    DMA_SetSourceBufferMode( DMAC, BOARD_SPI_DMA_TX_CHANNEL, DMA_TRANSFER_LLI, dwSrcIncr >> 24 ) ;
+    DMA_SetDestBufferMode( DMAC, BOARD_SPI_DMA_TX_CHANNEL, DMA_TRANSFER_LLI, DMAC_CTRLB_DST_INCR_FIXED >> 28 ) ;
+    DMA_SetFlowControl( DMAC, BOARD_SPI_DMA_TX_CHANNEL, DMAC_CTRLB_FC_MEM2PER_DMA_FC >> 21 ) ;
+    DMA_SetConfiguration( DMAC, BOARD_SPI_DMA_TX_CHANNEL, DMAC_CFG_DST_PER( SPID_DMA_TX_PER )
+                                                        | DMAC_CFG_SRC_H2SEL_SW
+                                                        | DMAC_CFG_DST_H2SEL_HW
+                                                        | DMAC_CFG_SOD_DISABLE
+                                                        | DMAC_CFG_AHB_PROT( 1 )
+                                                        | DMAC_CFG_FIFOCFG_ALAP_CFG ) ;
+
+    DMA_EnableIt( DMAC, SPID_DMA_IT_MASK ) ;
+    DMA_EnableChannels( DMAC, (1 << BOARD_SPI_DMA_TX_CHANNEL) | (1 << BOARD_SPI_DMA_RX_CHANNEL) ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the driver and its SPI in master mode.
+ *
+ * \param pSpid   Driver instance.
+ * \param pSpiHw  SPI peripheral (Spi*).
+ * \param bSpiId  Peripheral ID of the SPI.
+ */
+extern void SPID_Configure( Spid* pSpid, void* pSpiHw, uint8_t bSpiId )
+{
+    pSpid->pSpiHw = pSpiHw ;
+    pSpid->spiId = bSpiId ;
+    pSpid->pCurrentCommand = 0 ;
+    pSpid->dwArmed = 0 ;
+    pSpid->semaphore = 1 ;
+
+    SPI_Configure( (Spi*)pSpiHw, bSpiId, SPI_MR_MSTR | SPI_MR_MODFDIS | SPI_MR_WDRBT | SPI_PCS( 0 ) ) ;
+    SPI_Enable( (Spi*)pSpiHw ) ;
+
+    DMAD_Initialize( BOARD_SPI_DMA_TX_CHANNEL, DMAD_NO_DEFAULT_IT ) ;
+    DMAD_Initialize( BOARD_SPI_DMA_RX_CHANNEL, DMAD_USE_DEFAULT_IT ) ;
+}
+
+/**
+ * \brief Configure a chip select; CSAAT is always added.
+ *
+ * \param pSpid  Driver instance.
+ * \param dwCs   Chip select (0 to 3).
+ * \param dwCsr  SPI_CSR value: clock, mode and delays.
+ */
+extern void SPID_ConfigureCS( Spid* pSpid, uint32_t dwCs, uint32_t dwCsr )
+{
+    SPI_ConfigureNPCS( (Spi*)pSpid->pSpiHw, dwCs, dwCsr | SPI_CSR_CSAAT ) ;
+}
+
+/**
+ * \brief Start a command. The command bytes are sent before the function
+ * returns; the data phase may still be running on the DMAC.
+ *
+ * \param pSpid     Driver instance.
+ * \param pCommand  Command to send, valid until the end of the transfer.
+ * \return 0 if the command is started, SPID_ERROR_LOCK if the driver is busy.
+ */
+extern uint32_t SPID_SendCommand( Spid* pSpid, SpidCmd* pCommand )
+{
+    Spi* pSpi = (Spi*)pSpid->pSpiHw ;
+    uint32_t i ;
+
+    if ( pSpid->semaphore == 0 )
+    {
+        return SPID_ERROR_LOCK ;
+    }
+    pSpid->semaphore-- ;
+    pSpid->pCurrentCommand = pCommand ;
+    pSpid->dwArmed = 0 ;
+
+    pSpi->SPI_MR = (pSpi->SPI_MR & ~SPI_MR_PCS_Msk) | SPI_PCS( pCommand->spiCs ) ;
+    (void)pSpi->SPI_RDR ;
+
+    for ( i = 0 ; i < pCommand->cmdSize ; i++ )
+    {
+        pCommand->pCmd[i] = _Exchange( pSpi, pCommand->pCmd[i] ) ;
+    }
+
+    if ( pCommand->dataSize < SPID_CPU_THRESHOLD )
+    {
+        for ( i = 0 ; i < pCommand->dataSize ; i++ )
+        {
+            if ( pCommand->dataIn )
+            {
+                pCommand->pData[i] = _Exchange( pSpi, 0xFF ) ;
+            }
+            else
+            {
+                _Exchange( pSpi, pCommand->pData[i] ) ;
+            }
+        }
+        _Finish( pSpid, 0 ) ;
+
+        return 0 ;
+    }
+
+    gpSpidActive = pSpid ;
+    _StartChain( pSpid ) ;
+
+    return 0 ;
+}
+
+/**
+ * \brief Return 1 while a command is in progress.
+ */
+extern uint32_t SPID_IsBusy( const Spid* pSpid )
+{
+    return pSpid->semaphore == 0 ;
+}
+
+/**
+ * \brief DMAC interrupt part of the driver: arms the next chain or ends the
+ * command.
+ *
+ * \param dwStatus  DMAC_EBCISR value read by the DMAC interrupt handler.
+ */
+extern void SPID_DmaHandler( uint32_t dwStatus )
+{
+    Spid* pSpid = gpSpidActive ;
+    uint8_t bStatus = 0 ;
+
+    if ( (pSpid == 0) || !(dwStatus & SPID_DMA_IT_MASK) )
+    {
+        return ;
+    }
+
+    if ( dwStatus & (DMAC_EBCISR_ERR0 << BOARD_SPI_DMA_RX_CHANNEL) )
+    {
+        TRACE_ERROR( "SPID: DMA AHB error\n\r" ) ;
+        bStatus = SPID_ERROR_DMA ;
+    }
+    else if ( pSpid->dwArmed < pSpid->pCurrentCommand->dataSize )
+    {
+        _StartChain( pSpid ) ;
+        return ;
+    }
+
+    DMA_DisableIt( DMAC, SPID_DMA_IT_MASK ) ;
+    DMA_DisableChannels( DMAC, (1 << BOARD_SPI_DMA_TX_CHANNEL) | (1 << BOARD_SPI_DMA_RX_CHANNEL) ) ;
+
+    gpSpidActive = 0 ;
+    _Finish( pSpid, bStatus ) ;
+}
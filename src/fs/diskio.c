@@ -16,8 +16,157 @@
 //#include <stdio.h>
 #include "assert.h"
 
-#define MAX_MEDS        1
-extern Media medias[MAX_MEDS];
+/// Media of each drive, indexed by the DRV_xxx numbers (see main.c)
+extern Media medias[];
+
+/// Free cluster bitmaps, one per drive in the BOARD_SDRAM_FREEMAP area of
+/// the SDRAM map. 1 MB covers 8M clusters.
+#define FREEMAP_SIZE    BOARD_SDRAM_FREEMAP_SIZE
+#define FREEMAP_ADDR(drv) \
+    (BOARD_SDRAM_FREEMAP_ADDR + (drv) * FREEMAP_SIZE)
+
+//------------------------------------------------------------------------------
+/// Completion of a request queued by submit_sectors(): one less to wait for.
+//------------------------------------------------------------------------------
+static void request_done (
+    void *argument,
+    uint8_t status,
+    uint32_t transferred,
+    uint32_t remaining
+)
+{
+    (*(volatile UINT*)argument)--;
+}
+
+//------------------------------------------------------------------------------
+/// Reads or writes sector ranges of a drive through the request queue of its
+/// media and waits for them. The ranges are queued with the queue held
+/// (MED_Plug()), MED_QUEUE_SIZE at a time, so that the adjacent ones are
+/// merged into one media access.
+//------------------------------------------------------------------------------
+static DRESULT submit_sectors (
+    BYTE drv,               /* Physical drive number (0..) */
+    BYTE write,             /* MED_REQUEST_READ or MED_REQUEST_WRITE */
+    const DISKVEC *vec,     /* Sector ranges */
+    UINT count              /* Number of sector ranges */
+)
+{
+    Media *pMedia = &medias[drv];
+    MEDRequest requests[MED_QUEUE_SIZE];
+    MEDIovec iovs[MED_QUEUE_SIZE];
+    volatile UINT pending;
+    unsigned int scale = 1;
+    unsigned int result;
+    UINT i, n;
+    DRESULT res = RES_OK;
+
+    if (pMedia->blockSize < SECTOR_SIZE_DEFAULT)
+    {
+        scale = SECTOR_SIZE_DEFAULT / pMedia->blockSize;
+    }
+
+    while (count && (res == RES_OK))
+    {
+        n = (count > MED_QUEUE_SIZE) ? MED_QUEUE_SIZE : count;
+        pending = 0;
+
+        MED_Plug(pMedia);
+        for (i = 0; i < n; i++)
+        {
+            iovs[i].data = vec[i].buff;
+            iovs[i].length = vec[i].count * scale;
+            requests[i].address = vec[i].sector * scale;
+            requests[i].pIov = &iovs[i];
+            requests[i].bNumIov = 1;
+            requests[i].bWrite = write;
+            requests[i].callback = request_done;
+            requests[i].argument = (void*)&pending;
+
+            pending++;
+            result = MED_Submit(pMedia, &requests[i]);
+            if (result != MED_STATUS_SUCCESS)
+            {
+                TRACE_ERROR("MED_Submit pb: 0x%X\n\r", result);
+                pending--;
+                res = (result == MED_STATUS_PROTECTED) ? RES_WRPRT : RES_ERROR;
+                break;
+            }
+        }
+        MED_Unplug(pMedia);
+
+        /* Synchronous drivers are done already */
+        while (pending);
+
+        while (i--)
+        {
+            if (requests[i].bStatus != MED_STATUS_SUCCESS)
+            {
+                TRACE_ERROR("MED request pb: 0x%X\n\r", requests[i].bStatus);
+                res = RES_ERROR;
+            }
+        }
+        vec += n;
+        count -= n;
+    }
+
+    return res;
+}
+
+//------------------------------------------------------------------------------
+/// Discards a sector range {start, end} of a drive (CTRL_TRIM). The file
+/// system only issues it from its sync, after the FAT that frees the range
+/// has been written and flushed, so the data may be dropped at once.
+//------------------------------------------------------------------------------
+static DRESULT trim_sectors (
+    BYTE drv,        /* Physical drive number (0..) */
+    DWORD *range     /* First and last sectors */
+)
+{
+    unsigned int addr, len;
+
+    if (medias[drv].blockSize < SECTOR_SIZE_DEFAULT)
+    {
+        addr = range[0] * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
+        len  = (range[1] - range[0] + 1) * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
+    }
+    else
+    {
+        addr = range[0];
+        len  = range[1] - range[0] + 1;
+    }
+
+    if (MED_Trim(&medias[drv], addr, len) != MED_STATUS_SUCCESS)
+    {
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the address of a sector range {start, count, address} of a drive
+/// mapped in the memory space (CTRL_MAP).
+//------------------------------------------------------------------------------
+static DRESULT map_sectors (
+    BYTE drv,        /* Physical drive number (0..) */
+    DWORD *map       /* First sector and count, address returned */
+)
+{
+    unsigned int addr, len;
+
+    if (medias[drv].blockSize < SECTOR_SIZE_DEFAULT)
+    {
+        addr = map[0] * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
+        len  = map[1] * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
+    }
+    else
+    {
+        addr = map[0];
+        len  = map[1];
+    }
+
+    map[2] = (DWORD)MED_Map(&medias[drv], addr, len);
+    return map[2] ? RES_OK : RES_PARERR;
+}
 
 
 /*-----------------------------------------------------------------------*/
@@ -44,6 +193,14 @@ DSTATUS disk_initialize (
         case DRV_NAND:
             stat = 0;
             break;
+
+        case DRV_SFLASH:
+            stat = 0;
+            break;
+
+        case DRV_NOR:
+            stat = STA_PROTECT;
+            break;
     }
 
     return stat;
@@ -71,6 +228,12 @@ DSTATUS disk_status (
         case DRV_NAND:
             stat = 0;
             break;
+        case DRV_SFLASH:
+            stat = 0;
+            break;
+        case DRV_NOR:
+            stat = STA_PROTECT;  // read-only
+            break;
     }
 
     return stat;
@@ -84,36 +247,35 @@ DRESULT disk_read (
 	BYTE drv,		/* Physical drive number (0..) */
 	BYTE *buff,		/* Data buffer to store read data */
 	DWORD sector,	/* Sector address (LBA) */
-	BYTE count		/* Number of sectors to read (1..255) */
+	UINT count		/* Number of sectors to read */
 )
 {
-    unsigned char result;
-    DRESULT res = RES_ERROR;
+    DISKVEC vec;
+    PROF_SCOPE(PROF_DISK_READ);
 
-    unsigned int addr, len;
-    if (medias[drv].blockSize < SECTOR_SIZE_DEFAULT)
-    {
-        addr = sector * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
-        len  = count * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
-    }
-    else
-    {
-        addr = sector;
-        len  = count;
-    }
+    vec.buff = buff;
+    vec.sector = sector;
+    vec.count = count;
 
-    result = MED_Read(&medias[drv], addr, (void*)buff, len, NULL, NULL);
+    return submit_sectors(drv, MED_REQUEST_READ, &vec, 1);
+}
 
-    if( result == MED_STATUS_SUCCESS )
-    {
-        res = RES_OK;
-    }
-    else
-    {
-        TRACE_ERROR("MED_Read pb: 0x%X\n\r", result);
-        res = RES_ERROR;
-    }
-   return res;
+/*-----------------------------------------------------------------------*/
+/* Read Sector Ranges                                                    */
+/*-----------------------------------------------------------------------*/
+/* The ranges are queued together on the media, which merges the adjacent
+/  ones into one access: a caller that knows several ranges ahead (e.g. the
+/  fragments of a file, from f_extent) gets them read back to back. */
+
+DRESULT disk_readv (
+	BYTE drv,			/* Physical drive number (0..) */
+	const DISKVEC *vec,	/* Sector ranges to read */
+	UINT count			/* Number of sector ranges */
+)
+{
+    PROF_SCOPE(PROF_DISK_READ);
+
+    return submit_sectors(drv, MED_REQUEST_READ, vec, count);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -130,39 +292,17 @@ DRESULT disk_write (
 	BYTE drv,			/* Physical drive number (0..) */
 	const BYTE *buff,	/* Data to be written */
 	DWORD sector,		/* Sector address (LBA) */
-	BYTE count			/* Number of sectors to write (1..255) */
+	UINT count			/* Number of sectors to write */
 )
 {
-    DRESULT res=RES_PARERR;
-    unsigned int result;
-    void * tmp;
-    tmp = (void *) buff;
-
-    unsigned int addr, len;
-    if (medias[drv].blockSize < SECTOR_SIZE_DEFAULT)
-    {
-        addr = sector * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
-        len  = count * (SECTOR_SIZE_DEFAULT / medias[drv].blockSize);
-    }
-    else
-    {
-        addr = sector;
-        len  = count;
-    }
-
-    result = MED_Write(&medias[drv], addr, (void*)tmp, len, NULL, NULL);
+    DISKVEC vec;
+    PROF_SCOPE(PROF_DISK_WRITE);
 
-    if( result == MED_STATUS_SUCCESS )
-    {
-        res = RES_OK;
-    }
-    else
-    {
-        TRACE_ERROR("MED_Write pb: 0x%X\n\r", result);
-        res = RES_ERROR;
-    }
+    vec.buff = (BYTE*)buff;
+    vec.sector = sector;
+    vec.count = count;
 
-    return res;
+    return submit_sectors(drv, MED_REQUEST_WRITE, &vec, 1);
 }
 #endif /* _READONLY */
 
@@ -239,8 +379,12 @@ DRESULT disk_ioctl (
         case DRV_MMC :
         switch (ctrl)
         {
-            case GET_BLOCK_SIZE:
-                *(DWORD*)buff = 1;
+            case GET_BLOCK_SIZE:   /* Erase block: the SD allocation unit */
+                *(DWORD*)buff = SD_GetAuSizeBlocks((SdCard*)medias[DRV_MMC].interface);
+                if (*(DWORD*)buff == 0)
+                {
+                    *(DWORD*)buff = 1;
+                }
                 res = RES_OK;
                 break;
 
@@ -270,8 +414,19 @@ DRESULT disk_ioctl (
                 res = RES_OK;
                 break;
 
-            case CTRL_SYNC :   /* Make sure that data has been written */
-                res = RES_OK;
+            case CTRL_SYNC :   /* Write back the coalesced sectors */
+                if (MED_Flush(&medias[DRV_MMC]) == MED_STATUS_SUCCESS)
+                {
+                    res = RES_OK;
+                }
+                else
+                {
+                    res = RES_ERROR;
+                }
+                break;
+
+            case CTRL_TRIM :   /* Discard freed sectors */
+                res = trim_sectors(DRV_MMC, (DWORD*)buff);
                 break;
 
             default:
@@ -318,6 +473,76 @@ DRESULT disk_ioctl (
                     res = RES_OK;
                     break;
 
+                case CTRL_TRIM :   /* Discard freed sectors */
+                    res = trim_sectors(DRV_NAND, (DWORD*)buff);
+                    break;
+
+                default:
+                    res = RES_PARERR;
+        }
+        break;
+
+        case DRV_SFLASH :
+            switch (ctrl)
+            {
+                case GET_BLOCK_SIZE:   /* Erase block: one erase unit */
+                    *(DWORD*)buff = SFLASH_ERASE_SIZE / SECTOR_SIZE_DEFAULT;
+                    res = RES_OK;
+                    break;
+
+                case GET_SECTOR_COUNT :   /* Get number of sectors on the disk (DWORD) */
+                    *(DWORD*)buff = (DWORD)(medias[DRV_SFLASH].size /
+                                            (SECTOR_SIZE_DEFAULT /
+                                            medias[DRV_SFLASH].blockSize));
+                    res = RES_OK;
+                    break;
+
+                case GET_SECTOR_SIZE :   /* Get sectors on the disk (WORD) */
+                    *(WORD*)buff = SECTOR_SIZE_DEFAULT;
+                    res = RES_OK;
+                    break;
+
+                case CTRL_SYNC :   /* Writes are done when they return */
+                    res = RES_OK;
+                    break;
+
+                case CTRL_TRIM :   /* Erase freed sectors */
+                    res = trim_sectors(DRV_SFLASH, (DWORD*)buff);
+                    break;
+
+                default:
+                    res = RES_PARERR;
+        }
+        break;
+
+        case DRV_NOR :
+            switch (ctrl)
+            {
+                case GET_BLOCK_SIZE:
+                    *(DWORD*)buff = 1;
+                    res = RES_OK;
+                    break;
+
+                case GET_SECTOR_COUNT :   /* Get number of sectors on the disk (DWORD) */
+                    *(DWORD*)buff = (DWORD)(medias[DRV_NOR].size /
+                                            (SECTOR_SIZE_DEFAULT /
+                                            medias[DRV_NOR].blockSize));
+                    res = RES_OK;
+                    break;
+
+                case GET_SECTOR_SIZE :   /* Get sectors on the disk (WORD) */
+                    *(WORD*)buff = SECTOR_SIZE_DEFAULT;
+                    res = RES_OK;
+                    break;
+
+                case CTRL_SYNC :   /* Read-only */
+                    res = RES_OK;
+                    break;
+
+                case CTRL_MAP :   /* Address of the sectors in the flash */
+                    res = map_sectors(DRV_NOR, (DWORD*)buff);
+                    break;
+
                 default:
                     res = RES_PARERR;
         }
@@ -349,5 +574,24 @@ DWORD get_fattime (void)
     return time;
 }
 
+#if _USE_FREEMAP && !_FS_READONLY
+//------------------------------------------------------------------------------
+/// Return the memory holding the free cluster bitmap of a drive, 1 bit per
+/// FAT entry, or 0 if the bitmap does not fit and the FAT must be scanned.
+/// \param drv  Physical drive number.
+/// \param nfatent  Number of FAT entries of the volume.
+//------------------------------------------------------------------------------
+DWORD* ff_freemap (BYTE drv, DWORD nfatent)
+{
+    if ((drv != DRV_NAND && drv != DRV_MMC)
+        || (nfatent + 31) / 32 * 4 > FREEMAP_SIZE) {
+
+        return 0;
+    }
+
+    return (DWORD *)FREEMAP_ADDR(drv);
+}
+#endif
+
 
 
@@ -10,9 +10,13 @@
 #define DRV_NAND 	0
 #define DRV_MMC 	1
 #define DRV_SDRAM 	2
+#define DRV_SFLASH 	3
+#define DRV_NOR 	4
 
 #define NAND_ROOT_DIRECTORY "0:"
 #define MMC_ROOT_DIRECTORY "1:"
+#define SFLASH_ROOT_DIRECTORY "3:"
+#define NOR_ROOT_DIRECTORY "4:"
 
 
 
@@ -33,15 +37,23 @@ typedef enum {
 	RES_PARERR		/* 4: Invalid Parameter */
 } DRESULT;
 
+/* Sector range of disk_readv() */
+typedef struct {
+	BYTE	*buff;		/* Data buffer */
+	DWORD	sector;		/* First sector */
+	UINT	count;		/* Number of sectors */
+} DISKVEC;
+
 
 /*---------------------------------------*/
 /* Prototypes for disk control functions */
 
 DSTATUS disk_initialize (BYTE);
 DSTATUS disk_status (BYTE);
-DRESULT disk_read (BYTE, BYTE*, DWORD, BYTE);
+DRESULT disk_read (BYTE, BYTE*, DWORD, UINT);
+DRESULT disk_readv (BYTE, const DISKVEC*, UINT);
 #if	_READONLY == 0
-DRESULT disk_write (BYTE, const BYTE*, DWORD, BYTE);
+DRESULT disk_write (BYTE, const BYTE*, DWORD, UINT);
 #endif
 DRESULT disk_ioctl (BYTE, BYTE, void*);
 
@@ -64,6 +76,8 @@ DRESULT disk_ioctl (BYTE, BYTE, void*);
 #define CTRL_POWER			4
 #define CTRL_LOCK			5
 #define CTRL_EJECT			6
+#define CTRL_TRIM			7	/* Discard a sector range {start, end} (for only _USE_TRIM) */
+#define CTRL_MAP			8	/* Get the address of a mapped sector range {start, count, address} (for only _USE_MAP) */
 /* MMC/SDC command */
 #define MMC_GET_TYPE		10
 #define MMC_GET_CSD			11
@@ -85,6 +85,7 @@
 
 #include "ff.h"			/* FatFs configurations and declarations */
 #include "diskio.h"		/* Declarations of low level disk I/O functions */
+#include "prof.h"			/* Boot profiler scopes */
 
 
 /*--------------------------------------------------------------------------
@@ -443,6 +444,85 @@ FRESULT move_window (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Pending discard of freed clusters                      */
+/*-----------------------------------------------------------------------*/
+#if _USE_TRIM && !_FS_READONLY
+static
+void trim_add (
+	FATFS *fs,		/* File system object */
+	DWORD scl,		/* First cluster of a freed run */
+	DWORD ecl		/* Last cluster of the run */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < fs->n_trim; i++) {	/* Join a pending run it touches */
+		if (fs->trim[i][1] + 1 == scl) { fs->trim[i][1] = ecl; return; }
+		if (ecl + 1 == fs->trim[i][0]) { fs->trim[i][0] = scl; return; }
+	}
+	if (fs->n_trim < _TRIM_RANGES) {	/* Else the run is just not discarded */
+		fs->trim[fs->n_trim][0] = scl;
+		fs->trim[fs->n_trim][1] = ecl;
+		fs->n_trim++;
+	}
+}
+
+
+static
+void trim_cancel (
+	FATFS *fs,		/* File system object */
+	DWORD clst		/* Cluster# being allocated again */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < fs->n_trim; i++) {
+		if (clst < fs->trim[i][0] || clst > fs->trim[i][1]) continue;
+		if (fs->trim[i][0] == fs->trim[i][1]) {	/* Drop the run */
+			fs->n_trim--;
+			fs->trim[i][0] = fs->trim[fs->n_trim][0];
+			fs->trim[i][1] = fs->trim[fs->n_trim][1];
+		} else if (clst == fs->trim[i][0]) {
+			fs->trim[i][0]++;
+		} else if (clst == fs->trim[i][1]) {
+			fs->trim[i][1]--;
+		} else {								/* Split the run, or keep its lower part */
+			if (fs->n_trim < _TRIM_RANGES) {
+				fs->trim[fs->n_trim][0] = clst + 1;
+				fs->trim[fs->n_trim][1] = fs->trim[i][1];
+				fs->n_trim++;
+			}
+			fs->trim[i][1] = clst - 1;
+		}
+		break;
+	}
+}
+
+
+static
+void trim_flush (
+	FATFS *fs		/* File system object */
+)
+{
+	DWORD rt[2];
+	UINT i;
+
+
+	for (i = 0; i < fs->n_trim; i++) {
+		rt[0] = (fs->trim[i][0] - 2) * fs->csize + fs->database;
+		rt[1] = (fs->trim[i][1] - 2) * fs->csize + fs->database + fs->csize - 1;
+		disk_ioctl(fs->drv, CTRL_TRIM, rt);
+	}
+	fs->n_trim = 0;
+}
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Clean-up cached data                                                  */
 /*-----------------------------------------------------------------------*/
@@ -472,6 +552,11 @@ FRESULT sync (	/* FR_OK: successful, FR_DISK_ERR: failed */
 		/* Make sure that no pending write process in the physical drive */
 		if (disk_ioctl(fs->drv, CTRL_SYNC, (void*)0) != RES_OK)
 			res = FR_DISK_ERR;
+#if _USE_TRIM
+		/* The freed clusters are discarded only once the FAT and FSInfo
+		   that free them are on the media */
+		if (res == FR_OK) trim_flush(fs);
+#endif
 	}
 
 	return res;
@@ -578,6 +663,17 @@ FRESULT put_fat (
 			res = FR_INT_ERR;
 		}
 		fs->wflag = 1;
+#if _USE_TRIM
+		if (res == FR_OK && val) trim_cancel(fs, clst);	/* In use again: keep its data */
+#endif
+#if _USE_FREEMAP
+		if (res == FR_OK && fs->fmap) {	/* Keep the free cluster bitmap coherent */
+			if (val)
+				fs->fmap[clst / 32] |= 1UL << (clst % 32);
+			else
+				fs->fmap[clst / 32] &= ~(1UL << (clst % 32));
+		}
+#endif
 	}
 
 	return res;
@@ -587,6 +683,117 @@ FRESULT put_fat (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Build and search the free cluster bitmap               */
+/*-----------------------------------------------------------------------*/
+#if _USE_FREEMAP && !_FS_READONLY
+#define FMAP_USED(fs, clst)	((fs)->fmap[(clst) / 32] & (1UL << ((clst) % 32)))
+
+static
+FRESULT fmap_build (	/* FR_OK: bitmap built or not available, !=0: error */
+	FATFS *fs			/* File system object */
+)
+{
+	FRESULT res;
+	DWORD *map, clst, sect, stat, n, nw;
+	UINT i;
+	BYTE *p;
+
+
+	if (fs->fmap) return FR_OK;			/* Already built */
+	map = ff_freemap(fs->drv, fs->n_fatent);
+	if (!map) return FR_OK;				/* No memory, the FAT is scanned */
+
+	nw = (fs->n_fatent + 31) / 32;
+	mem_set(map, 0, (int)(nw * 4));
+	if (fs->n_fatent % 32)				/* Entries past the end are never free */
+		map[nw - 1] = ~0UL << (fs->n_fatent % 32);
+	map[0] |= 3;						/* Entries 0 and 1 are reserved */
+
+	n = 0;
+	if (fs->fs_type == FS_FAT12) {
+		for (clst = 2; clst < fs->n_fatent; clst++) {
+			stat = get_fat(fs, clst);
+			if (stat == 0xFFFFFFFF) return FR_DISK_ERR;
+			if (stat == 1) return FR_INT_ERR;
+			if (stat) map[clst / 32] |= 1UL << (clst % 32); else n++;
+		}
+	} else {							/* FAT16/32: parse the FAT sectors in the window */
+		sect = fs->fatbase;
+		i = 0; p = 0;
+		for (clst = 0; clst < fs->n_fatent; clst++) {
+			if (!i) {
+				res = move_window(fs, sect++);
+				if (res != FR_OK) return res;
+				p = fs->win;
+				i = SS(fs);
+			}
+			if (fs->fs_type == FS_FAT16) {
+				stat = LD_WORD(p);
+				p += 2; i -= 2;
+			} else {
+				stat = LD_DWORD(p) & 0x0FFFFFFF;
+				p += 4; i -= 4;
+			}
+			if (clst < 2) continue;
+			if (stat) map[clst / 32] |= 1UL << (clst % 32); else n++;
+		}
+	}
+
+	fs->fmap = map;
+	fs->free_clust = n;					/* The count is now exact, save it to the FSInfo */
+	if (fs->fs_type == FS_FAT32) fs->fsi_flag = 1;
+
+	return FR_OK;
+}
+
+
+static
+DWORD fmap_find (	/* 0:No free cluster, >=2:Free cluster# */
+	FATFS *fs,		/* File system object */
+	DWORD scl		/* The search starts after this cluster */
+)
+{
+	DWORD ncl, nw, w, cnt, free;
+
+
+	nw = (fs->n_fatent + 31) / 32;
+	ncl = scl + 1;
+	if (ncl >= fs->n_fatent) ncl = 2;
+	w = ncl / 32;
+	free = ~fs->fmap[w] & (~0UL << (ncl % 32));	/* Free entries from ncl in the first word */
+	for (cnt = nw; !free; cnt--) {		/* 32 entries at a time, wrapping around once */
+		if (!cnt) return 0;				/* No free cluster */
+		if (++w >= nw) w = 0;
+		free = ~fs->fmap[w];
+	}
+	for (ncl = w * 32; !(free & 1); ncl++) free >>= 1;
+
+	return ncl;
+}
+#endif /* _USE_FREEMAP && !_FS_READONLY */
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get sector# from cluster#                                             */
+/*-----------------------------------------------------------------------*/
+
+
+DWORD clust2sect (	/* !=0: Sector number, 0: Failed - invalid cluster# */
+	FATFS *fs,		/* File system object */
+	DWORD clst		/* Cluster# to be converted */
+)
+{
+	clst -= 2;
+	if (clst >= (fs->n_fatent - 2)) return 0;		/* Invalid cluster# */
+	return clst * fs->csize + fs->database;
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Remove a cluster chain                                 */
 /*-----------------------------------------------------------------------*/
@@ -599,6 +806,9 @@ FRESULT remove_chain (
 {
 	FRESULT res;
 	DWORD nxt;
+#if _USE_TRIM
+	DWORD scl = clst, ecl = clst;
+#endif
 
 
 	if (clst < 2 || clst >= fs->n_fatent) {	/* Check range */
@@ -617,6 +827,14 @@ FRESULT remove_chain (
 				fs->free_clust++;
 				fs->fsi_flag = 1;
 			}
+#if _USE_TRIM
+			if (ecl + 1 == nxt) {	/* Next cluster is contiguous? */
+				ecl = nxt;
+			} else {				/* End of the run: discard it at the next sync */
+				trim_add(fs, scl, ecl);
+				scl = ecl = nxt;
+			}
+#endif
 			clst = nxt;	/* Next cluster */
 		}
 	}
@@ -641,6 +859,9 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 	DWORD cs, ncl, scl;
 
 
+#if _USE_FREEMAP
+	if (fmap_build(fs) != FR_OK) return 0xFFFFFFFF;
+#endif
 	if (clst == 0) {		/* Create a new chain */
 		scl = fs->last_clust;			/* Get suggested start point */
 		if (!scl || scl >= fs->n_fatent) scl = 1;
@@ -652,8 +873,13 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		scl = clst;
 	}
 
-	ncl = scl;				/* Start cluster */
-	for (;;) {
+#if _USE_FREEMAP
+	if (fs->fmap) {			/* Take the next free cluster from the bitmap */
+		ncl = fmap_find(fs, scl);
+		if (!ncl) return 0;				/* No free cluster */
+	} else
+#endif
+	for (ncl = scl;;) {		/* Scan the FAT from the start cluster */
 		ncl++;							/* Next cluster */
 		if (ncl >= fs->n_fatent) {		/* Wrap around */
 			ncl = 2;
@@ -686,24 +912,6 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 
 
 
-/*-----------------------------------------------------------------------*/
-/* Get sector# from cluster#                                             */
-/*-----------------------------------------------------------------------*/
-
-
-DWORD clust2sect (	/* !=0: Sector number, 0: Failed - invalid cluster# */
-	FATFS *fs,		/* File system object */
-	DWORD clst		/* Cluster# to be converted */
-)
-{
-	clst -= 2;
-	if (clst >= (fs->n_fatent - 2)) return 0;		/* Invalid cluster# */
-	return clst * fs->csize + fs->database;
-}
-
-
-
-
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Set directory index                              */
 /*-----------------------------------------------------------------------*/
@@ -991,6 +1199,140 @@ BYTE sum_sfn (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Directory entry cache                            */
+/*-----------------------------------------------------------------------*/
+#if _USE_DIRCACHE
+
+static
+DCENT* dc_bucket (	/* Pointer to the first way of the bucket */
+	FATFS *fs,		/* File system object */
+	DWORD sclust,	/* Directory start cluster */
+	const BYTE *name	/* SFN */
+)
+{
+	DWORD h = sclust;
+	UINT i;
+
+
+	for (i = 0; i < 11; i++) h = h * 31 + name[i];
+	return &fs->dcache[h % (_DIRCACHE_SIZE / 2) * 2];
+}
+
+
+static
+int dc_match (	/* 1:The slot holds the name */
+	const DCENT *e,
+	DWORD sclust,
+	const BYTE *name
+)
+{
+	return e->used && e->sclust == sclust && !mem_cmp(e->name, name, 11);
+}
+
+
+static
+void dc_unfull (	/* The directory is no longer fully indexed */
+	FATFS *fs,
+	DWORD sclust
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < _DIRCACHE_DIRS; i++)
+		if (fs->dc_full[i] == sclust) fs->dc_full[i] = 0xFFFFFFFF;
+}
+
+
+static
+void dc_setfull (	/* Mark the directory fully indexed */
+	FATFS *fs,
+	DWORD sclust
+)
+{
+	dc_unfull(fs, sclust);
+	fs->dc_full[fs->dc_next] = sclust;
+	if (++fs->dc_next >= _DIRCACHE_DIRS) fs->dc_next = 0;
+}
+
+
+static
+int dc_put (	/* 1:An entry of the same directory was evicted */
+	FATFS *fs,		/* File system object */
+	DWORD sclust,	/* Directory start cluster */
+	const BYTE *name,	/* SFN */
+	WORD index		/* Entry index in the directory */
+)
+{
+	DCENT *e = dc_bucket(fs, sclust, name);
+	int lost = 0;
+
+
+	if (!dc_match(&e[0], sclust, name)) {	/* Keep the bucket in LRU order */
+		if (e[1].used && !dc_match(&e[1], sclust, name)) {	/* Evict the oldest way */
+			if (e[1].sclust == sclust) lost = 1;
+			dc_unfull(fs, e[1].sclust);
+		}
+		e[1] = e[0];
+	}
+	e[0].sclust = sclust;
+	e[0].index = index;
+	mem_cpy(e[0].name, name, 11);
+	e[0].used = 1;
+
+	return lost;
+}
+
+
+#if !_FS_READONLY
+static
+void dc_drop (	/* Remove a name from the cache */
+	FATFS *fs,
+	DWORD sclust,
+	const BYTE *name
+)
+{
+	DCENT *e = dc_bucket(fs, sclust, name);
+
+
+	if (dc_match(&e[0], sclust, name)) e[0].used = 0;
+	if (dc_match(&e[1], sclust, name)) e[1].used = 0;
+}
+#endif
+
+
+static
+int dc_find (	/* 1:Found (dj points the entry), 0:Not in the directory, -1:Unknown */
+	DIR *dj			/* Pointer to the directory object linked to the file name */
+)
+{
+	DCENT *e = dc_bucket(dj->fs, dj->sclust, dj->fn);
+	BYTE *dir;
+	UINT i;
+
+
+	if (!dc_match(e, dj->sclust, dj->fn)) e++;
+	if (dc_match(e, dj->sclust, dj->fn)) {	/* Cached: check the entry is still there */
+		if (dir_sdi(dj, e->index) == FR_OK && move_window(dj->fs, dj->sect) == FR_OK) {
+			dir = dj->dir;
+			if (!(dir[DIR_Attr] & AM_VOL) && !mem_cmp(dir, dj->fn, 11)) return 1;
+		}
+		e->used = 0;					/* Stale, scan the directory again */
+		dc_unfull(dj->fs, dj->sclust);
+		return -1;
+	}
+
+	for (i = 0; i < _DIRCACHE_DIRS; i++)	/* Not cached: absent if the directory is fully indexed */
+		if (dj->fs->dc_full[i] == dj->sclust) return 0;
+
+	return -1;
+}
+#endif /* _USE_DIRCACHE */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Find an object in the directory                  */
 /*-----------------------------------------------------------------------*/
@@ -1005,6 +1347,14 @@ FRESULT dir_find (
 #if _USE_LFN
 	BYTE a, ord, sum;
 #endif
+#if _USE_DIRCACHE
+	int lost = 0;
+
+	switch (dc_find(dj)) {			/* Try the directory entry cache first */
+	case 1: return FR_OK;
+	case 0: return FR_NO_FILE;
+	}
+#endif
 
 	res = dir_sdi(dj, 0);			/* Rewind directory object */
 	if (res != FR_OK) return res;
@@ -1040,12 +1390,21 @@ FRESULT dir_find (
 			}
 		}
 #else		/* Non LFN configuration */
+#if _USE_DIRCACHE
+		if (c != 0xE5 && !(dir[DIR_Attr] & AM_VOL))	/* Index every valid entry on the way */
+			lost |= dc_put(dj->fs, dj->sclust, dir, dj->index);
+#endif
 		if (!(dir[DIR_Attr] & AM_VOL) && !mem_cmp(dir, dj->fn, 11)) /* Is it a valid entry? */
 			break;
 #endif
 		res = dir_next(dj, 0);		/* Next entry */
 	} while (res == FR_OK);
 
+#if _USE_DIRCACHE
+	if (res == FR_NO_FILE && !lost)	/* Scanned to the end: every entry is in the cache */
+		dc_setfull(dj->fs, dj->sclust);
+#endif
+
 	return res;
 }
 
@@ -1205,6 +1564,9 @@ FRESULT dir_register (	/* FR_OK:Successful, FR_DENIED:No free entry or too many
 			dir[DIR_NTres] = *(dj->fn+NS) & (NS_BODY | NS_EXT);	/* Put NT flag */
 #endif
 			dj->fs->wflag = 1;
+#if _USE_DIRCACHE
+			dc_put(dj->fs, dj->sclust, dir, dj->index);	/* Index the new entry */
+#endif
 		}
 	}
 
@@ -1247,6 +1609,11 @@ FRESULT dir_remove (	/* FR_OK: Successful, FR_DISK_ERR: A disk error */
 	if (res == FR_OK) {
 		res = move_window(dj->fs, dj->sect);
 		if (res == FR_OK) {
+#if _USE_DIRCACHE
+			dc_drop(dj->fs, dj->sclust, dj->dir);	/* Forget the entry */
+			if (dj->dir[DIR_Attr] & AM_DIR)		/* and the content of a removed directory */
+				dc_unfull(dj->fs, ((DWORD)LD_WORD(dj->dir+DIR_FstClusHI) << 16) | LD_WORD(dj->dir+DIR_FstClusLO));
+#endif
 			*dj->dir = 0xE5;			/* Mark the entry "deleted" */
 			dj->fs->wflag = 1;
 		}
@@ -1778,6 +2145,12 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 	/* Initialize cluster allocation information */
 	fs->free_clust = 0xFFFFFFFF;
 	fs->last_clust = 0;
+#if _USE_FREEMAP
+	fs->fmap = 0;			/* The bitmap is rebuilt on first need */
+#endif
+#if _USE_TRIM
+	fs->n_trim = 0;			/* Runs freed before a remount are not discarded */
+#endif
 
 	/* Get fsinfo if available */
 	if (fmt == FS_FAT32) {
@@ -1803,6 +2176,12 @@ FRESULT chk_mounted (	/* FR_OK(0): successful, !=0: any error occurred */
 	for (vol = 0; vol < _FS_SHARE; vol++)
 		fs->flsem[vol].ctr = 0;
 #endif
+#if _USE_DIRCACHE			/* Clear the directory entry cache */
+	mem_set(fs->dcache, 0, sizeof(fs->dcache));
+	for (vol = 0; vol < _DIRCACHE_DIRS; vol++)
+		fs->dc_full[vol] = 0xFFFFFFFF;
+	fs->dc_next = 0;
+#endif
 
 	return FR_OK;
 }
@@ -1893,6 +2272,7 @@ FRESULT f_open (
 	DIR dj;
 	BYTE *dir;
 	DEF_NAMEBUF;
+	PROF_SCOPE(PROF_F_OPEN);
 
 
 	fp->fs = 0;			/* Clear file object */
@@ -2026,6 +2406,7 @@ FRESULT f_read (
 	DWORD clst, sect, remain;
 	UINT rcnt, cc;
 	BYTE csect, *rbuff = buff;
+	PROF_SCOPE(PROF_F_READ);
 
 
 	*br = 0;	/* Initialize byte counter */
@@ -2055,9 +2436,17 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fp->fs);					/* When remaining bytes >= sector size, */
 			if (cc) {								/* Read maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)		/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
-				if (disk_read(fp->fs->drv, rbuff, sect, (BYTE)cc) != RES_OK)
+				if (csect + cc > fp->fs->csize) {	/* Clip at the end of the contiguous cluster run */
+					remain = fp->fs->csize - csect;
+					while (remain < cc) {
+						clst = get_fat(fp->fs, fp->curr_clust);
+						if (clst != fp->curr_clust + 1) break;
+						fp->curr_clust = clst;
+						remain += fp->fs->csize;
+					}
+					if (remain < cc) cc = (UINT)remain;
+				}
+				if (disk_read(fp->fs->drv, rbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
 #if !_FS_READONLY && _FS_MINIMIZE <= 2				/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
@@ -2116,10 +2505,11 @@ FRESULT f_write (
 )
 {
 	FRESULT res;
-	DWORD clst, sect;
+	DWORD clst, sect, remain;
 	UINT wcnt, cc;
 	const BYTE *wbuff = buff;
 	BYTE csect;
+	PROF_SCOPE(PROF_F_WRITE);
 
 
 	*bw = 0;	/* Initialize byte counter */
@@ -2164,9 +2554,17 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fp->fs);					/* When remaining bytes >= sector size, */
 			if (cc) {								/* Write maximum contiguous sectors directly */
-				if (csect + cc > fp->fs->csize)		/* Clip at cluster boundary */
-					cc = fp->fs->csize - csect;
-				if (disk_write(fp->fs->drv, wbuff, sect, (BYTE)cc) != RES_OK)
+				if (csect + cc > fp->fs->csize) {	/* Clip at the end of the contiguous cluster run */
+					remain = fp->fs->csize - csect;
+					while (remain < cc) {			/* (the run is already allocated, e.g. by f_prealloc) */
+						clst = get_fat(fp->fs, fp->curr_clust);
+						if (clst != fp->curr_clust + 1) break;
+						fp->curr_clust = clst;
+						remain += fp->fs->csize;
+					}
+					if (remain < cc) cc = (UINT)remain;
+				}
+				if (disk_write(fp->fs->drv, wbuff, sect, cc) != RES_OK)
 					ABORT(fp->fs, FR_DISK_ERR);
 #if _FS_TINY
 				if (fp->fs->winsect - sect < cc) {	/* Refill sector cache if it gets dirty by the direct write */
@@ -2229,6 +2627,7 @@ FRESULT f_sync (
 	FRESULT res;
 	DWORD tim;
 	BYTE *dir;
+	PROF_SCOPE(PROF_F_SYNC);
 
 
 	res = validate(fp->fs, fp->id);		/* Check validity of the object */
@@ -2372,6 +2771,7 @@ FRESULT f_lseek (
 )
 {
 	FRESULT res;
+	PROF_SCOPE(PROF_F_LSEEK);
 
 
 	res = validate(fp->fs, fp->id);		/* Check validity of the object */
@@ -2663,6 +3063,12 @@ FRESULT f_getfree (
 	res = chk_mounted(&path, fatfs, 0);
 	if (res == FR_OK) {
 		/* If free_clust is valid, return it without full cluster scan */
+#if _USE_FREEMAP
+		/* Building the bitmap counts the free clusters */
+		if ((*fatfs)->free_clust > (*fatfs)->n_fatent - 2)
+			res = fmap_build(*fatfs);
+		if (res != FR_OK) LEAVE_FF(*fatfs, res);
+#endif
 		if ((*fatfs)->free_clust <= (*fatfs)->n_fatent - 2) {
 			*nclst = (*fatfs)->free_clust;
 		} else {
@@ -2756,6 +3162,199 @@ FRESULT f_truncate (
 
 
 
+#if _USE_PREALLOC
+/*-----------------------------------------------------------------------*/
+/* Preallocate a Contiguous Cluster Chain to the File                    */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_prealloc (
+	FIL *fp,		/* Pointer to the file object (must be empty) */
+	DWORD fsz		/* Final file size in unit of byte */
+)
+{
+	FRESULT res;
+	DWORD n, cs, clst, scl, stcl, ncl;
+
+
+	res = validate(fp->fs, fp->id);		/* Check validity of the object */
+	if (res == FR_OK) {
+		if (fp->flag & FA__ERROR) {			/* Check abort flag */
+			res = FR_INT_ERR;
+		} else {
+			if (!(fp->flag & FA_WRITE) || fsz == 0 || fp->fsize || fp->org_clust)
+				res = FR_DENIED;			/* Check access mode and that the file is empty */
+		}
+	}
+#if _USE_FREEMAP
+	if (res == FR_OK) res = fmap_build(fp->fs);
+#endif
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+
+	n = (fsz - 1) / ((DWORD)fp->fs->csize * SS(fp->fs)) + 1;	/* Number of clusters required */
+	stcl = fp->fs->last_clust;			/* Start the scan at the allocation point */
+	if (stcl < 2 || stcl >= fp->fs->n_fatent) stcl = 2;
+
+	scl = clst = stcl; ncl = 0;			/* Find a run of n free clusters in one pass */
+	for (;;) {
+#if _USE_FREEMAP
+		if (fp->fs->fmap)
+			cs = FMAP_USED(fp->fs, clst) ? 2 : 0;
+		else
+#endif
+		cs = get_fat(fp->fs, clst);
+		if (cs == 1) { res = FR_INT_ERR; break; }
+		if (cs == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
+		if (cs == 0) {						/* Free cluster: grow the run */
+			if (++ncl == n) break;
+		} else {							/* Used cluster: restart the run after it */
+			scl = clst + 1; ncl = 0;
+		}
+		if (++clst >= fp->fs->n_fatent) {	/* Wrap around (a run cannot cross the end) */
+			scl = clst = 2; ncl = 0;
+		}
+		if (clst == stcl) { res = FR_DENIED; break; }	/* No contiguous space */
+	}
+
+	if (res == FR_OK) {					/* Link the run in the FAT (sequential, so mostly in the window) */
+		for (clst = scl; clst < scl + n - 1 && res == FR_OK; clst++)
+			res = put_fat(fp->fs, clst, clst + 1);
+		if (res == FR_OK) res = put_fat(fp->fs, clst, 0x0FFFFFFF);
+		if (res == FR_OK) {
+			fp->org_clust = scl;			/* The file now owns the run */
+			fp->fsize = fsz;
+			fp->flag |= FA__WRITTEN;
+			fp->fs->last_clust = clst;		/* Update FSINFO */
+			if (fp->fs->free_clust != 0xFFFFFFFF) {
+				fp->fs->free_clust -= n;
+				fp->fs->fsi_flag = 1;
+			}
+		} else {
+			fp->flag |= FA__ERROR;
+		}
+	}
+
+	LEAVE_FF(fp->fs, res);
+}
+#endif /* _USE_PREALLOC */
+
+
+
+
+#if _USE_MAP
+/*-----------------------------------------------------------------------*/
+/* Get the Address of the Data of a File on a Mapped Drive               */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_map (
+	FIL *fp,		/* Pointer to the file object */
+	const BYTE **pp	/* Pointer to the variable to return the address of the data */
+)
+{
+	FRESULT res;
+	DWORD n, clst, nxt, mp[3];
+
+
+	*pp = 0;
+	res = validate(fp->fs, fp->id);		/* Check validity of the object */
+	if (res == FR_OK) {
+		if (fp->flag & FA__ERROR) {			/* Check abort flag */
+			res = FR_INT_ERR;
+		} else {
+			if (fp->fsize == 0) res = FR_DENIED;
+#if !_FS_READONLY
+			if (fp->flag & FA_WRITE)
+				res = FR_DENIED;			/* Only the data of a file opened to read is stable */
+#endif
+		}
+	}
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+
+	n = (fp->fsize - 1) / ((DWORD)fp->fs->csize * SS(fp->fs));	/* Links to follow */
+	clst = fp->org_clust;
+	while (n--) {						/* The chain must be one run of clusters */
+		nxt = get_fat(fp->fs, clst);
+		if (nxt == 1) LEAVE_FF(fp->fs, FR_INT_ERR);
+		if (nxt == 0xFFFFFFFF) LEAVE_FF(fp->fs, FR_DISK_ERR);
+		if (nxt != clst + 1) LEAVE_FF(fp->fs, FR_DENIED);	/* Fragmented file */
+		clst = nxt;
+	}
+
+	mp[0] = clust2sect(fp->fs, fp->org_clust);
+	mp[1] = (fp->fsize + SS(fp->fs) - 1) / SS(fp->fs);
+	if (!mp[0]) LEAVE_FF(fp->fs, FR_INT_ERR);
+	if (disk_ioctl(fp->fs->drv, CTRL_MAP, mp) != RES_OK || !mp[2])
+		LEAVE_FF(fp->fs, FR_DENIED);	/* The drive is not mapped */
+
+	*pp = (const BYTE*)mp[2];
+	LEAVE_FF(fp->fs, FR_OK);
+}
+#endif /* _USE_MAP */
+
+
+
+
+#if _USE_EXTENT
+/*-----------------------------------------------------------------------*/
+/* Get the Sectors of the Contiguous Data at the File Pointer            */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_extent (
+	FIL *fp,		/* Pointer to the file object */
+	UINT btr,		/* Number of bytes to take at most */
+	DWORD *ext		/* Pointer to the {first sector, number of bytes} returned */
+)
+{
+	FRESULT res;
+	DWORD clst, remain;
+	BYTE csect;
+
+
+	ext[0] = ext[1] = 0;
+	res = validate(fp->fs, fp->id);		/* Check validity of the object */
+	if (res != FR_OK) LEAVE_FF(fp->fs, res);
+	if (fp->flag & FA__ERROR)			/* Check abort flag */
+		LEAVE_FF(fp->fs, FR_INT_ERR);
+	if (!(fp->flag & FA_READ))			/* Check access mode */
+		LEAVE_FF(fp->fs, FR_DENIED);
+#if !_FS_READONLY
+	if (fp->flag & FA_WRITE)
+		LEAVE_FF(fp->fs, FR_DENIED);	/* Data of a file opened to write can be in its buffer */
+#endif
+	if (fp->fptr % SS(fp->fs))
+		LEAVE_FF(fp->fs, FR_DENIED);	/* Not on a sector boundary */
+	remain = fp->fsize - fp->fptr;
+	if (btr > remain) btr = (UINT)remain;	/* Truncate btr by remaining bytes */
+	if (!btr) LEAVE_FF(fp->fs, FR_OK);
+
+	csect = (BYTE)(fp->fptr / SS(fp->fs) & (fp->fs->csize - 1));	/* Sector offset in the cluster */
+	if (!csect) {						/* On the cluster boundary? */
+		clst = (fp->fptr == 0) ?		/* On the top of the file? */
+			fp->org_clust : get_fat(fp->fs, fp->curr_clust);
+		if (clst <= 1) ABORT(fp->fs, FR_INT_ERR);
+		if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
+		fp->curr_clust = clst;			/* Update current cluster */
+	}
+	ext[0] = clust2sect(fp->fs, fp->curr_clust);
+	if (!ext[0]) ABORT(fp->fs, FR_INT_ERR);
+	ext[0] += csect;
+	ext[1] = (DWORD)(fp->fs->csize - csect) * SS(fp->fs);	/* Rest of the cluster */
+	while (ext[1] < btr) {				/* Extend over the contiguous cluster run */
+		clst = get_fat(fp->fs, fp->curr_clust);
+		if (clst == 0xFFFFFFFF) ABORT(fp->fs, FR_DISK_ERR);
+		if (clst != fp->curr_clust + 1) break;
+		fp->curr_clust = clst;
+		ext[1] += (DWORD)fp->fs->csize * SS(fp->fs);
+	}
+	if (ext[1] > btr) ext[1] = btr;
+	fp->fptr += ext[1];					/* Move the file pointer past the data */
+
+	LEAVE_FF(fp->fs, FR_OK);
+}
+#endif /* _USE_EXTENT */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Delete a File or Directory                                            */
 /*-----------------------------------------------------------------------*/
@@ -281,6 +281,20 @@ typedef struct {
 
 
 
+#if _USE_DIRCACHE
+#if _USE_LFN
+#error _USE_DIRCACHE must be 0 on LFN cfg.
+#endif
+typedef struct {
+	DWORD	sclust;			/* Directory start cluster (0:root) */
+	WORD	index;			/* Entry index in the directory */
+	BYTE	name[11];		/* SFN of the entry */
+	BYTE	used;			/* 1:Valid slot */
+} DCENT;
+#endif
+
+
+
 /* File system object structure (FATFS) */
 
 typedef struct {
@@ -302,6 +316,13 @@ typedef struct {
 	DWORD	last_clust;		/* Last allocated cluster */
 	DWORD	free_clust;		/* Number of free clusters */
 	DWORD	fsi_sector;		/* fsinfo sector (FAT32) */
+#if _USE_FREEMAP
+	DWORD*	fmap;			/* Free cluster bitmap (1:used), 0:not built */
+#endif
+#if _USE_TRIM
+	DWORD	trim[_TRIM_RANGES][2];	/* Freed cluster runs {first, last} to discard at sync */
+	UINT	n_trim;			/* Number of runs in trim[] */
+#endif
 #endif
 #if _FS_RPATH
 	DWORD	cdir;			/* Current directory start cluster (0:root) */
@@ -316,6 +337,11 @@ typedef struct {
 #if _FS_SHARE
 	FILESEM	flsem[_FS_SHARE];	/* File lock semaphores */
 #endif
+#if _USE_DIRCACHE
+	DCENT	dcache[_DIRCACHE_SIZE];	/* Directory entry cache (2-way buckets) */
+	DWORD	dc_full[_DIRCACHE_DIRS];	/* Fully indexed directories (0xFFFFFFFF:none) */
+	BYTE	dc_next;		/* Next dc_full[] slot to replace */
+#endif
 } FATFS;
 
 
@@ -435,6 +461,15 @@ FRESULT f_rename (const TCHAR*, const TCHAR*);		/* Rename/Move a file or directo
 #if _USE_FORWARD
 FRESULT f_forward (FIL*, UINT(*)(const BYTE*,UINT), UINT, UINT*);	/* Forward data to the stream */
 #endif
+#if _USE_PREALLOC
+FRESULT f_prealloc (FIL*, DWORD);					/* Allocate a contiguous cluster chain to an empty file */
+#endif
+#if _USE_MAP
+FRESULT f_map (FIL*, const BYTE**);					/* Get the address of the data of a file on a mapped drive */
+#endif
+#if _USE_EXTENT
+FRESULT f_extent (FIL*, UINT, DWORD*);				/* Get the sectors of the contiguous data at the file pointer */
+#endif
 #if _USE_MKFS
 FRESULT f_mkfs (BYTE, BYTE, UINT);					/* Create a file system on the drive */
 #endif
@@ -464,6 +499,11 @@ TCHAR* f_gets (TCHAR*, int, FIL*);					/* Get a string from the file */
 DWORD get_fattime (void);
 #endif
 
+/* Free cluster bitmap memory */
+#if _USE_FREEMAP && !_FS_READONLY
+DWORD* ff_freemap (BYTE, DWORD);	/* Get (n_fatent + 31) / 32 words for a drive, 0:not available */
+#endif
+
 /* Unicode support functions */
 #if _USE_LFN						/* Unicode - OEM code conversion */
 WCHAR ff_convert (WCHAR, UINT);		/* OEM-Unicode bidirectional conversion */
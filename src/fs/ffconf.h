@@ -31,8 +31,8 @@
 /* The _FS_MINIMIZE option defines minimization level to remove some functions.
 /
 /   0: Full function.
-/   1: f_stat, f_getfree, f_unlink, f_mkdir, f_chmod, f_truncate and f_rename
-/      are removed.
+/   1: f_stat, f_getfree, f_unlink, f_mkdir, f_chmod, f_truncate, f_prealloc
+/      and f_rename are removed.
 /   2: f_opendir and f_readdir are removed in addition to level 1.
 /   3: f_lseek is removed in addition to level 2. */
 
@@ -53,6 +53,56 @@
 /* To enable fast seek feature, set _USE_FASTSEEK to 1. */
 
 
+#define	_USE_FREEMAP	1	/* 0:Disable or 1:Enable */
+/* To enable the free cluster bitmap, set _USE_FREEMAP to 1 and set _FS_READONLY
+/  to 0. The bitmap is built with one pass over the FAT on first need, in the
+/  memory returned by the user defined ff_freemap function, and is then kept up
+/  to date by every FAT update. Cluster allocation and f_getfree do not scan the
+/  FAT any more, and the exact free cluster count is saved to the FSInfo. */
+
+
+#define	_USE_DIRCACHE	1	/* 0:Disable or 1:Enable */
+#define	_DIRCACHE_SIZE	32	/* Cached entries per volume (even number) */
+#define	_DIRCACHE_DIRS	4	/* Fully indexed directories per volume */
+/* To enable the directory entry cache, set _USE_DIRCACHE to 1 and _USE_LFN to 0.
+/  Every entry seen while scanning a directory is indexed in a hash table from
+/  (directory, SFN) to the entry index, so that the next lookup of the name is
+/  one probe. Once a directory has been scanned to its end without losing an
+/  entry to a collision, a name missing from the table is known to be absent
+/  and the lookup fails without scanning. */
+
+
+#define	_USE_PREALLOC	1	/* 0:Disable or 1:Enable */
+/* To enable f_prealloc function, set _USE_PREALLOC to 1 and set _FS_READONLY to 0.
+/  f_prealloc reserves a contiguous cluster chain for the final size of an empty
+/  file so that f_write streams multi-sector writes into it and the file is read
+/  back as a single run. */
+
+
+#define	_USE_TRIM	1	/* 0:Disable or 1:Enable */
+#define	_TRIM_RANGES	8	/* Freed cluster runs held per volume until the sync */
+/* To enable the discard of freed clusters, set _USE_TRIM to 1 and set _FS_READONLY
+/  to 0. remove_chain then records each run of contiguous freed clusters in the
+/  volume, and the next sync issues a CTRL_TRIM disk_ioctl for each run after the
+/  FAT, the FSInfo and the CTRL_SYNC, so that a power loss never leaves a FAT on
+/  the media that still points to discarded data. A run allocated again before
+/  the sync is withdrawn; runs beyond _TRIM_RANGES are simply not discarded. */
+
+
+#define	_USE_MAP	1	/* 0:Disable or 1:Enable */
+/* To enable f_map function, set _USE_MAP to 1. f_map returns the address of the
+/  data of a file stored in one run of clusters on a drive mapped in the memory
+/  space (CTRL_MAP disk_ioctl), so that it is used in place instead of being
+/  read through sector buffers. */
+
+
+#define	_USE_EXTENT	1	/* 0:Disable or 1:Enable */
+/* To enable f_extent function, set _USE_EXTENT to 1. f_extent returns the first
+/  sector and the length of the contiguous data at the file pointer and moves the
+/  pointer past it without reading the data, so that the caller gathers the
+/  fragments of a file and reads them together with disk_readv. */
+
+
 
 /*---------------------------------------------------------------------------/
 / Locale and Namespace Configurations
@@ -122,7 +172,7 @@
 / Physical Drive Configurations
 /----------------------------------------------------------------------------*/
 
-#define _DRIVES		3
+#define _DRIVES		5
 /* Number of volumes (logical drives) to be used. */
 
 
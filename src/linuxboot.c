@@ -4,6 +4,9 @@
 -----------------------------------------------------------------------------*/
 //#include "types.h"
 #include "linuxboot.h"
+#include "download.h"
+#include <stdio.h>
+#include <string.h>
 
 /*---------------------------------------------------------------------------
                              LOCAL DEFINED CONSTANTS
@@ -25,6 +28,7 @@ static void setup_initrd2_tag(unsigned int start, unsigned int size);
 static void setup_mem_tag(unsigned int start, unsigned int len);
 static void setup_cmdline_tag(const char *line);
 static void setup_end_tag(void);
+static unsigned int be32(unsigned int value);
 
 /*---------------------------------------------------------------------------
   Function   : bootlinux
@@ -72,6 +76,84 @@ void bootlinux(LINUX_MACHINE_PARMS *lparms)
 	theKernel(0, lparms->machine, parm_at);
 }
 
+/*---------------------------------------------------------------------------
+  Function   : check_xip_image
+  Purpose    : Validates an execute-in-place kernel stored in memory-mapped
+               flash as an uncompressed u-boot image ("mkimage -A arm -O linux
+               -T kernel -C none -a <data> -e <entry>"), the data being
+               linked to run where it is stored
+  Parameters : addr      - Address of the image header in the flash
+               max_size  - Size of the flash partition holding the image
+               entry     - Returns the entry point of the kernel
+  Returns    : Returns the length of the kernel in bytes, 0 if the image is
+               not a valid XIP kernel
+  Notes      : Only the header is checked unless built with XIP_CHECK_DATA:
+               the data CRC reads the whole kernel from the flash
+-----------------------------------------------------------------------------*/
+unsigned int check_xip_image(unsigned int addr, unsigned int max_size, unsigned int *entry)
+{
+	const uimage_hdr *uip = (const uimage_hdr *)addr;
+	uimage_hdr hdr;
+	unsigned int data = addr + sizeof(uimage_hdr);
+	unsigned int size;
+
+	if (be32(uip->ih_magic) != IH_MAGIC)
+		return 0;
+
+	/* Header CRC, computed with the CRC field cleared */
+	memcpy(&hdr, uip, sizeof(hdr));
+	hdr.ih_hcrc = 0;
+	if (Download_Crc32(0, (const uint8_t *)&hdr, sizeof(hdr)) != be32(uip->ih_hcrc)) {
+		printf("-E- XIP: bad header CRC\n\r");
+		return 0;
+	}
+
+	if (uip->ih_os != IH_OS_LINUX || uip->ih_arch != IH_ARCH_ARM
+	    || uip->ih_type != IH_TYPE_KERNEL || uip->ih_comp != IH_COMP_NONE) {
+		printf("-E- XIP: not an uncompressed ARM Linux kernel\n\r");
+		return 0;
+	}
+
+	size = be32(uip->ih_size);
+	if (size > max_size - sizeof(uimage_hdr)) {
+		printf("-E- XIP: kernel larger than its partition\n\r");
+		return 0;
+	}
+
+	/* The kernel text runs in place: it must be linked where it is stored */
+	if (be32(uip->ih_load) != data) {
+		printf("-E- XIP: kernel linked at 0x%x, stored at 0x%x\n\r", be32(uip->ih_load), data);
+		return 0;
+	}
+	if (be32(uip->ih_ep) < data || be32(uip->ih_ep) >= data + size) {
+		printf("-E- XIP: entry point 0x%x out of the kernel\n\r", be32(uip->ih_ep));
+		return 0;
+	}
+
+#if defined(XIP_CHECK_DATA)
+	if (Download_Crc32(0, (const uint8_t *)data, size) != be32(uip->ih_dcrc)) {
+		printf("-E- XIP: bad data CRC\n\r");
+		return 0;
+	}
+#endif
+
+	printf("-I- XIP kernel \"%.32s\", %u bytes at 0x%x\n\r", uip->ih_name, size, data);
+	*entry = be32(uip->ih_ep);
+	return size;
+}
+
+/*---------------------------------------------------------------------------
+  Function   : be32
+  Purpose    : Converts a big endian word of an image header
+  Parameters : value  - Word as read from the header
+  Returns    : The word in the CPU byte order
+  Notes      : None
+-----------------------------------------------------------------------------*/
+static unsigned int be32(unsigned int value)
+{
+	return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+}
+
 /*---------------------------------------------------------------------------
   Function   : setup_core_tag
   Purpose    : Initialises the Linux core tag
@@ -22,6 +22,13 @@
 
 #define ATAG_CMD_LINE_LEN	64
 
+/* u-boot image header (mkimage), fields in big endian */
+#define IH_MAGIC			0x27051956
+#define IH_OS_LINUX			5
+#define IH_ARCH_ARM			2
+#define IH_TYPE_KERNEL		2
+#define IH_COMP_NONE		0
+
 #define C1_DC				(1 << 2)		/* dcache off/on */
 #define C1_IC				(1 << 12)		/* icache off/on */
 
@@ -155,5 +162,6 @@ struct atag
                               GLOBAL FUNCTION PROTOTYPES
 -----------------------------------------------------------------------------*/
 void bootlinux(LINUX_MACHINE_PARMS *lparms);
+unsigned int check_xip_image(unsigned int addr, unsigned int max_size, unsigned int *entry);
 
 #endif /* LINUX_H_ */
@@ -10,6 +10,7 @@
 #include <string.h>
 #include "ff.h"
 #include "diskio.h"
+#include "memories.h"
 #include "Media_Init.h"
 #include "linuxboot.h"
 
@@ -18,11 +19,105 @@
 
 #define ZIMAGE_LOAD_ADDR	(SRAM_BASE + 0x008000)
 #define RAMDISK_LOAD_ADDR	(SRAM_BASE + 0x800000)
+
+/* Largest images: the ramdisk ends below the areas of the SDRAM map
+   (board_sdram.h) that the download ring, the SD write-back windows and the
+   FAT free-cluster bitmaps take */
+#define ZIMAGE_MAX_SIZE		(RAMDISK_LOAD_ADDR - ZIMAGE_LOAD_ADDR)
+#define RAMDISK_MAX_SIZE	(BOARD_SDRAM_RING_ADDR - RAMDISK_LOAD_ADDR)
+
+/* Boot events */
+#define EVENT_NAND_DONE		(1 << 0)
+#define EVENT_SD_DONE		(1 << 1)
+#define EVENT_LCD_DONE		(1 << 2)
+#define EVENT_SPLASH_DONE	(1 << 3)
+#define EVENT_LCD_FILL		(1 << 4)
+
+/* Splash screen drawn from the SD card before the kernel is loaded */
+#define SPLASH_FILE			"splash.bmp"
+
+/* Time given at boot to press one of the keys below, in ms. By default no
+   time is given: only a key already received by the console is taken (hold
+   it down during the reset). Build with -DBOOT_KEY_WINDOW_MS=500 to prompt
+   for a key. */
+#ifndef BOOT_KEY_WINDOW_MS
+#define BOOT_KEY_WINDOW_MS	0
+#endif
+
+/* Cortex-M3 DWT cycle counter */
+#define DWT_CTRL			(*(volatile uint32_t*)0xE0001000)
+#define DWT_CYCCNT			(*(volatile uint32_t*)0xE0001004)
+#define DWT_CTRL_CYCCNTENA	(1 << 0)
+
+/* Storage benchmark, entered with BENCH_KEY on the console at boot. The
+   kernel and ramdisk areas are free then and hold the buffers. */
+#define BENCH_KEY			'b'
+#define BENCH_AREA_SIZE		(4 * 1024 * 1024)
+#define BENCH_SHADOW_ADDR	RAMDISK_LOAD_ADDR
+#define BENCH_BUFFER_ADDR	(RAMDISK_LOAD_ADDR + BENCH_AREA_SIZE)
+#define BENCH_BUFFER_SIZE	(1024 * 1024)
+#define BENCH_FILE			"BENCH.DAT"
+
+/* Serial download, entered with DOWNLOAD_KEY on the console at boot (host
+   tool: resources/host/dload.c). The PDC receives the frames in the two
+   halves of a ring in the BOARD_SDRAM_RING area, each half re-armed once consumed;
+   the ring is larger than the host window so it never overruns. */
+#define DOWNLOAD_KEY		'd'
+#define DOWNLOAD_USART		USART0
+#define DOWNLOAD_USART_ID	ID_USART0
+#define DOWNLOAD_BAUDRATE	921600
+#define DOWNLOAD_RING_SIZE	BOARD_SDRAM_RING_SIZE
+#define DOWNLOAD_RING_ADDR	BOARD_SDRAM_RING_ADDR
+
+/* Network boot, entered with NETBOOT_KEY on the console at boot, or at every
+   boot when built with -DNETBOOT_ALWAYS: the kernel and ramdisk are fetched
+   with TFTP straight to their load addresses (host test bench:
+   resources/host/netsim.c). The client and its receive ring take the
+   BOARD_SDRAM_RING area, like the download ring. */
+#define NETBOOT_KEY			'n'
+#define NETBOOT_IP			NETBOOT_ADDRESS( 192, 168, 1, 10 )
+#define NETBOOT_SERVER		NETBOOT_ADDRESS( 192, 168, 1, 1 )
+#define NETBOOT_MAC			{ 0x00, 0x04, 0x25, 0x1C, 0xA0, 0x02 }
+#define NETBOOT_AREA_SIZE	BOARD_SDRAM_RING_SIZE
+#define NETBOOT_AREA_ADDR	BOARD_SDRAM_RING_ADDR
+#define NETBOOT_LINK_MS		5000
+
+/* Execute-in-place boot, built with -DBOOT_XIP: the kernel stays in the first
+   BOARD_NORFLASH_XIP_SIZE bytes of the norflash as an uncompressed uImage
+   whose text runs where it is stored (CONFIG_XIP_KERNEL, XIP_PHYS_ADDR =
+   XIP_IMAGE_ADDR + 64, "mkimage -A arm -O linux -T kernel -C none
+   -a 0x63000040 -e <entry>"). Only the ramdisk is copied to SDRAM. */
+#define XIP_IMAGE_ADDR		BOARD_NORFLASH_ADDR
+
+/* Load an image from the load task, giving the CPU back after each batch of
+   extents read */
+#define LOAD_IMAGE( pTask, size, dst, maxSize, name ) \
+    do { \
+        (size) = 0 ; \
+        if ( image_open( &imageLoad, (dst), (maxSize), (name) ) ) \
+        { \
+            while ( image_read( &imageLoad ) ) \
+            { \
+                SCHED_YIELD( pTask ) ; \
+            } \
+            (size) = image_close( &imageLoad ) ; \
+        } \
+    } while ( 0 )
+
+/* Image streamed to SDRAM by image_open(), image_read() and image_close() */
+typedef struct {
+	FIL file;				/* Image file */
+	unsigned char *da;		/* Next byte loaded */
+	unsigned int curOffset;	/* Bytes loaded */
+	const BYTE *pMapped;	/* Image of a mapped drive, NULL otherwise */
+} ImageLoad;
+
 /*---------------------------------------------------------------------------
                               LOCAL FUNCTION DEFINITIONS
 -----------------------------------------------------------------------------*/
-static void loadLinux(void);
-static int load_image(unsigned int dst, const char* FileName);
+static int image_open(ImageLoad *pLoad, unsigned int dst, unsigned int maxSize, const char* FileName);
+static int image_read(ImageLoad *pLoad);
+static int image_close(ImageLoad *pLoad);
 
 /*----------------------------------------------------------------------------
  *        Local variables
@@ -33,6 +128,43 @@ static unsigned int machine_type = 5000;
 static const char bootargs[ATAG_CMD_LINE_LEN] =
 {"mem=32M init=/bin/sh console=ttyS0,115200 ramdisk_size=16384"};
 
+/* Boot tasks */
+static SchedTask lcdTask;
+static SchedTask nandTask;
+static SchedTask sdTask;
+static SchedTask loadTask;
+
+/* Linux parameters filled by the load task */
+static LINUX_MACHINE_PARMS lparms;
+
+/* Image streamed by the load task */
+static ImageLoad imageLoad;
+
+/* Result of the norflash mount, -1 until tried */
+static int norflashStatus = -1;
+
+/* Medias declared by Media_Init.c */
+extern Media medias[MAX_LUNS];
+
+/* Benchmark file */
+static FIL benchFile;
+
+/* Splash screen file */
+static FIL splashFile;
+
+/* Serial download state */
+static DownloadReceiver downloadReceiver;
+static FIL downloadFile;
+static uint8_t downloadTx[DOWNLOAD_HEADER_SIZE + DOWNLOAD_CRC_SIZE];
+static uint8_t sdMounted;
+static uint8_t nandMounted;
+
+/* Network boot state */
+static NetbootRxDescriptor* netbootRing;
+static uint32_t netbootLastCycles;
+static uint32_t netbootCycles;
+static uint32_t netbootMs;
+
 /**
  *  \brief Configure LEDs
  *
@@ -46,37 +178,84 @@ static void _ConfigureLeds( void )
     LED_Configure( LED_RED ) ;
 }
 
-/*----------------------------------------------------------------------------
- *        Exported functions
- *----------------------------------------------------------------------------*/
+/**
+ *  \brief Start the DWT cycle counter used for the boot task timing
+ */
+static void _ConfigureCycleCounter( void )
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk ;
+    DWT_CYCCNT = 0 ;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA ;
+}
+
+static uint32_t _GetCycles( void )
+{
+    return DWT_CYCCNT ;
+}
 
 /**
- *  \brief getting-started Application entry point.
+ *  \brief Idle hook: every task waits for an interrupt completion. Once the
+ *  NAND is up, the wait is used to erase its dirty blocks one at a time.
+ */
+static void _Idle( void )
+{
+    if ( (Sched_GetEvents() & EVENT_NAND_DONE) && Medias_CollectNand( 1 ) )
+    {
+        return ;
+    }
+    __WFI() ;
+}
+
+/**
+ *  \brief BMP reader on a FatFs file
+ */
+static uint32_t _SplashRead( void* pArg, uint8_t* pBuffer, uint32_t dwSize )
+{
+    UINT dwRead = 0 ;
+
+    if ( f_read( (FIL*)pArg, pBuffer, dwSize, &dwRead ) != FR_OK )
+    {
+        return 0 ;
+    }
+
+    return dwRead ;
+}
+
+/**
+ *  \brief Stream SPLASH_FILE from the SD card to the LCD
  *
- *  \return Unused (ANSI-C compatibility).
+ *  \return 1 if the splash screen is displayed, 0 otherwise.
  */
-extern int main( void )
+static uint32_t _DrawSplash( void )
 {
-#if defined   ( __CC_ARM   ) /* Keil �Vision 4 */
-    /* Disable semihosting */
-#    pragma import(__use_no_semihosting_swi)
-#endif
-	uint8_t result = 0;
-	/* Disable watchdog */
-    WDT_Disable( WDT ) ;
-    TRACE_CONFIGURE(115200, BOARD_MCK);
+    uint8_t bRc ;
 
-    printf( "-- %s\n\r", BOARD_NAME ) ;
-    printf( "-- Compiled: %s %s --\n\r", __DATE__, __TIME__ ) ;
+    if ( f_open( &splashFile, MMC_ROOT_DIRECTORY SPLASH_FILE, FA_OPEN_EXISTING | FA_READ ) != FR_OK )
+    {
+        return 0 ;
+    }
 
-    /* complete SDRAM configuration.*/
-    BOARD_ConfigureSdram() ;
+    bRc = BMP_DrawStream( _SplashRead, &splashFile, 0, 0 ) ;
+    f_close( &splashFile ) ;
 
-    printf( "Configure TC.\n\r" );
-    //_ConfigureTc() ;
+    return (bRc == 0) ;
+}
 
-    printf( "Configure LED PIOs.\n\r" ) ;
-    _ConfigureLeds() ;
+/**
+ *  \brief LCD DMA completion, called from the DMAC interrupt
+ */
+static void _LcdFillDone( void* pArg, uint32_t dwStatus )
+{
+    Sched_PostEvent( EVENT_LCD_FILL ) ;
+}
+
+/**
+ *  \brief LCD bring-up, then the SD card splash screen or, without one, the
+ *  test pattern, one primitive per slice
+ */
+static uint8_t _LcdTask( SchedTask* pTask )
+{
+    SCHED_BEGIN( pTask ) ;
 
     /* Initialize LCD */
 	LCD_Initialize() ;
@@ -84,22 +263,41 @@ extern int main( void )
 	LCD_SetBacklight(32);
 
 	LCD_On();
+	SCHED_YIELD( pTask ) ;
+
+	/* The splash screen goes first, the load task waits for it */
+	SCHED_WAIT_EVENTS( pTask, EVENT_SD_DONE ) ;
+	if ( _DrawSplash() )
+	{
+		Sched_PostEvent( EVENT_SPLASH_DONE | EVENT_LCD_DONE ) ;
+		SCHED_EXIT( pTask ) ;
+	}
+	Sched_PostEvent( EVENT_SPLASH_DONE ) ;
 
-	/* Test basic color space translation and LCD_DrawFilledRectangle */
+	/* Test basic color space translation and LCD_DrawFilledRectangle. The
+	   large fills are streamed by the DMAC while the other tasks run. */
 	LCD_SetColor(COLOR_WHITE);
-	LCD_DrawFilledRectangle(0, 0, BOARD_LCD_WIDTH-1, BOARD_LCD_HEIGHT-1);
+	Sched_ClearEvent( EVENT_LCD_FILL ) ;
+	LCD_DrawFilledRectangleAsync(0, 0, BOARD_LCD_WIDTH-1, BOARD_LCD_HEIGHT-1, _LcdFillDone, NULL);
+	SCHED_WAIT_EVENTS( pTask, EVENT_LCD_FILL ) ;
 
 	LCD_SetColor(COLOR_BLACK);
 	LCD_DrawFilledRectangle(BOARD_LCD_WIDTH-5, BOARD_LCD_HEIGHT-5, 4, 4);
 
 	LCD_SetColor(COLOR_BLUE);
-	LCD_DrawFilledRectangle(8, 8, BOARD_LCD_WIDTH-9, BOARD_LCD_HEIGHT-9);
+	Sched_ClearEvent( EVENT_LCD_FILL ) ;
+	LCD_DrawFilledRectangleAsync(8, 8, BOARD_LCD_WIDTH-9, BOARD_LCD_HEIGHT-9, _LcdFillDone, NULL);
+	SCHED_WAIT_EVENTS( pTask, EVENT_LCD_FILL ) ;
 
 	LCD_SetColor(COLOR_RED);
-	LCD_DrawFilledRectangle(12, 12, BOARD_LCD_WIDTH-13, BOARD_LCD_HEIGHT-13);
+	Sched_ClearEvent( EVENT_LCD_FILL ) ;
+	LCD_DrawFilledRectangleAsync(12, 12, BOARD_LCD_WIDTH-13, BOARD_LCD_HEIGHT-13, _LcdFillDone, NULL);
+	SCHED_WAIT_EVENTS( pTask, EVENT_LCD_FILL ) ;
 
 	LCD_SetColor(COLOR_GREEN);
-	LCD_DrawFilledRectangle(16, 14, BOARD_LCD_WIDTH-17, BOARD_LCD_HEIGHT-17);
+	Sched_ClearEvent( EVENT_LCD_FILL ) ;
+	LCD_DrawFilledRectangleAsync(16, 14, BOARD_LCD_WIDTH-17, BOARD_LCD_HEIGHT-17, _LcdFillDone, NULL);
+	SCHED_WAIT_EVENTS( pTask, EVENT_LCD_FILL ) ;
 
 	LCD_SetColor(COLOR_RED);
 
@@ -114,103 +312,804 @@ extern int main( void )
 	/* Test LCD_DrawRectangle */
 	LCD_DrawRectangle(BOARD_LCD_WIDTH/4, BOARD_LCD_HEIGHT/4, BOARD_LCD_WIDTH*3/4, BOARD_LCD_HEIGHT*3/4);
 	LCD_DrawRectangle(BOARD_LCD_WIDTH*2/3, BOARD_LCD_HEIGHT*2/3, BOARD_LCD_WIDTH/3, BOARD_LCD_HEIGHT/3);
+	SCHED_YIELD( pTask ) ;
 
 	/* Test LCD_DrawFilledCircle */
 	LCD_SetColor(COLOR_BLUE);
 	LCD_DrawFilledCircle(BOARD_LCD_WIDTH*3/4, BOARD_LCD_HEIGHT*3/4, BOARD_LCD_WIDTH/4);
 	LCD_DrawCircle(BOARD_LCD_WIDTH/4, BOARD_LCD_HEIGHT/4, BOARD_LCD_HEIGHT/4);
+	SCHED_YIELD( pTask ) ;
+
 	LCD_SetColor(COLOR_YELLOW);
 	LCD_DrawFilledCircle(BOARD_LCD_WIDTH/4, BOARD_LCD_HEIGHT*3/4, BOARD_LCD_HEIGHT/4);
 	LCD_DrawCircle(BOARD_LCD_WIDTH*3/4, BOARD_LCD_HEIGHT/4, BOARD_LCD_WIDTH/4);
 
-	/* Test LCD_DrawPicture */
-	RTT_SetPrescaler(RTT, 32768 );
-    result = Medias_Init();
-	loadLinux();
+	Sched_PostEvent( EVENT_LCD_DONE ) ;
+
+    SCHED_END( pTask ) ;
 }
 
+/**
+ *  \brief NAND bring-up: device scan, one group of blocks per slice, then
+ *  translation layer and mount
+ */
+static uint8_t _NandTask( SchedTask* pTask )
+{
+    SCHED_BEGIN( pTask ) ;
 
-//------------------------------------------------------------------------------
-//         Local functions
-//------------------------------------------------------------------------------
-static void loadLinux(void)
+    while ( Medias_InitNandStep() == MEDIAS_INIT_PENDING )
+    {
+        SCHED_YIELD( pTask ) ;
+    }
+    Sched_PostEvent( EVENT_NAND_DONE ) ;
+
+    SCHED_END( pTask ) ;
+}
+
+/**
+ *  \brief SD card identification, one poll of the card power-up per slice,
+ *  and mount
+ */
+static uint8_t _SdTask( SchedTask* pTask )
+{
+    SCHED_BEGIN( pTask ) ;
+
+    while ( Medias_InitSdcardStep() == MEDIAS_INIT_PENDING )
+    {
+        SCHED_YIELD( pTask ) ;
+    }
+    Sched_PostEvent( EVENT_SD_DONE ) ;
+
+    SCHED_END( pTask ) ;
+}
+
+/**
+ *  \brief Mount the norflash on first use
+ *  \return 0 if the volume is mounted
+ */
+static int _MountNorFlash( void )
+{
+    if ( norflashStatus < 0 )
+    {
+        norflashStatus = Medias_InitNorFlash() ;
+    }
+
+    return norflashStatus ;
+}
+
+#if defined( BOOT_XIP )
+/**
+ *  \brief Look for the XIP kernel at the start of the norflash
+ *  \return Size of the kernel, 0 if none: the kernel is then loaded to SDRAM
+ */
+static unsigned int _XipProbe( void )
+{
+    unsigned int dwEntry ;
+    unsigned int dwSize ;
+
+    /* Configures the EBI and mounts the volume following the XIP partition */
+    _MountNorFlash() ;
+
+    dwSize = check_xip_image( XIP_IMAGE_ADDR, BOARD_NORFLASH_XIP_SIZE, &dwEntry ) ;
+    if ( dwSize )
+    {
+        lparms.kernel_addr = dwEntry ;
+    }
+
+    return dwSize ;
+}
+#endif
+
+/**
+ *  \brief Stream the kernel and ramdisk images from the SD card to SDRAM, one
+ *  batch of extents per slice
+ */
+static uint8_t _LoadTask( SchedTask* pTask )
+{
+    SCHED_BEGIN( pTask ) ;
+
+    SCHED_WAIT_EVENTS( pTask, EVENT_SD_DONE | EVENT_SPLASH_DONE ) ;
+
+#if defined( BOOT_XIP )
+    /* An XIP kernel is not copied: only the ramdisk is staged below */
+    if ( lparms.kernel_size == 0 )
+    {
+        lparms.kernel_size = _XipProbe() ;
+        SCHED_YIELD( pTask ) ;
+    }
+#endif
+
+    /* Images received by the serial download are already in place */
+    if ( lparms.kernel_size == 0 )
+    {
+        LOAD_IMAGE( pTask, lparms.kernel_size, ZIMAGE_LOAD_ADDR, ZIMAGE_MAX_SIZE, MMC_ROOT_DIRECTORY "Image" ) ;
+    }
+
+    if ( lparms.ramdisk_size == 0 )
+    {
+        LOAD_IMAGE( pTask, lparms.ramdisk_size, RAMDISK_LOAD_ADDR, RAMDISK_MAX_SIZE, MMC_ROOT_DIRECTORY "ramdisk" ) ;
+    }
+
+#if defined( BOOT_XIP )
+    /* XIP kernel without a ramdisk on the SD card: take the one of the norflash */
+    if ( (lparms.kernel_addr != 0) && (lparms.ramdisk_size == 0) && (_MountNorFlash() == 0) )
+    {
+        LOAD_IMAGE( pTask, lparms.ramdisk_size, RAMDISK_LOAD_ADDR, RAMDISK_MAX_SIZE, NOR_ROOT_DIRECTORY "ramdisk" ) ;
+    }
+#endif
+
+    /* No kernel on the SD card: boot the images of the norflash */
+    if ( (lparms.kernel_size == 0) && (_MountNorFlash() == 0) )
+    {
+        LOAD_IMAGE( pTask, lparms.kernel_size, ZIMAGE_LOAD_ADDR, ZIMAGE_MAX_SIZE, NOR_ROOT_DIRECTORY "Image" ) ;
+        LOAD_IMAGE( pTask, lparms.ramdisk_size, RAMDISK_LOAD_ADDR, RAMDISK_MAX_SIZE, NOR_ROOT_DIRECTORY "ramdisk" ) ;
+    }
+
+    /* Still no kernel: boot the recovery images of the serial flash */
+    if ( (lparms.kernel_size == 0) && (Medias_InitSerialFlash() == 0) )
+    {
+        LOAD_IMAGE( pTask, lparms.kernel_size, ZIMAGE_LOAD_ADDR, ZIMAGE_MAX_SIZE, SFLASH_ROOT_DIRECTORY "Image" ) ;
+        LOAD_IMAGE( pTask, lparms.ramdisk_size, RAMDISK_LOAD_ADDR, RAMDISK_MAX_SIZE, SFLASH_ROOT_DIRECTORY "ramdisk" ) ;
+    }
+
+    SCHED_END( pTask ) ;
+}
+
+/**
+ *  \brief Raw media transfer in the last BENCH_AREA_SIZE bytes of the media.
+ *  Writes put back the contents saved by _BenchRunMedia, so the area is left
+ *  as it was found.
+ */
+static uint32_t _BenchMediaIo( void* pArg, uint32_t dwOffset, uint8_t* pBuffer, uint32_t dwSize, uint8_t bWrite )
+{
+    Media* pMedia = (Media*)pArg ;
+    uint32_t dwUnit = pMedia->blockSize ;
+    uint32_t dwAddress = pMedia->size - BENCH_AREA_SIZE / dwUnit + dwOffset / dwUnit ;
+
+    if ( bWrite )
+    {
+        return MED_Write( pMedia, dwAddress, (uint8_t*)BENCH_SHADOW_ADDR + dwOffset, dwSize / dwUnit, NULL, NULL ) ;
+    }
+
+    return MED_Read( pMedia, dwAddress, pBuffer, dwSize / dwUnit, NULL, NULL ) ;
+}
+
+static uint32_t _BenchMediaSync( void* pArg )
+{
+    return MED_Flush( (Media*)pArg ) ;
+}
+
+/**
+ *  \brief FatFs transfer in the benchmark file
+ */
+static uint32_t _BenchFileIo( void* pArg, uint32_t dwOffset, uint8_t* pBuffer, uint32_t dwSize, uint8_t bWrite )
+{
+    FIL* pFile = (FIL*)pArg ;
+    UINT done = 0 ;
+    FRESULT res = FR_OK ;
+
+    if ( pFile->fptr != dwOffset )
+    {
+        res = f_lseek( pFile, dwOffset ) ;
+    }
+    if ( res == FR_OK )
+    {
+        res = bWrite ? f_write( pFile, pBuffer, dwSize, &done ) : f_read( pFile, pBuffer, dwSize, &done ) ;
+    }
+
+    return (res != FR_OK) || (done != dwSize) ;
+}
+
+static uint32_t _BenchFileSync( void* pArg )
+{
+    return f_sync( (FIL*)pArg ) != FR_OK ;
+}
+
+/**
+ *  \brief Run every workload on a target
+ */
+static void _BenchRunTarget( BenchTarget* pTarget )
+{
+    BenchResult result ;
+    uint32_t i ;
+
+    for ( i = 0 ; i < gdwBenchNumWorkloads ; i++ )
+    {
+        if ( Bench_Run( pTarget, &gBenchWorkloads[i], &result ) == 0 )
+        {
+            Bench_PrintResult( pTarget, &gBenchWorkloads[i], &result ) ;
+        }
+    }
+}
+
+/**
+ *  \brief Benchmark a drive through MED_Read/MED_Write, then through FatFs
+ */
+static void _BenchRunDrive( uint8_t drv, const char* pRawName, const char* pFileName, const char* pPath )
+{
+    Media* pMedia = &medias[drv] ;
+    BenchTarget target ;
+    uint32_t dwUnit = pMedia->blockSize ;
+    uint32_t dwDone ;
+
+    if ( (pMedia->state != MED_STATE_READY) || (dwUnit == 0) || (pMedia->size < BENCH_AREA_SIZE / dwUnit) )
+    {
+        printf( "-W- %s not available\n\r", pRawName ) ;
+        return ;
+    }
+
+    /* Save the raw area first, the write workloads put it back */
+    for ( dwDone = 0 ; dwDone < BENCH_AREA_SIZE ; dwDone += BENCH_BUFFER_SIZE )
+    {
+        if ( MED_Read( pMedia, pMedia->size - (BENCH_AREA_SIZE - dwDone) / dwUnit,
+                       (uint8_t*)BENCH_SHADOW_ADDR + dwDone, BENCH_BUFFER_SIZE / dwUnit, NULL, NULL ) != MED_STATUS_SUCCESS )
+        {
+            printf( "-E- %s: cannot save the test area\n\r", pRawName ) ;
+            return ;
+        }
+    }
+
+    target.pName = pRawName ;
+    target.fIo = _BenchMediaIo ;
+    target.fSync = _BenchMediaSync ;
+    target.pArg = pMedia ;
+    target.dwCapacity = BENCH_AREA_SIZE ;
+    _BenchRunTarget( &target ) ;
+
+    if ( f_open( &benchFile, pPath, FA_CREATE_ALWAYS | FA_READ | FA_WRITE ) != FR_OK )
+    {
+        printf( "-W- %s: cannot create %s\n\r", pFileName, pPath ) ;
+        return ;
+    }
+    /* Contiguous file when the volume allows it, otherwise it grows */
+    f_prealloc( &benchFile, BENCH_AREA_SIZE ) ;
+
+    target.pName = pFileName ;
+    target.fIo = _BenchFileIo ;
+    target.fSync = _BenchFileSync ;
+    target.pArg = &benchFile ;
+    _BenchRunTarget( &target ) ;
+
+    f_close( &benchFile ) ;
+    f_unlink( pPath ) ;
+}
+
+/**
+ *  \brief Take a key from the console, waiting BOOT_KEY_WINDOW_MS for it
+ *
+ *  \return the key pressed, 0 if none.
+ */
+static uint8_t _BootKey( void )
+{
+    uint32_t dwStart = _GetCycles() ;
+
+#if BOOT_KEY_WINDOW_MS > 0
+    printf( "-- Press '%c' for the storage benchmark, '%c' for the serial download, '%c' for the network boot\n\r",
+            BENCH_KEY, DOWNLOAD_KEY, NETBOOT_KEY ) ;
+#endif
+    do
+    {
+        if ( UART_IsRxReady() )
+        {
+            return UART_GetChar() ;
+        }
+    }
+    while ( _GetCycles() - dwStart < BOOT_KEY_WINDOW_MS * (BOARD_MCK / 1000) ) ;
+
+    return 0 ;
+}
+
+/**
+ *  \brief Storage benchmark mode, the board does not boot Linux afterwards
+ */
+static void _Benchmark( void )
+{
+    uint32_t dwDrive ;
+
+    printf( "-I- Drive (0: NAND, 1: SD card, 2: both)\n\r" ) ;
+    if ( !UART_GetIntegerMinMax( &dwDrive, 0, 2 ) )
+    {
+        dwDrive = 2 ;
+    }
+    printf( "\n\r" ) ;
+
+    Bench_Initialize( _GetCycles, BOARD_MCK / 1000000, (uint8_t*)BENCH_BUFFER_ADDR, BENCH_BUFFER_SIZE ) ;
+    Bench_PrintHeader() ;
+
+    if ( dwDrive != 0 )
+    {
+        if ( Medias_InitSdcard() == 0 )
+        {
+            _BenchRunDrive( DRV_MMC, "sd-raw", "sd-fat", MMC_ROOT_DIRECTORY BENCH_FILE ) ;
+        }
+    }
+    if ( dwDrive != 1 )
+    {
+        if ( Medias_InitNand() == 0 )
+        {
+            _BenchRunDrive( DRV_NAND, "nand-raw", "nand-fat", NAND_ROOT_DIRECTORY BENCH_FILE ) ;
+        }
+    }
+
+    printf( "-I- Benchmark done, reset the board to boot\n\r" ) ;
+    while ( 1 ) ;
+}
+
+/**
+ *  \brief Destination of a downloaded image: "Image" and "ramdisk" go where
+ *  the boot expects them
+ */
+static uint8_t* _DownloadOpen( void* pArg, const DownloadImage* pImage )
+{
+    if ( (strcmp( pImage->pName, "Image" ) == 0) && (pImage->dwSize <= ZIMAGE_MAX_SIZE) )
+    {
+        return (uint8_t*)ZIMAGE_LOAD_ADDR ;
+    }
+    if ( (strcmp( pImage->pName, "ramdisk" ) == 0) && (pImage->dwSize <= RAMDISK_MAX_SIZE) )
+    {
+        return (uint8_t*)RAMDISK_LOAD_ADDR ;
+    }
+
+    printf( "-E- Download: %s (%u bytes) rejected\n\r", pImage->pName, (unsigned int)pImage->dwSize ) ;
+    return NULL ;
+}
+
+/**
+ *  \brief Write a downloaded image to a file of the media
+ */
+static uint32_t _DownloadCommit( const char* pRoot, const DownloadImage* pImage, uint8_t* pData )
+{
+    char path[4 + DOWNLOAD_NAME_SIZE] ;
+    UINT done = 0 ;
+    FRESULT res ;
+
+    strcpy( path, pRoot ) ;
+    strcat( path, pImage->pName ) ;
+    if ( f_open( &downloadFile, path, FA_CREATE_ALWAYS | FA_WRITE ) != FR_OK )
+    {
+        return DOWNLOAD_STATUS_COMMIT ;
+    }
+    /* Contiguous file when the volume allows it, so the boot reads it in one run */
+    f_prealloc( &downloadFile, pImage->dwSize ) ;
+    res = f_write( &downloadFile, pData, pImage->dwSize, &done ) ;
+    if ( f_close( &downloadFile ) != FR_OK )
+    {
+        res = FR_DISK_ERR ;
+    }
+
+    return ((res == FR_OK) && (done == pImage->dwSize)) ? DOWNLOAD_STATUS_OK : DOWNLOAD_STATUS_COMMIT ;
+}
+
+/**
+ *  \brief A downloaded image is complete: boot it and write it to the media
+ *  when asked
+ */
+static uint32_t _DownloadClose( void* pArg, const DownloadImage* pImage, uint8_t* pData )
+{
+    uint32_t dwStatus = DOWNLOAD_STATUS_OK ;
+
+    if ( pData == (uint8_t*)ZIMAGE_LOAD_ADDR )
+    {
+        lparms.kernel_size = pImage->dwSize ;
+    }
+    else
+    {
+        lparms.ramdisk_size = pImage->dwSize ;
+    }
+
+    if ( pImage->bCommit == DOWNLOAD_COMMIT_SD )
+    {
+        if ( !sdMounted )
+        {
+            sdMounted = (Medias_InitSdcard() == 0) ;
+        }
+        dwStatus = sdMounted ? _DownloadCommit( MMC_ROOT_DIRECTORY, pImage, pData ) : DOWNLOAD_STATUS_COMMIT ;
+    }
+    else if ( pImage->bCommit == DOWNLOAD_COMMIT_NAND )
+    {
+        if ( !nandMounted )
+        {
+            nandMounted = (Medias_InitNand() == 0) ;
+        }
+        dwStatus = nandMounted ? _DownloadCommit( NAND_ROOT_DIRECTORY, pImage, pData ) : DOWNLOAD_STATUS_COMMIT ;
+    }
+
+    printf( "-I- Download: %s, %u bytes, status %u\n\r", pImage->pName, (unsigned int)pImage->dwSize, (unsigned int)dwStatus ) ;
+    return dwStatus ;
+}
+
+/**
+ *  \brief Send an answer to the host once the previous one is out
+ */
+static void _DownloadSend( void* pArg, const uint8_t* pFrame, uint32_t dwSize )
+{
+    Usart* pUsart = DOWNLOAD_USART ;
+
+    while ( (pUsart->US_TCR != 0) || (pUsart->US_TNCR != 0) ) ;
+    memcpy( downloadTx, pFrame, dwSize ) ;
+    USART_WriteBuffer( pUsart, downloadTx, dwSize ) ;
+}
+
+/**
+ *  \brief Serial download mode: receive images from the host tool until it
+ *  ends the session, then boot
+ */
+static void _Download( void )
+{
+    const Pin pPins[] = { PIN_USART0_RXD, PIN_USART0_TXD } ;
+    Usart* pUsart = DOWNLOAD_USART ;
+    uint8_t* pRing = (uint8_t*)DOWNLOAD_RING_ADDR ;
+    uint32_t dwHalf = DOWNLOAD_RING_SIZE / 2 ;
+    uint32_t dwArm = 0 ;
+    uint32_t dwRead = 0 ;
+    uint32_t dwWrite ;
+    uint32_t dwSize ;
+    uint32_t bDone = 0 ;
+
+    Download_InitReceiver( &downloadReceiver, _DownloadOpen, _DownloadClose, _DownloadSend, NULL ) ;
+
+    PIO_Configure( pPins, PIO_LISTSIZE( pPins ) ) ;
+    PMC->PMC_PCER0 = 1 << DOWNLOAD_USART_ID ;
+    USART_Configure( pUsart, US_MR_USART_MODE_NORMAL | US_MR_USCLKS_MCK | US_MR_CHRL_8_BIT | US_MR_PAR_NO
+                           | US_MR_NBSTOP_1_BIT | US_MR_CHMODE_NORMAL | US_MR_OVER,
+                     DOWNLOAD_BAUDRATE, BOARD_MCK ) ;
+
+    /* Both halves armed: current and next PDC banks */
+    USART_ReadBuffer( pUsart, pRing, dwHalf ) ;
+    USART_ReadBuffer( pUsart, pRing + dwHalf, dwHalf ) ;
+    USART_SetReceiverEnabled( pUsart, 1 ) ;
+    USART_SetTransmitterEnabled( pUsart, 1 ) ;
+
+    printf( "-I- Serial download on USART0 at %u bauds\n\r", DOWNLOAD_BAUDRATE ) ;
+    while ( !bDone )
+    {
+        /* The PDC moved to its next bank: re-arm the half it left once read */
+        if ( (pUsart->US_RNCR == 0) && ((dwRead < dwArm) || (dwRead >= dwArm + dwHalf)) )
+        {
+            USART_ReadBuffer( pUsart, pRing + dwArm, dwHalf ) ;
+            dwArm ^= dwHalf ;
+        }
+
+        dwWrite = (pUsart->US_RPR - DOWNLOAD_RING_ADDR) % DOWNLOAD_RING_SIZE ;
+        if ( dwWrite != dwRead )
+        {
+            dwSize = ((dwWrite > dwRead) ? dwWrite : DOWNLOAD_RING_SIZE) - dwRead ;
+            bDone = Download_Input( &downloadReceiver, pRing + dwRead, dwSize ) ;
+            dwRead = (dwRead + dwSize) % DOWNLOAD_RING_SIZE ;
+        }
+    }
+
+    /* Last ACK out before the line is released */
+    while ( (pUsart->US_TCR != 0) || (pUsart->US_TNCR != 0) || ((pUsart->US_CSR & US_CSR_TXEMPTY) == 0) ) ;
+    pUsart->US_PTCR = US_PTCR_RXTDIS | US_PTCR_TXTDIS ;
+
+    printf( "-I- Download done: %u frames, %u bad, %u NAKs, %u duplicates\n\r",
+            (unsigned int)downloadReceiver.dwFrames, (unsigned int)downloadReceiver.parser.dwErrors,
+            (unsigned int)downloadReceiver.dwNaks, (unsigned int)downloadReceiver.dwDuplicates ) ;
+}
+
+/**
+ *  \brief Milliseconds for the network boot, from the cycle counter
+ */
+static uint32_t _NetbootClock( void )
+{
+    uint32_t dwNow = _GetCycles() ;
+
+    netbootCycles += dwNow - netbootLastCycles ;
+    netbootLastCycles = dwNow ;
+    netbootMs += netbootCycles / (BOARD_MCK / 1000) ;
+    netbootCycles %= BOARD_MCK / 1000 ;
+
+    return netbootMs ;
+}
+
+/**
+ *  \brief Send a frame once a transmit buffer is free
+ */
+static void _NetbootSend( void* pArg, const uint8_t* pFrame, uint32_t dwSize )
+{
+    while ( EMAC_Send( EMAC, pFrame, dwSize ) == EMAC_TX_BUFFER_BUSY ) ;
+}
+
+static void _NetbootRxStart( void* pArg, NetbootRxDescriptor* pRing )
+{
+    netbootRing = pRing ;
+    EMAC_StartRx( EMAC, (volatile EmacRxTDescriptor*)pRing ) ;
+}
+
+/**
+ *  \brief Pause or resume the receiver, return the descriptor it uses next
+ */
+static uint32_t _NetbootRxEnable( void* pArg, uint8_t bEnable )
+{
+    EMAC_SetRxEnabled( EMAC, bEnable ) ;
+
+    return (EMAC->EMAC_RBQP - (uint32_t)netbootRing) / sizeof( NetbootRxDescriptor ) ;
+}
+
+/**
+ *  \brief Network boot mode: fetch the kernel and the ramdisk from the TFTP
+ *  server to their load addresses. The images not fetched are then loaded
+ *  from the SD card as usual.
+ */
+static void _Netboot( void )
+{
+    const Pin pPins[] = { BOARD_EMAC_RUN_PINS } ;
+    const NetbootDevice device = { _NetbootSend, _NetbootRxStart, _NetbootRxEnable, _NetbootClock, NULL, NULL } ;
+    const uint8_t pMac[] = NETBOOT_MAC ;
+    Netboot* pNet = (Netboot*)NETBOOT_AREA_ADDR ;
+    EmacStats stats ;
+    uint32_t dwSize ;
+
+    PIO_Configure( pPins, PIO_LISTSIZE( pPins ) ) ;
+    netbootLastCycles = _GetCycles() ;
+    switch ( EMAC_PhyLinkUp( EMAC, ID_EMAC, pMac, BOARD_EMAC_PHY_ADDR, _NetbootClock, NETBOOT_LINK_MS ) )
+    {
+        case EMAC_PHY_OK :
+            printf( "-I- Netboot: link up\n\r" ) ;
+        break ;
+
+        case EMAC_PHY_NOPHY :
+            printf( "-E- Netboot: no PHY\n\r" ) ;
+            return ;
+
+        default :
+            printf( "-E- Netboot: no link\n\r" ) ;
+            return ;
+    }
+
+    Netboot_Initialize( pNet, &device, pMac, NETBOOT_IP, NETBOOT_SERVER ) ;
+    if ( Netboot_Fetch( pNet, "Image", (uint8_t*)ZIMAGE_LOAD_ADDR, ZIMAGE_MAX_SIZE, &dwSize ) == NETBOOT_OK )
+    {
+        lparms.kernel_size = dwSize ;
+    }
+    if ( Netboot_Fetch( pNet, "ramdisk", (uint8_t*)RAMDISK_LOAD_ADDR, RAMDISK_MAX_SIZE, &dwSize ) == NETBOOT_OK )
+    {
+        lparms.ramdisk_size = dwSize ;
+    }
+
+    /* The ring is in the memory given to Linux */
+    EMAC_GetStatistics( EMAC, &stats, 0 ) ;
+    EMAC_Reset( EMAC ) ;
+
+    printf( "-I- Netboot: kernel %u bytes, ramdisk %u bytes\n\r", (unsigned int)lparms.kernel_size, (unsigned int)lparms.ramdisk_size ) ;
+    printf( "-I- Netboot: %u blocks in place, %u gathered, %u frames dropped, %u resent, %u overruns, %u without buffer\n\r",
+            (unsigned int)pNet->stats.dwDirect, (unsigned int)pNet->stats.dwGathered, (unsigned int)pNet->stats.dwDropped,
+            (unsigned int)pNet->stats.dwResent, (unsigned int)stats.rx_ovrs, (unsigned int)stats.rx_bnas ) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ *  \brief getting-started Application entry point.
+ *
+ *  \return Unused (ANSI-C compatibility).
+ */
+extern int main( void )
 {
+#if defined   ( __CC_ARM   ) /* Keil �Vision 4 */
+    /* Disable semihosting */
+#    pragma import(__use_no_semihosting_swi)
+#endif
+	/* Disable watchdog */
+    WDT_Disable( WDT ) ;
+    TRACE_CONFIGURE(115200, BOARD_MCK);
+
+    printf( "-- %s\n\r", BOARD_NAME ) ;
+    printf( "-- Compiled: %s %s --\n\r", __DATE__, __TIME__ ) ;
+
+    /* complete SDRAM configuration.*/
+    BOARD_ConfigureSdram() ;
+
+    /* DMA service for bulk SDRAM copies and fills */
+    DMA_MemInitialize() ;
+
+    printf( "Configure TC.\n\r" );
+    //_ConfigureTc() ;
+
+    printf( "Configure LED PIOs.\n\r" ) ;
+    _ConfigureLeds() ;
+
+	RTT_SetPrescaler(RTT, 32768 );
+
+    /* Overlap LCD, NAND and SD bring-up with the image loading */
+    _ConfigureCycleCounter() ;
+#if defined( PROFILE )
+    Prof_Initialize() ;
+#endif
+    switch ( _BootKey() )
+    {
+        case BENCH_KEY :
+            _Benchmark() ;
+        break ;
 
-    LINUX_MACHINE_PARMS lparms;
+        case DOWNLOAD_KEY :
+            _Download() ;
+        break ;
 
-   	const char* kernelFile = MMC_ROOT_DIRECTORY "Image";
-   	const char* ramdiskFile = MMC_ROOT_DIRECTORY "ramdisk";
-    lparms.kernel_size = load_image(ZIMAGE_LOAD_ADDR, kernelFile);
+        case NETBOOT_KEY :
+            _Netboot() ;
+        break ;
 
-    lparms.ramdisk_size = load_image(RAMDISK_LOAD_ADDR, ramdiskFile);
+#if defined( NETBOOT_ALWAYS )
+        default :
+            _Netboot() ;
+        break ;
+#endif
+    }
+
+    Sched_Initialize( _GetCycles, _Idle ) ;
+    Sched_AddTask( &sdTask, "sdcard", _SdTask, NULL ) ;
+    Sched_AddTask( &loadTask, "load", _LoadTask, NULL ) ;
+    Sched_AddTask( &lcdTask, "lcd", _LcdTask, NULL ) ;
+    Sched_AddTask( &nandTask, "nand", _NandTask, NULL ) ;
+    Sched_Run() ;
+    Sched_PrintReport( BOARD_MCK / 1000000 ) ;
+#if defined( PROFILE )
+    /* Stops the sampling before the kernel takes over SysTick */
+    Prof_Dump( BOARD_MCK / 1000000 ) ;
+#endif
 
     /* Set up the rest of the Linux machine parameters */
     lparms.machine = machine_type;
     lparms.ram_base = SRAM_BASE;
     lparms.ram_size = SRAM_SIZE;
-    lparms.kernel_addr = ZIMAGE_LOAD_ADDR;
+    if (lparms.kernel_addr == 0)
+        lparms.kernel_addr = ZIMAGE_LOAD_ADDR;
     lparms.ramdisk_addr = RAMDISK_LOAD_ADDR;
     lparms.bootargs = (char *)bootargs;
     printf("Booting Linux\n\r");
     bootlinux(&lparms);
-
 }
 
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
 /*---------------------------------------------------------------------------
-  Function   : load_uimage
-  Purpose    : Loads a binary image from Flash memory into SRAM. The flash
-               image is formatted as a u-boot image using u-boot's
-               "mkimage" utility.
-  Parameters : dst   - Destination SRAM address
-               src   - Source Flash memory address
-  Returns    : Returns the length of the unformatted image in bytes
+  Function   : image_open
+  Purpose    : Opens a binary image to load into SRAM with image_read(). The
+               part of SRAM it takes is cleared, unless the image is on a
+               mapped drive.
+  Parameters : pLoad    - Image load state
+               dst      - Destination SRAM address
+               maxSize  - Largest image that fits at dst
+               FileName - Image file
+  Returns    : Returns 1 if the image is opened, 0 when it cannot be opened
+               or does not fit
   Notes      : None
 -----------------------------------------------------------------------------*/
-static int load_image(unsigned int dst, const char* FileName)
-{
-	char text[16];
-	uimage_hdr *uip;
-	int i, len;
-	unsigned char *da = (unsigned char *)dst;
-    unsigned int ByteToRead;
-    unsigned int curOffset;
-    unsigned int ByteRead;
-    FIL FileObject;
+static int image_open(ImageLoad *pLoad, unsigned int dst, unsigned int maxSize, const char* FileName)
+{
    	FRESULT res;
 
 	 printf("-I- Open the same file : \"%s\"\n\r", FileName);
-  	 res = f_open(&FileObject, FileName, FA_OPEN_EXISTING|FA_READ);
+  	 res = f_open(&pLoad->file, FileName, FA_OPEN_EXISTING|FA_READ);
 	 if( res != FR_OK ) {
 		printf("-E- f_open read pb: 0x%X \n\r", res);
-		//return 0;
+		return 0;
+	 }
+	 if( pLoad->file.fsize > maxSize ) {
+		printf("-E- %s too large: %u > %u bytes\n\r", FileName, (unsigned int)pLoad->file.fsize, maxSize);
+		f_close(&pLoad->file);
+		return 0;
 	 }
 
 	 // Read file
 	 printf("-I- Read file\n\r");
-	 memset(da, 0, FileObject.fsize);
-	 //FileObject.fsize
-	 curOffset = 0;
-	 while (curOffset < FileObject.fsize)
+	 pLoad->da = (unsigned char *)dst;
+	 pLoad->curOffset = 0;
+	 if (f_map(&pLoad->file, &pLoad->pMapped) != FR_OK)
 	 {
-		 ByteToRead = 512;
-		 res = f_read(&FileObject, da, ByteToRead, &ByteRead);
-		 if(res != FR_OK) {
-			printf("-E- f_read pb: 0x%X \n\r", res);
-			//return 0;
-			len = 0;
+		 pLoad->pMapped = NULL;
+		 DMA_Memset(pLoad->da, 0, pLoad->file.fsize, NULL, NULL);
+		 if (DMA_MemWait() != DMAMEM_STATUS_SUCCESS)
+		 {
+			 printf("-W- DMA clear failed, clearing with the CPU\n\r");
+			 memset(pLoad->da, 0, pLoad->file.fsize);
 		 }
-		 else
+	 }
+	 return 1;
+}
+
+/*---------------------------------------------------------------------------
+  Function   : image_read
+  Purpose    : Loads the next part of the image opened by image_open(): the
+               fragments located by one batch of FAT reads, read back to back
+               through the media request queue.
+  Parameters : pLoad - Image load state
+  Returns    : Returns 1 while part of the image is left, 0 once it is loaded
+               or cannot be read
+  Notes      : None
+-----------------------------------------------------------------------------*/
+static int image_read(ImageLoad *pLoad)
+{
+	/* Last sector of an image whose size is not a multiple of the sector size */
+	static BYTE tail[SECTOR_SIZE_DEFAULT] __attribute__((aligned(4)));
+	FIL *fp = &pLoad->file;
+    unsigned int batchSize;
+    unsigned int tailSize;
+    DISKVEC vec[MED_QUEUE_SIZE];
+    UINT numVec;
+    DWORD ext[2];
+   	FRESULT res;
+
+	 if (pLoad->pMapped)
+	 {
+		 /* Mapped drive: one DMA copy from the flash, no sector buffer */
+		 DMA_Memcpy(pLoad->da, pLoad->pMapped, fp->fsize, NULL, NULL);
+		 if (DMA_MemWait() != DMAMEM_STATUS_SUCCESS)
 		 {
-			 curOffset += ByteRead;
-			 da += ByteRead;
+			 printf("-W- DMA copy failed, copying with the CPU\n\r");
+			 memcpy(pLoad->da, pLoad->pMapped, fp->fsize);
+		 }
+		 pLoad->curOffset = fp->fsize;
+		 return 0;
+	 }
+	 if (pLoad->curOffset >= fp->fsize)
+	 {
+		 return 0;
+	 }
+
+	 numVec = 0;
+	 batchSize = 0;
+	 tailSize = 0;
+	 while ((numVec < MED_QUEUE_SIZE - 1) && (pLoad->curOffset + batchSize < fp->fsize))
+	 {
+		 res = f_extent(fp, fp->fsize - pLoad->curOffset - batchSize, ext);
+		 if ((res != FR_OK) || (ext[1] == 0)) {
+			printf("-E- f_extent pb: 0x%X \n\r", res);
+			break;
+		 }
+		 if (ext[1] >= SECTOR_SIZE_DEFAULT) {
+			 vec[numVec].buff = pLoad->da + batchSize;
+			 vec[numVec].sector = ext[0];
+			 vec[numVec].count = ext[1] / SECTOR_SIZE_DEFAULT;
+			 numVec++;
 		 }
+		 /* End of the file: adjacent on the media, merged in the same run */
+		 tailSize = ext[1] % SECTOR_SIZE_DEFAULT;
+		 if (tailSize) {
+			 vec[numVec].buff = tail;
+			 vec[numVec].sector = ext[0] + ext[1] / SECTOR_SIZE_DEFAULT;
+			 vec[numVec].count = 1;
+			 numVec++;
+		 }
+		 batchSize += ext[1];
+	 }
+	 if (!numVec || (disk_readv(fp->fs->drv, vec, numVec) != RES_OK)) {
+		printf("-E- disk_readv pb\n\r");
+		return 0;
+	 }
+	 pLoad->curOffset += batchSize;
+	 pLoad->da += batchSize;
+	 if (tailSize) {
+		 memcpy(pLoad->da - tailSize, tail, tailSize);
 	 }
+	 return (pLoad->curOffset < fp->fsize);
+}
+
+/*---------------------------------------------------------------------------
+  Function   : image_close
+  Purpose    : Closes the image loaded by image_read().
+  Parameters : pLoad - Image load state
+  Returns    : Returns the length of the image in bytes, 0 when it is not
+               fully loaded
+  Notes      : None
+-----------------------------------------------------------------------------*/
+static int image_close(ImageLoad *pLoad)
+{
+	int len;
+   	FRESULT res;
 
-	 len = FileObject.fsize;
+	 /* A partly read image is not booted: the next media is tried */
+	 len = (pLoad->curOffset < pLoad->file.fsize) ? 0 : pLoad->file.fsize;
 
 	 // Close the file
 	 printf("-I- Close file\n\r");
-	 res = f_close(&FileObject);
+	 res = f_close(&pLoad->file);
 	 if( res != FR_OK ) {
 		printf("-E- f_close pb: 0x%X \n\r", res);
 		//return 0;
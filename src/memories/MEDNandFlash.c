@@ -208,6 +208,7 @@ static unsigned char MEDNandFlash_Write(
     unsigned char *buffer = (unsigned char *) data;
     unsigned int remainingLength;
     unsigned char status;
+    PROF_SCOPE(PROF_NAND_WRITE);
 
     TRACE_INFO("MEDNandFlash_Write(0x%08X, %d)\n\r", address, (int)length);
 
@@ -352,6 +353,7 @@ static unsigned char MEDNandFlash_Read(
     unsigned int readSize;
     unsigned char *buffer = (unsigned char *) data;
     unsigned char status;
+    PROF_SCOPE(PROF_NAND_READ);
 
     TRACE_INFO("MEDNandFlash_Read(0x%08X, %d)\n\r", address, (int)length);
 
@@ -410,6 +412,8 @@ static unsigned char MEDNandFlash_Read(
 //------------------------------------------------------------------------------
 static unsigned char MEDNandFlash_Flush(Media *media)
 {
+    PROF_SCOPE(PROF_NAND_FLUSH);
+
     TRACE_INFO("MEDNandFlash_Flush()\n\r");
 
     if (FlushCurrentPage(media)) {
@@ -433,6 +437,56 @@ static unsigned char MEDNandFlash_Flush(Media *media)
     return MED_STATUS_SUCCESS;
 }
 
+//------------------------------------------------------------------------------
+/// Discards the data of an address range. Only the blocks fully inside the
+/// range are unmapped; partial blocks are left untouched. Returns
+/// MED_STATUS_SUCCESS if succesful; otherwise, returns MED_STATUS_ERROR.
+/// \param media  Pointer to a NandFlash Media instance.
+/// \param address  Address of the range.
+/// \param length  Number of bytes in the range.
+//------------------------------------------------------------------------------
+static unsigned char MEDNandFlash_Trim(
+    Media *media,
+    unsigned int address,
+    unsigned int length)
+{
+    unsigned int blockSize = NandFlashModel_GetBlockSizeInBytes(MODEL(media->interface));
+    unsigned int block, end;
+
+    TRACE_INFO("MEDNandFlash_Trim(0x%08X, %d)\n\r", address, (int)length);
+
+    if ((address + length) > media->size) {
+
+        TRACE_ERROR("MEDNandFlash_Trim: Range too big\n\r");
+        return MED_STATUS_ERROR;
+    }
+
+    block = (address + blockSize - 1) / blockSize;
+    end = (address + length) / blockSize;
+    for (; block < end; block++) {
+
+        // Forget the cached pages of the block
+        if (currentWriteBlock == (signed short) block) {
+
+            currentWriteBlock = -1;
+            currentWritePage = -1;
+        }
+        if (currentReadBlock == (signed short) block) {
+
+            currentReadBlock = -1;
+            currentReadPage = -1;
+        }
+
+        if (TranslatedNandFlash_DiscardBlock(TRANSLATED(media->interface), block)) {
+
+            TRACE_ERROR("MEDNandFlash_Trim: Could not discard block #%u\n\r", block);
+            return MED_STATUS_ERROR;
+        }
+    }
+
+    return MED_STATUS_SUCCESS;
+}
+
 //------------------------------------------------------------------------------
 /// Interrupt handler for the nandflash media. Triggered when the flush timer
 /// expires, initiating a MEDNandFlash_Flush().
@@ -467,6 +521,7 @@ void MEDNandFlash_Initialize( Media* pMedia, struct TranslatedNandFlash *transla
     pMedia->lock = 0;
     pMedia->unlock = 0;
     pMedia->flush = MEDNandFlash_Flush;
+    pMedia->trim = (Media_trim)MEDNandFlash_Trim;
     pMedia->handler = MEDNandFlash_InterruptHandler;
 
     pMedia->interface = translated;
@@ -482,6 +537,7 @@ void MEDNandFlash_Initialize( Media* pMedia, struct TranslatedNandFlash *transla
     pMedia->protected = 0;
     pMedia->removable = 0;
     pMedia->state = MED_STATE_READY;
+    MED_InitQueue( pMedia ) ;
 
     currentWriteBlock = -1;
     currentWritePage = -1;
@@ -490,3 +546,24 @@ void MEDNandFlash_Initialize( Media* pMedia, struct TranslatedNandFlash *transla
 
 }
 
+//------------------------------------------------------------------------------
+/// Erases at most the given number of dirty blocks of a nandflash media. Meant
+/// to be called at idle points so that the write path rarely has to erase.
+/// \param media  Pointer to a nandflash Media instance.
+/// \param maxErases  Maximum number of blocks to erase.
+/// \return the number of blocks erased (0 when there is nothing left to do).
+//------------------------------------------------------------------------------
+unsigned int MEDNandFlash_CollectGarbage(Media *media, unsigned int maxErases)
+{
+    unsigned short erased = 0;
+
+    if (TranslatedNandFlash_CollectGarbage(TRANSLATED(media->interface),
+                                           maxErases,
+                                           &erased)) {
+
+        TRACE_ERROR("MEDNandFlash_CollectGarbage: Could not erase dirty blocks\n\r");
+    }
+
+    return erased;
+}
+
@@ -0,0 +1,202 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "memories.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Constants
+//------------------------------------------------------------------------------
+
+/// CFI offsets of the primary command set and of the device size (2^n bytes)
+#define NOR_CFI_PRIMARY_CODE    0x13
+#define NOR_CFI_DEVICE_SIZE     0x27
+
+/// Return to read array mode
+#define NOR_AMD_RESET           0xF0
+#define NOR_INTEL_READ_ARRAY    0xFF
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//! \brief  Reads the size of a CFI flash on an 8-bit bus and puts it back in
+//!         read array mode
+//! \param  pNor  Base address of the flash
+//! \return The size of the flash in bytes, 0 if no CFI flash answers
+//------------------------------------------------------------------------------
+static uint32_t ProbeCfi(volatile uint8_t *pNor)
+{
+    uint32_t shift;
+    uint32_t size = 0;
+    uint32_t code = CMD_SET_AMD;
+
+    // A x8 device decodes the query at 0x55, a x16 device in byte mode at 0xAA
+    for (shift = 0; (shift < 2) && (size == 0); shift++) {
+
+        pNor[CFI_QUERY_ADDRESS << shift] = CFI_QUERY_COMMAND;
+        if ((pNor[(CFI_QUERY_OFFSET + 0) << shift] == 'Q')
+            && (pNor[(CFI_QUERY_OFFSET + 1) << shift] == 'R')
+            && (pNor[(CFI_QUERY_OFFSET + 2) << shift] == 'Y')) {
+
+            code = pNor[NOR_CFI_PRIMARY_CODE << shift]
+                   | (pNor[(NOR_CFI_PRIMARY_CODE + 1) << shift] << 8);
+            size = 1 << pNor[NOR_CFI_DEVICE_SIZE << shift];
+        }
+        pNor[0] = NOR_AMD_RESET;
+    }
+
+    if ((code == CMD_SET_INTEL) || (code == CMD_SET_INTEL_EXT)) {
+
+        pNor[0] = NOR_INTEL_READ_ARRAY;
+    }
+
+    return size;
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Reads data from a NOR flash media
+//! \param  media    Pointer to a Media instance
+//! \param  address  Address of the first block to read
+//! \param  data     Pointer to the data buffer
+//! \param  length   Number of blocks to read
+//! \param  callback Optional callback to invoke when the read finishes
+//! \param  argument Optional argument for the callback
+//! \return Operation result code
+//------------------------------------------------------------------------------
+static uint8_t MEDNorFlash_Read(Media         *media,
+                                uint32_t      address,
+                                void          *data,
+                                uint32_t      length,
+                                MediaCallback callback,
+                                void          *argument)
+{
+    // Check that the data to read is not too big
+    if ((length + address) > media->size) {
+
+        TRACE_WARNING("MEDNorFlash_Read: Data too big: %d, %d\n\r",
+                      (int)length, (int)address);
+        return MED_STATUS_ERROR;
+    }
+
+    memcpy(data, MED_Map(media, address, length), length * media->blockSize);
+
+    // Invoke callback
+    if (callback != 0) {
+
+        callback(argument, MED_STATUS_SUCCESS, length * media->blockSize, 0);
+    }
+
+    return MED_STATUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Refuses the writes, the NOR flash media being read-only
+//! \return MED_STATUS_PROTECTED
+//------------------------------------------------------------------------------
+static uint8_t MEDNorFlash_Write(Media         *media,
+                                 uint32_t      address,
+                                 void          *data,
+                                 uint32_t      length,
+                                 MediaCallback callback,
+                                 void          *argument)
+{
+    return MED_STATUS_PROTECTED;
+}
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Initializes a Media instance on a CFI NOR flash mapped in the memory space.
+/// \param  media    Pointer to the Media instance to initialize
+/// \param  address  Base address of the flash, NOR_BLOCK_SIZE aligned
+/// \param  offset   Offset of the media in the flash, NOR_BLOCK_SIZE aligned;
+///                  the area below it is left out (XIP kernel)
+/// \param  maxSize  Size of the chip select window, the media is limited to it
+/// \return 1 if success, 0 if no CFI flash answers or the flash is not
+/// larger than offset.
+//------------------------------------------------------------------------------
+uint8_t MEDNorFlash_Initialize(Media *media, uint32_t address, uint32_t offset, uint32_t maxSize)
+{
+    uint32_t size;
+
+    TRACE_INFO("MEDNorFlash init\n\r");
+
+    size = ProbeCfi((volatile uint8_t *)address);
+    if (size == 0) {
+
+        return 0;
+    }
+    if (size > maxSize) {
+
+        size = maxSize;
+    }
+    if (size <= offset) {
+
+        return 0;
+    }
+
+    media->interface = 0;
+    media->write = MEDNorFlash_Write;
+    media->read = MEDNorFlash_Read;
+    media->cancelIo = 0;
+    media->lock = 0;
+    media->unlock = 0;
+    media->handler = 0;
+    media->flush = 0;
+    media->trim = 0;
+
+    media->blockSize = NOR_BLOCK_SIZE;
+    media->baseAddress = (address + offset) / NOR_BLOCK_SIZE;
+    media->size = (size - offset) / NOR_BLOCK_SIZE;
+
+    media->mappedRD  = 1;
+    media->mappedWR  = 0;
+    media->protected = 1;
+    media->removable = 0;
+
+    media->state = MED_STATE_READY;
+
+    media->transfer.data = 0;
+    media->transfer.address = 0;
+    media->transfer.length = 0;
+    media->transfer.callback = 0;
+    media->transfer.argument = 0;
+    MED_InitQueue(media);
+
+    return 1;
+}
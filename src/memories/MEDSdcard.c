@@ -43,6 +43,41 @@
 /// Number of SD Slots
 #define NUM_SD_SLOTS            1
 
+/// Number of write coalescing windows (scattered writes, e.g. the FAT and
+/// files appended in turn; a single stream is not buffered)
+#define WCACHE_WINDOWS          2
+/// Maximum window size in blocks (2MB); larger AUs use an aligned 2MB part
+#define WCACHE_MAXBLOCKS        4096
+/// Window size when the card does not report its AU (64KB)
+#define WCACHE_DEFBLOCKS        128
+/// Window buffers in the BOARD_SDRAM_WCACHE area of the SDRAM map
+#define WCACHE_ADDR             BOARD_SDRAM_WCACHE_ADDR
+#if WCACHE_WINDOWS * WCACHE_MAXBLOCKS * SD_BLOCK_SIZE > BOARD_SDRAM_WCACHE_SIZE
+#error "The write-back windows do not fit in BOARD_SDRAM_WCACHE_SIZE"
+#endif
+/// Base of a free window
+#define WCACHE_FREE             0xFFFFFFFF
+
+//------------------------------------------------------------------------------
+//         Types
+//------------------------------------------------------------------------------
+
+/// Write coalescing window: a block aligned on the window size, buffered
+/// in SDRAM until it is full or flushed.
+typedef struct {
+
+    /// First block of the window, WCACHE_FREE if unused
+    uint32_t base;
+    /// Number of dirty blocks
+    uint32_t numDirty;
+    /// Last access time, for LRU replacement
+    uint32_t lastUse;
+    /// Window buffer
+    uint8_t *pBuffer;
+    /// Dirty blocks (one bit per block)
+    uint32_t dirty[WCACHE_MAXBLOCKS / 32];
+} WCacheWindow;
+
 //------------------------------------------------------------------------------
 //         Local variables
 //------------------------------------------------------------------------------
@@ -58,6 +93,18 @@ static SdCard sdDrv[NUM_SD_SLOTS];
 static const Pin pinSdDAT0 = PIN_MCI_DAT0;
 #endif
 
+/// Write coalescing windows of slot 0.
+static WCacheWindow wcache[WCACHE_WINDOWS];
+
+/// Window size in blocks.
+static uint32_t wcacheBlocks;
+
+/// Access counter for the LRU replacement.
+static uint32_t wcacheClock;
+
+/// Block following the last write, WCACHE_FREE before the first one.
+static uint32_t wcacheNext;
+
 //------------------------------------------------------------------------------
 //      Internal Functions
 //------------------------------------------------------------------------------
@@ -177,6 +224,410 @@ static void ConfigurePIO(uint8_t mciID)
 
 
 
+//------------------------------------------------------------------------------
+//         Write coalescing
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Initializes the write coalescing windows. The window size is the card
+/// allocation unit, so that each flush rewrites whole AUs where possible
+/// instead of making the card read-modify-write them.
+/// \param  pSd  Pointer to the SdCard instance
+//------------------------------------------------------------------------------
+static void WCache_Initialize(SdCard *pSd)
+{
+    uint32_t i;
+
+    wcacheBlocks = SD_GetAuSizeBlocks(pSd);
+    if (wcacheBlocks == 0) {
+
+        wcacheBlocks = WCACHE_DEFBLOCKS;
+    }
+    else if (wcacheBlocks > WCACHE_MAXBLOCKS) {
+
+        wcacheBlocks = WCACHE_MAXBLOCKS;
+    }
+    TRACE_INFO("SD write window: %u blocks\n\r", (unsigned int)wcacheBlocks);
+
+    wcacheClock = 0;
+    wcacheNext = WCACHE_FREE;
+    for (i = 0; i < WCACHE_WINDOWS; i++) {
+
+        wcache[i].base = WCACHE_FREE;
+        wcache[i].numDirty = 0;
+        wcache[i].lastUse = 0;
+        wcache[i].pBuffer = (uint8_t *)WCACHE_ADDR
+                            + i * WCACHE_MAXBLOCKS * SD_BLOCK_SIZE;
+        memset(wcache[i].dirty, 0, sizeof(wcache[i].dirty));
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Writes the dirty blocks of a window to the card, as one multiple block
+/// write per run of consecutive dirty blocks, and frees the window. Only a
+/// run filling the whole window is announced with ACMD23: for a short run
+/// the extra CMD12 and ACMD23 cost more than the pre-erase saves.
+/// \param  pSd      Pointer to the SdCard instance
+/// \param  pWindow  Window to flush
+/// \return 0 if successful, otherwise the SD error code
+//------------------------------------------------------------------------------
+static uint8_t WCache_FlushWindow(SdCard *pSd, WCacheWindow *pWindow)
+{
+    uint32_t start, end;
+    uint8_t error = 0;
+
+    if (pWindow->base == WCACHE_FREE) {
+
+        return 0;
+    }
+
+    start = 0;
+    while (!error && pWindow->numDirty) {
+
+        // Find the next run of dirty blocks
+        while (!(pWindow->dirty[start / 32] & (1u << (start % 32)))) {
+
+            start++;
+        }
+        end = start;
+        while (end < wcacheBlocks
+               && (pWindow->dirty[end / 32] & (1u << (end % 32)))) {
+
+            pWindow->dirty[end / 32] &= ~(1u << (end % 32));
+            end++;
+        }
+        pWindow->numDirty -= end - start;
+
+        if (end - start == wcacheBlocks) {
+
+            error = SD_WritePreErased(pSd,
+                                      pWindow->base,
+                                      pWindow->pBuffer,
+                                      wcacheBlocks);
+        }
+        else {
+
+            error = SD_Write(pSd,
+                             pWindow->base + start,
+                             pWindow->pBuffer + start * SD_BLOCK_SIZE,
+                             end - start, 0, 0);
+        }
+        start = end;
+    }
+
+    // Data is lost on error, leave a clean window
+    pWindow->numDirty = 0;
+    memset(pWindow->dirty, 0, sizeof(pWindow->dirty));
+    pWindow->base = WCACHE_FREE;
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+/// Flushes all the windows in ascending address order and stops the last
+/// transfer so that the card programs the data.
+/// \param  pSd  Pointer to the SdCard instance
+/// \return 0 if successful, otherwise the SD error code
+//------------------------------------------------------------------------------
+static uint8_t WCache_Flush(SdCard *pSd)
+{
+    WCacheWindow *pWindow;
+    uint32_t i;
+    uint8_t error = 0;
+
+    for (;;) {
+
+        pWindow = 0;
+        for (i = 0; i < WCACHE_WINDOWS; i++) {
+
+            if (wcache[i].base != WCACHE_FREE
+                && (!pWindow || wcache[i].base < pWindow->base)) {
+
+                pWindow = &wcache[i];
+            }
+        }
+        if (!pWindow) {
+
+            break;
+        }
+        if (WCache_FlushWindow(pSd, pWindow)) {
+
+            error = 1;
+        }
+    }
+
+    if (SD_StopTransfer(pSd)) {
+
+        error = 1;
+    }
+    return error;
+}
+
+//------------------------------------------------------------------------------
+/// Returns the window holding a block, or 0.
+/// \param  base  Window aligned block address
+//------------------------------------------------------------------------------
+static WCacheWindow * WCache_Find(uint32_t base)
+{
+    uint32_t i;
+
+    for (i = 0; i < WCACHE_WINDOWS; i++) {
+
+        if (wcache[i].base == base) {
+
+            return &wcache[i];
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Drops the blocks of a range from the windows, without writing them.
+/// \param  address  First block of the range
+/// \param  length   Number of blocks
+//------------------------------------------------------------------------------
+static void WCache_Discard(uint32_t address, uint32_t length)
+{
+    WCacheWindow *pWindow;
+    uint32_t block, offset;
+    uint32_t i;
+
+    for (i = 0; i < WCACHE_WINDOWS; i++) {
+
+        pWindow = &wcache[i];
+        if (pWindow->base == WCACHE_FREE
+            || pWindow->base >= address + length
+            || pWindow->base + wcacheBlocks <= address) {
+
+            continue;
+        }
+        for (block = address; block < address + length; block++) {
+
+            offset = block - pWindow->base;
+            if (offset < wcacheBlocks
+                && (pWindow->dirty[offset / 32] & (1u << (offset % 32)))) {
+
+                pWindow->dirty[offset / 32] &= ~(1u << (offset % 32));
+                pWindow->numDirty--;
+            }
+        }
+        if (pWindow->numDirty == 0) {
+
+            pWindow->base = WCACHE_FREE;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/// Writes blocks through the coalescing windows. A write that continues the
+/// previous one, or that covers a window, is part of a stream and goes
+/// straight to the card, so that the stream stays one CMD25 whatever windows
+/// it crosses; only a new stream is announced with ACMD23. A short scattered
+/// write is copied to its window, which is written back once full or when it
+/// is the least recently used one and another window is needed.
+/// \param  pSd      Pointer to the SdCard instance
+/// \param  address  First block to write
+/// \param  pData    Data to write
+/// \param  length   Number of blocks
+/// \return 0 if successful, otherwise the SD error code
+//------------------------------------------------------------------------------
+static uint8_t WCache_Write(SdCard   *pSd,
+                            uint32_t address,
+                            uint8_t  *pData,
+                            uint32_t length)
+{
+    WCacheWindow *pWindow;
+    uint32_t base, offset, count, i;
+    uint8_t error = 0;
+
+    if (address == wcacheNext) {
+
+        // The start of the stream may still be in a window: write it first
+        // so that the CMD25 carries on from it. The buffered copies of the
+        // blocks about to be written are dropped before
+        WCache_Discard(address, length);
+        base = (address - 1) - (address - 1) % wcacheBlocks;
+        pWindow = WCache_Find(base);
+        if (pWindow) {
+
+            error = WCache_FlushWindow(pSd, pWindow);
+        }
+        if (!error) {
+
+            error = SD_Write(pSd, address, pData, length, 0, 0);
+        }
+        wcacheNext = address + length;
+        return error;
+    }
+    wcacheNext = address + length;
+
+    if (length >= wcacheBlocks) {
+
+        // The buffered copies are overwritten
+        WCache_Discard(address, length);
+        return SD_WritePreErased(pSd, address, pData, length);
+    }
+
+    while (!error && length) {
+
+        offset = address % wcacheBlocks;
+        base = address - offset;
+        count = wcacheBlocks - offset;
+        if (count > length) {
+
+            count = length;
+        }
+        pWindow = WCache_Find(base);
+
+        if (!pWindow) {
+
+            // Take a free window, or write back the least recently used
+            pWindow = &wcache[0];
+            for (i = 1; i < WCACHE_WINDOWS; i++) {
+
+                if (pWindow->base == WCACHE_FREE) {
+
+                    break;
+                }
+                if (wcache[i].base == WCACHE_FREE
+                    || wcache[i].lastUse < pWindow->lastUse) {
+
+                    pWindow = &wcache[i];
+                }
+            }
+            error = WCache_FlushWindow(pSd, pWindow);
+            pWindow->base = base;
+        }
+
+        memcpy(pWindow->pBuffer + offset * SD_BLOCK_SIZE,
+               pData,
+               count * SD_BLOCK_SIZE);
+        for (i = offset; i < offset + count; i++) {
+
+            if (!(pWindow->dirty[i / 32] & (1u << (i % 32)))) {
+
+                pWindow->dirty[i / 32] |= 1u << (i % 32);
+                pWindow->numDirty++;
+            }
+        }
+        pWindow->lastUse = ++wcacheClock;
+
+        if (pWindow->numDirty == wcacheBlocks) {
+
+            error |= WCache_FlushWindow(pSd, pWindow);
+        }
+
+        address += count;
+        pData += count * SD_BLOCK_SIZE;
+        length -= count;
+    }
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+/// Copies the blocks still buffered in the windows over data read from
+/// the card.
+/// \param  address  First block read
+/// \param  pData    Data read
+/// \param  length   Number of blocks
+//------------------------------------------------------------------------------
+static void WCache_Overlay(uint32_t address, uint8_t *pData, uint32_t length)
+{
+    WCacheWindow *pWindow;
+    uint32_t block, offset;
+    uint32_t i;
+
+    for (i = 0; i < WCACHE_WINDOWS; i++) {
+
+        pWindow = &wcache[i];
+        if (pWindow->base == WCACHE_FREE
+            || pWindow->base >= address + length
+            || pWindow->base + wcacheBlocks <= address) {
+
+            continue;
+        }
+        for (block = address; block < address + length; block++) {
+
+            offset = block - pWindow->base;
+            if (offset < wcacheBlocks
+                && (pWindow->dirty[offset / 32] & (1u << (offset % 32)))) {
+
+                memcpy(pData + (block - address) * SD_BLOCK_SIZE,
+                       pWindow->pBuffer + offset * SD_BLOCK_SIZE,
+                       SD_BLOCK_SIZE);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Discards a range of blocks of a SDCARD memory: the buffered blocks
+//!         are dropped and the erase units fully inside the range are erased,
+//!         so that the card does not copy their stale data any more.
+//! \param  media    Pointer to a Media instance
+//! \param  address  First block of the range
+//! \param  length   Number of blocks
+//! \return Operation result code
+//------------------------------------------------------------------------------
+static uint8_t MEDSdcard_Trim(Media *media, uint32_t address, uint32_t length)
+{
+    SdCard *pSd = (SdCard*)media->interface;
+    uint32_t unit, start, end;
+    uint8_t error = 0;
+
+    if (media->state != MED_STATE_READY) {
+
+        TRACE_WARNING("MEDSdcard_Trim: Media is busy\n\r");
+        return MED_STATUS_BUSY;
+    }
+
+    if ((length + address) > media->size) {
+
+        TRACE_WARNING("MEDSdcard_Trim: Range too big\n\r");
+        return MED_STATUS_ERROR;
+    }
+
+    media->state = MED_STATE_BUSY;
+
+    WCache_Discard(address, length);
+
+    // Erase whole units only
+    unit = SD_GetEraseUnitBlocks(pSd);
+    start = ((address + unit - 1) / unit) * unit;
+    end = ((address + length) / unit) * unit;
+    if (start < end) {
+
+        error = SD_Erase(pSd, start, end - 1);
+    }
+
+    media->state = MED_STATE_READY;
+
+    return (error ? MED_STATUS_ERROR : MED_STATUS_SUCCESS);
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Writes back the blocks buffered for a SDCARD memory
+//! \param  media    Pointer to a Media instance
+//! \return Operation result code
+//------------------------------------------------------------------------------
+static uint8_t MEDSdcard_Flush(Media *media)
+{
+    uint8_t error;
+
+    if (media->state != MED_STATE_READY) {
+
+        TRACE_WARNING("MEDSdcard_Flush: Media is busy\n\r");
+        return MED_STATUS_BUSY;
+    }
+
+    media->state = MED_STATE_BUSY;
+    error = WCache_Flush((SdCard*)media->interface);
+    media->state = MED_STATE_READY;
+
+    return (error ? MED_STATUS_ERROR : MED_STATUS_SUCCESS);
+}
+
 //------------------------------------------------------------------------------
 //! \brief  Reads a specified amount of data from a SDCARD memory
 //! \param  media    Pointer to a Media instance
@@ -216,7 +667,11 @@ static uint8_t MEDSdcard_Read(Media         *media,
     // Enter Busy state
     media->state = MED_STATE_BUSY;
 
-    error = SD_Read((SdCard*)media->interface, address, data, length, callback, argument );//length,
+    error = SD_Read((SdCard*)media->interface, address, data, length, 0, 0);
+    if (!error) {
+
+        WCache_Overlay(address, (uint8_t*)data, length);
+    }
 
     // Leave the Busy state
     media->state = MED_STATE_READY;
@@ -224,10 +679,15 @@ static uint8_t MEDSdcard_Read(Media         *media,
     // Invoke callback
     if (callback != 0) {
 
-        callback(argument, MED_STATUS_SUCCESS, 0, 0);
+        if (error) {
+            callback(argument, MED_STATUS_ERROR, 0, length * media->blockSize);
+        }
+        else {
+            callback(argument, MED_STATUS_SUCCESS, length * media->blockSize, 0);
+        }
     }
 
-    return MED_STATUS_SUCCESS;
+    return (error ? MED_STATUS_ERROR : MED_STATUS_SUCCESS);
 }
 
 //------------------------------------------------------------------------------
@@ -269,7 +729,7 @@ static uint8_t MEDSdcard_Write(Media         *media,
     // Put the media in Busy state
     media->state = MED_STATE_BUSY;
 
-    error = SD_Write((SdCard*)media->interface, address, data, length, callback, argument ); // length,
+    error = WCache_Write((SdCard*)media->interface, address, (uint8_t*)data, length);
 
     // Leave the Busy state
     media->state = MED_STATE_READY;
@@ -277,10 +737,15 @@ static uint8_t MEDSdcard_Write(Media         *media,
     // Invoke the callback if it exists
     if (callback != 0) {
 
-        callback(argument, MED_STATUS_SUCCESS, 0, 0);
+        if (error) {
+            callback(argument, MED_STATUS_ERROR, 0, length * media->blockSize);
+        }
+        else {
+            callback(argument, MED_STATUS_SUCCESS, length * media->blockSize, 0);
+        }
     }
 
-    return MED_STATUS_SUCCESS;
+    return (error ? MED_STATUS_ERROR : MED_STATUS_SUCCESS);
 }
 
 //------------------------------------------------------------------------------
@@ -438,11 +903,13 @@ uint8_t MEDSdcard_Detect( Media * media, uint8_t mciID )
 }
 
 //------------------------------------------------------------------------------
-/// Initializes a Media instance and the associated physical interface
+/// Starts the initialization of a Media instance: configures the associated
+/// physical interface and powers the card on. The card is then identified by
+/// MEDSdcard_InitializeStep().
 /// \param  media Pointer to the Media instance to initialize
 /// \return 1 if success.
 //------------------------------------------------------------------------------
-uint8_t MEDSdcard_Initialize(Media *media, uint8_t mciID)
+uint8_t MEDSdcard_InitializeStart(Media *media, uint8_t mciID)
 {
     TRACE_INFO("MEDSdcard init\n\r");
 
@@ -483,12 +950,39 @@ uint8_t MEDSdcard_Initialize(Media *media, uint8_t mciID)
     MCI_SetBusyFix(mciDrv, &pinSdDAT0);
 #endif
 
-    // Initialize the SD card driver
-    if (SD_Init(sdDrv, (Mcid *)mciDrv))
+    // Start the SD card driver initialization
+    if (SD_InitStart(sdDrv, (Mcid *)mciDrv))
     {
         TRACE_ERROR("SD/MMC card initialization failed\n\r");
         return 0;
     }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// Runs one step of the initialization started by MEDSdcard_InitializeStart():
+/// the card is polled once until it has powered up, then the media fields are
+/// initialized.
+/// \param  media Pointer to the Media instance to initialize
+/// \return MED_STATUS_BUSY while the card powers up, MED_STATUS_SUCCESS once
+/// the media is ready, MED_STATUS_ERROR otherwise.
+//------------------------------------------------------------------------------
+uint8_t MEDSdcard_InitializeStep(Media *media, uint8_t mciID)
+{
+    uint8_t error;
+
+    // Identify the card and set it in transfer state
+    error = SD_InitStep(sdDrv);
+    if (error == SDMMC_ERROR_BUSY)
+    {
+        return MED_STATUS_BUSY;
+    }
+    if (error)
+    {
+        TRACE_ERROR("SD/MMC card initialization failed\n\r");
+        return MED_STATUS_ERROR;
+    }
     else
     {
         //SD_DisplayRegisterCSD(&sdDrv);
@@ -502,17 +996,21 @@ uint8_t MEDSdcard_Initialize(Media *media, uint8_t mciID)
 
     // Initialize media fields
     //--------------------------------------------------------------------------
+    WCache_Initialize(sdDrv);
+
     media->interface = sdDrv;
     #if !defined(OP_BOOTSTRAP_MCI_on)
     media->write = MEDSdcard_Write;
+    media->trim = MEDSdcard_Trim;
     #else
     media->write = 0;
+    media->trim = 0;
     #endif
     media->read = MEDSdcard_Read;
     media->lock = 0;
     media->unlock = 0;
     media->handler = 0;
-    media->flush = 0;
+    media->flush = MEDSdcard_Flush;
 
     media->blockSize = SD_BLOCK_SIZE;
     media->baseAddress = 0;
@@ -528,10 +1026,33 @@ uint8_t MEDSdcard_Initialize(Media *media, uint8_t mciID)
     media->transfer.data = 0;
     media->transfer.address = 0;
     media->transfer.length = 0;
+    MED_InitQueue(media);
     media->transfer.callback = 0;
     media->transfer.argument = 0;
 
-    return 1;
+    return MED_STATUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+/// Initializes a Media instance and the associated physical interface
+/// \param  media Pointer to the Media instance to initialize
+/// \return 1 if success.
+//------------------------------------------------------------------------------
+uint8_t MEDSdcard_Initialize(Media *media, uint8_t mciID)
+{
+    uint8_t status;
+
+    if (!MEDSdcard_InitializeStart(media, mciID))
+    {
+        return 0;
+    }
+    do
+    {
+        status = MEDSdcard_InitializeStep(media, mciID);
+    }
+    while (status == MED_STATUS_BUSY);
+
+    return (status == MED_STATUS_SUCCESS);
 }
 
 //------------------------------------------------------------------------------
@@ -600,6 +1121,7 @@ uint8_t MEDSdusb_Initialize(Media *media, uint8_t mciID)
     media->unlock = 0;
     media->handler = 0;
     media->flush = 0;
+    media->trim = 0;
 
     media->blockSize = SD_BLOCK_SIZE;
     media->baseAddress = 0;
@@ -615,6 +1137,7 @@ uint8_t MEDSdusb_Initialize(Media *media, uint8_t mciID)
     media->transfer.data = 0;
     media->transfer.address = 0;
     media->transfer.length = 0;
+    MED_InitQueue(media);
     media->transfer.callback = 0;
     media->transfer.argument = 0;
 
@@ -634,6 +1157,9 @@ void MEDSdcard_EraseAll(Media *media)
 
     TRACE_INFO("MEDSdcard Erase All ...\n\r");
 
+    error = WCache_Flush((SdCard*)media->interface);
+    assert( !error );
+
     // Clear the block buffer
     memset(buffer, 0, media->blockSize * multiBlock);
 
@@ -656,6 +1182,9 @@ void MEDSdcard_EraseBlock(Media *media, uint32_t block)
     uint8_t buffer[SD_BLOCK_SIZE];
     uint8_t error;
 
+    error = WCache_Flush((SdCard*)media->interface);
+    assert( !error );
+
     // Clear the block buffer
     memset(buffer, 0, media->blockSize);
 
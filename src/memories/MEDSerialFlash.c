@@ -0,0 +1,352 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "memories.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Constants
+//------------------------------------------------------------------------------
+
+/// Media blocks in an erase unit
+#define SFLASH_BLOCKS_PER_ERASE (SFLASH_ERASE_SIZE / SFLASH_BLOCK_SIZE)
+
+//------------------------------------------------------------------------------
+//         Local variables
+//------------------------------------------------------------------------------
+
+/// Contents of the erase unit being written.
+static uint8_t eraseBuffer[SFLASH_ERASE_SIZE]
+    __attribute__ ((aligned (4), section (".nandinfo")));
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//! \brief  Writes data inside one erase unit of the serial flash
+//! \param  pAt26   Pointer to the AT26 driver
+//! \param  base    Address of the erase unit
+//! \param  offset  Offset of the data in the unit
+//! \param  pData   Data to write
+//! \param  size    Size of the data in bytes
+//! \return 0 if successful, an AT26_ERROR_xxx code otherwise
+//------------------------------------------------------------------------------
+static uint8_t WriteUnit(At26     *pAt26,
+                         uint32_t base,
+                         uint32_t offset,
+                         uint8_t  *pData,
+                         uint32_t size)
+{
+    uint8_t error;
+    uint32_t page;
+    uint32_t i;
+
+    error = AT26D_Read(pAt26, eraseBuffer, SFLASH_ERASE_SIZE, base);
+    if (error) {
+
+        return error;
+    }
+
+    // Nothing to do if the data is already there
+    if (memcmp(eraseBuffer + offset, pData, size) == 0) {
+
+        return 0;
+    }
+
+    // Programming can only clear bits
+    for (i = 0; i < size; i++) {
+
+        if ((eraseBuffer[offset + i] & pData[i]) != pData[i]) {
+
+            break;
+        }
+    }
+    if (i == size) {
+
+        return AT26D_Write(pAt26, pData, size, base + offset);
+    }
+
+    // Erase, then program back every page which is not blank
+    memcpy(eraseBuffer + offset, pData, size);
+    error = AT26D_EraseBlock(pAt26, base);
+    for (page = 0; !error && (page < SFLASH_ERASE_SIZE); page += AT26_PageSize(pAt26)) {
+
+        for (i = page; i < page + AT26_PageSize(pAt26); i++) {
+
+            if (eraseBuffer[i] != 0xFF) {
+
+                error = AT26D_Write(pAt26, eraseBuffer + page, AT26_PageSize(pAt26), base + page);
+                break;
+            }
+        }
+    }
+
+    return error;
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Reads data from a serial flash media
+//! \param  media    Pointer to a Media instance
+//! \param  address  Address of the data to read
+//! \param  data     Pointer to the buffer in which to store the retrieved
+//!                   data
+//! \param  length   Length of the buffer
+//! \param  callback Optional pointer to a callback function to invoke when
+//!                   the operation is finished
+//! \param  argument Optional pointer to an argument for the callback
+//! \return Operation result code
+//------------------------------------------------------------------------------
+static uint8_t MEDSerialFlash_Read(Media         *media,
+                                   uint32_t      address,
+                                   void          *data,
+                                   uint32_t      length,
+                                   MediaCallback callback,
+                                   void          *argument)
+{
+    uint8_t error;
+
+    // Check that the media is ready
+    if (media->state != MED_STATE_READY) {
+
+        TRACE_INFO("Media busy\n\r");
+        return MED_STATUS_BUSY;
+    }
+
+    // Check that the data to read is not too big
+    if ((length + address) > media->size) {
+
+        TRACE_WARNING("MEDSerialFlash_Read: Data too big: %d, %d\n\r",
+                      (int)length, (int)address);
+        return MED_STATUS_ERROR;
+    }
+
+    // Enter Busy state
+    media->state = MED_STATE_BUSY;
+
+    error = AT26D_Read((At26*)media->interface, (uint8_t*)data,
+                       length * SFLASH_BLOCK_SIZE, address * SFLASH_BLOCK_SIZE);
+
+    // Leave the Busy state
+    media->state = MED_STATE_READY;
+
+    // Invoke callback
+    if (callback != 0) {
+
+        if (error) {
+            callback(argument, MED_STATUS_ERROR, 0, length * media->blockSize);
+        }
+        else {
+            callback(argument, MED_STATUS_SUCCESS, length * media->blockSize, 0);
+        }
+    }
+
+    return (error ? MED_STATUS_ERROR : MED_STATUS_SUCCESS);
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Writes data on a serial flash media
+//! \param  media    Pointer to a Media instance
+//! \param  address  Address at which to write
+//! \param  data     Pointer to the data to write
+//! \param  length   Size of the data buffer
+//! \param  callback Optional pointer to a callback function to invoke when
+//!                   the write operation terminates
+//! \param  argument Optional argument for the callback function
+//! \return Operation result code
+//------------------------------------------------------------------------------
+static uint8_t MEDSerialFlash_Write(Media         *media,
+                                    uint32_t      address,
+                                    void          *data,
+                                    uint32_t      length,
+                                    MediaCallback callback,
+                                    void          *argument)
+{
+    At26 *pAt26 = (At26*)media->interface;
+    uint8_t *pData = (uint8_t*)data;
+    uint8_t error = 0;
+    uint32_t first;
+    uint32_t count;
+    uint32_t remaining = length;
+
+    if (media->protected) {
+
+        return MED_STATUS_PROTECTED;
+    }
+
+    // Check that the media if ready
+    if (media->state != MED_STATE_READY) {
+
+        TRACE_WARNING("MEDSerialFlash_Write: Media is busy\n\r");
+        return MED_STATUS_BUSY;
+    }
+
+    // Check that the data to write is not too big
+    if ((length + address) > media->size) {
+
+        TRACE_WARNING("MEDSerialFlash_Write: Data too big\n\r");
+        return MED_STATUS_ERROR;
+    }
+
+    // Put the media in Busy state
+    media->state = MED_STATE_BUSY;
+
+    while (!error && (remaining > 0)) {
+
+        first = address % SFLASH_BLOCKS_PER_ERASE;
+        count = SFLASH_BLOCKS_PER_ERASE - first;
+        if (count > remaining) {
+
+            count = remaining;
+        }
+
+        error = WriteUnit(pAt26,
+                          (address - first) * SFLASH_BLOCK_SIZE,
+                          first * SFLASH_BLOCK_SIZE,
+                          pData,
+                          count * SFLASH_BLOCK_SIZE);
+
+        address += count;
+        pData += count * SFLASH_BLOCK_SIZE;
+        remaining -= count;
+    }
+
+    // Leave the Busy state
+    media->state = MED_STATE_READY;
+
+    // Invoke the callback if it exists
+    if (callback != 0) {
+
+        if (error) {
+            callback(argument, MED_STATUS_ERROR, 0, length * media->blockSize);
+        }
+        else {
+            callback(argument, MED_STATUS_SUCCESS, length * media->blockSize, 0);
+        }
+    }
+
+    return (error ? MED_STATUS_ERROR : MED_STATUS_SUCCESS);
+}
+
+//------------------------------------------------------------------------------
+//! \brief  Erases the erase units entirely inside a discarded range, so that
+//!         the next writes there do not need an erase
+//! \param  media    Pointer to a Media instance
+//! \param  address  First block discarded
+//! \param  length   Number of blocks discarded
+//! \return Operation result code
+//------------------------------------------------------------------------------
+static uint8_t MEDSerialFlash_Trim(Media *media, uint32_t address, uint32_t length)
+{
+    At26 *pAt26 = (At26*)media->interface;
+    uint32_t unit;
+    uint32_t end;
+    uint32_t i;
+
+    if (media->protected || ((length + address) > media->size)) {
+
+        return MED_STATUS_ERROR;
+    }
+
+    unit = (address + SFLASH_BLOCKS_PER_ERASE - 1) / SFLASH_BLOCKS_PER_ERASE;
+    end = (address + length) / SFLASH_BLOCKS_PER_ERASE;
+    for (; unit < end; unit++) {
+
+        // A read is much shorter than an erase: skip the blank units
+        if (AT26D_Read(pAt26, eraseBuffer, SFLASH_ERASE_SIZE, unit * SFLASH_ERASE_SIZE)) {
+
+            return MED_STATUS_ERROR;
+        }
+        for (i = 0; (i < SFLASH_ERASE_SIZE) && (eraseBuffer[i] == 0xFF); i++);
+        if ((i < SFLASH_ERASE_SIZE) && AT26D_EraseBlock(pAt26, unit * SFLASH_ERASE_SIZE)) {
+
+            return MED_STATUS_ERROR;
+        }
+    }
+
+    return MED_STATUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Initializes a Media instance on an identified AT26 serial flash. The media
+/// is read-only if the device cannot be unprotected or does not erase by
+/// SFLASH_ERASE_SIZE blocks.
+/// \param  media Pointer to the Media instance to initialize
+/// \param  pAt26 AT26 driver, AT26_FindDevice() done
+/// \return 1 if success.
+//------------------------------------------------------------------------------
+uint8_t MEDSerialFlash_Initialize(Media *media, At26 *pAt26)
+{
+    TRACE_INFO("MEDSerialFlash init\n\r");
+
+    if (pAt26->pDesc == 0) {
+
+        return 0;
+    }
+
+    media->interface = pAt26;
+    media->write = MEDSerialFlash_Write;
+    media->read = MEDSerialFlash_Read;
+    media->cancelIo = 0;
+    media->lock = 0;
+    media->unlock = 0;
+    media->handler = 0;
+    media->flush = 0;
+    media->trim = MEDSerialFlash_Trim;
+
+    media->blockSize = SFLASH_BLOCK_SIZE;
+    media->baseAddress = 0;
+    media->size = AT26_Size(pAt26) / SFLASH_BLOCK_SIZE;
+
+    media->mappedRD  = 0;
+    media->mappedWR  = 0;
+    media->protected = (AT26_BlockSize(pAt26) != SFLASH_ERASE_SIZE)
+                       || (AT26D_Unprotect(pAt26) != 0);
+    media->removable = 0;
+
+    media->state = MED_STATE_READY;
+
+    media->transfer.data = 0;
+    media->transfer.address = 0;
+    media->transfer.length = 0;
+    media->transfer.callback = 0;
+    media->transfer.argument = 0;
+    MED_InitQueue(media);
+
+    return 1;
+}
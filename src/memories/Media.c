@@ -33,6 +33,8 @@
 
 #include "memories.h"
 
+#include <string.h>
+
 /*------------------------------------------------------------------------------
 //      Inline Functions
  *------------------------------------------------------------------------------*/
@@ -130,6 +132,46 @@ extern uint32_t MED_Flush( Media* pMedia )
     }
 }
 
+/**
+ *  \brief  Tells the media that the data in the given range is no longer used,
+ *  so that it is not preserved by the media internal copies. The content of
+ *  the range is undefined afterwards.
+ *  \param  media    Pointer to the Media instance to use
+ *  \param  address  Address of the first block of the range
+ *  \param  length   Number of blocks in the range
+ */
+extern uint32_t MED_Trim( Media* pMedia, uint32_t address, uint32_t length )
+{
+    if ( pMedia->trim )
+    {
+        return pMedia->trim( pMedia, address, length ) ;
+    }
+    else {
+
+        return MED_STATUS_SUCCESS ;
+    }
+}
+
+/**
+ *  \brief  Returns the address of a range of a media mapped to the memory
+ *  space, so that it can be used in place instead of being read in a buffer.
+ *  The range stays valid as long as the media is not written.
+ *  \param  media    Pointer to the Media instance to use
+ *  \param  address  Address of the first block of the range
+ *  \param  length   Number of blocks in the range
+ *  \return Pointer to the first byte of the range, 0 if the media is not
+ *  mapped to read or the range is out of the media.
+ */
+extern void* MED_Map( Media* pMedia, uint32_t address, uint32_t length )
+{
+    if ( !pMedia->mappedRD || (address > pMedia->size) || (length > pMedia->size - address) )
+    {
+        return 0 ;
+    }
+
+    return (void*)((pMedia->baseAddress + address) * pMedia->blockSize) ;
+}
+
 /**
  *  \brief  Invokes the interrupt handler of the specified media
  *  \param  media Pointer to the Media instance to use
@@ -140,6 +182,8 @@ extern inline void MED_Handler( Media* pMedia )
     {
         pMedia->handler( pMedia ) ;
     }
+
+    MED_ServiceQueue( pMedia ) ;
 }
 
 /**
@@ -160,6 +204,202 @@ extern inline uint32_t MED_IsInitialized( Media* pMedia )
     return (pMedia->state != MED_STATE_NOT_READY) ;
 }
 
+/*------------------------------------------------------------------------------
+ *      Request queue internal functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ *  \brief  Returns the i-th pending request, 0 being the oldest one
+ */
+static MEDRequest* MEDQueue_At( const MEDQueue* pQueue, uint32_t i )
+{
+    return pQueue->pRequests[(pQueue->bHead + i) % MED_QUEUE_SIZE] ;
+}
+
+/**
+ *  \brief  Returns the total size of a request in media blocks
+ */
+static uint32_t MEDQueue_RequestLength( const MEDRequest* pRequest )
+{
+    uint32_t dwLength = 0 ;
+    uint32_t i ;
+
+    for ( i = 0 ; i < pRequest->bNumIov ; i++ )
+    {
+        dwLength += pRequest->pIov[i].length ;
+    }
+
+    return dwLength ;
+}
+
+/**
+ *  \brief  Removes the oldest request from the queue and invokes its callback
+ */
+static void MEDQueue_Complete( Media* pMedia, uint8_t bStatus )
+{
+    MEDQueue* pQueue = &pMedia->queue ;
+    MEDRequest* pRequest = MEDQueue_At( pQueue, 0 ) ;
+    uint32_t dwBytes = MEDQueue_RequestLength( pRequest ) * pMedia->blockSize ;
+
+    if ( bStatus != MED_STATUS_SUCCESS )
+    {
+        pRequest->bStatus = bStatus ;
+    }
+
+    pQueue->bHead = (pQueue->bHead + 1) % MED_QUEUE_SIZE ;
+    pQueue->bCount-- ;
+    pQueue->bRunCount-- ;
+
+    if ( pRequest->callback )
+    {
+        if ( pRequest->bStatus == MED_STATUS_SUCCESS )
+        {
+            pRequest->callback( pRequest->argument, pRequest->bStatus, dwBytes, 0 ) ;
+        }
+        else
+        {
+            pRequest->callback( pRequest->argument, pRequest->bStatus, 0, dwBytes ) ;
+        }
+    }
+}
+
+/**
+ *  \brief  Accounts for the blocks moved by the last driver call and
+ *          completes the requests entirely transferred.
+ *
+ *  On error the remaining requests of the run are completed with the error
+ *  status, as the media position is no longer known.
+ */
+static void MEDQueue_EndSegment( Media* pMedia )
+{
+    MEDQueue* pQueue = &pMedia->queue ;
+    MEDRequest* pRequest ;
+    uint32_t dwBlocks = pQueue->dwIssued ;
+    uint32_t dwLength ;
+
+    pQueue->dwIssued = 0 ;
+
+    if ( pQueue->bStatus != MED_STATUS_SUCCESS )
+    {
+        TRACE_WARNING( "MED_ServiceQueue: run aborted (%d)\n\r", pQueue->bStatus ) ;
+        while ( pQueue->bRunCount )
+        {
+            MEDQueue_Complete( pMedia, pQueue->bStatus ) ;
+        }
+
+        return ;
+    }
+
+    while ( dwBlocks )
+    {
+        pRequest = MEDQueue_At( pQueue, pQueue->bRunIndex ) ;
+        dwLength = pRequest->pIov[pQueue->bIovIndex].length - pQueue->dwIovOffset ;
+        if ( dwLength > dwBlocks )
+        {
+            pQueue->dwIovOffset += dwBlocks ;
+            break ;
+        }
+
+        dwBlocks -= dwLength ;
+        pQueue->dwIovOffset = 0 ;
+        if ( ++pQueue->bIovIndex == pRequest->bNumIov )
+        {
+            pQueue->bIovIndex = 0 ;
+            pQueue->bRunIndex++ ;
+        }
+    }
+
+    /* Requests before bRunIndex are done */
+    while ( pQueue->bRunIndex )
+    {
+        pQueue->bRunIndex-- ;
+        MEDQueue_Complete( pMedia, MED_STATUS_SUCCESS ) ;
+    }
+}
+
+/**
+ *  \brief  Media callback of the driver calls issued by the queue
+ */
+static void MEDQueue_Callback( void *argument, uint8_t status, uint32_t transferred, uint32_t remaining )
+{
+    Media* pMedia = (Media*)argument ;
+
+    pMedia->queue.bStatus = status ;
+    pMedia->queue.bPending = 0 ;
+
+    /* Asynchronous completion: continue with the next segment */
+    if ( !pMedia->queue.bActive )
+    {
+        MED_ServiceQueue( pMedia ) ;
+    }
+}
+
+/**
+ *  \brief  Issues one driver call for the current position of the run. The
+ *          following iovecs that continue the same buffer in memory are
+ *          coalesced into the same call.
+ */
+static void MEDQueue_StartSegment( Media* pMedia )
+{
+    MEDQueue* pQueue = &pMedia->queue ;
+    MEDRequest* pRequest = MEDQueue_At( pQueue, pQueue->bRunIndex ) ;
+    MEDIovec* pIov = &pRequest->pIov[pQueue->bIovIndex] ;
+    uint8_t* pData = (uint8_t*)pIov->data + pQueue->dwIovOffset * pMedia->blockSize ;
+    uint32_t dwBlocks = pIov->length - pQueue->dwIovOffset ;
+    uint32_t dwRequest = pQueue->bRunIndex ;
+    uint32_t dwIov = pQueue->bIovIndex ;
+    uint32_t dwAddress ;
+    uint8_t bWrite = pRequest->bWrite ;
+    uint8_t bRc ;
+
+    while ( dwBlocks < MED_SG_MAX_BLOCKS )
+    {
+        if ( ++dwIov == pRequest->bNumIov )
+        {
+            if ( ++dwRequest == pQueue->bRunCount )
+            {
+                break ;
+            }
+            pRequest = MEDQueue_At( pQueue, dwRequest ) ;
+            dwIov = 0 ;
+        }
+
+        pIov = &pRequest->pIov[dwIov] ;
+        if ( (uint8_t*)pIov->data != pData + dwBlocks * pMedia->blockSize )
+        {
+            break ;
+        }
+        dwBlocks += pIov->length ;
+    }
+
+    if ( dwBlocks > MED_SG_MAX_BLOCKS )
+    {
+        dwBlocks = MED_SG_MAX_BLOCKS ;
+    }
+
+    dwAddress = pQueue->dwAddress ;
+    pQueue->dwAddress += dwBlocks ;
+    pQueue->dwIssued = dwBlocks ;
+    pQueue->bStatus = MED_STATUS_SUCCESS ;
+    pQueue->bPending = 1 ;
+
+    if ( bWrite )
+    {
+        bRc = pMedia->write( pMedia, dwAddress, pData, dwBlocks, MEDQueue_Callback, pMedia ) ;
+    }
+    else
+    {
+        bRc = pMedia->read( pMedia, dwAddress, pData, dwBlocks, MEDQueue_Callback, pMedia ) ;
+    }
+
+    /* Rejected by the driver without callback */
+    if ( (bRc != MED_STATUS_SUCCESS) && pQueue->bPending )
+    {
+        pQueue->bStatus = (bRc == MED_STATUS_BUSY) ? MED_STATUS_ERROR : bRc ;
+        pQueue->bPending = 0 ;
+    }
+}
+
 /*------------------------------------------------------------------------------
  *         Exported functions
  *------------------------------------------------------------------------------*/
@@ -180,6 +420,201 @@ extern void MED_HandleAll( Media* pMedia, uint8_t bNumMedia )
 
     for ( i = 0 ; i < bNumMedia ; i++ )
     {
-        (pMedia + i)->handler(&(pMedia[i])) ;
+        if ( pMedia[i].handler )
+        {
+            pMedia[i].handler( &(pMedia[i]) ) ;
+        }
+
+        MED_ServiceQueue( &(pMedia[i]) ) ;
+    }
+}
+
+/**
+ *  \brief  Empties the request queue of a media. Must be called by the
+ *          media initialization functions.
+ *  \param  pMedia Pointer to the Media instance to use
+ */
+extern void MED_InitQueue( Media* pMedia )
+{
+    memset( &pMedia->queue, 0, sizeof( MEDQueue ) ) ;
+}
+
+/**
+ *  \brief  Returns the number of requests, starting from the oldest one,
+ *          which form one run: same direction and each request starting
+ *          where the previous one ends on the media.
+ *  \param  pQueue Pointer to a non-empty request queue
+ */
+extern uint32_t MED_MergeCount( const MEDQueue* pQueue )
+{
+    const MEDRequest* pFirst = MEDQueue_At( pQueue, 0 ) ;
+    const MEDRequest* pNext ;
+    uint32_t dwEnd = pFirst->address + MEDQueue_RequestLength( pFirst ) ;
+    uint32_t dwCount ;
+
+    for ( dwCount = 1 ; dwCount < pQueue->bCount ; dwCount++ )
+    {
+        pNext = MEDQueue_At( pQueue, dwCount ) ;
+        if ( (pNext->bWrite != pFirst->bWrite) || (pNext->address != dwEnd) )
+        {
+            break ;
+        }
+        dwEnd += MEDQueue_RequestLength( pNext ) ;
+    }
+
+    return dwCount ;
+}
+
+/**
+ *  \brief  Queues a scatter-gather request on a media and starts servicing
+ *          the queue if the media is idle.
+ *
+ *  Requests are serviced in order. Consecutive requests of the same
+ *  direction covering adjacent media ranges are merged into one run, so
+ *  that the driver sees a single sequential access (e.g. one open-ended
+ *  multiple block command on SD cards).
+ *  \param  pMedia   Pointer to the Media instance to use
+ *  \param  pRequest Request descriptor, owned by the caller until its
+ *                   callback is invoked
+ *  \return MED_STATUS_SUCCESS if queued, MED_STATUS_BUSY if the queue is
+ *          full, MED_STATUS_ERROR if the request is invalid
+ */
+extern uint32_t MED_Submit( Media* pMedia, MEDRequest* pRequest )
+{
+    MEDQueue* pQueue = &pMedia->queue ;
+    uint32_t dwLength ;
+    uint32_t dwPriMask ;
+    uint32_t i ;
+
+    if ( pRequest->bNumIov == 0 )
+    {
+        return MED_STATUS_ERROR ;
+    }
+
+    for ( i = 0 ; i < pRequest->bNumIov ; i++ )
+    {
+        if ( pRequest->pIov[i].length == 0 )
+        {
+            return MED_STATUS_ERROR ;
+        }
+    }
+
+    dwLength = MEDQueue_RequestLength( pRequest ) ;
+    if ( (pRequest->address + dwLength) > pMedia->size )
+    {
+        TRACE_WARNING( "MED_Submit: Data too big: %u, %u\n\r", (unsigned int)pRequest->address, (unsigned int)dwLength ) ;
+        return MED_STATUS_ERROR ;
+    }
+
+    if ( pRequest->bWrite && pMedia->protected )
+    {
+        return MED_STATUS_PROTECTED ;
+    }
+
+    /* Would never be serviced */
+    if ( pMedia->state == MED_STATE_NOT_READY )
+    {
+        return MED_STATUS_ERROR ;
+    }
+
+    pRequest->bStatus = MED_STATUS_SUCCESS ;
+
+    dwPriMask = __get_PRIMASK() ;
+    __disable_irq() ;
+    if ( pQueue->bCount == MED_QUEUE_SIZE )
+    {
+        __set_PRIMASK( dwPriMask ) ;
+        return MED_STATUS_BUSY ;
+    }
+    pQueue->pRequests[(pQueue->bHead + pQueue->bCount) % MED_QUEUE_SIZE] = pRequest ;
+    pQueue->bCount++ ;
+    __set_PRIMASK( dwPriMask ) ;
+
+    MED_ServiceQueue( pMedia ) ;
+
+    return MED_STATUS_SUCCESS ;
+}
+
+/**
+ *  \brief  Services the request queue of a media: issues the driver calls
+ *          back to back until the queue is empty or a driver call completes
+ *          asynchronously, in which case servicing resumes from the driver
+ *          completion (interrupt) or from MED_Handler().
+ *  \param  pMedia Pointer to the Media instance to use
+ */
+extern void MED_ServiceQueue( Media* pMedia )
+{
+    MEDQueue* pQueue = &pMedia->queue ;
+    uint32_t dwPriMask ;
+
+    dwPriMask = __get_PRIMASK() ;
+    __disable_irq() ;
+    if ( pQueue->bActive || pQueue->bPending || pQueue->bPlugged )
+    {
+        __set_PRIMASK( dwPriMask ) ;
+        return ;
+    }
+    pQueue->bActive = 1 ;
+    __set_PRIMASK( dwPriMask ) ;
+
+    for ( ;; )
+    {
+        while ( !pQueue->bPending )
+        {
+            if ( pQueue->dwIssued )
+            {
+                MEDQueue_EndSegment( pMedia ) ;
+            }
+
+            if ( (pQueue->bCount == 0) || (pMedia->state != MED_STATE_READY) )
+            {
+                break ;
+            }
+
+            if ( pQueue->bRunCount == 0 )
+            {
+                pQueue->bRunIndex = 0 ;
+                pQueue->bIovIndex = 0 ;
+                pQueue->dwIovOffset = 0 ;
+                pQueue->dwAddress = MEDQueue_At( pQueue, 0 )->address ;
+            }
+            /* Extend the run with the requests queued since it started */
+            pQueue->bRunCount = MED_MergeCount( pQueue ) ;
+
+            MEDQueue_StartSegment( pMedia ) ;
+        }
+
+        /* A driver call may complete before bActive is cleared */
+        __disable_irq() ;
+        if ( pQueue->bPending || !pQueue->dwIssued )
+        {
+            pQueue->bActive = 0 ;
+            __set_PRIMASK( dwPriMask ) ;
+            break ;
+        }
+        __set_PRIMASK( dwPriMask ) ;
     }
 }
+
+/**
+ *  \brief  Holds the request queue of a media: the requests submitted until
+ *          MED_Unplug() are only queued, so that a caller with several
+ *          requests at hand gets the adjacent ones merged even when the
+ *          driver completes synchronously. A run in progress is not stopped.
+ *  \param  pMedia Pointer to the Media instance to use
+ */
+extern void MED_Plug( Media* pMedia )
+{
+    pMedia->queue.bPlugged = 1 ;
+}
+
+/**
+ *  \brief  Releases the request queue of a media held by MED_Plug() and
+ *          services the requests queued meanwhile.
+ *  \param  pMedia Pointer to the Media instance to use
+ */
+extern void MED_Unplug( Media* pMedia )
+{
+    pMedia->queue.bPlugged = 0 ;
+    MED_ServiceQueue( pMedia ) ;
+}
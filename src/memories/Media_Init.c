@@ -26,6 +26,13 @@
 -----------------------------------------------------------------------------*/
 
 #define NAND_ESRAM_BUFFER(bufName) bufName __attribute__ ((section (".nandinfo")))
+
+/* The XIP kernel partition only exists in the -DBOOT_XIP profile */
+#if defined(BOOT_XIP)
+#define NOR_VOLUME_OFFSET BOARD_NORFLASH_XIP_SIZE
+#else
+#define NOR_VOLUME_OFFSET 0
+#endif
 /*---------------------------------------------------------------------------
                                 LOCAL DATA TYPES
 -----------------------------------------------------------------------------*/
@@ -83,6 +90,22 @@ static unsigned int dataBytesAddr = BOARD_NF_DATA_ADDR;
 static const Pin nfCePin = BOARD_NF_CE_PIN;
 /** Nandflash ready/busy pin.*/
 static const Pin nfRbPin = BOARD_NF_RB_PIN;
+/** Set once the nandflash media is initialized.*/
+static unsigned char nandReady;
+/** Set while the block scan of the nandflash is in progress.*/
+static unsigned char nandScanning;
+/** Set while the SD card powers up.*/
+static unsigned char sdStarting;
+
+/** Pins used to access to the serial flash.*/
+static const Pin pPinsSf[] = {BOARD_AT26_PINS};
+/** SPI driver of the serial flash.*/
+static Spid spid;
+/** Serial flash driver.*/
+static At26 at26;
+
+/** Pins used to access to the norflash.*/
+static const Pin pPinsNor[] = {PINS_NORFLASH};
 
 
 ///////////////////////////////
@@ -93,40 +116,64 @@ Media NAND_ESRAM_BUFFER(medias[MAX_LUNS]);
 /// Number of medias which are effectively used.
 
 /*---------------------------------------------------------------------------
-   Function   : FatFs_NandFlash_Init
+   Function   : Medias_InitNand
  -----------------------------------------------------------------------------*/
  /**
- *  @brief 	Init Nandflash for FatFS
+ *  @brief 	Init Nandflash and mount it for FatFS
  *  @retval Returns 0 if succesful; otherwise, returns error code.
- *  @remarks None
+ *  @remarks The block scan of the translation layer is done here.
  */
-int Medias_Init(void)
+int Medias_InitNand(void)
 {
-    /* Temporary buffer */
-    unsigned short block, page;
-    unsigned int i;
-    /* Errors returned by SkipNandFlash functions */
-    unsigned char error = 0;
-    DIR dirs;
+    int error;
+
+    do {
+        error = Medias_InitNandStep();
+    } while (error == MEDIAS_INIT_PENDING);
 
+    return error;
+}
+
+/*---------------------------------------------------------------------------
+   Function   : Medias_InitNandStep
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	One step of Medias_InitNand()
+ *  @retval Returns MEDIAS_INIT_PENDING while the block scan is in progress,
+ *          0 if succesful; otherwise, returns error code.
+ *  @remarks Each call scans one group of blocks (ManagedNandFlash_SCANGROUP).
+ */
+int Medias_InitNandStep(void)
+{
     FRESULT res;
+    unsigned char error;
+
     /* Configure SMC for Nandflash accesses */
 #if 1
-    BOARD_ConfigureNandFlash(SMC);
-	PIO_Configure(pPinsNf, PIO_LISTSIZE(pPinsNf));
+	if (!nandScanning) {
+		BOARD_ConfigureNandFlash(SMC);
+		PIO_Configure(pPinsNf, PIO_LISTSIZE(pPinsNf));
 
-	memset(&translatedNf, 0, sizeof(translatedNf));
+		memset(&translatedNf, 0, sizeof(translatedNf));
+		nandScanning = 1;
+	}
 
-	if (TranslatedNandFlash_Initialize(&translatedNf,
+	error = TranslatedNandFlash_Initialize(&translatedNf,
 							   0,
 							   cmdBytesAddr,
 							   addrBytesAddr,
 							   dataBytesAddr,
 							   nfCePin,
-							   nfRbPin, 0, 2048)) {
+							   nfRbPin, 0, 2048);
+	if (error == NandCommon_ERROR_SCANPENDING) {
+
+	   return MEDIAS_INIT_PENDING;
+	}
+	nandScanning = 0;
+	if (error) {
 
 	   printf("-E- Device Unknown\n\r");
-	   return 0;
+	   return 1;
 	}
 
 	printf("-I- Nandflash driver initialized\n\r");
@@ -144,18 +191,93 @@ int Medias_Init(void)
 	printf("-I- Size of the data area of a page in bytes : 0x%x \n\r",pageSize);
 	printf("-I- Number of pages per block : 0x%x \n\r",numPagesPerBlock);
 	MEDNandFlash_Initialize(&medias[DRV_NAND] , &translatedNf);
+	nandReady = 1;
 #endif
 
+#if 1
+	res = f_mount(DRV_NAND, &fs[DRV_NAND]);
+    if( res != FR_OK )
+    {
+    	printf("-E- f_mount pb: 0x%X\n\r", res);
+    	return 1;
+    }
+#endif
+	NandScratch_PrintReport();
+	return 0;
+}
+
+/*---------------------------------------------------------------------------
+   Function   : Medias_CollectNand
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	Erase a few dirty blocks of the Nandflash
+ *  @param  maxErases  Maximum number of blocks to erase.
+ *  @retval Returns the number of blocks erased, 0 when there is nothing to do.
+ *  @remarks Called at idle points, each erase takes one tBERS.
+ */
+int Medias_CollectNand(unsigned int maxErases)
+{
+	if (!nandReady)
+	{
+		return 0;
+	}
+
+	return MEDNandFlash_CollectGarbage(&medias[DRV_NAND], maxErases);
+}
+
+/*---------------------------------------------------------------------------
+   Function   : Medias_InitSdcard
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	Init the SD card and mount it for FatFS
+ *  @retval Returns 0 if succesful; otherwise, returns error code.
+ *  @remarks None
+ */
+int Medias_InitSdcard(void)
+{
+    int error;
+
+    do {
+        error = Medias_InitSdcardStep();
+    } while (error == MEDIAS_INIT_PENDING);
+
+    return error;
+}
+
+/*---------------------------------------------------------------------------
+   Function   : Medias_InitSdcardStep
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	One step of Medias_InitSdcard()
+ *  @retval Returns MEDIAS_INIT_PENDING while the card powers up,
+ *          0 if succesful; otherwise, returns error code.
+ *  @remarks Each call polls the card once (ACMD41).
+ */
+int Medias_InitSdcardStep(void)
+{
+    DIR dirs;
+    FRESULT res;
+
 
 #if 1
-	MEDSdcard_Initialize(&medias[DRV_MMC], 0 ); //TODO: Try to fix MMC SD init
+	if (!sdStarting) {
+		if (MEDSdcard_InitializeStart(&medias[DRV_MMC], 0)) { //TODO: Try to fix MMC SD init
+			sdStarting = 1;
+		}
+	}
+	if (sdStarting) {
+		if (MEDSdcard_InitializeStep(&medias[DRV_MMC], 0) == MED_STATUS_BUSY) {
+			return MEDIAS_INIT_PENDING;
+		}
+		sdStarting = 0;
+	}
 
 	memset(&fs[DRV_MMC], 0, sizeof(FATFS));
 	res = f_mount(DRV_MMC, &fs[DRV_MMC]);
 	if( res != FR_OK )
 	{
 		printf("-E- f_mount pb: 0x%X\n\r", res);
-		return 0;
+		return 1;
 	}
 
 
@@ -173,18 +295,108 @@ int Medias_Init(void)
     }
 
 #endif
+	return 0;
+}
+
+/*---------------------------------------------------------------------------
+   Function   : Medias_InitSerialFlash
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	Init the AT26 serial flash and mount it for FatFS
+ *  @retval Returns 0 if succesful; otherwise, returns error code.
+ *  @remarks The serial flash holds the recovery images.
+ */
+int Medias_InitSerialFlash(void)
+{
+    FRESULT res;
+    unsigned int jedecId;
+
+	PIO_Configure(pPinsSf, PIO_LISTSIZE(pPinsSf));
+	SPID_Configure(&spid, BOARD_AT26_SPI_BASE, BOARD_AT26_SPI_ID);
+	SPID_ConfigureCS(&spid, BOARD_AT26_NPCS,
+					 SPI_CSR_NCPHA | SPI_CSR_BITS_8_BIT
+					 | SPI_SCBR(BOARD_AT26_SPCK, BOARD_MCK));
+	AT26_Configure(&at26, &spid, BOARD_AT26_NPCS);
+
+	jedecId = AT26D_ReadJedecId(&at26);
+	if (AT26_FindDevice(&at26, jedecId) == 0) {
+
+	   printf("-E- Serial flash unknown (JEDEC ID 0x%08X)\n\r", jedecId);
+	   return 1;
+	}
+
+	printf("-I- Serial flash %s, 0x%x bytes\n\r", AT26_Name(&at26), AT26_Size(&at26));
+	MEDSerialFlash_Initialize(&medias[DRV_SFLASH], &at26);
+
+	memset(&fs[DRV_SFLASH], 0, sizeof(FATFS));
+	res = f_mount(DRV_SFLASH, &fs[DRV_SFLASH]);
+	if( res != FR_OK )
+	{
+		printf("-E- f_mount pb: 0x%X\n\r", res);
+		return 1;
+	}
 
-#if 1
-	res = f_mount(DRV_NAND, &fs[DRV_NAND]);
-    if( res != FR_OK )
-    {
-    	printf("-E- f_mount pb: 0x%X\n\r", res);
-    	return 0;
-    }
-#endif
 	return 0;
 }
 
+/*---------------------------------------------------------------------------
+   Function   : Medias_InitNorFlash
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	Init the parallel norflash and mount it for FatFS
+ *  @retval Returns 0 if succesful; otherwise, returns error code.
+ *  @remarks The norflash is mapped: the files stored in one run of clusters
+ *           are used in place (f_map). With -DBOOT_XIP the volume starts
+ *           after the XIP kernel partition. The flash is left in read
+ *           array mode.
+ */
+int Medias_InitNorFlash(void)
+{
+    FRESULT res;
+
+	PIO_Configure(pPinsNor, PIO_LISTSIZE(pPinsNor));
+	BOARD_ConfigureNorFlash(SMC);
+
+	if (!MEDNorFlash_Initialize(&medias[DRV_NOR], BOARD_NORFLASH_ADDR,
+	                            NOR_VOLUME_OFFSET, BOARD_NORFLASH_MAX_SIZE)) {
+
+	   printf("-E- No CFI norflash\n\r");
+	   return 1;
+	}
+
+	printf("-I- Norflash volume at 0x%x, 0x%x bytes\n\r",
+	       medias[DRV_NOR].baseAddress * medias[DRV_NOR].blockSize,
+	       medias[DRV_NOR].size * medias[DRV_NOR].blockSize);
+
+	memset(&fs[DRV_NOR], 0, sizeof(FATFS));
+	res = f_mount(DRV_NOR, &fs[DRV_NOR]);
+	if( res != FR_OK )
+	{
+		printf("-E- f_mount pb: 0x%X\n\r", res);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------
+   Function   : Medias_Init
+ -----------------------------------------------------------------------------*/
+ /**
+ *  @brief 	Init all the medias for FatFS, one after the other
+ *  @retval Returns 0 if succesful; otherwise, returns error code.
+ *  @remarks None
+ */
+int Medias_Init(void)
+{
+    int error;
+
+    error = Medias_InitNand();
+    error |= Medias_InitSdcard();
+
+    return error;
+}
+
 
 //------------------------------------------------------------------------------
 /// Scan the directory passed in argument and display all the files and
@@ -54,5 +54,9 @@ extern void MEDNandFlash_Initialize(
     Media *media,
     struct TranslatedNandFlash *tnf);
 
+extern unsigned int MEDNandFlash_CollectGarbage(
+    Media *media,
+    unsigned int maxErases);
+
 #endif //#ifndef MEDNANDFLASH_H
 
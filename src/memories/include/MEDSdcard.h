@@ -48,6 +48,8 @@
 
 extern uint8_t MEDSdcard_Detect( Media *media, uint8_t mciID ) ;
 extern uint8_t MEDSdcard_Initialize( Media *media, uint8_t mciID ) ;
+extern uint8_t MEDSdcard_InitializeStart( Media *media, uint8_t mciID ) ;
+extern uint8_t MEDSdcard_InitializeStep( Media *media, uint8_t mciID ) ;
 extern uint8_t MEDSdusb_Initialize( Media *media, uint8_t mciID ) ;
 extern void MEDSdcard_EraseAll( Media *media ) ;
 extern void MEDSdcard_EraseBlock( Media *media, uint32_t block ) ;
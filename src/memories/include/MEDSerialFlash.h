@@ -0,0 +1,73 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !Purpose
+///
+/// Media driver of an AT26 serial flash, in 512-byte blocks so that FatFs
+/// uses it as a drive (DRV_SFLASH).
+///
+/// !Usage
+///
+/// -# Identify the device (AT26D_ReadJedecId(), AT26_FindDevice()), then
+///    call MEDSerialFlash_Initialize().
+/// -# A read is a single fast read command streamed to the buffer.
+/// -# A write reads back each 4K erase block it touches and only erases the
+///    block when a bit must go from 0 to 1. Trimmed blocks are erased at
+///    once, so that files written later in their place skip the erase.
+//------------------------------------------------------------------------------
+
+#ifndef MEDSERIALFLASH_H
+#define MEDSERIALFLASH_H
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "Media.h"
+#include "at26d.h"
+
+//------------------------------------------------------------------------------
+//         Definitions
+//------------------------------------------------------------------------------
+
+/// Serial flash media block size in bytes.
+#define SFLASH_BLOCK_SIZE       512
+/// Erase unit of the writes in bytes (AT26_BLOCK_ERASE_4K).
+#define SFLASH_ERASE_SIZE       (4 * 1024)
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+extern uint8_t MEDSerialFlash_Initialize(Media *media, At26 *pAt26);
+
+#endif //#ifndef MEDSERIALFLASH_H
@@ -54,6 +54,12 @@
 /** Erase all, reset erase count */
 #define NandEraseFULL                   2
 
+/** Number of blocks whose status is retrieved by one call of
+    ManagedNandFlash_Initialize(), so the boot tasks run between the groups*/
+#ifndef ManagedNandFlash_SCANGROUP
+#define ManagedNandFlash_SCANGROUP      64
+#endif
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -69,6 +75,10 @@ struct ManagedNandFlash {
     struct NandBlockStatus blockStatuses[NandCommon_MAXNUMBLOCKS];
     uint16_t baseBlock;
     uint16_t sizeInBlocks;
+    /** Next block examined by ManagedNandFlash_CollectDirtyBlocks()*/
+    uint16_t dirtyCursor;
+    /** Next block whose status is retrieved, 0 when no scan is pending*/
+    uint16_t scanBlock;
 };
 
 /*----------------------------------------------------------------------------
@@ -119,6 +129,12 @@ extern uint8_t ManagedNandFlash_CopyPage(
     uint16_t destBlock,
     uint16_t destPage);
 
+extern uint8_t ManagedNandFlash_MergePages(
+    const struct ManagedNandFlash *managed,
+    uint16_t sourceBlock,
+    uint16_t destBlock,
+    const uint8_t *pageMask);
+
 extern uint8_t ManagedNandFlash_CopyBlock(
     const struct ManagedNandFlash *managed,
     uint16_t sourceBlock,
@@ -127,6 +143,12 @@ extern uint8_t ManagedNandFlash_CopyBlock(
 extern uint8_t ManagedNandFlash_EraseDirtyBlocks(
     struct ManagedNandFlash *managed);
 
+extern uint8_t ManagedNandFlash_CollectDirtyBlocks(
+    struct ManagedNandFlash *managed,
+    uint16_t maxErases,
+    int32_t skipBlock,
+    uint16_t *erased);
+
 extern uint8_t ManagedNandFlash_FindYoungestBlock(
     const struct ManagedNandFlash *managed,
     uint8_t status,
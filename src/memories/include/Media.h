@@ -69,6 +69,15 @@
 #define MED_STATE_READY         0x00     /* Media is ready for access */
 #define MED_STATE_BUSY          0x01     /* Media is busy */
 
+/**
+ *  \brief  Request queue
+ */
+#define MED_QUEUE_SIZE          8        /* Requests queued per media */
+#define MED_SG_MAX_BLOCKS       0x7FFFFFFF /* Blocks issued in one driver call */
+
+#define MED_REQUEST_READ        0
+#define MED_REQUEST_WRITE       1
+
 /*------------------------------------------------------------------------------
 //      Types
  *------------------------------------------------------------------------------*/
@@ -90,6 +99,8 @@ typedef uint8_t (*Media_ioctl)( Media* pMedia, uint8_t ctrl, void *buff ) ;
 
 typedef uint8_t (*Media_flush)( Media* pMedia ) ;
 
+typedef uint8_t (*Media_trim)( Media* pMedia, uint32_t address, uint32_t length ) ;
+
 typedef void (*Media_handler)( Media* pMedia ) ;
 
 /**
@@ -105,6 +116,56 @@ typedef struct
     void* argument ;           /* < Callback argument */
 } MEDTransfer ;
 
+/**
+ *  \brief  One element of a scatter-gather list
+ */
+typedef struct
+{
+    void* data ;               /* < Pointer to the data buffer */
+    uint32_t length ;          /* < Size of the buffer in media blocks */
+} MEDIovec ;
+
+/**
+ *  \brief  Scatter-gather request queued on a media
+ *
+ *  The descriptor and its iovec list are owned by the caller and must stay
+ *  valid until the callback is invoked.
+ *  \see    MED_Submit
+ */
+typedef struct
+{
+    uint32_t address ;         /* < Media address of the first iovec */
+    MEDIovec* pIov ;           /* < Scatter-gather list */
+    uint8_t bNumIov ;          /* < Number of elements in pIov */
+    uint8_t bWrite ;           /* < MED_REQUEST_READ or MED_REQUEST_WRITE */
+    uint8_t bStatus ;          /* < Completion status */
+    uint8_t reserved ;
+    MediaCallback callback;    /* < Callback to invoke when the request done */
+    void* argument ;           /* < Callback argument */
+} MEDRequest ;
+
+/**
+ *  \brief  Per-media request queue and position inside the run in progress
+ *  \see    MEDRequest
+ */
+typedef struct
+{
+    MEDRequest* pRequests[MED_QUEUE_SIZE] ; /* < Ring of pending requests */
+    uint8_t bHead ;            /* < Index of the oldest request */
+    uint8_t bCount ;           /* < Number of pending requests */
+    uint8_t bRunCount ;        /* < Requests merged in the run in progress */
+    uint8_t bRunIndex ;        /* < Request being transferred in the run */
+    uint8_t bIovIndex ;        /* < Iovec being transferred in the request */
+    uint8_t bActive ;          /* < MED_ServiceQueue() is running */
+    uint8_t bPending ;         /* < A driver call is in progress */
+    uint8_t bStatus ;          /* < Status of the last driver call */
+    uint8_t bPlugged ;         /* < Held by MED_Plug(): requests are queued only */
+    uint8_t reserved[3] ;
+    uint32_t dwIovOffset ;     /* < Blocks already done in the iovec */
+    uint32_t dwAddress ;       /* < Media address of the next driver call */
+    uint32_t dwIssued ;        /* < Blocks issued in the last driver call */
+} MEDQueue ;
+
 /**
  *  \brief  Media object
  *  \see    MEDTransfer
@@ -117,15 +178,17 @@ struct _Media
   Media_lock     lock;         /* < lock method if possible */
   Media_unlock   unlock;       /* < unlock method if possible */
   Media_flush    flush;        /* < Flush method */
+  Media_trim     trim;         /* < Discard method (data no longer used) */
   Media_handler  handler;      /* < Interrupt handler */
 
   uint32_t   blockSize;    /* < Block size in bytes (1, 512, 1K, 2K ...) */
   uint32_t   baseAddress;  /* < Base address of media in number of blocks */
   uint32_t   size;         /* < Size of media in number of blocks */
   MEDTransfer    transfer;     /* < Current transfer operation */
+  MEDQueue       queue;        /* < Pending scatter-gather requests */
   void           *interface;   /* < Pointer to the physical interface used */
   uint8_t  bReserved:4,
-    mappedRD:1,   /* < Mapped to memory space to read */
+    mappedRD:1,   /* < Mapped to memory space to read, at baseAddress */
     mappedWR:1,   /* < Mapped to memory space to write */
     protected:1,  /* < Protected media? */
     removable:1;  /* < Removable/Fixed media? */
@@ -151,11 +214,20 @@ extern uint32_t MED_Read( Media* pMedia, uint32_t address, void* data, uint32_t
 extern uint32_t MED_Lock( Media* pMedia, uint32_t start, uint32_t end, uint32_t *pActualStart, uint32_t *pActualEnd ) ;
 extern uint32_t MED_Unlock( Media* pMedia, uint32_t start, uint32_t end, uint32_t *pActualStart, uint32_t *pActualEnd ) ;
 extern uint32_t MED_Flush( Media* pMedia ) ;
+extern uint32_t MED_Trim( Media* pMedia, uint32_t address, uint32_t length ) ;
+extern void* MED_Map( Media* pMedia, uint32_t address, uint32_t length ) ;
 extern void MED_Handler( Media* pMedia ) ;
 extern void MED_DeInit( Media* pMedia ) ;
 extern uint32_t MED_IsInitialized( Media* pMedia ) ;
 
 extern void MED_HandleAll( Media *medias, uint8_t numMedias ) ;
 
+extern void MED_InitQueue( Media* pMedia ) ;
+extern uint32_t MED_Submit( Media* pMedia, MEDRequest* pRequest ) ;
+extern void MED_ServiceQueue( Media* pMedia ) ;
+extern uint32_t MED_MergeCount( const MEDQueue* pQueue ) ;
+extern void MED_Plug( Media* pMedia ) ;
+extern void MED_Unplug( Media* pMedia ) ;
+
 #endif /* _MEDIA_ */
 
@@ -14,7 +14,9 @@
 //#define SKIPBLOCKNANDFLASH	1
 /// Maximum number of LUNs which can be defined.
 /// (Logical drive = physical drive = medium number)
-#define MAX_LUNS        3
+#define MAX_LUNS        5
+/// Returned by the Medias_InitXxxStep() functions until the media is up.
+#define MEDIAS_INIT_PENDING     (-1)
 
 
 /*---------------------------------------------------------------------------
@@ -43,5 +45,12 @@
 -----------------------------------------------------------------------------*/
 
 extern int Medias_Init(void);
+extern int Medias_InitNand(void);
+extern int Medias_InitNandStep(void);
+extern int Medias_InitSdcard(void);
+extern int Medias_InitSdcardStep(void);
+extern int Medias_InitSerialFlash(void);
+extern int Medias_InitNorFlash(void);
+extern int Medias_CollectNand(unsigned int maxErases);
 
 #endif /* NANDDRV_H */
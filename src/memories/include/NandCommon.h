@@ -126,5 +126,11 @@
 /** HW Ecc Not compatible with the Nand Model*/
 #define NandCommon_ERROR_ECC_NOT_COMPATIBLE 15
 
+/** No scratch buffer left in the NandScratch arena*/
+#define NandCommon_ERROR_NOSCRATCH          16
+
+/** The block scan is not finished, the initialization must be called again*/
+#define NandCommon_ERROR_SCANPENDING        17
+
 #endif /*#ifndef NANDCOMMON_H */
 
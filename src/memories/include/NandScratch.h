@@ -0,0 +1,58 @@
+/**
+ * \file
+ *
+ * \section Purpose
+ *
+ * Static arena of page-sized and spare-sized scratch buffers shared by the
+ * nandflash layers (Raw, Ecc, Managed, Mapped and Translated), so that
+ * temporary page copies do not live on the 4K system stack.
+ *
+ * \section Usage
+ *
+ * -# Take a buffer with NandScratch_AcquirePage() or NandScratch_AcquireSpare()
+ *    at the start of the operation; 0 is returned when the arena is exhausted.
+ * -# Give it back with NandScratch_Release() on every return path.
+ * -# NandScratch_PrintReport() prints the maximum number of buffers used at
+ *    the same time, to tune NandScratch_NUMPAGES / NandScratch_NUMSPARES.
+ *
+ * The arena is not protected against interrupts: the nandflash layers must
+ * only be called from one context.
+ */
+
+#ifndef NANDSCRATCH_H
+#define NANDSCRATCH_H
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Number of page data buffers (deepest nesting is a copy through RAM
+    calling EccNandFlash_ReadPage) */
+#ifndef NandScratch_NUMPAGES
+#define NandScratch_NUMPAGES        3
+#endif
+
+/** Number of page spare buffers */
+#ifndef NandScratch_NUMSPARES
+#define NandScratch_NUMSPARES       4
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+extern uint8_t *NandScratch_AcquirePage( void ) ;
+
+extern uint8_t *NandScratch_AcquireSpare( void ) ;
+
+extern void NandScratch_Release( void *buffer ) ;
+
+extern void NandScratch_PrintReport( void ) ;
+
+#endif /* #ifndef NANDSCRATCH_H */
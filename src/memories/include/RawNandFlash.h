@@ -100,6 +100,12 @@ extern unsigned char RawNandFlash_CopyPage(
     unsigned short destBlock,
     unsigned short destPage);
 
+extern unsigned char RawNandFlash_CopyBackPages(
+    const struct RawNandFlash *raw,
+    unsigned short sourceBlock,
+    unsigned short destBlock,
+    const unsigned char *pageMask);
+
 extern unsigned char RawNandFlash_CopyBlock(
     const struct RawNandFlash *raw,
     unsigned short sourceBlock,
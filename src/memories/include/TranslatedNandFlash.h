@@ -36,15 +36,72 @@
 
 #include "MappedNandFlash.h"
 
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * Number of page-mapped log blocks of the hybrid translation mode.
+ * A page rewritten out of order inside a mapped block is appended to a log
+ * block dedicated to that logical block instead of relocating the whole block;
+ * the log block is merged with its data block only when it is full, when it
+ * is evicted for another logical block, or before the logical mapping is
+ * saved. A log block only pays off when its logical block is rewritten again
+ * before the merge, so new log blocks are opened only while the recent
+ * rewrites come back to their block often enough; scattered rewrites relocate
+ * the block instead. 0 disables the hybrid mode (every rewrite relocates the
+ * block).
+ */
+#ifndef TranslatedNandFlash_NUMLOGBLOCKS
+#define TranslatedNandFlash_NUMLOGBLOCKS    0
+#endif
+
+/** Log page index of a logical page which has not been logged*/
+#define TranslatedNandFlash_PAGENOTLOGGED   0xFF
+
 /*----------------------------------------------------------------------------
  *        Type
  *----------------------------------------------------------------------------*/
+
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+/** Log block holding the latest copy of rewritten pages of one logical block*/
+struct TranslatedLogBlock {
+
+    /** Physical block of the log, -1 if unused*/
+    signed short physicalBlock;
+    /** Logical block whose pages are logged*/
+    signed short logicalBlock;
+    /** Number of log pages written*/
+    unsigned short writtenPages;
+    /** Rewrites that came back to the log after other pages were written*/
+    unsigned short hits;
+    /** Host page count at the last write, used to evict the oldest log and
+        to tell a new rewrite from the next page of the same one*/
+    unsigned int lastWrite;
+    /** Log page holding each logical page, or TranslatedNandFlash_PAGENOTLOGGED*/
+    unsigned char pageMap[NandCommon_MAXNUMPAGESPERBLOCK];
+};
+#endif
+
 struct TranslatedNandFlash {
 
     struct MappedNandFlash mapped;
     signed short currentLogicalBlock;
     signed short previousPhysicalBlock;
     unsigned char currentBlockPageStatuses[NandCommon_MAXNUMPAGESPERBLOCK / 8];
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    struct TranslatedLogBlock logBlocks[TranslatedNandFlash_NUMLOGBLOCKS];
+    /** Blocks last relocated instead of logged, -1 if none*/
+    signed short skippedBlocks[TranslatedNandFlash_NUMLOGBLOCKS];
+    /** Next entry of skippedBlocks to replace*/
+    unsigned short nextSkipped;
+    /** Log hits minus misses, new log blocks are opened while it is not negative*/
+    signed short logCredit;
+#endif
+    /** Pages written by the upper layer*/
+    unsigned int hostPages;
+    /** Pages programmed on the device, including block copies and merges*/
+    unsigned int programmedPages;
 };
 
 /*----------------------------------------------------------------------------
@@ -86,6 +143,15 @@ extern unsigned char TranslatedNandFlash_EraseAll(
 extern unsigned char TranslatedNandFlash_SaveLogicalMapping(
     struct TranslatedNandFlash *translated);
 
+extern unsigned char TranslatedNandFlash_DiscardBlock(
+    struct TranslatedNandFlash *translated,
+    unsigned short block);
+
+extern unsigned char TranslatedNandFlash_CollectGarbage(
+    struct TranslatedNandFlash *translated,
+    unsigned short maxErases,
+    unsigned short *erased);
+
 extern unsigned short TranslatedNandFlash_GetDeviceSizeInBlocks(
    const struct TranslatedNandFlash *translated);
 
@@ -95,5 +161,8 @@ extern unsigned int TranslatedNandFlash_GetDeviceSizeInPages(
 extern unsigned long long TranslatedNandFlash_GetDeviceSizeInBytes(
    const struct TranslatedNandFlash *translated);
 
+extern void TranslatedNandFlash_PrintStatistics(
+   const struct TranslatedNandFlash *translated);
+
 #endif /*#ifndef TRANSLATEDNANDFLASH_H */
 
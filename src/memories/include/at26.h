@@ -77,7 +77,7 @@
 //         Headers
 //------------------------------------------------------------------------------
 
-//#include "chip.h"
+#include "spid.h"
 
 //------------------------------------------------------------------------------
 //         Macros
@@ -34,6 +34,13 @@
 /// The AT26 Serialflash driver.
 /// 
 /// !Usage
+///
+/// -# Configure the command layer with AT26_Configure(), then identify the
+///    device with AT26D_ReadJedecId() and AT26_FindDevice().
+/// -# Call AT26D_Unprotect() before any erase or write.
+/// -# Erase with AT26D_EraseBlock() or AT26D_EraseChip(), program with
+///    AT26D_Write() and read back with AT26D_Read().
+/// -# The functions return once the device is ready again.
 //------------------------------------------------------------------------------
 
 #ifndef AT26D_H
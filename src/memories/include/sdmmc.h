@@ -40,6 +40,8 @@
  *  \section Usage
  *  - General Card Support
  *    -# SD_Init(): Run the SDcard initialization sequence
+ *    -# SD_InitStart(), SD_InitStep(): Same sequence, one ACMD41 poll of the
+ *       card power-up per step so that other work runs meanwhile
  *    -# SD_GetCardType() : Return SD/MMC reported card type.
  *  - SD/MMC Memory Card Operations
  *    -# SD_ReadBlock() : Read one block of data
@@ -135,7 +137,8 @@
 #define SD_CSD_C_SIZE_MULT(pSd)        SD_CSD(pSd, 47,  3) ///< Device size multiplier
 #define SD_CSD_ERASE_BLK_EN(pSd)       SD_CSD(pSd, 46,  1) ///< Erase single block enable
 #define MMC_CSD_ERASE_BLK_EN(pSd)      SD_CSD(pSd, 46,  1) ///< Erase single block enable
-#define MMC_CSD_ERASE_GRP_SIZE(pSd)    SD_CSD(pSd, 42,  4) ///< Erase group size
+#define MMC_CSD_ERASE_GRP_SIZE(pSd)    SD_CSD(pSd, 42,  5) ///< Erase group size
+#define MMC_CSD_ERASE_GRP_MULT(pSd)    SD_CSD(pSd, 37,  5) ///< Erase group size multiplier
 #define SD_CSD_ERASE_GRP_MULT(pSd)     SD_CSD(pSd, 37,  4) ///< Erase group size multiplier
 #define SD_CSD_SECTOR_SIZE(pSd)        ((SD_CSD(pSd, 40,  6) << 1) + SD_CSD(pSd, 39,  1)) ///< Erase sector size
 #define SD_CSD_WP_GRP_SIZE(pSd)        SD_CSD(pSd, 32,  7) ///< Write protect group size
@@ -456,6 +459,11 @@
 extern uint8_t SD_Init(SdCard *pSd,
                        void   *pSdDriver);
 
+extern uint8_t SD_InitStart(SdCard *pSd,
+                            void   *pSdDriver);
+
+extern uint8_t SD_InitStep(SdCard *pSd);
+
 extern uint8_t SD_GetCardType(SdCard * pSd);
 
 extern uint32_t SD_GetNumberBlocks(SdCard * pSd);
@@ -467,17 +475,30 @@ extern uint32_t SD_GetTotalSizeKB(SdCard * pSd);
 extern uint8_t SD_Read(SdCard        *pSd,
                        uint32_t      address,
                        void          *pData,
-                       uint16_t      length,
+                       uint32_t      length,
                        SdmmcCallback pCallback,
                        void          *pArgs);
 
 extern uint8_t SD_Write(SdCard        *pSd,
                         uint32_t      address,
                         void          *pData,
-                        uint16_t      length,
+                        uint32_t      length,
                         SdmmcCallback pCallback,
                         void          *pArgs);
 
+extern uint8_t SD_WritePreErased(SdCard   *pSd,
+                                 uint32_t address,
+                                 void     *pData,
+                                 uint32_t length);
+
+extern uint8_t SD_StopTransfer(SdCard * pSd);
+
+extern uint32_t SD_GetAuSizeBlocks(SdCard * pSd);
+
+extern uint32_t SD_GetEraseUnitBlocks(SdCard * pSd);
+
+extern uint8_t SD_Erase(SdCard * pSd, uint32_t start, uint32_t end);
+
 extern uint8_t SD_ReadBlock(
     SdCard *pSd,
     uint32_t address,
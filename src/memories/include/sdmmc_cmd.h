@@ -61,6 +61,7 @@
  *   - SdmmcCmd18() : Read multiple blocks
  *   - SdmmcCmd24() : Write single block
  *   - SdmmcCmd25() : Write multiple blocks
+ *   - SdmmcCmd38() : Erase the selected write blocks or erase groups
  *   - SdmmcCmd55() : App command, should be sent before application specific
  *                    command
  *   - SdmmcRead() : Write data without any command
@@ -72,7 +73,10 @@
  *   - SdCmd6() : SD Switch command.
  *   - SdCmd8() : Sends SD Memory Card interface condition, which includes host supply voltage
  *                information and asks the card whether card supports voltage
+ *   - SdCmd32() : Sets the first write block to be erased
+ *   - SdCmd33() : Sets the last write block to be erased
  *   - SdAcmd6() : Defines the data bus width
+ *   - SdAcmd23() : Sets the number of blocks to pre-erase before writing
  *   - SdAcmd41() : Asks to all cards to send their operations conditions.
  *   - SdAcmd51() : Sends SD Card Configuration Register (SCR).
  * - Functions for MMC card
@@ -80,6 +84,8 @@
  *   - MmcCmd3() : Set a new relative address to MMC card.
  *   - MmcCmd6() : MMC Switch.
  *   - MmcCmd8() : Sends MMC EXT_CSD.
+ *   - MmcCmd35() : Sets the first erase group to be erased
+ *   - MmcCmd36() : Sets the last erase group to be erased
  */
 
 #ifndef SDMMC_CMD_H
@@ -182,6 +188,10 @@
 #define SDMMC_BLOCK_SIZE            512
 /** SD/MMC card block size binary shift value. */
 #define SDMMC_BLOCK_SIZE_SHIFT      9
+/** Maximum size in bytes of one data phase (SdmmcRead()/SdmmcWrite()).
+ *  Longer accesses are split in several data phases of the same
+ *  open-ended multiple block command. */
+#define SDMMC_MAX_XFR_SIZE          (256*1024)
 
 /** SD/MMC command status: ready */
 #define SDMMC_CMD_READY             0
@@ -353,6 +363,8 @@ typedef struct _SdCard
     uint8_t cardSlot;
     /** Card State */
     uint8_t state;
+    /** Card answered CMD8: ACMD41 asks for high capacity (identification) */
+    uint8_t hcs;
 } SdCard;
 
 
@@ -510,7 +522,13 @@ extern uint8_t MmcCmd1(SdCard * pSd,uint32_t * pOCR,SdmmcCallback fCallback);
 extern uint8_t MmcCmd3(SdCard * pSd, uint16_t cardAddr,SdmmcCallback fCallback);
 extern uint8_t MmcCmd6(SdCard * pSd, const void * pSwitchArg, uint32_t * pResp,SdmmcCallback fCallback);
 extern uint8_t MmcCmd8(SdCard * pSd,uint8_t * pEXT,SdmmcCallback fCallback);
+extern uint8_t MmcCmd35(SdCard * pSd, uint32_t address, uint32_t * pStatus,SdmmcCallback fCallback);
+extern uint8_t MmcCmd36(SdCard * pSd, uint32_t address, uint32_t * pStatus,SdmmcCallback fCallback);
+extern uint8_t SdCmd32(SdCard * pSd, uint32_t address, uint32_t * pStatus,SdmmcCallback fCallback);
+extern uint8_t SdCmd33(SdCard * pSd, uint32_t address, uint32_t * pStatus,SdmmcCallback fCallback);
+extern uint8_t SdmmcCmd38(SdCard * pSd, uint32_t * pStatus,SdmmcCallback fCallback);
 extern uint8_t SdAcmd13(SdCard * pSd,uint32_t * pSdSTAT,SdmmcCallback fCallback);
+extern uint8_t SdAcmd23(SdCard * pSd, uint32_t nbBlocks, uint32_t * pStatus,SdmmcCallback fCallback);
 extern uint8_t SdAcmd41(SdCard * pSd,uint32_t * pIo,SdmmcCallback fCallback);
 extern uint8_t SdAcmd51(SdCard * pSd,uint32_t * pSCR,SdmmcCallback fCallback);
 extern uint8_t SdAcmd6(SdCard * pSd, uint32_t arg, uint32_t * pStatus,SdmmcCallback fCallback);
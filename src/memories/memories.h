@@ -50,13 +50,16 @@
 #include "include/MEDFlash.h"
 #include "include/Media.h"
 #include "include/MEDNandFlash.h"
+#include "include/MEDNorFlash.h"
 #include "include/MEDRamDisk.h"
 #include "include/MEDSdcard.h"
 #include "include/MEDSdmmc.h"
 #include "include/MEDSdram.h"
+#include "include/MEDSerialFlash.h"
 #include "include/NandCommon.h"
 #include "include/NandFlashModel.h"
 #include "include/NandFlashModelList.h"
+#include "include/NandScratch.h"
 #include "include/NandSpareScheme.h"
 #include "include/NorFlashAmd.h"
 #include "include/NorFlashApi.h"
@@ -114,28 +114,22 @@ unsigned char EccNandFlash_Initialize(
 }
 
 /**
- * \brief  Reads the data and/or spare of a page of a nandflash chip, and verify that
- * the data is valid using the ECC information contained in the spare. If one
- * buffer pointer is 0, the corresponding area is not saved.
- * \param ecc  Pointer to an EccNandFlash instance.
- * \param block  Number of block to read from.
- * \param page  Number of page to read inside given block.
- * \param data  Data area buffer.
- * \param spare  Spare area buffer.
- * \return 0 if the data has been read and is valid; otherwise returns either
- * NandCommon_ERROR_CORRUPTEDDATA or ...
+ * \brief  Reads and verifies a page (see EccNandFlash_ReadPage()) using the
+ * given scratch buffers.
+ * \param tmpData  Page data scratch buffer (unused with HARDWARE_ECC).
+ * \param tmpSpare  Page spare scratch buffer.
  */
-unsigned char EccNandFlash_ReadPage(
+static unsigned char ReadPage(
     const struct EccNandFlash *ecc,
     unsigned short block,
     unsigned short page,
     void *data,
-    void *spare)
+    void *spare,
+    unsigned char *tmpData,
+    unsigned char *tmpSpare)
 {
-    unsigned char tmpSpare[NandCommon_MAXPAGESPARESIZE];
     unsigned char error;
 #ifndef HARDWARE_ECC
-    unsigned char tmpData[NandCommon_MAXPAGEDATASIZE];
     unsigned char hamming[NandCommon_MAXSPAREECCBYTES];
 #else
     unsigned char hsiaoInSpare[NandCommon_MAXSPAREECCBYTES];
@@ -145,7 +139,6 @@ unsigned char EccNandFlash_ReadPage(
     unsigned short pageDataSize = NandFlashModel_GetPageDataSize(MODEL(ecc));
     unsigned char pageSpareSize = NandFlashModel_GetPageSpareSize(MODEL(ecc));
 
-    TRACE_DEBUG("EccNandFlash_ReadPage(B#%d:P#%d)\n\r", block, page);
 #ifndef HARDWARE_ECC
     /* Start by reading the spare and the data */
     error = RawNandFlash_ReadPage(RAW(ecc), block, page, tmpData, tmpSpare);
@@ -212,6 +205,53 @@ unsigned char EccNandFlash_ReadPage(
     return 0;
 }
 
+/**
+ * \brief  Reads the data and/or spare of a page of a nandflash chip, and verify that
+ * the data is valid using the ECC information contained in the spare. If one
+ * buffer pointer is 0, the corresponding area is not saved.
+ * \param ecc  Pointer to an EccNandFlash instance.
+ * \param block  Number of block to read from.
+ * \param page  Number of page to read inside given block.
+ * \param data  Data area buffer.
+ * \param spare  Spare area buffer.
+ * \return 0 if the data has been read and is valid; otherwise returns either
+ * NandCommon_ERROR_CORRUPTEDDATA or ...
+ */
+unsigned char EccNandFlash_ReadPage(
+    const struct EccNandFlash *ecc,
+    unsigned short block,
+    unsigned short page,
+    void *data,
+    void *spare)
+{
+    unsigned char *tmpData = 0;
+    unsigned char *tmpSpare;
+    unsigned char error;
+
+    TRACE_DEBUG("EccNandFlash_ReadPage(B#%d:P#%d)\n\r", block, page);
+
+    tmpSpare = NandScratch_AcquireSpare();
+#ifndef HARDWARE_ECC
+    tmpData = NandScratch_AcquirePage();
+    if (!tmpData) {
+
+        NandScratch_Release(tmpSpare);
+        return NandCommon_ERROR_NOSCRATCH;
+    }
+#endif
+    if (!tmpSpare) {
+
+        NandScratch_Release(tmpData);
+        return NandCommon_ERROR_NOSCRATCH;
+    }
+
+    error = ReadPage(ecc, block, page, data, spare, tmpData, tmpSpare);
+
+    NandScratch_Release(tmpData);
+    NandScratch_Release(tmpSpare);
+    return error;
+}
+
 /**
  * \brief  Writes the data and/or spare area of a nandflash page, after calculating an
  * ECC for the data area and storing it in the spare. If no data buffer is
@@ -233,7 +273,7 @@ unsigned char EccNandFlash_WritePage(
     void *spare)
 {
     unsigned char error;
-    unsigned char tmpSpare[NandCommon_MAXPAGESPARESIZE];
+    unsigned char *tmpSpare = 0;
     unsigned short pageDataSize = NandFlashModel_GetPageDataSize(MODEL(ecc));
     unsigned short pageSpareSize = NandFlashModel_GetPageSpareSize(MODEL(ecc));
 #ifndef HARDWARE_ECC
@@ -258,13 +298,18 @@ unsigned char EccNandFlash_WritePage(
     /* Store code in spare buffer (if no buffer provided, use a temp. one) */
     if (!spare) {
 
-        spare = tmpSpare;
+        spare = tmpSpare = NandScratch_AcquireSpare();
+        if (!spare) {
+
+            return NandCommon_ERROR_NOSCRATCH;
+        }
         memset(spare, 0xFF, pageSpareSize);
     }
     NandSpareScheme_WriteEcc(NandFlashModel_GetScheme(MODEL(ecc)), spare, hamming);
 
     /* Perform write operation */
     error = RawNandFlash_WritePage(RAW(ecc), block, page, data, spare);
+    NandScratch_Release(tmpSpare);
     if (error) {
 
         TRACE_ERROR("EccNandFlash_WritePage: Failed to write page\n\r");
@@ -274,13 +319,18 @@ unsigned char EccNandFlash_WritePage(
 #else
     /* Store code in spare buffer (if no buffer provided, use a temp. one) */
     if (!spare) {
-        spare = tmpSpare;
+        spare = tmpSpare = NandScratch_AcquireSpare();
+        if (!spare) {
+
+            return NandCommon_ERROR_NOSCRATCH;
+        }
         memset(spare, 0xFF, pageSpareSize);
     }
     /* Perform write operation */
     error = RawNandFlash_WritePage(RAW(ecc), block, page, data, spare);
     if (error) {
 
+        NandScratch_Release(tmpSpare);
         TRACE_ERROR("EccNandFlash_WritePage: Failed to write page\n\r");
         return error;
     }
@@ -288,6 +338,7 @@ unsigned char EccNandFlash_WritePage(
     /* Perform write operation */
     NandSpareScheme_WriteEcc(NandFlashModel_GetScheme(MODEL(ecc)), spare, hsiao);
     error = RawNandFlash_WritePage(RAW(ecc), block, page, 0, spare);
+    NandScratch_Release(tmpSpare);
     if (error) {
         TRACE_ERROR("EccNandFlash_WritePage: Failed to write page\n\r");
         return error;
@@ -55,6 +55,13 @@
 #define BADBLOCK        255
 #define GOODBLOCK       254
 
+/** When not 0, one page out of ManagedNandFlash_MERGEVERIFYINTERVAL is copied
+    through the ECC path by ManagedNandFlash_MergePages(), the others with
+    copy-back. Off by default: only page #0 takes the ECC path. */
+#ifndef ManagedNandFlash_MERGEVERIFYINTERVAL
+#define ManagedNandFlash_MERGEVERIFYINTERVAL    0
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -180,6 +187,139 @@ static uint8_t WriteBlockStatus( const struct ManagedNandFlash *managed, uint16_
     return RawNandFlash_WritePage( RAW( managed ), block, 0, 0, spare ) ;
 }
 
+/**
+ * \brief  Retrieves the status of the next ManagedNandFlash_SCANGROUP blocks of a
+ * device which is not virgin, then displays the wear information once the
+ * whole managed area is scanned.
+ *
+ * \param managed  Pointer to a ManagedNandFlash instance.
+ * \param spare  Pointer to allocated spare area (must be assigned)
+ * \return 0 if the scan is done; NandCommon_ERROR_SCANPENDING if blocks remain.
+ */
+static uint8_t RetrieveBlockStatuses( struct ManagedNandFlash *managed, uint8_t *spare )
+{
+    const struct NandSpareScheme *scheme = NandFlashModel_GetScheme( MODEL( managed ) );
+    uint16_t baseBlock = managed->baseBlock;
+    uint16_t sizeInBlocks = managed->sizeInBlocks;
+    uint32_t block, phyBlock, lastBlock;
+    struct NandBlockStatus blockStatus;
+    uint8_t badBlockMarker;
+    uint8_t error;
+    uint32_t eraseCount;
+
+    /* Retrieve block statuses from their first page spare area, one group
+       of blocks per call */
+    lastBlock = managed->scanBlock + ManagedNandFlash_SCANGROUP;
+    if ( lastBlock > sizeInBlocks )
+    {
+        lastBlock = sizeInBlocks;
+    }
+    for ( block=managed->scanBlock ; block < lastBlock; block++ )
+    {
+        phyBlock = baseBlock + block;
+
+        /* Read spare of first page */
+        error = RawNandFlash_ReadPage(RAW(managed), phyBlock, 0, 0, spare);
+        if ( error )
+        {
+
+            TRACE_ERROR("ManagedNandFlash_Initialize: Read block #%d(%d)\n\r",
+                        block, phyBlock);
+        }
+
+        /* Retrieve bad block marker and block status */
+        NandSpareScheme_ReadBadBlockMarker(scheme, spare, &badBlockMarker);
+        NandSpareScheme_ReadExtra(scheme, spare, &blockStatus, 4, 0);
+
+        /* If they do not match, block must be bad */
+        if ( (badBlockMarker != 0xFF) && (blockStatus.status != NandBlockStatus_BAD) )
+        {
+            TRACE_DEBUG("Block #%d(%d) is bad\n\r", block, phyBlock);
+            managed->blockStatuses[block].status = NandBlockStatus_BAD;
+        }
+        /* Check that block status is not default (meaning block is not managed) */
+        else
+        {
+            if ( blockStatus.status == NandBlockStatus_DEFAULT )
+            {
+            	TRACE_DEBUG("Block #%d(%d) is not managed\n\r", block, phyBlock);
+                //assert( 0 ) ; /* "Block #%d(%d) is not managed\n\r", block, phyBlock */
+            }
+            /* Otherwise block status is accurate */
+            else
+            {
+                TRACE_DEBUG("Block #%03d(%d) : status = %2d | eraseCount = %d\n\r",
+                            block, phyBlock,
+                            blockStatus.status, blockStatus.eraseCount);
+                managed->blockStatuses[block] = blockStatus;
+
+                /* Clean block*/
+                /*Release LIVE blocks */
+                /*
+                if (managed->blockStatuses[block].status == NandBlockStatus_LIVE) {
+
+                    ManagedNandFlash_ReleaseBlock(managed, block);
+                }
+                 Erase DIRTY blocks
+                if (managed->blockStatuses[block].status == NandBlockStatus_DIRTY) {
+
+                    ManagedNandFlash_EraseBlock(managed, block);
+                }*/
+            }
+        }
+    }
+
+    if ( lastBlock < sizeInBlocks )
+    {
+        managed->scanBlock = lastBlock;
+        return NandCommon_ERROR_SCANPENDING;
+    }
+    managed->scanBlock = 0;
+
+    /* Display erase count information*/
+    TRACE_ERROR_WP("|--------|------------|--------|--------|--------|\n\r");
+    TRACE_ERROR_WP("|  Wear  |   Count    |  Free  |  Live  | Dirty  |\n\r");
+    TRACE_ERROR_WP("|--------|------------|--------|--------|--------|\n\r");
+
+
+	uint32_t count = 0 ;
+	uint32_t live = 0 ;
+	uint32_t dirty = 0 ;
+	uint32_t free = 0 ;
+
+	for ( block=0 ; block < sizeInBlocks ; block++ )
+	{
+		if ( managed->blockStatuses[block].status != NandBlockStatus_BAD )
+		{
+			count++ ;
+			switch ( managed->blockStatuses[block].status )
+			{
+				case NandBlockStatus_LIVE:
+					live++ ;
+				break ;
+
+				case NandBlockStatus_DIRTY:
+					dirty++ ;
+				break ;
+
+				case NandBlockStatus_FREE:
+					free++ ;
+				break ;
+			}
+		}
+	}
+
+	if ( count > 0 )
+	{
+		TRACE_ERROR_WP( "|  %4d  |  %8d  |  %4d  |  %4d  |  %4d  |\n\r",
+				  eraseCount, count, free, live, dirty);
+	}
+
+    TRACE_ERROR_WP("|--------|------------|--------|--------|--------|\n\r");
+
+    return 0;
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -197,7 +337,9 @@ static uint8_t WriteBlockStatus( const struct ManagedNandFlash *managed, uint16_
  * \param pinReadyBusy  Pin used to monitor the ready/busy signal of the Nand.
  * \param baseBlock Base physical block address of managed area, managed 0.
  * \param sizeInBlocks Number of blocks that is managed.
- * \return 0 if the initialization is done; or returns a error code.
+ * \return 0 if the initialization is done; NandCommon_ERROR_SCANPENDING if the
+ * block statuses are not all retrieved yet, the function must then be called
+ * again with the same parameters to resume the scan; or returns a error code.
  */
 uint8_t ManagedNandFlash_Initialize(
     struct ManagedNandFlash *managed,
@@ -214,14 +356,16 @@ uint8_t ManagedNandFlash_Initialize(
     uint8_t spare[NandCommon_MAXPAGESPARESIZE];
     uint32_t numBlocks;
     //uint32_t pageSpareSize;
-    const struct NandSpareScheme *scheme;
     uint32_t block, phyBlock;
-    struct NandBlockStatus blockStatus;
-    uint8_t badBlockMarker;
-    uint32_t eraseCount, minEraseCount, maxEraseCount;
 
     TRACE_DEBUG("ManagedNandFlash_Initialize()\n\r");
 
+    /* Resume the block status retrieval of the previous call */
+    if (managed->scanBlock) {
+
+        return RetrieveBlockStatuses(managed, spare);
+    }
+
     /* Initialize EccNandFlash */
     error = EccNandFlash_Initialize(ECC(managed),
                                     model,
@@ -238,7 +382,6 @@ uint8_t ManagedNandFlash_Initialize(
     /* Retrieve model information */
     numBlocks = NandFlashModel_GetDeviceSizeInBlocks(MODEL(managed));
     //pageSpareSize = NandFlashModel_GetPageSpareSize(MODEL(managed));
-    scheme = NandFlashModel_GetScheme(MODEL(managed));
 
     /* Initialize base & size */
     if (sizeInBlocks == 0) sizeInBlocks = numBlocks;
@@ -259,6 +402,8 @@ uint8_t ManagedNandFlash_Initialize(
 
     managed->baseBlock = baseBlock;
     managed->sizeInBlocks = sizeInBlocks;
+    managed->dirtyCursor = 0;
+    managed->scanBlock = 0;
 
     /* Initialize block statuses */
     /* First, check if device is virgin*/
@@ -307,116 +452,7 @@ uint8_t ManagedNandFlash_Initialize(
     else {
 
         TRACE_INFO("Managed, retrieving information ...\n\r");
-
-        /* Retrieve block statuses from their first page spare area
-          (find maximum and minimum wear at the same time) */
-        minEraseCount = 0xFFFFFFFF;
-        maxEraseCount = 0;
-        for ( block=0 ; block < sizeInBlocks; block++ )
-        {
-            phyBlock = baseBlock + block;
-
-            /* Read spare of first page */
-            error = RawNandFlash_ReadPage(RAW(managed), phyBlock, 0, 0, spare);
-            if ( error )
-            {
-
-                TRACE_ERROR("ManagedNandFlash_Initialize: Read block #%d(%d)\n\r",
-                            block, phyBlock);
-            }
-
-            /* Retrieve bad block marker and block status */
-            NandSpareScheme_ReadBadBlockMarker(scheme, spare, &badBlockMarker);
-            NandSpareScheme_ReadExtra(scheme, spare, &blockStatus, 4, 0);
-
-            /* If they do not match, block must be bad */
-            if ( (badBlockMarker != 0xFF) && (blockStatus.status != NandBlockStatus_BAD) )
-            {
-                TRACE_DEBUG("Block #%d(%d) is bad\n\r", block, phyBlock);
-                managed->blockStatuses[block].status = NandBlockStatus_BAD;
-            }
-            /* Check that block status is not default (meaning block is not managed) */
-            else
-            {
-                if ( blockStatus.status == NandBlockStatus_DEFAULT )
-                {
-                	TRACE_DEBUG("Block #%d(%d) is not managed\n\r", block, phyBlock);
-                    //assert( 0 ) ; /* "Block #%d(%d) is not managed\n\r", block, phyBlock */
-                }
-                /* Otherwise block status is accurate */
-                else
-                {
-                    TRACE_DEBUG("Block #%03d(%d) : status = %2d | eraseCount = %d\n\r",
-                                block, phyBlock,
-                                blockStatus.status, blockStatus.eraseCount);
-                    managed->blockStatuses[block] = blockStatus;
-
-                    /* Check for min/max erase counts */
-                    if ( blockStatus.eraseCount < minEraseCount )
-                    {
-                        minEraseCount = blockStatus.eraseCount;
-                    }
-                    if ( blockStatus.eraseCount > maxEraseCount )
-                    {
-                        maxEraseCount = blockStatus.eraseCount;
-                    }
-
-                    /* Clean block*/
-                    /*Release LIVE blocks */
-                    /*
-                    if (managed->blockStatuses[block].status == NandBlockStatus_LIVE) {
-
-                        ManagedNandFlash_ReleaseBlock(managed, block);
-                    }
-                     Erase DIRTY blocks
-                    if (managed->blockStatuses[block].status == NandBlockStatus_DIRTY) {
-
-                        ManagedNandFlash_EraseBlock(managed, block);
-                    }*/
-                }
-            }
-        }
-
-        /* Display erase count information*/
-        TRACE_ERROR_WP("|--------|------------|--------|--------|--------|\n\r");
-        TRACE_ERROR_WP("|  Wear  |   Count    |  Free  |  Live  | Dirty  |\n\r");
-        TRACE_ERROR_WP("|--------|------------|--------|--------|--------|\n\r");
-
-
-		uint32_t count = 0 ;
-		uint32_t live = 0 ;
-		uint32_t dirty = 0 ;
-		uint32_t free = 0 ;
-
-		for ( block=0 ; block < sizeInBlocks ; block++ )
-		{
-			if ( managed->blockStatuses[block].status != NandBlockStatus_BAD )
-			{
-				count++ ;
-				switch ( managed->blockStatuses[block].status )
-				{
-					case NandBlockStatus_LIVE:
-						live++ ;
-					break ;
-
-					case NandBlockStatus_DIRTY:
-						dirty++ ;
-					break ;
-
-					case NandBlockStatus_FREE:
-						free++ ;
-					break ;
-				}
-			}
-		}
-
-		if ( count > 0 )
-		{
-			TRACE_ERROR_WP( "|  %4d  |  %8d  |  %4d  |  %4d  |  %4d  |\n\r",
-					  eraseCount, count, free, live, dirty);
-		}
-
-        TRACE_ERROR_WP("|--------|------------|--------|--------|--------|\n\r");
+        return RetrieveBlockStatuses(managed, spare);
     }
 
     return 0;
@@ -633,31 +669,38 @@ uint8_t ManagedNandFlash_CopyPage(
       overwritten*/
     if (destPage == 0) {
 
-        uint8_t data[NandCommon_MAXPAGEDATASIZE];
-        uint8_t spare[NandCommon_MAXPAGESPARESIZE];
+        uint8_t *data = NandScratch_AcquirePage();
+        uint8_t *spare = NandScratch_AcquireSpare();
 
-        /* Read data & spare to copy*/
-        error = EccNandFlash_ReadPage(ECC(managed),
-                                      managed->baseBlock + sourceBlock,
-                                      sourcePage,
-                                      data, spare);
-        if (error) {
+        if (!data || !spare) {
 
-            return error;
+            error = NandCommon_ERROR_NOSCRATCH;
         }
+        else {
 
-        /* Write destination block status information in spare*/
-        NandSpareScheme_WriteExtra(NandFlashModel_GetScheme(MODEL(managed)),
-                                   spare,
-                                   &(managed->blockStatuses[destBlock]),
-                                   4,
-                                   0);
-
-        /* Write page*/
-        error = RawNandFlash_WritePage(RAW(managed),
-                                       managed->baseBlock + destBlock,
-                                       destPage,
-                                       data, spare);
+            /* Read data & spare to copy*/
+            error = EccNandFlash_ReadPage(ECC(managed),
+                                          managed->baseBlock + sourceBlock,
+                                          sourcePage,
+                                          data, spare);
+        }
+        if (!error) {
+
+            /* Write destination block status information in spare*/
+            NandSpareScheme_WriteExtra(NandFlashModel_GetScheme(MODEL(managed)),
+                                       spare,
+                                       &(managed->blockStatuses[destBlock]),
+                                       4,
+                                       0);
+
+            /* Write page*/
+            error = RawNandFlash_WritePage(RAW(managed),
+                                           managed->baseBlock + destBlock,
+                                           destPage,
+                                           data, spare);
+        }
+        NandScratch_Release(data);
+        NandScratch_Release(spare);
         if (error) {
 
             return error;
@@ -676,6 +719,113 @@ uint8_t ManagedNandFlash_CopyPage(
     return 0;
 }
 
+/**
+ * \brief Copies a set of pages of a block to the same pages of another block.
+ * When the device supports it, the pages are moved in one copy-back batch
+ * (RawNandFlash_CopyBackPages()), which skips the erased source pages;
+ * page #0, which holds the block status, goes through the ECC path instead.
+ * If ManagedNandFlash_MERGEVERIFYINTERVAL is set, one page out of that
+ * interval takes the ECC path too, so that the source block is checked (and
+ * single bit errors corrected) on a sampled basis. Without copy-back, every
+ * page is copied with ManagedNandFlash_CopyPage().
+ * \param managed  Pointer to a ManagedNandFlash instance.
+ * \param sourceBlock  Source block number based on managed area (LIVE or DIRTY).
+ * \param destBlock  Destination block number based on managed area (LIVE).
+ * \param pageMask  Bitmap of the pages to copy (bit i of byte i/8 for page i).
+ * \return 0 if successful; NandCommon_ERROR_WRONGSTATUS if a block does not
+ * have the right status; otherwise returns an NandCommon_ERROR_xxx code.
+ */
+uint8_t ManagedNandFlash_MergePages(
+    const struct ManagedNandFlash *managed,
+    uint16_t sourceBlock,
+    uint16_t destBlock,
+    const uint8_t *pageMask)
+{
+    uint16_t numPages = NandFlashModel_GetBlockSizeInPages(MODEL(managed));
+    uint8_t copyBackMask[NandCommon_MAXNUMPAGESPERBLOCK / 8];
+    uint8_t *data;
+    uint8_t copyBack;
+    uint8_t error;
+    uint16_t page;
+
+    TRACE_INFO("ManagedNandFlash_MergePages(B#%d -> B#%d)\n\r", sourceBlock, destBlock);
+
+    /* Check block statuses */
+    if ((managed->blockStatuses[sourceBlock].status != NandBlockStatus_LIVE)
+         && (managed->blockStatuses[sourceBlock].status != NandBlockStatus_DIRTY)) {
+
+        TRACE_ERROR("ManagedNandFlash_MergePages: Source block must be LIVE or DIRTY.\n\r");
+        return NandCommon_ERROR_WRONGSTATUS;
+    }
+    if (managed->blockStatuses[destBlock].status != NandBlockStatus_LIVE) {
+
+        TRACE_ERROR("ManagedNandFlash_MergePages: Destination block must be LIVE.\n\r");
+        return NandCommon_ERROR_WRONGSTATUS;
+    }
+
+    copyBack = NandFlashModel_SupportsCopyBack(MODEL(managed));
+    memcpy(copyBackMask, pageMask, (numPages + 7) / 8);
+
+    /* Pages copied one by one: every page without copy-back, otherwise the
+       sampled ones */
+    for (page=0; page < numPages; page++) {
+
+        if (!((pageMask[page / 8] >> (page % 8)) & 1)) {
+
+            continue;
+        }
+#if (ManagedNandFlash_MERGEVERIFYINTERVAL > 0)
+        if (copyBack && ((page % ManagedNandFlash_MERGEVERIFYINTERVAL) != 0)) {
+#else
+        if (copyBack && (page != 0)) {
+#endif
+
+            continue;
+        }
+        copyBackMask[page / 8] &= ~(1 << (page % 8));
+
+        if ((page == 0) || !copyBack) {
+
+            error = ManagedNandFlash_CopyPage(managed, sourceBlock, page, destBlock, page);
+        }
+        else {
+
+            /* Verified copy: ECC check of the source, fresh ECC on the dest.*/
+            data = NandScratch_AcquirePage();
+            if (!data) {
+
+                return NandCommon_ERROR_NOSCRATCH;
+            }
+            error = EccNandFlash_ReadPage(ECC(managed),
+                                          managed->baseBlock + sourceBlock,
+                                          page, data, 0);
+            if (!error) {
+
+                error = EccNandFlash_WritePage(ECC(managed),
+                                               managed->baseBlock + destBlock,
+                                               page, data, 0);
+            }
+            NandScratch_Release(data);
+        }
+        if (error) {
+
+            TRACE_ERROR("ManagedNandFlash_MergePages: Failed to copy page %d\n\r", page);
+            return error;
+        }
+    }
+
+    if (!copyBack) {
+
+        return 0;
+    }
+
+    /* Remaining pages in one copy-back batch*/
+    return RawNandFlash_CopyBackPages(RAW(managed),
+                                      managed->baseBlock + sourceBlock,
+                                      managed->baseBlock + destBlock,
+                                      copyBackMask);
+}
+
 /**
  * \brief Copies the data from a whole block to another block on a nandflash. Both
  *  blocks must be LIVE.
@@ -741,6 +891,52 @@ uint8_t ManagedNandFlash_EraseDirtyBlocks( struct ManagedNandFlash *managed )
     return 0 ;
 }
 
+/**
+ * \brief Erases at most the given number of DIRTY blocks, so that the time
+ * spent is bounded (one tBERS per block). The scan resumes after the last
+ * block examined by the previous call.
+ * \param managed  Pointer to a ManagedNandFlash instance.
+ * \param maxErases  Maximum number of blocks to erase.
+ * \param skipBlock  DIRTY block which must be kept (still read), or -1.
+ * \param erased  Pointer to the number of erased blocks variable, can be 0.
+ * \return 0 if successful; otherwise, returns a NandCommon_ERROR code.
+ */
+uint8_t ManagedNandFlash_CollectDirtyBlocks(
+    struct ManagedNandFlash *managed,
+    uint16_t maxErases,
+    int32_t skipBlock,
+    uint16_t *erased)
+{
+    uint32_t i ;
+    uint32_t block ;
+    uint16_t count = 0 ;
+    uint8_t error = 0 ;
+
+    for ( i=0 ; (i < managed->sizeInBlocks) && (count < maxErases) ; i++ )
+    {
+        block = managed->dirtyCursor ;
+        managed->dirtyCursor = (block + 1 < managed->sizeInBlocks) ? (block + 1) : 0 ;
+
+        if ( (managed->blockStatuses[block].status == NandBlockStatus_DIRTY)
+             && ((int32_t)block != skipBlock) )
+        {
+            error = ManagedNandFlash_EraseBlock( managed, block ) ;
+            if ( error )
+            {
+                break ;
+            }
+            count++ ;
+        }
+    }
+
+    if ( erased )
+    {
+        *erased = count ;
+    }
+
+    return error ;
+}
+
 /**
  * \brief Looks for the youngest block having the desired status among the blocks
  * of a managed nandflash. If a block is found, its index is stored inside
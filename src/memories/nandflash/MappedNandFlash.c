@@ -73,19 +73,20 @@
  *
  * \param mapped  Pointer to a MappedNandFlash instance.
  * \param logicalMappingBlock  Pointer to a variable for storing the block number.
+ * \param data  Page data scratch buffer.
  * \return  0 if mapping has been found; otherwise returns
  * NandCommon_ERROR_NOMAPPING if no mapping exists, or another NandCommon_ERROR_xxx code.
  */
 static unsigned char FindLogicalMappingBlock(
     const struct MappedNandFlash *mapped,
-    signed short *logicalMappingBlock)
+    signed short *logicalMappingBlock,
+    unsigned char *data)
 {
     unsigned short block;
     unsigned char found;
     unsigned short numBlocks = ManagedNandFlash_GetDeviceSizeInBlocks(MANAGED(mapped));
     unsigned short pageDataSize = NandFlashModel_GetPageDataSize(MODEL(mapped));
     unsigned char error;
-    unsigned char data[NandCommon_MAXPAGEDATASIZE];
     unsigned int i;
 
     //TRACE_INFO("FindLogicalMappingBlock ~%d\n\r", numBlocks);
@@ -150,14 +151,15 @@ static unsigned char FindLogicalMappingBlock(
  *
  * \param mapped  Pointer to a MappedNandFlash instance.
  * \param physicalBlock  Physical block number.
+ * \param data  Page data scratch buffer.
  * \return  0 if successful; otherwise, returns a NandCommon_ERROR code.
  */
 static unsigned char LoadLogicalMapping(
     struct MappedNandFlash *mapped,
-    unsigned short physicalBlock)
+    unsigned short physicalBlock,
+    unsigned char *data)
 {
     unsigned char error;
-    unsigned char data[NandCommon_MAXPAGEDATASIZE];
     unsigned short pageDataSize =
                     NandFlashModel_GetPageDataSize(MODEL(mapped));
     unsigned short numBlocks =
@@ -254,6 +256,101 @@ static unsigned char LoadLogicalMapping(
     return 0;
 }
 
+/**
+ * \brief  Saves the logical mapping (see MappedNandFlash_SaveLogicalMapping())
+ * using the given page scratch buffer.
+ */
+static unsigned char SaveLogicalMapping(
+    struct MappedNandFlash *mapped,
+    unsigned short physicalBlock,
+    unsigned char *data)
+{
+    unsigned char error;
+    unsigned short pageDataSize =
+                    NandFlashModel_GetPageDataSize(MODEL(mapped));
+    /*unsigned short numBlocks =
+                    ManagedNandFlash_GetDeviceSizeInBlocks(MANAGED(mapped));*/
+    unsigned int i;
+    unsigned int remainingSize;
+    unsigned char *currentBuffer;
+    unsigned short currentPage;
+    unsigned int writeSize;
+    signed short previousPhysicalBlock;
+
+    /* Allocate new block*/
+    error = ManagedNandFlash_AllocateBlock(MANAGED(mapped), physicalBlock);
+    if (error) {
+
+        return error;
+    }
+
+    /* Save mapping*/
+    previousPhysicalBlock = mapped->logicalMappingBlock;
+    mapped->logicalMappingBlock = physicalBlock;
+
+    /* Save actual mapping in pages #1-#XXX*/
+    currentBuffer = (unsigned char *) mapped->logicalMapping;
+    remainingSize = sizeof(mapped->logicalMapping);
+    currentPage = 1;
+    while (remainingSize > 0) {
+
+        writeSize = min(remainingSize, pageDataSize);
+        memset(data, 0xFF, pageDataSize);
+        memcpy(data, currentBuffer, writeSize);
+        error = ManagedNandFlash_WritePage(MANAGED(mapped),
+                                           physicalBlock,
+                                           currentPage,
+                                           data,
+                                           0);
+        if (error) {
+
+            TRACE_ERROR(
+             "MappedNandFlash_SaveLogicalMapping: Failed to write mapping\n\r");
+            return error;
+        }
+
+        currentBuffer += writeSize;
+        remainingSize -= writeSize;
+        currentPage++;
+    }
+
+    /* Mark page #0 of block with a distinguishible pattern, so the mapping can
+       be retrieved at startup*/
+    for (i=0; i < pageDataSize; i++) {
+
+        data[i] = PATTERN(i);
+    }
+    error = ManagedNandFlash_WritePage(MANAGED(mapped),
+                                       physicalBlock, 0,
+                                       data, 0);
+    if (error) {
+
+        TRACE_ERROR(
+            "MappedNandFlash_SaveLogicalMapping: Failed to write pattern\n\r");
+        return error;
+    }
+
+    /* Mapping is not modified anymore*/
+    mapped->mappingModified = 0;
+
+    /* Release previous block (if any)*/
+    if (previousPhysicalBlock != -1) {
+
+        TRACE_DEBUG("Previous physical block was #%d\n\r",
+                    previousPhysicalBlock);
+        error = ManagedNandFlash_ReleaseBlock(MANAGED(mapped),
+                                              previousPhysicalBlock);
+        if (error) {
+
+            return error;
+        }
+    }
+
+    TRACE_INFO("Mapping saved on block #%d\n\r", physicalBlock);
+
+    return 0;
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -286,6 +383,7 @@ unsigned char MappedNandFlash_Initialize(
     unsigned short numBlocks;
     unsigned short block;
     signed short logicalMappingBlock = 0;
+    unsigned char *data;
 
     TRACE_INFO("MappedNandFlash_Initialize()\n\r");
 
@@ -306,14 +404,22 @@ unsigned char MappedNandFlash_Initialize(
 
     /* Scan to find logical mapping*/
     mapped->mappingModified = 0;
-    error = FindLogicalMappingBlock(mapped, &logicalMappingBlock);
+    data = NandScratch_AcquirePage();
+    if (!data) {
+
+        return NandCommon_ERROR_NOSCRATCH;
+    }
+    error = FindLogicalMappingBlock(mapped, &logicalMappingBlock, data);
     if (!error) {
 
         /* Extract mapping from block*/
         mapped->logicalMappingBlock = logicalMappingBlock;
-        return LoadLogicalMapping(mapped, logicalMappingBlock);
+        error = LoadLogicalMapping(mapped, logicalMappingBlock, data);
+        NandScratch_Release(data);
+        return error;
     }
-    else if (error == NandCommon_ERROR_NOMAPPING) {
+    NandScratch_Release(data);
+    if (error == NandCommon_ERROR_NOMAPPING) {
 
         /* Start with no block mapped*/
         mapped->logicalMappingBlock = -1;
@@ -547,17 +653,7 @@ unsigned char MappedNandFlash_SaveLogicalMapping(
     unsigned short physicalBlock)
 {
     unsigned char error;
-    unsigned char data[NandCommon_MAXPAGEDATASIZE];
-    unsigned short pageDataSize =
-                    NandFlashModel_GetPageDataSize(MODEL(mapped));
-    /*unsigned short numBlocks =
-                    ManagedNandFlash_GetDeviceSizeInBlocks(MANAGED(mapped));*/
-    unsigned int i;
-    unsigned int remainingSize;
-    unsigned char *currentBuffer;
-    unsigned short currentPage;
-    unsigned int writeSize;
-    signed short previousPhysicalBlock;
+    unsigned char *data;
 
     TRACE_INFO("MappedNandFlash_SaveLogicalMapping(B#%d)\n\r", physicalBlock);
 
@@ -567,78 +663,15 @@ unsigned char MappedNandFlash_SaveLogicalMapping(
         return 0;
     }
 
-    /* Allocate new block*/
-    error = ManagedNandFlash_AllocateBlock(MANAGED(mapped), physicalBlock);
-    if (error) {
-
-        return error;
-    }
-
-    /* Save mapping*/
-    previousPhysicalBlock = mapped->logicalMappingBlock;
-    mapped->logicalMappingBlock = physicalBlock;
-
-    /* Save actual mapping in pages #1-#XXX*/
-    currentBuffer = (unsigned char *) mapped->logicalMapping;
-    remainingSize = sizeof(mapped->logicalMapping);
-    currentPage = 1;
-    while (remainingSize > 0) {
-
-        writeSize = min(remainingSize, pageDataSize);
-        memset(data, 0xFF, pageDataSize);
-        memcpy(data, currentBuffer, writeSize);
-        error = ManagedNandFlash_WritePage(MANAGED(mapped),
-                                           physicalBlock,
-                                           currentPage,
-                                           data,
-                                           0);
-        if (error) {
-
-            TRACE_ERROR(
-             "MappedNandFlash_SaveLogicalMapping: Failed to write mapping\n\r");
-            return error;
-        }
-
-        currentBuffer += writeSize;
-        remainingSize -= writeSize;
-        currentPage++;
-    }
-
-    /* Mark page #0 of block with a distinguishible pattern, so the mapping can
-       be retrieved at startup*/
-    for (i=0; i < pageDataSize; i++) {
+    data = NandScratch_AcquirePage();
+    if (!data) {
 
-        data[i] = PATTERN(i);
+        return NandCommon_ERROR_NOSCRATCH;
     }
-    error = ManagedNandFlash_WritePage(MANAGED(mapped),
-                                       physicalBlock, 0,
-                                       data, 0);
-    if (error) {
+    error = SaveLogicalMapping(mapped, physicalBlock, data);
+    NandScratch_Release(data);
 
-        TRACE_ERROR(
-            "MappedNandFlash_SaveLogicalMapping: Failed to write pattern\n\r");
-        return error;
-    }
-
-    /* Mapping is not modified anymore*/
-    mapped->mappingModified = 0;
-
-    /* Release previous block (if any)*/
-    if (previousPhysicalBlock != -1) {
-
-        TRACE_DEBUG("Previous physical block was #%d\n\r",
-                    previousPhysicalBlock);
-        error = ManagedNandFlash_ReleaseBlock(MANAGED(mapped),
-                                              previousPhysicalBlock);
-        if (error) {
-
-            return error;
-        }
-    }
-
-    TRACE_INFO("Mapping saved on block #%d\n\r", physicalBlock);
-
-    return 0;
+    return error;
 }
 
 /**
@@ -0,0 +1,156 @@
+/**
+ * \file
+ *
+ * Implementation of the nandflash scratch buffer arena.
+ *
+ * Each class of buffers is tracked by a bitmap of the buffers in use; the
+ * arena itself is placed in the .nandinfo section with the other nandflash
+ * tables since it does not need to be cleared.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "memories.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Page data buffers */
+static uint8_t pages[NandScratch_NUMPAGES][NandCommon_MAXPAGEDATASIZE]
+    __attribute__ ((aligned (4), section (".nandinfo")));
+
+/** Page spare buffers */
+static uint8_t spares[NandScratch_NUMSPARES][NandCommon_MAXPAGESPARESIZE]
+    __attribute__ ((aligned (4), section (".nandinfo")));
+
+/** Buffers in use (one bit per buffer) */
+static uint32_t pagesUsed ;
+static uint32_t sparesUsed ;
+
+/** High-water marks */
+static uint8_t pagesMax ;
+static uint8_t sparesMax ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Take the first free buffer of a class.
+ *
+ * \param pUsed   Bitmap of the buffers in use.
+ * \param count   Number of buffers in the class.
+ * \param pMax    High-water mark of the class.
+ * \return the buffer index, or -1 if they are all in use.
+ */
+static int32_t Acquire( uint32_t *pUsed, uint32_t count, uint8_t *pMax )
+{
+    uint32_t i ;
+    uint32_t inUse = 0 ;
+    int32_t index = -1 ;
+
+    for ( i=0 ; i < count ; i++ )
+    {
+        if ( *pUsed & (1u << i) )
+        {
+            inUse++ ;
+        }
+        else if ( index == -1 )
+        {
+            index = i ;
+        }
+    }
+
+    if ( index != -1 )
+    {
+        *pUsed |= 1u << index ;
+        if ( inUse + 1 > *pMax )
+        {
+            *pMax = inUse + 1 ;
+        }
+    }
+
+    return index ;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Take a page data buffer (NandCommon_MAXPAGEDATASIZE bytes).
+ *
+ * \return the buffer, or 0 if they are all in use.
+ */
+extern uint8_t *NandScratch_AcquirePage( void )
+{
+    int32_t index = Acquire( &pagesUsed, NandScratch_NUMPAGES, &pagesMax ) ;
+
+    if ( index == -1 )
+    {
+        TRACE_ERROR( "NandScratch_AcquirePage: no page buffer left\n\r" ) ;
+        return 0 ;
+    }
+
+    return pages[index] ;
+}
+
+/**
+ * \brief Take a page spare buffer (NandCommon_MAXPAGESPARESIZE bytes).
+ *
+ * \return the buffer, or 0 if they are all in use.
+ */
+extern uint8_t *NandScratch_AcquireSpare( void )
+{
+    int32_t index = Acquire( &sparesUsed, NandScratch_NUMSPARES, &sparesMax ) ;
+
+    if ( index == -1 )
+    {
+        TRACE_ERROR( "NandScratch_AcquireSpare: no spare buffer left\n\r" ) ;
+        return 0 ;
+    }
+
+    return spares[index] ;
+}
+
+/**
+ * \brief Give a buffer back to the arena. A null pointer is ignored.
+ *
+ * \param buffer  Buffer returned by NandScratch_AcquirePage() or
+ *                NandScratch_AcquireSpare().
+ */
+extern void NandScratch_Release( void *buffer )
+{
+    uint8_t *p = (uint8_t *)buffer ;
+
+    if ( p == 0 )
+    {
+        return ;
+    }
+
+    if ( (p >= pages[0]) && (p < pages[NandScratch_NUMPAGES]) )
+    {
+        pagesUsed &= ~(1u << ((p - pages[0]) / NandCommon_MAXPAGEDATASIZE)) ;
+    }
+    else
+    {
+        assert( (p >= spares[0]) && (p < spares[NandScratch_NUMSPARES]) ) ;
+        sparesUsed &= ~(1u << ((p - spares[0]) / NandCommon_MAXPAGESPARESIZE)) ;
+    }
+}
+
+/**
+ * \brief Print the maximum number of buffers used at the same time.
+ */
+extern void NandScratch_PrintReport( void )
+{
+    printf( "-I- NAND scratch: %u/%u pages, %u/%u spares used at most\n\r",
+            (unsigned int)pagesMax, (unsigned int)NandScratch_NUMPAGES,
+            (unsigned int)sparesMax, (unsigned int)NandScratch_NUMSPARES ) ;
+}
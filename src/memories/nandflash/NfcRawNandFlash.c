@@ -212,7 +212,7 @@ static unsigned char IsOperationComplete(const struct RawNandFlash *raw)
  * \param sramOffset  NFC internal sram start offset.
  * \param size   Number of data bytes to send.
  */
-static void CopyDataToNfcInternalSram(
+static RAMFUNC void CopyDataToNfcInternalSram(
     const struct RawNandFlash *raw,
     unsigned char *data,
     unsigned short sramOffset,
@@ -250,7 +250,7 @@ static void CopyDataToNfcInternalSram(
  * \param sramOffset  NFC internal sram start offset.
  * \param size Number of data bytes to receive.
  */
-static void CopyDataFromNfcInternalSram(
+static RAMFUNC void CopyDataFromNfcInternalSram(
     const struct RawNandFlash *raw,
     unsigned char *data,
     unsigned short sramOffset,
@@ -505,9 +505,13 @@ static unsigned char CopyPage(
     else {
 
         /* Software copy*/
-        unsigned char data[NandCommon_MAXPAGEDATASIZE];
-        unsigned char spare[NandCommon_MAXPAGESPARESIZE];
-        if (RawNandFlash_ReadPage(raw, sourceBlock, sourcePage, data, spare)) {
+        unsigned char *data = NandScratch_AcquirePage();
+        unsigned char *spare = NandScratch_AcquireSpare();
+        if (!data || !spare) {
+
+            error = NandCommon_ERROR_NOSCRATCH;
+        }
+        else if (RawNandFlash_ReadPage(raw, sourceBlock, sourcePage, data, spare)) {
 
             TRACE_ERROR("CopyPage: Failed to read page to copy\n\r");
             error = NandCommon_ERROR_CANNOTREAD;
@@ -517,6 +521,8 @@ static unsigned char CopyPage(
             TRACE_ERROR("CopyPage: Failed to write dest. page\n\r");
             error = NandCommon_ERROR_CANNOTWRITE;
         }
+        NandScratch_Release(data);
+        NandScratch_Release(spare);
     }
 
     return error;
@@ -837,6 +843,175 @@ unsigned char RawNandFlash_CopyPage(
     return NandCommon_ERROR_BADBLOCK;
 }
 
+/**
+ * \brief Reads the ECC bytes of the spare area out of the page register after a
+ * copy-back read (random data output), and checks whether they are erased.
+ * The page register is left as it is for the copy-back program.
+ *
+ * \param raw  Pointer to a RawNandFlash instance.
+ * \return 1 if the ECC bytes are all 0xFF (page never programmed); otherwise 0.
+ */
+static unsigned char IsCopyBackPageErased(const struct RawNandFlash *raw)
+{
+    const struct NandSpareScheme *scheme = NandFlashModel_GetScheme(MODEL(raw));
+    unsigned short column = NandFlashModel_GetPageDataSize(MODEL(raw))
+                            + scheme->eccBytesPositions[0];
+    unsigned short numBytes = scheme->eccBytesPositions[scheme->numEccBytes - 1]
+                              - scheme->eccBytesPositions[0] + 1;
+    unsigned short erased = 0xFFFF;
+    unsigned short i;
+
+    /* Check the data bus width of the NandFlash */
+    if (NandFlashModel_GetDataBusWidth(MODEL(raw)) == 16) {
+        /* Div 2 is because we address in word and not in byte */
+        column >>= 1;
+        numBytes = (numBytes + 1) >> 1;
+    }
+
+    SMC_NFC_SendCommand(SMC,
+                    NFCADDR_CMD_NFCCMD |                    /* Command.*/
+                    0 |                                     /* NFC read data.*/
+                    0 |                                     /* NFC auto R/W is disabled.*/
+                    BOARD_NF_CSID |                         /* CSID.*/
+                    NFCADDR_CMD_ACYCLE_TWO |                /* Column address only.*/
+                    NFCADDR_CMD_VCMD2 |                     /* CMD2 enabled.*/
+                    (COMMAND_RANDOM_OUT_2 << 10)|           /* CMD2.*/
+                    (COMMAND_RANDOM_OUT << 2),              /* CMD1.*/
+                    (column >> 8) & 0xFF,                   /* Address cylce 1.*/
+                    column & 0xFF                           /* Address cylce 0.*/
+                    );
+    for (i=0; i < numBytes; i++) {
+
+        if (NandFlashModel_GetDataBusWidth(MODEL(raw)) == 16) {
+
+            erased &= READ_DATA16(raw);
+        }
+        else {
+
+            erased &= READ_DATA8(raw) | 0xFF00;
+        }
+    }
+
+    return (erased == 0xFFFF);
+}
+
+/**
+ * \brief Copies a set of pages of a block to the same pages of another block with
+ * the copy-back command, without transferring the data on the bus. The
+ * addresses of the next page are computed while the previous page is being
+ * programmed; its status is checked just before the next copy-back read.
+ * A page whose program fails is retried with RawNandFlash_CopyPage().
+ * After each copy-back read, the ECC bytes are read out of the page register:
+ * a source page that was never programmed is not programmed on the destination,
+ * which stays erased and reads the same.
+ *
+ * \param raw  Pointer to a RawNandFlash instance.
+ * \param sourceBlock  Source block number.
+ * \param destBlock  Destination block number.
+ * \param pageMask  Bitmap of the pages to copy (bit i of byte i/8 for page i).
+ * \return 0 if successful; NandCommon_ERROR_CANNOTCOPY if the device does not
+ * support copy-back; otherwise returns NandCommon_ERROR_BADBLOCK.
+ * \note Pages keep their index, so the source and destination pages always
+ * have the same parity (plane). The pages must have been written with their
+ * ECC (EccNandFlash), so that a programmed page never has all its ECC bytes
+ * erased.
+ */
+unsigned char RawNandFlash_CopyBackPages(
+    const struct RawNandFlash *raw,
+    unsigned short sourceBlock,
+    unsigned short destBlock,
+    const unsigned char *pageMask)
+{
+    unsigned short numPages = NandFlashModel_GetBlockSizeInPages(MODEL(raw));
+    unsigned int sourceCycle0, sourceCycle1234;
+    unsigned int destCycle0, destCycle1234;
+    signed int pendingPage = -1;
+    unsigned int page;
+
+    TRACE_DEBUG("RawNandFlash_CopyBackPages(B#%d->B#%d)\n\r",
+              sourceBlock, destBlock);
+
+    if (!NandFlashModel_SupportsCopyBack(MODEL(raw))) {
+
+        return NandCommon_ERROR_CANNOTCOPY;
+    }
+
+    for (page=0; page <= numPages; page++) {
+
+        if ((page < numPages) && !((pageMask[page / 8] >> (page % 8)) & 1)) {
+
+            continue;
+        }
+
+        /* Prepare the next page while the previous one is programmed*/
+        if (page < numPages) {
+
+            NFC_TranslateAddress(raw, 0, sourceBlock * numPages + page,
+                                 &sourceCycle0, &sourceCycle1234, 1);
+            NFC_TranslateAddress(raw, 0, destBlock * numPages + page,
+                                 &destCycle0, &destCycle1234, 1);
+        }
+
+        /* Complete the previous program*/
+        if (pendingPage != -1) {
+
+            while( !SMC_NFC_isReadyBusy(SMC) );
+            if (!IsOperationComplete(raw)) {
+
+                TRACE_WARNING("RawNandFlash_CopyBackPages: retry page %d\n\r", pendingPage);
+                if (RawNandFlash_CopyPage(raw, sourceBlock, pendingPage, destBlock, pendingPage)) {
+
+                    return NandCommon_ERROR_BADBLOCK;
+                }
+            }
+            pendingPage = -1;
+        }
+        if (page == numPages) {
+
+            break;
+        }
+
+        /* Copy-back read*/
+        SMC_NFC_SendCommand(SMC,
+                    NFCADDR_CMD_NFCCMD |                    /* Command.*/
+                    0 |                                     /* NFC read data.*/
+                    0 |                                     /* NFC auto R/W is disabled.*/
+                    BOARD_NF_CSID |                         /* CSID.*/
+                    NFCADDR_CMD_ACYCLE_FIVE |               /* Number of address cycle.*/
+                    NFCADDR_CMD_VCMD2 |                     /* CMD2 enabled.*/
+                    (COMMAND_COPYBACK_READ_2 << 10)|        /* CMD2.*/
+                    (COMMAND_COPYBACK_READ_1 << 2),         /* CMD1.*/
+                    sourceCycle1234,                        /* Address cylce 1, 2, 3, 4.*/
+                    sourceCycle0                            /* Address cylce 0.*/
+                    );
+        while( !SMC_NFC_isReadyBusy(SMC) );
+
+        /* Nothing to copy from an erased page*/
+        if (IsCopyBackPageErased(raw)) {
+
+            TRACE_DEBUG("RawNandFlash_CopyBackPages: page %d erased\n\r", page);
+            continue;
+        }
+
+        /* Copy-back program, completed at the next iteration*/
+        SMC_NFC_SendCommand(SMC,
+                    NFCADDR_CMD_NFCCMD |                    /* Command.*/
+                    0 |                                     /* No data transfer.*/
+                    0 |                                     /* NFC auto R/W is disabled. */
+                    BOARD_NF_CSID |                         /* CSID.*/
+                    NFCADDR_CMD_ACYCLE_FIVE |               /* Number of address cycle.*/
+                    NFCADDR_CMD_VCMD2 |                     /* CMD2 enabled.*/
+                    (COMMAND_COPYBACK_PROGRAM_2 << 10)|     /* CMD2.*/
+                    (COMMAND_COPYBACK_PROGRAM_1 << 2),      /* CMD1.*/
+                    destCycle1234,                          /* Address cylce 1, 2, 3, 4.*/
+                    destCycle0                              /* Address cylce 0.*/
+                    );
+        pendingPage = page;
+    }
+
+    return 0;
+}
+
 /**
  * \brief Copies the data of one whole block of a NandFlash device to another block.
  *
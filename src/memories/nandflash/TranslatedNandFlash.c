@@ -60,6 +60,16 @@
 /** Maximum allowed erase count difference*/
 #define MAXERASEDIFFERENCE          5
 
+/** Number of FREE blocks below which allocations erase dirty blocks*/
+#define GCFREETHRESHOLD             8
+
+/** Maximum number of blocks erased by one allocation*/
+#define GCWRITEBUDGET               1
+
+/** Bound of the log hit credit, i.e. how long a change of workload takes to
+    switch the log blocks on or off*/
+#define LOGCREDITMAX                8
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -133,24 +143,54 @@ static void MarkAllPagesClean( struct TranslatedNandFlash *translated )
     memset( translated->currentBlockPageStatuses, 0, sizeof( translated->currentBlockPageStatuses ) ) ;
 }
 
+/**
+ * \brief  Erases a few dirty blocks when the FREE pool runs low, so that the
+ * erases are spread over the allocations instead of being done all at once
+ * when the last FREE block is reached.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+static unsigned char CollectOnWrite(struct TranslatedNandFlash *translated)
+{
+    if (ManagedNandFlash_CountBlocks(MANAGED(translated), NandBlockStatus_FREE)
+        > GCFREETHRESHOLD) {
+
+        return 0;
+    }
+
+    return TranslatedNandFlash_CollectGarbage(translated, GCWRITEBUDGET, 0);
+}
+
 /**
  * \brief  Allocates the best-fitting physical block for the given logical block.
+ * At most one LIVE block is switched for wear levelling per allocation, so
+ * that the copies are spread over the allocations like the erases.
  *
  * \param translated  Pointer to a TranslatedNandFlash instance.
  * \param block  Logical block number.
+ * \param levelWear  Switch a LIVE block if the erase count difference is too big.
  * \return 0 if successful; otherwise returns NandCommon_ERROR_NOBLOCKFOUND if
  * there are no more free blocks, or a NandCommon_ERROR code.
  */
 static unsigned char AllocateBlock(
     struct TranslatedNandFlash *translated,
-    unsigned short block)
+    unsigned short block,
+    unsigned char levelWear)
 {
     unsigned short freeBlock, liveBlock;
     unsigned char error;
     signed int eraseDifference;
+    signed short liveLogicalBlock;
 
     TRACE_DEBUG("Allocating a new block\n\r");
 
+    error = CollectOnWrite(translated);
+    if (error)
+    {
+        return error;
+    }
+
     /* Find youngest free block and youngest live block*/
     if (ManagedNandFlash_FindYoungestBlock(MANAGED(translated),
                                            NandBlockStatus_FREE,
@@ -183,13 +223,14 @@ static unsigned char AllocateBlock(
         }
 
         /* Allocate new block*/
-        return AllocateBlock(translated, block);
+        return AllocateBlock(translated, block, levelWear);
     }
 
     /* Find youngest LIVE block to check the erase count difference*/
-    if (!ManagedNandFlash_FindYoungestBlock(MANAGED(translated),
-                                            NandBlockStatus_LIVE,
-                                            &liveBlock))
+    if (levelWear
+        && !ManagedNandFlash_FindYoungestBlock(MANAGED(translated),
+                                               NandBlockStatus_LIVE,
+                                               &liveBlock))
     {
         /* Calculate erase count difference*/
         TRACE_DEBUG("Free block erase count = %d\n\r", MANAGED(translated)->blockStatuses[freeBlock].eraseCount);
@@ -197,22 +238,23 @@ static unsigned char AllocateBlock(
         eraseDifference = abs(MANAGED(translated)->blockStatuses[freeBlock].eraseCount
                               - MANAGED(translated)->blockStatuses[liveBlock].eraseCount);
 
-        /* Check if it is too big*/
-        if (eraseDifference > MAXERASEDIFFERENCE)
+        /* Check if it is too big (the logical mapping block and the log
+           blocks are LIVE but not mapped, they cannot be switched)*/
+        liveLogicalBlock = MappedNandFlash_PhysicalToLogical(MAPPED(translated), liveBlock);
+        if ((eraseDifference > MAXERASEDIFFERENCE) && (liveLogicalBlock != -1))
         {
             TRACE_WARNING("Erase difference too big, switching blocks\n\r");
             MappedNandFlash_Map(
                 MAPPED(translated),
-                MappedNandFlash_PhysicalToLogical(
-                    MAPPED(translated),
-                    liveBlock),
+                liveLogicalBlock,
                 freeBlock);
             ManagedNandFlash_CopyBlock(MANAGED(translated),
                                        liveBlock,
                                        freeBlock);
+            translated->programmedPages += NandFlashModel_GetBlockSizeInPages(MODEL(translated));
 
-            /* Allocate a new block*/
-            return AllocateBlock(translated, block);
+            /* Allocate a new block, the next switch is left to the next allocation*/
+            return AllocateBlock(translated, block, 0);
         }
     }
 
@@ -223,6 +265,432 @@ static unsigned char AllocateBlock(
     return 0;
 }
 
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+/**
+ * \brief  Returns the index of the log block dedicated to a logical block.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param block  Logical block number.
+ * \return the log block index, or -1 if the logical block has no log block.
+ */
+static signed int FindLogBlock(
+    const struct TranslatedNandFlash *translated,
+    unsigned short block)
+{
+    unsigned int i;
+
+    for (i=0; i < TranslatedNandFlash_NUMLOGBLOCKS; i++)
+    {
+        if ((translated->logBlocks[i].physicalBlock != -1)
+            && (translated->logBlocks[i].logicalBlock == block))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * \brief  Adds log hits (positive) or misses (negative) to the log credit.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param credit  Hits or misses.
+ */
+static void CreditLog(
+    struct TranslatedNandFlash *translated,
+    signed int credit)
+{
+    credit += translated->logCredit;
+    if (credit > LOGCREDITMAX)
+    {
+        credit = LOGCREDITMAX;
+    }
+    else if (credit < -LOGCREDITMAX)
+    {
+        credit = -LOGCREDITMAX;
+    }
+    translated->logCredit = credit;
+}
+
+/**
+ * \brief  Tells whether the rewrite of a block without log block opens one.
+ * The log blocks are worth their merge only if their block is rewritten again
+ * meanwhile: each such rewrite is a hit and each log merged without one is a
+ * miss. While the misses win, a rewrite relocates the block as without log
+ * blocks, and the last relocated blocks stand for the logs they would have
+ * had, so that the hit rate is still measured.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param block  Logical block number.
+ * \return 1 if a log block is to be opened; 0 if the block is to be relocated.
+ */
+static unsigned char LogIsWorthIt(
+    struct TranslatedNandFlash *translated,
+    unsigned short block)
+{
+    unsigned int i;
+
+    for (i=0; i < TranslatedNandFlash_NUMLOGBLOCKS; i++)
+    {
+        if (translated->skippedBlocks[i] == block)
+        {
+            translated->skippedBlocks[i] = -1;
+            CreditLog(translated, 1);
+            break;
+        }
+    }
+    if (translated->logCredit >= 0)
+    {
+        return 1;
+    }
+
+    /* A block leaving the list without being rewritten would have missed*/
+    i = translated->nextSkipped;
+    if (translated->skippedBlocks[i] != -1)
+    {
+        CreditLog(translated, -1);
+    }
+    translated->skippedBlocks[i] = block;
+    translated->nextSkipped = (i + 1) % TranslatedNandFlash_NUMLOGBLOCKS;
+
+    return 0;
+}
+
+/**
+ * \brief  Finds the youngest FREE block. If this is the last one, the logical
+ * mapping is saved in it and the dirty blocks are erased first, the same way
+ * AllocateBlock() does. The block is not allocated.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param freeBlock  Pointer to the block number variable.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+static unsigned char FindFreeBlock(
+    struct TranslatedNandFlash *translated,
+    unsigned short *freeBlock)
+{
+    unsigned char error;
+
+    error = CollectOnWrite(translated);
+    if (error)
+    {
+        return error;
+    }
+
+    if (ManagedNandFlash_FindYoungestBlock(MANAGED(translated),
+                                           NandBlockStatus_FREE,
+                                           freeBlock)) {
+
+        TRACE_ERROR("FindFreeBlock: Could not find a free block\n\r");
+        return NandCommon_ERROR_NOBLOCKFOUND;
+    }
+
+    if (ManagedNandFlash_CountBlocks(MANAGED(translated),
+                                     NandBlockStatus_FREE) == 1) {
+
+        /* The current block still reads its clean pages from the previous
+           (DIRTY) block: complete it before dirty blocks are erased*/
+        error = TranslatedNandFlash_Flush(translated);
+        if (error)
+        {
+            return error;
+        }
+        error = MappedNandFlash_SaveLogicalMapping(MAPPED(translated), *freeBlock);
+        if (error)
+        {
+            TRACE_ERROR("FindFreeBlock: Failed to save mapping\n\r");
+            return error;
+        }
+        error = ManagedNandFlash_EraseDirtyBlocks(MANAGED(translated));
+        if (error)
+        {
+            TRACE_ERROR("FindFreeBlock: Failed to erase dirty blocks\n\r");
+            return error;
+        }
+
+        return FindFreeBlock(translated, freeBlock);
+    }
+
+    return 0;
+}
+
+/**
+ * \brief  Merges a log block with its data block and frees the log block.
+ * If the log holds every page of the block in order, it simply becomes the
+ * data block (switch merge); otherwise a new block is allocated and filled
+ * with the logged pages and the remaining pages of the data block.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param index  Log block index.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+static unsigned char MergeLogBlock(
+    struct TranslatedNandFlash *translated,
+    unsigned int index)
+{
+    struct TranslatedLogBlock *log = &(translated->logBlocks[index]);
+    unsigned short numPages = NandFlashModel_GetBlockSizeInPages(MODEL(translated));
+    unsigned short block = log->logicalBlock;
+    unsigned short freeBlock;
+    signed short dataBlock;
+    signed short newBlock;
+    unsigned short logPage;
+    unsigned short i;
+    unsigned char error;
+    unsigned char *mergeBuffer;
+    unsigned char unloggedPages[NandCommon_MAXNUMPAGESPERBLOCK / 8];
+
+    TRACE_INFO("MergeLogBlock(PB#%d -> LB#%d, %d pages)\n\r",
+               log->physicalBlock, block, log->writtenPages);
+
+    if (log->hits == 0)
+    {
+        CreditLog(translated, -1);
+    }
+
+    /* The data block is about to be replaced: complete the current write*/
+    if (block == translated->currentLogicalBlock)
+    {
+        error = TranslatedNandFlash_Flush(translated);
+        if (error)
+        {
+            return error;
+        }
+        translated->currentLogicalBlock = -1;
+        MarkAllPagesClean(translated);
+    }
+
+    /* Switch merge if the log has been written sequentially from page #0*/
+    for (i=0; (i < numPages) && (log->pageMap[i] == i); i++);
+    if (i == numPages)
+    {
+        TRACE_DEBUG("Switch merge\n\r");
+        dataBlock = MappedNandFlash_LogicalToPhysical(MAPPED(translated), block);
+        if (dataBlock != -1)
+        {
+            error = ManagedNandFlash_ReleaseBlock(MANAGED(translated), dataBlock);
+            if (error)
+            {
+                return error;
+            }
+        }
+        MAPPED(translated)->logicalMapping[block] = log->physicalBlock;
+        MAPPED(translated)->mappingModified = 1;
+        log->physicalBlock = -1;
+
+        return 0;
+    }
+
+    /* Full merge in a new block*/
+    error = FindFreeBlock(translated, &freeBlock);
+    if (error)
+    {
+        return error;
+    }
+    dataBlock = MappedNandFlash_LogicalToPhysical(MAPPED(translated), block);
+    error = MappedNandFlash_Map(MAPPED(translated), block, freeBlock);
+    if (error)
+    {
+        return error;
+    }
+    newBlock = freeBlock;
+
+    /* Pages which have not been logged in one batch*/
+    memset(unloggedPages, 0, sizeof(unloggedPages));
+    for (i=0; i < numPages; i++)
+    {
+        if (log->pageMap[i] == TranslatedNandFlash_PAGENOTLOGGED)
+        {
+            unloggedPages[i / 8] |= 1 << (i % 8);
+        }
+    }
+    error = ManagedNandFlash_MergePages(MANAGED(translated), dataBlock, newBlock, unloggedPages);
+    if (error)
+    {
+        TRACE_ERROR("MergeLogBlock: copy data block pages\n\r");
+        return error;
+    }
+
+    for (i=0; i < numPages; i++)
+    {
+        logPage = log->pageMap[i];
+        if (logPage == TranslatedNandFlash_PAGENOTLOGGED)
+        {
+            continue;
+        }
+        else if ((logPage & 1) == (i & 1))
+        {
+            error = ManagedNandFlash_CopyPage(MANAGED(translated),
+                                              log->physicalBlock, logPage, newBlock, i);
+        }
+        else
+        {
+            /* Copy-back requires the same page parity: go through RAM*/
+            mergeBuffer = NandScratch_AcquirePage();
+            if (!mergeBuffer)
+            {
+                return NandCommon_ERROR_NOSCRATCH;
+            }
+            error = ManagedNandFlash_ReadPage(MANAGED(translated),
+                                              log->physicalBlock, logPage,
+                                              mergeBuffer, 0);
+            if (!error)
+            {
+                error = ManagedNandFlash_WritePage(MANAGED(translated),
+                                                   newBlock, i, mergeBuffer, 0);
+            }
+            NandScratch_Release(mergeBuffer);
+        }
+        if (error)
+        {
+            TRACE_ERROR("MergeLogBlock: copy page #%d\n\r", i);
+            return error;
+        }
+    }
+    translated->programmedPages += numPages;
+
+    /* Free the log block*/
+    error = ManagedNandFlash_ReleaseBlock(MANAGED(translated), log->physicalBlock);
+    log->physicalBlock = -1;
+
+    return error;
+}
+
+/**
+ * \brief  Merges every log block with its data block.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+static unsigned char MergeAllLogBlocks(struct TranslatedNandFlash *translated)
+{
+    unsigned int i;
+    unsigned char error;
+
+    for (i=0; i < TranslatedNandFlash_NUMLOGBLOCKS; i++)
+    {
+        if (translated->logBlocks[i].physicalBlock != -1)
+        {
+            error = MergeLogBlock(translated, i);
+            if (error)
+            {
+                return error;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief  Appends a page to the log block of its logical block. A log block is
+ * taken from the pool (merging the least recently written one if they are
+ * all in use) when the logical block has none or when its log is full.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param block  Logical block number (must be mapped).
+ * \param page  Number of page to write inside logical block.
+ * \param data  Data area buffer, can be 0.
+ * \param spare  Spare area buffer, can be 0.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+static unsigned char WriteLogPage(
+    struct TranslatedNandFlash *translated,
+    unsigned short block,
+    unsigned short page,
+    void *data,
+    void *spare)
+{
+    unsigned short numPages = NandFlashModel_GetBlockSizeInPages(MODEL(translated));
+    struct TranslatedLogBlock *log;
+    signed int index;
+    unsigned int i;
+    unsigned short freeBlock;
+    unsigned char error;
+
+    /* A full log is merged, the block then gets a new log*/
+    index = FindLogBlock(translated, block);
+    if ((index != -1) && (translated->logBlocks[index].lastWrite + 1 != translated->hostPages))
+    {
+        translated->logBlocks[index].hits++;
+        CreditLog(translated, 1);
+    }
+    if ((index != -1) && (translated->logBlocks[index].writtenPages == numPages))
+    {
+        error = MergeLogBlock(translated, index);
+        if (error)
+        {
+            return error;
+        }
+        index = -1;
+    }
+
+    if (index == -1)
+    {
+        /* Take an unused log block, or evict the least recently written one*/
+        index = 0;
+        for (i=0; i < TranslatedNandFlash_NUMLOGBLOCKS; i++)
+        {
+            if (translated->logBlocks[i].physicalBlock == -1)
+            {
+                index = i;
+                break;
+            }
+            if (translated->logBlocks[i].lastWrite < translated->logBlocks[index].lastWrite)
+            {
+                index = i;
+            }
+        }
+        if (translated->logBlocks[index].physicalBlock != -1)
+        {
+            error = MergeLogBlock(translated, index);
+            if (error)
+            {
+                return error;
+            }
+        }
+
+        error = FindFreeBlock(translated, &freeBlock);
+        if (error)
+        {
+            return error;
+        }
+        error = ManagedNandFlash_AllocateBlock(MANAGED(translated), freeBlock);
+        if (error)
+        {
+            return error;
+        }
+        TRACE_DEBUG("Log PB#%d for LB#%d\n\r", freeBlock, block);
+
+        log = &(translated->logBlocks[index]);
+        log->physicalBlock = freeBlock;
+        log->logicalBlock = block;
+        log->writtenPages = 0;
+        log->hits = 0;
+        memset(log->pageMap, TranslatedNandFlash_PAGENOTLOGGED, sizeof(log->pageMap));
+    }
+
+    /* Append page*/
+    log = &(translated->logBlocks[index]);
+    error = ManagedNandFlash_WritePage(MANAGED(translated),
+                                       log->physicalBlock,
+                                       log->writtenPages,
+                                       data,
+                                       spare);
+    log->writtenPages++;
+    translated->programmedPages++;
+    if (error)
+    {
+        return error;
+    }
+    log->pageMap[page] = log->writtenPages - 1;
+    log->lastWrite = translated->hostPages;
+
+    return 0;
+}
+#endif
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -252,9 +720,24 @@ unsigned char TranslatedNandFlash_Initialize(
     unsigned short baseBlock,
     unsigned short sizeInBlocks)
 {
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    unsigned int i;
+#endif
+
     translated->currentLogicalBlock = -1;
     translated->previousPhysicalBlock = -1;
     MarkAllPagesClean(translated);
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    for (i=0; i < TranslatedNandFlash_NUMLOGBLOCKS; i++)
+    {
+        translated->logBlocks[i].physicalBlock = -1;
+        translated->skippedBlocks[i] = -1;
+    }
+    translated->nextSkipped = 0;
+    translated->logCredit = 0;
+#endif
+    translated->hostPages = 0;
+    translated->programmedPages = 0;
 
     /* Initialize MappedNandFlash*/
     return MappedNandFlash_Initialize(MAPPED(translated),
@@ -284,9 +767,23 @@ unsigned char TranslatedNandFlash_ReadPage( const struct TranslatedNandFlash *tr
                                             unsigned short page, void *data, void *spare )
 {
     unsigned char error ;
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    signed int index ;
+#endif
 
     TRACE_INFO("TranslatedNandFlash_ReadPage(B#%d:P#%d)\n\r", block, page);
 
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    /* The latest copy of a rewritten page is in the log block*/
+    index = FindLogBlock( translated, block ) ;
+    if ( (index != -1) && (translated->logBlocks[index].pageMap[page] != TranslatedNandFlash_PAGENOTLOGGED) )
+    {
+        TRACE_DEBUG("Reading page from log block\n\r");
+        return ManagedNandFlash_ReadPage( MANAGED( translated ), translated->logBlocks[index].physicalBlock,
+                                          translated->logBlocks[index].pageMap[page], data, spare ) ;
+    }
+#endif
+
     /* If the page to read is in the current block, there is a previous physical
        block and the page is clean -> read the page in the old block since the
        new one does not contain meaningful data*/
@@ -392,6 +889,24 @@ unsigned char TranslatedNandFlash_WritePage( struct TranslatedNandFlash *transla
         }
     }
 
+    translated->hostPages++;
+
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    /* Out-of-order rewrites of a mapped block go to its log block; only a
+       rewrite starting at page #0 relocates the block (sequential overwrite),
+       and so does a scattered rewrite while the log blocks do not pay off*/
+    if ( allocate && (MappedNandFlash_LogicalToPhysical(MAPPED(translated), block) != -1) )
+    {
+        if ( (FindLogBlock(translated, block) != -1)
+             || (((page != 0) || (translated->currentLogicalBlock == block))
+                 && LogIsWorthIt(translated, block)) )
+        {
+            TRACE_DEBUG("Write page in log block\n\r");
+            return WriteLogPage(translated, block, page, data, spare);
+        }
+    }
+#endif
+
     /* Allocate block if needed*/
     if ( allocate )
     {
@@ -403,7 +918,7 @@ unsigned char TranslatedNandFlash_WritePage( struct TranslatedNandFlash *transla
         }
         translated->previousPhysicalBlock = MappedNandFlash_LogicalToPhysical( MAPPED(translated), block ) ;
         TRACE_DEBUG("Previous physical block is now #%d\n\r", translated->previousPhysicalBlock ) ;
-        error = AllocateBlock( translated, block ) ;
+        error = AllocateBlock( translated, block, 1 ) ;
         if ( error )
         {
             return error;
@@ -420,6 +935,7 @@ unsigned char TranslatedNandFlash_WritePage( struct TranslatedNandFlash *transla
                                       page,
                                       data,
                                       spare);
+    translated->programmedPages++;
     if ( error )
     {
         return error;
@@ -443,6 +959,7 @@ unsigned char TranslatedNandFlash_Flush(struct TranslatedNandFlash *translated)
     unsigned int i;
     unsigned char error;
     unsigned int currentPhysicalBlock;
+    unsigned char cleanPages[NandCommon_MAXNUMPAGESPERBLOCK / 8];
 
     /* Check if there is a current block and a previous block*/
     if ((translated->currentLogicalBlock == -1)
@@ -463,21 +980,24 @@ unsigned char TranslatedNandFlash_Flush(struct TranslatedNandFlash *translated)
     {
         if (PageIsClean(translated, i))
         {
-            TRACE_DEBUG("Copying back page #%d of block #%d\n\r", i, translated->previousPhysicalBlock);
-
-            /* Copy page*/
-            error = ManagedNandFlash_CopyPage(MANAGED(translated),
-                                              translated->previousPhysicalBlock,
-                                              i,
-                                              currentPhysicalBlock,
-                                              i);
-            if (error)
-            {
-                TRACE_ERROR("FinishCurrentWrite: copy page #%d\n\r", i);
-                return error;
-            }
+            translated->programmedPages++;
         }
     }
+    for (i=0; i < sizeof(cleanPages); i++)
+    {
+        cleanPages[i] = ~translated->currentBlockPageStatuses[i];
+    }
+
+    /* Copy pages in one batch*/
+    error = ManagedNandFlash_MergePages(MANAGED(translated),
+                                        translated->previousPhysicalBlock,
+                                        currentPhysicalBlock,
+                                        cleanPages);
+    if (error)
+    {
+        TRACE_ERROR("FinishCurrentWrite: copy pages\n\r");
+        return error;
+    }
 
     translated->currentLogicalBlock = -1;
     translated->previousPhysicalBlock = -1;
@@ -495,6 +1015,10 @@ unsigned char TranslatedNandFlash_EraseAll(
     struct TranslatedNandFlash *translated,
     unsigned char level)
 {
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    unsigned int i;
+#endif
+
     MappedNandFlash_EraseAll(MAPPED(translated), level);
 
     if (level > NandEraseDIRTY)
@@ -502,10 +1026,89 @@ unsigned char TranslatedNandFlash_EraseAll(
         translated->currentLogicalBlock = -1;
         translated->previousPhysicalBlock = -1;
         MarkAllPagesClean(translated);
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+        for (i=0; i < TranslatedNandFlash_NUMLOGBLOCKS; i++)
+        {
+            translated->logBlocks[i].physicalBlock = -1;
+        }
+#endif
     }
     return 0;
 }
 
+/**
+ * \brief  Discards the content of a logical block: the block is unmapped and
+ * its physical block (and log block, if any) released as dirty, so that its
+ * pages are neither copied by the next flush or merge nor kept by the wear
+ * levelling. The block reads back as erased until it is written again.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param block  Logical block number.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+unsigned char TranslatedNandFlash_DiscardBlock(
+    struct TranslatedNandFlash *translated,
+    unsigned short block)
+{
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    signed int index;
+    unsigned char error;
+#endif
+
+    TRACE_INFO("TranslatedNandFlash_DiscardBlock(LB#%d)\n\r", block);
+
+    /* The missing pages of the block being written are not copied*/
+    if (translated->currentLogicalBlock == block)
+    {
+        translated->currentLogicalBlock = -1;
+        translated->previousPhysicalBlock = -1;
+        MarkAllPagesClean(translated);
+    }
+
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    /* Drop the rewritten pages without merging them*/
+    index = FindLogBlock(translated, block);
+    if (index != -1)
+    {
+        error = ManagedNandFlash_ReleaseBlock(MANAGED(translated),
+                                              translated->logBlocks[index].physicalBlock);
+        if (error)
+        {
+            return error;
+        }
+        translated->logBlocks[index].physicalBlock = -1;
+    }
+#endif
+
+    if (MappedNandFlash_LogicalToPhysical(MAPPED(translated), block) == -1)
+    {
+        return 0;
+    }
+
+    return MappedNandFlash_Unmap(MAPPED(translated), block);
+}
+
+/**
+ * \brief  Erases at most the given number of dirty blocks. The previous
+ * physical block of the block being written is kept since its pages are
+ * still read. Meant to be called from idle points with a small budget.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ * \param maxErases  Maximum number of blocks to erase.
+ * \param erased  Pointer to the number of erased blocks variable, can be 0.
+ * \return 0 if successful; otherwise returns a NandCommon_ERROR code.
+ */
+unsigned char TranslatedNandFlash_CollectGarbage(
+    struct TranslatedNandFlash *translated,
+    unsigned short maxErases,
+    unsigned short *erased)
+{
+    return ManagedNandFlash_CollectDirtyBlocks(MANAGED(translated),
+                                               maxErases,
+                                               translated->previousPhysicalBlock,
+                                               erased);
+}
+
 /**
  * \brief  Allocates a free block to save the current logical mapping on it.
  *
@@ -520,6 +1123,16 @@ unsigned char TranslatedNandFlash_SaveLogicalMapping(
 
     TRACE_INFO("TranslatedNandFlash_SaveLogicalMapping()\n\r");
 
+#if (TranslatedNandFlash_NUMLOGBLOCKS > 0)
+    /* Log blocks are not part of the saved mapping: merge them first*/
+    error = MergeAllLogBlocks(translated);
+    if (error)
+    {
+        TRACE_ERROR("TranNF_SaveLogicalMapping: Failed to merge log blocks\n\r");
+        return error;
+    }
+#endif
+
     /* Save logical mapping in the youngest free block*/
     /* Find the youngest block*/
     error = ManagedNandFlash_FindYoungestBlock(MANAGED(translated),
@@ -597,3 +1210,25 @@ unsigned long long TranslatedNandFlash_GetDeviceSizeInBytes(
            * NandFlashModel_GetPageDataSize(MODEL(translated));
 }
 
+/**
+ * \brief   Prints the number of pages written by the upper layer and the number
+ * of pages programmed on the device since initialization (page copies and
+ * merges included, logical mapping saves excluded), and their ratio: the
+ * write amplification of the translation layer.
+ *
+ * \param translated  Pointer to a TranslatedNandFlash instance.
+ */
+void TranslatedNandFlash_PrintStatistics(
+   const struct TranslatedNandFlash *translated)
+{
+    unsigned int ratio = 0;
+
+    if (translated->hostPages)
+    {
+        ratio = (unsigned int)(((unsigned long long)translated->programmedPages * 100)
+                               / translated->hostPages);
+    }
+    printf("-I- NAND: %u pages written, %u pages programmed, amplification %u.%02u (%u log blocks)\n\r",
+           translated->hostPages, translated->programmedPages,
+           ratio / 100, ratio % 100, TranslatedNandFlash_NUMLOGBLOCKS);
+}
@@ -298,6 +298,36 @@
 /** Cmd27, adtc, R1 */
 #define SDMMC_PROGRAM_CSD           (27| HSMCI_CMDR_RSPTYP_48_BIT )
 
+/*-------------------------------------------------
+ * Class 5 commands: Erase commands
+ *-------------------------------------------------*/
+
+/** Cmd32, SD, ac, R1 */
+#define SD_ERASE_WR_BLK_START       (32| HSMCI_CMDR_TRCMD_NO_DATA \
+                                       | HSMCI_CMDR_SPCMD_STD \
+                                       | HSMCI_CMDR_RSPTYP_48_BIT \
+                                       | HSMCI_CMDR_MAXLAT )
+/** Cmd33, SD, ac, R1 */
+#define SD_ERASE_WR_BLK_END         (33| HSMCI_CMDR_TRCMD_NO_DATA \
+                                       | HSMCI_CMDR_SPCMD_STD \
+                                       | HSMCI_CMDR_RSPTYP_48_BIT \
+                                       | HSMCI_CMDR_MAXLAT )
+/** Cmd35, MMC, ac, R1 */
+#define MMC_ERASE_GROUP_START       (35| HSMCI_CMDR_TRCMD_NO_DATA \
+                                       | HSMCI_CMDR_SPCMD_STD \
+                                       | HSMCI_CMDR_RSPTYP_48_BIT \
+                                       | HSMCI_CMDR_MAXLAT )
+/** Cmd36, MMC, ac, R1 */
+#define MMC_ERASE_GROUP_END         (36| HSMCI_CMDR_TRCMD_NO_DATA \
+                                       | HSMCI_CMDR_SPCMD_STD \
+                                       | HSMCI_CMDR_RSPTYP_48_BIT \
+                                       | HSMCI_CMDR_MAXLAT )
+/** Cmd38, ac, R1b */
+#define SDMMC_ERASE                 (38| HSMCI_CMDR_TRCMD_NO_DATA \
+                                       | HSMCI_CMDR_SPCMD_STD \
+                                       | HSMCI_CMDR_RSPTYP_R1B \
+                                       | HSMCI_CMDR_MAXLAT )
+
 /*------------------------------------------------
  * Class 8 commands: Application specific commands
  *------------------------------------------------*/
@@ -431,7 +461,11 @@ static unsigned char memChunkSize = 4;
 
 //#define FIFO_SIZE (0x4000 - 0x200)
 #define FIFO_SIZE (16*1024) // Any FIFO size is OK for DMA
-static DmaLinkList  LLI_CH [4];
+/* One descriptor per FIFO_SIZE bytes, enough for the largest data phase */
+#define MCI_DMA_NUM_LLI     (SDMMC_MAX_XFR_SIZE / FIFO_SIZE)
+/* Largest transfer (in words) covered by the descriptors */
+#define MCI_DMA_MAX_WORDS   (MCI_DMA_NUM_LLI * FIFO_SIZE / 4)
+static DmaLinkList  LLI_CH [MCI_DMA_NUM_LLI];
 #define     LAST_ROW            0x100
 static void AT91F_Prepare_Multiple_Transfer(unsigned int Channel,
                                             unsigned int LLI_rownumber,
@@ -475,9 +509,9 @@ static unsigned int DMACH_MCI_P2M(unsigned int channel_index,
     destAddress = (unsigned int)dest_addr; //(unsigned int)SSC_THR_ADD;
     buffSize    = trans_size;
 
-    if(buffSize >= 0x10000){
+    if(buffSize > MCI_DMA_MAX_WORDS){
         TRACE_WARNING("SD DMA, size too big %d\n\r", buffSize);
-        buffSize = 0xffff;
+        buffSize = MCI_DMA_MAX_WORDS;
     }
 
     // Set DMA channel source address
@@ -490,7 +524,7 @@ static unsigned int DMACH_MCI_P2M(unsigned int channel_index,
     DMA_SetDescriptorAddr(DMAC, channel_index, (unsigned int)&LLI_CH[0]);
 
     // Set DMA channel control A
-    DMA_SetSourceBufferSize(DMAC, channel_index, buffSize,
+    DMA_SetSourceBufferSize(DMAC, channel_index, DMAC_CTRLA_BTSIZE(buffSize),
             (DMAC_CTRLA_SRC_WIDTH_WORD >> 24),
             (DMAC_CTRLA_DST_WIDTH_WORD >> 28), 0);
 
@@ -587,9 +621,9 @@ static unsigned int DMACH_MCI_M2P(unsigned int channel_index,
     DMA_DisableChannel(DMAC, channel_index);
 
     buffSize = trans_size;
-    if(buffSize >= 0x10000){
+    if(buffSize > MCI_DMA_MAX_WORDS){
         TRACE_WARNING("SD DMA, size too big %d\n\r", buffSize);
-        buffSize = 0xffff;
+        buffSize = MCI_DMA_MAX_WORDS;
     }
 
     // DMA channel configuration
@@ -606,7 +640,7 @@ static unsigned int DMACH_MCI_M2P(unsigned int channel_index,
     DMA_SetDescriptorAddr(DMAC, channel_index, (unsigned int)&LLI_CH[0]);
 
     // Set DMA channel control A
-    DMA_SetSourceBufferSize(DMAC, channel_index, buffSize,
+    DMA_SetSourceBufferSize(DMAC, channel_index, DMAC_CTRLA_BTSIZE(buffSize),
                               (DMAC_CTRLA_SRC_WIDTH_WORD >> 24),
                               (DMAC_CTRLA_DST_WIDTH_WORD >> 28), 0);
 
@@ -707,7 +741,7 @@ static inline void DMACH_EnableIt( Dmac* pDmac,
  * \param pXfr Pointer to transfer instance.
  * \param size Size of data in bytes.
  */
-static uint8_t FIFO_Write(Hsmci *pHw, MciTransfer *pXfr, uint32_t size)
+static RAMFUNC uint8_t FIFO_Write(Hsmci *pHw, MciTransfer *pXfr, uint32_t size)
 {
     volatile uint32_t *pFIFO = (volatile uint32_t*)((uint32_t)pHw + 0x200);
     register uint32_t c4, c1;
@@ -747,7 +781,7 @@ static uint8_t FIFO_Write(Hsmci *pHw, MciTransfer *pXfr, uint32_t size)
  * \param pXfr Pointer to transfer instance.
  * \param size Size of data in DW.
  */
-static uint8_t FIFO_Read(Hsmci *pHw, MciTransfer *pXfr, uint32_t size)
+static RAMFUNC uint8_t FIFO_Read(Hsmci *pHw, MciTransfer *pXfr, uint32_t size)
 {
     volatile uint32_t *pFIFO = (volatile uint32_t*)((uint32_t)pHw + 0x200);
     register uint32_t c4, c1;
@@ -1692,6 +1726,163 @@ uint8_t SdioCmd53(SdCard *pSd,
     return error;
 }
 
+/**
+ * Sets the address of the first write block to be erased.
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param address   Data address on SD/MMC card (byte or block address, as for Cmd24).
+ * \param pStatus   Pointer to buffer for command response as status.
+ * \param fCallback Pointer to optional callback invoked on command end.
+ *                  NULL:    Function return until command finished.
+ *                  Pointer: Return immediately and invoke callback at end.
+ *                  Callback argument is fixed to a pointer to SdCard instance.
+ * \return the command transfer result (see SendMciCommand).
+ */
+uint8_t SdCmd32(SdCard *pSd,
+                uint32_t address,
+                uint32_t *pStatus,
+                SdmmcCallback fCallback)
+{
+    MciCmd *pCommand = &(mciCmd);
+
+    TRACE_DEBUG("Cmd32()\n\r");
+    ResetMciCommand(pCommand);
+
+    /* Fill command information */
+    pCommand->cmd = SD_ERASE_WR_BLK_START;
+    pCommand->arg = address;
+    pCommand->resType = 1;
+    pCommand->pResp = pStatus;
+
+    /* Send command */
+    return SendMciCommand(pSd, fCallback);
+}
+
+/**
+ * Sets the address of the last write block of the continuous range to be
+ * erased.
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param address   Data address on SD/MMC card (byte or block address, as for Cmd24).
+ * \param pStatus   Pointer to buffer for command response as status.
+ * \param fCallback Pointer to optional callback invoked on command end.
+ *                  NULL:    Function return until command finished.
+ *                  Pointer: Return immediately and invoke callback at end.
+ *                  Callback argument is fixed to a pointer to SdCard instance.
+ * \return the command transfer result (see SendMciCommand).
+ */
+uint8_t SdCmd33(SdCard *pSd,
+                uint32_t address,
+                uint32_t *pStatus,
+                SdmmcCallback fCallback)
+{
+    MciCmd *pCommand = &(mciCmd);
+
+    TRACE_DEBUG("Cmd33()\n\r");
+    ResetMciCommand(pCommand);
+
+    /* Fill command information */
+    pCommand->cmd = SD_ERASE_WR_BLK_END;
+    pCommand->arg = address;
+    pCommand->resType = 1;
+    pCommand->pResp = pStatus;
+
+    /* Send command */
+    return SendMciCommand(pSd, fCallback);
+}
+
+/**
+ * Sets the address of the first erase group within a range to be selected
+ * for erase.
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param address   Data address on SD/MMC card (byte or block address, as for Cmd24).
+ * \param pStatus   Pointer to buffer for command response as status.
+ * \param fCallback Pointer to optional callback invoked on command end.
+ *                  NULL:    Function return until command finished.
+ *                  Pointer: Return immediately and invoke callback at end.
+ *                  Callback argument is fixed to a pointer to SdCard instance.
+ * \return the command transfer result (see SendMciCommand).
+ */
+uint8_t MmcCmd35(SdCard *pSd,
+                 uint32_t address,
+                 uint32_t *pStatus,
+                 SdmmcCallback fCallback)
+{
+    MciCmd *pCommand = &(mciCmd);
+
+    TRACE_DEBUG("Cmd35()\n\r");
+    ResetMciCommand(pCommand);
+
+    /* Fill command information */
+    pCommand->cmd = MMC_ERASE_GROUP_START;
+    pCommand->arg = address;
+    pCommand->resType = 1;
+    pCommand->pResp = pStatus;
+
+    /* Send command */
+    return SendMciCommand(pSd, fCallback);
+}
+
+/**
+ * Sets the address of the last erase group within a continuous range to
+ * be selected for erase.
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param address   Data address on SD/MMC card (byte or block address, as for Cmd24).
+ * \param pStatus   Pointer to buffer for command response as status.
+ * \param fCallback Pointer to optional callback invoked on command end.
+ *                  NULL:    Function return until command finished.
+ *                  Pointer: Return immediately and invoke callback at end.
+ *                  Callback argument is fixed to a pointer to SdCard instance.
+ * \return the command transfer result (see SendMciCommand).
+ */
+uint8_t MmcCmd36(SdCard *pSd,
+                 uint32_t address,
+                 uint32_t *pStatus,
+                 SdmmcCallback fCallback)
+{
+    MciCmd *pCommand = &(mciCmd);
+
+    TRACE_DEBUG("Cmd36()\n\r");
+    ResetMciCommand(pCommand);
+
+    /* Fill command information */
+    pCommand->cmd = MMC_ERASE_GROUP_END;
+    pCommand->arg = address;
+    pCommand->resType = 1;
+    pCommand->pResp = pStatus;
+
+    /* Send command */
+    return SendMciCommand(pSd, fCallback);
+}
+
+/**
+ * Erases all previously selected write blocks (or erase groups on MMC).
+ * The command returns when the card is no longer busy.
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param pStatus   Pointer to buffer for command response as status.
+ * \param fCallback Pointer to optional callback invoked on command end.
+ *                  NULL:    Function return until command finished.
+ *                  Pointer: Return immediately and invoke callback at end.
+ *                  Callback argument is fixed to a pointer to SdCard instance.
+ * \return the command transfer result (see SendMciCommand).
+ */
+uint8_t SdmmcCmd38(SdCard *pSd,
+                   uint32_t *pStatus,
+                   SdmmcCallback fCallback)
+{
+    MciCmd *pCommand = &(mciCmd);
+
+    TRACE_DEBUG("Cmd38()\n\r");
+    ResetMciCommand(pCommand);
+
+    /* Fill command information */
+    pCommand->cmd = SDMMC_ERASE;
+    pCommand->resType = 1;
+    pCommand->busyCheck = 1;
+    pCommand->pResp = pStatus;
+
+    /* Send command */
+    return SendMciCommand(pSd, fCallback);
+}
+
 /**
  * Indicates to the card that the next command is an application specific
  * command rather than a standard command.
@@ -1794,6 +1985,39 @@ uint8_t SdAcmd13(SdCard *pSd,
     return error;
 }
 
+/**
+ * Sets the number of write blocks to be pre-erased before writing, to speed
+ * up the next multiple block write command.
+ * Should be invoked after SdmmcCmd55().
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param nbBlocks  Number of blocks to pre-erase (23 bits, 0 for 1 block).
+ * \param pStatus   Pointer to buffer for command response as status.
+ * \param fCallback Pointer to optional callback invoked on command end.
+ *                  NULL:    Function return until command finished.
+ *                  Pointer: Return immediately and invoke callback at end.
+ *                  Callback argument is fixed to a pointer to SdCard instance.
+ * \return the command transfer result (see SendMciCommand).
+ */
+uint8_t SdAcmd23(SdCard *pSd,
+                 uint32_t nbBlocks,
+                 uint32_t *pStatus,
+                 SdmmcCallback fCallback)
+{
+    MciCmd *pCommand = &(mciCmd);
+
+    TRACE_DEBUG( "Acmd23()\n\r" ) ;
+    ResetMciCommand(pCommand);
+
+    /* Fill command information */
+    pCommand->cmd = SD_SET_WR_BLK_ERASE_COUNT;
+    pCommand->arg = nbBlocks & 0x7FFFFF;
+    pCommand->resType = 1;
+    pCommand->pResp = pStatus;
+
+    /* Send command */
+    return SendMciCommand(pSd, fCallback);
+}
+
 /**
  * Asks to all cards to send their operations conditions.
  * Returns the command transfer result (see SendMciCommand).
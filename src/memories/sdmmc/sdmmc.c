@@ -576,8 +576,25 @@ static uint8_t Acmd13(SdCard *pSd, uint32_t *pSdSTAT)
 }
 
 /**
- * Asks to all cards to send their operations conditions.
- * Returns the command transfer result (see SendCommand).
+ * Sets the number of blocks to pre-erase before the next multiple block
+ * write. Can be sent to a card only in 'tran_state'.
+ */
+static uint8_t Acmd23(SdCard *pSd, uint32_t nbBlocks)
+{
+    uint8_t error;
+    error = SdmmcCmd55(pSd, CARD_ADDR(pSd), NULL);
+    if (error) {
+        TRACE_ERROR("Acmd23.cmd55:%d\n\r", error);
+        return error;
+    }
+    return SdAcmd23(pSd, nbBlocks, NULL, NULL);
+}
+
+/**
+ * Asks to all cards to send their operations conditions, once.
+ * Returns the command transfer result (see SendCommand), or SDMMC_ERROR_BUSY
+ * while the card is still in its power-up sequence: the command is then sent
+ * again by the next call.
  * \param pSd  Pointer to a SD card driver instance.
  * \param hcs  Shall be true if Host support High capacity.
  * \param pCCS  Set the pointed flag to 1 if hcs != 0 and SD OCR CCS flag is set.
@@ -586,21 +603,23 @@ static uint8_t Acmd41(SdCard *pSd, uint8_t hcs, uint8_t *pCCS)
 {
     uint8_t error;
     uint32_t arg;
-    do {
-        error = SdmmcCmd55(pSd, 0, NULL);
-        if (error) {
-            TRACE_ERROR("Acmd41.cmd55:%d\n\r", error);
-            return error;
-        }
-        arg = SDMMC_HOST_VOLTAGE_RANGE;
-        if (hcs) arg |= OCR_SD_CCS;
-        error = SdAcmd41(pSd, &arg, NULL);
-        if (error) {
-            TRACE_ERROR("Acmd41.cmd41:%d\n\r", error);
-            return error;
-        }
-        *pCCS = ((arg & OCR_SD_CCS)!=0);
-    } while ((arg & OCR_POWER_UP_BUSY) != OCR_POWER_UP_BUSY);
+
+    error = SdmmcCmd55(pSd, 0, NULL);
+    if (error) {
+        TRACE_ERROR("Acmd41.cmd55:%d\n\r", error);
+        return error;
+    }
+    arg = SDMMC_HOST_VOLTAGE_RANGE;
+    if (hcs) arg |= OCR_SD_CCS;
+    error = SdAcmd41(pSd, &arg, NULL);
+    if (error) {
+        TRACE_ERROR("Acmd41.cmd41:%d\n\r", error);
+        return error;
+    }
+    *pCCS = ((arg & OCR_SD_CCS)!=0);
+    if ((arg & OCR_POWER_UP_BUSY) != OCR_POWER_UP_BUSY) {
+        return SDMMC_ERROR_BUSY;
+    }
     return 0;
 }
 
@@ -1225,19 +1244,14 @@ static uint8_t SdMmcDesideBuswidth(SdCard *pSd)
 }
 
 /**
- * \brief Run the SD/MMC/SDIO Mode initialization sequence.
- * This function runs the initialization procedure and the identification
- * process. Then it leaves the card in ready state. The following procedure must
- * check the card type and continue to put the card into tran(for memory card)
- * or cmd(for io card) state for data exchange.
+ * \brief Start the SD/MMC/SDIO Mode initialization sequence.
+ * This function resets the card and checks its operating voltage (CMD8), the
+ * identification is then run by SdMmcIdentify().
  * \param pSd  Pointer to a SD card driver instance.
  * \return 0 if successful; otherwise returns an \ref sdmmc_rc "SD_ERROR code".
  */
-static uint8_t SdMmcIdentify(SdCard *pSd)
+static uint8_t SdMmcIdentifyStart(SdCard *pSd)
 {
-    uint8_t mem = 0, io = 0, f8 = 0, mp = 1, ccs = 0;
-    uint8_t  isHdSupport = 0;
-    uint32_t status;
     uint8_t error;
     /* Reset HC to default HS and BusMode */
     SdmmcEnableHsMode(pSd, 0);
@@ -1410,10 +1424,11 @@ static uint8_t SdMmcIdentify(SdCard *pSd)
      * supports supplied voltage. The version 2.00 host shall issue CMD8 and
      * verify voltage before card initialization.
      * The host that does not support CMD8 shall supply high voltage range... */
+    pSd->hcs = 0;
     error = SdCmd8(pSd, 1, NULL);
     if (error == 0)
     {
-    	f8 = 1;
+    	pSd->hcs = 1;
     }
     else if (error != SDMMC_ERROR_NORESPONSE)
     {
@@ -1427,6 +1442,26 @@ static uint8_t SdMmcIdentify(SdCard *pSd)
         TRACE_WARNING("SdMmcIdentify.Cmd8: %u - Good\n\r", error)
     }
 
+    return 0;
+}
+
+/**
+ * \brief Run one step of the SD/MMC/SDIO identification process, started by
+ * SdMmcIdentifyStart(): the card is polled once with ACMD41 until it leaves
+ * its power-up sequence. Then it leaves the card in ready state. The following
+ * procedure must check the card type and continue to put the card into
+ * tran(for memory card) or cmd(for io card) state for data exchange.
+ * \param pSd  Pointer to a SD card driver instance.
+ * \return 0 if successful; SDMMC_ERROR_BUSY while the card powers up;
+ * otherwise returns an \ref sdmmc_rc "SD_ERROR code".
+ */
+static uint8_t SdMmcIdentify(SdCard *pSd)
+{
+    uint8_t mem = 0, io = 0, mp = 1, ccs = 0;
+    uint8_t  isHdSupport = 0;
+    uint32_t status;
+    uint8_t error;
+
     /* CMD5 is newly added for SDIO initialize & power on */
     status = 0;
     mp = 1;
@@ -1458,7 +1493,10 @@ static uint8_t SdMmcIdentify(SdCard *pSd)
     /* Has memory: SD/MMC/COMBO */
     if (mp) {
         /* Try SD memory initialize */
-        error = Acmd41(pSd, f8, &ccs);
+        error = Acmd41(pSd, pSd->hcs, &ccs);
+        if (error == SDMMC_ERROR_BUSY) {
+            return error;
+        }
         if (error) {
             unsigned int cmd1Retries = 10000;
             TRACE_DEBUG("SdMmcIdentify.Acmd41: %u, try MMC\n\r", error);
@@ -1635,7 +1673,9 @@ static uint8_t SdMmcEnum(SdCard *pSd)
  * \param address  Address of the block to read.
  * \param pData    Data buffer whose size is at least the block size, it can
  *            be 1,2 or 4-bytes aligned when used with DMA.
- * \param length   Number of blocks to be read.
+ * \param length   Number of blocks to be read. Runs longer than
+ *                  SDMMC_MAX_XFR_SIZE bytes are streamed as several data
+ *                  phases of the same open-ended CMD18.
  * \param pCallback Pointer to callback function that invoked when read done.
  *                  0 to start a blocked read.
  * \param pArgs     Pointer to callback function arguments.
@@ -1643,30 +1683,44 @@ static uint8_t SdMmcEnum(SdCard *pSd)
 uint8_t SD_Read(SdCard        *pSd,
                 uint32_t      address,
                 void          *pData,
-                uint16_t      length,
+                uint32_t      length,
                 SdmmcCallback pCallback,
                 void          *pArgs)
 {
+    uint8_t *pBuffer = (uint8_t*)pData;
+    uint32_t maxBlocks = SDMMC_MAX_XFR_SIZE / BLOCK_SIZE(pSd);
+    uint32_t nbBlocks;
     uint8_t error;
+    PROF_SCOPE(PROF_SD_READ);
 
     assert( pSd != NULL ) ;
     assert( pData != NULL ) ;
 
+    TRACE_DEBUG("SDrd(%u,%u)\n\r", address, length);
+
     if (   pSd->state != SD_STATE_READ
         || pSd->preBlock + 1 != address ) {
         /* Start infinite block reading */
         error = MoveToTransferState(pSd, address, 0, 0, 1);
     }
     else    error = 0;
-    if (!error) {
+
+    /* Only the last data phase completes asynchronously */
+    while (!error && length) {
+        nbBlocks = (length > maxBlocks) ? maxBlocks : length;
+        length -= nbBlocks;
         pSd->state = SD_STATE_READ;
-        pSd->preBlock = address + (length - 1);
-        error = SdmmcRead(pSd, BLOCK_SIZE(pSd), length, pData,
-                          pCallback, pArgs);
+        pSd->preBlock = address + (nbBlocks - 1);
+        error = SdmmcRead(pSd, BLOCK_SIZE(pSd), nbBlocks, pBuffer,
+                          length ? 0 : pCallback, pArgs);
+        address += nbBlocks;
+        pBuffer += nbBlocks * BLOCK_SIZE(pSd);
+    }
+    if (error) {
+        TRACE_ERROR("SDrd(%u):%u\n\r", address, error);
     }
-    TRACE_DEBUG("SDrd(%u,%u):%u\n\r", address, length, error);
 
-    return 0;
+    return error;
 }
 
 /**
@@ -1678,7 +1732,9 @@ uint8_t SD_Read(SdCard        *pSd,
  * \param address  Address of the block to read.
  * \param pData    Data buffer whose size is at least the block size, it can
  *            be 1,2 or 4-bytes aligned when used with DMA.
- * \param length   Number of blocks to be read.
+ * \param length   Number of blocks to be written. Runs longer than
+ *                  SDMMC_MAX_XFR_SIZE bytes are streamed as several data
+ *                  phases of the same open-ended CMD25.
  * \param pCallback Pointer to callback function that invoked when read done.
  *                  0 to start a blocked read.
  * \param pArgs     Pointer to callback function arguments.
@@ -1686,26 +1742,267 @@ uint8_t SD_Read(SdCard        *pSd,
 uint8_t SD_Write(SdCard        *pSd,
                  uint32_t      address,
                  void          *pData,
-                 uint16_t      length,
+                 uint32_t      length,
                  SdmmcCallback pCallback,
                  void          *pArgs)
 {
+    uint8_t *pBuffer = (uint8_t*)pData;
+    uint32_t maxBlocks = SDMMC_MAX_XFR_SIZE / BLOCK_SIZE(pSd);
+    uint32_t nbBlocks;
     uint8_t error = 0;
+    PROF_SCOPE(PROF_SD_WRITE);
 
     assert( pSd != NULL ) ;
 
+    TRACE_DEBUG("SDwr(%u,%u)\n\r", address, length);
+
     if (   pSd->state != SD_STATE_WRITE
         || pSd->preBlock + 1 != address ) {
         /* Start infinite block writing */
         error = MoveToTransferState(pSd, address, 0, 0, 0);
     }
-    if (!error) {
+
+    /* Only the last data phase completes asynchronously */
+    while (!error && length) {
+        nbBlocks = (length > maxBlocks) ? maxBlocks : length;
+        length -= nbBlocks;
+        pSd->state = SD_STATE_WRITE;
+        error = SdmmcWrite(pSd, BLOCK_SIZE(pSd), nbBlocks, pBuffer,
+                           length ? 0 : pCallback, pArgs);
+        pSd->preBlock = address + (nbBlocks - 1);
+        address += nbBlocks;
+        pBuffer += nbBlocks * BLOCK_SIZE(pSd);
+    }
+    if (error) {
+        TRACE_ERROR("SDwr(%u):%u\n\r", address, error);
+    }
+
+    return error;
+}
+
+/**
+ * Write a run of blocks as a new multiple block write, announcing its length
+ * with ACMD23 first so that SD cards pre-erase the destination (the hint is
+ * skipped on MMC and ignored if the card rejects it).
+ * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
+ * \param pSd      Pointer to a SD card driver instance.
+ * \param address  Address of the first block to write.
+ * \param pData    Data buffer.
+ * \param length   Number of blocks to be written.
+ */
+uint8_t SD_WritePreErased(SdCard   *pSd,
+                          uint32_t address,
+                          void     *pData,
+                          uint32_t length)
+{
+    uint32_t status;
+    uint8_t error;
+
+    assert( pSd != NULL ) ;
+
+    TRACE_DEBUG("SDwrPe(%u,%u)\n\r", address, length);
+
+    /* Close the current transfer: ACMD23 applies to the next CMD25 */
+    error = SD_StopTransfer(pSd);
+    if (error)
+    {
+        return error;
+    }
+
+    if ((pSd->cardType & CARD_TYPE_bmSDMMC) == CARD_TYPE_bmSD)
+    {
+        /* Wait for the end of the previous programming */
+        do
+        {
+            error = Cmd13(pSd, &status);
+            if (error)
+            {
+                TRACE_ERROR("SDwrPe.Cmd13: %d\n\r", error);
+                return error;
+            }
+        }
+        while ((status & STATUS_READY_FOR_DATA) == 0);
+
+        if (Acmd23(pSd, length))
+        {
+            TRACE_WARNING("SDwrPe.Acmd23 failed\n\r");
+        }
+    }
+
+    /* Start infinite block writing and stream the data: SD_Write() must see
+       the CMD25 just opened as its own, or it would restart it and the card
+       would spend the ACMD23 count on the empty transfer */
+    error = MoveToTransferState(pSd, address, 0, 0, 0);
+    if (!error)
+    {
         pSd->state = SD_STATE_WRITE;
-        error = SdmmcWrite(pSd, BLOCK_SIZE(pSd), length, pData,
-                           pCallback, pArgs);
-        pSd->preBlock = address + (length - 1);
+        pSd->preBlock = address - 1;
+        error = SD_Write(pSd, address, pData, length, 0, 0);
+    }
+
+    return error;
+}
+
+/**
+ * Stop the open-ended read or write transfer left by SD_Read()/SD_Write(), so
+ * that the card programs the last blocks received.
+ * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
+ * \param pSd Pointer to SdCard instance.
+ */
+uint8_t SD_StopTransfer(SdCard *pSd)
+{
+    uint32_t status;
+    uint8_t error;
+
+    assert( pSd != NULL ) ;
+
+    if ( (pSd->state == SD_STATE_READ) || (pSd->state == SD_STATE_WRITE) )
+    {
+        error = Cmd12(pSd, &status);
+        if (error)
+        {
+            TRACE_ERROR("SDstop.Cmd12: st%x, er%d\n\r", pSd->state, error);
+            return error;
+        }
+        pSd->state = SD_STATE_READY;
+    }
+    return 0;
+}
+
+/**
+ * Return the allocation unit (AU) size of a SD card in blocks, as reported
+ * by the SD Status (ACMD13), or 0 if it is unknown (MMC, old SD cards).
+ * \param pSd Pointer to SdCard instance.
+ */
+uint32_t SD_GetAuSizeBlocks(SdCard *pSd)
+{
+    uint32_t au;
+
+    assert( pSd != NULL ) ;
+
+    if (   ((pSd->cardType & CARD_TYPE_bmSDMMC) != CARD_TYPE_bmSD)
+        || !(pSd->optCmdBitMap & SD_ACMD13_SUPPORT) )
+    {
+        return 0;
+    }
+
+    au = SD_STAT_AU_SIZE(pSd);
+    if (au == 0)
+    {
+        return 0;
+    }
+    if (au <= SD_STAT_AU_SIZE_4M)
+    {
+        /* 16KB << (au - 1) */
+        return (16 * 1024 / SDMMC_BLOCK_SIZE) << (au - 1);
+    }
+    /* SD 3.00 sizes: 8, 12, 16, 24, 32 and 64 MB */
+    switch (au)
+    {
+        case 0xA: return  8 * 2048;
+        case 0xB: return 12 * 2048;
+        case 0xC: return 16 * 2048;
+        case 0xD: return 24 * 2048;
+        case 0xE: return 32 * 2048;
+        default:  return 64 * 2048;
+    }
+}
+
+/**
+ * Return the unit in which erases should be aligned, in blocks: the AU of SD
+ * cards when known (erasing less makes the card copy the rest of the AU),
+ * otherwise the erase sector of the CSD; the erase group of MMC.
+ * \param pSd Pointer to SdCard instance.
+ */
+uint32_t SD_GetEraseUnitBlocks(SdCard *pSd)
+{
+    uint32_t unit;
+
+    assert( pSd != NULL ) ;
+
+    if ((pSd->cardType & CARD_TYPE_bmSDMMC) == CARD_TYPE_bmSD)
+    {
+        unit = SD_GetAuSizeBlocks(pSd);
+        if (unit == 0)
+        {
+            unit = SD_CSD_ERASE_BLK_EN(pSd) ? 1 : SD_CSD_SECTOR_SIZE(pSd) + 1;
+        }
+    }
+    else
+    {
+        unit = (MMC_CSD_ERASE_GRP_SIZE(pSd) + 1)
+               * (MMC_CSD_ERASE_GRP_MULT(pSd) + 1);
+    }
+    return unit;
+}
+
+/**
+ * Erase a range of blocks (CMD32/33/38 on SD, CMD35/36/38 on MMC). The range
+ * should be aligned on SD_GetEraseUnitBlocks(); the erased blocks read back
+ * as all 0 or all 1 (see SD_SCR_DATA_STAT_AFTER_ERASE).
+ * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
+ * \param pSd    Pointer to a SD card driver instance.
+ * \param start  First block to erase.
+ * \param end    Last block to erase.
+ */
+uint8_t SD_Erase(SdCard *pSd, uint32_t start, uint32_t end)
+{
+    uint32_t status;
+    uint8_t error;
+
+    assert( pSd != NULL ) ;
+    assert( start <= end ) ;
+
+    TRACE_DEBUG("SDerase(%u,%u)\n\r", start, end);
+
+    error = SD_StopTransfer(pSd);
+    if (error)
+    {
+        return error;
+    }
+
+    /* Wait for the end of the previous programming */
+    do
+    {
+        error = Cmd13(pSd, &status);
+        if (error)
+        {
+            TRACE_ERROR("SDerase.Cmd13: %d\n\r", error);
+            return error;
+        }
+    }
+    while ((status & STATUS_READY_FOR_DATA) == 0);
+
+    if ((pSd->cardType & CARD_TYPE_bmSDMMC) == CARD_TYPE_bmSD)
+    {
+        error = SdCmd32(pSd, SD_ADDRESS(pSd, start), &status, NULL);
+        if (!error)
+        {
+            error = SdCmd33(pSd, SD_ADDRESS(pSd, end), &status, NULL);
+        }
+    }
+    else
+    {
+        error = MmcCmd35(pSd, SD_ADDRESS(pSd, start), &status, NULL);
+        if (!error)
+        {
+            error = MmcCmd36(pSd, SD_ADDRESS(pSd, end), &status, NULL);
+        }
+    }
+    if (!error)
+    {
+        error = SdmmcCmd38(pSd, &status, NULL);
+    }
+    if (error)
+    {
+        TRACE_ERROR("SDerase(%u,%u):%u\n\r", start, end, error);
+        return error;
+    }
+    if (status & (STATUS_ERASE_PARAM | STATUS_ERASE_SEQ_ERROR))
+    {
+        TRACE_ERROR("SDerase.stat: %x\n\r", status);
+        return SDMMC_ERROR;
     }
-    TRACE_DEBUG("SDwr(%u,%u):%u\n\r", address, length, error);
 
     return 0;
 }
@@ -1865,18 +2162,18 @@ uint8_t SD_WriteBlocks(SdCard *pSd,
 }
 
 /**
- * Run the SDcard initialization sequence. This function runs the
- * initialisation procedure and the identification process, then it sets the
- * SD card in transfer state to set the block length and the bus width.
+ * Start the SDcard initialization sequence: power on and reset of the card.
+ * The identification is then run by SD_InitStep(), without waiting for the
+ * card power-up.
  * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
  * \param pSd  Pointer to a SD card driver instance.
  * \param pSdDriver  Pointer to SD driver already initialized.
  */
-uint8_t SD_Init(SdCard *pSd, void *pSdDriver)
+uint8_t SD_InitStart(SdCard *pSd, void *pSdDriver)
 {
     uint8_t  error;
-    uint32_t clock;
     uint32_t i;
+    PROF_SCOPE(PROF_SD_INIT);
 
     /* Initialize SdCard structure */
     pSd->pSdDriver = pSdDriver;
@@ -1921,7 +2218,33 @@ uint8_t SD_Init(SdCard *pSd, void *pSdDriver)
      * The cards are initialized with a default relative card address
      * (RCA=0x0000) and with a default driver stage register setting
      * (lowest speed, highest driving current capability). */
+    error = SdMmcIdentifyStart(pSd);
+    if (error) {
+        TRACE_ERROR("SD_Init.Identify: %u\n\r", error);
+    }
+    return error;
+}
+
+/**
+ * Run one step of the SDcard initialization sequence started by
+ * SD_InitStart(): the card is polled once for the end of its power-up. Once it
+ * is identified, it is set in transfer state to set the block length and the
+ * bus width.
+ * \return 0 if the card is initialized; SDMMC_ERROR_BUSY while it powers up,
+ * SD_InitStep() must then be called again; otherwise returns an
+ * \ref sdmmc_rc "error code".
+ * \param pSd  Pointer to a SD card driver instance.
+ */
+uint8_t SD_InitStep(SdCard *pSd)
+{
+    uint8_t  error;
+    uint32_t clock;
+    PROF_SCOPE(PROF_SD_INIT);
+
     error = SdMmcIdentify(pSd);
+    if (error == SDMMC_ERROR_BUSY) {
+        return error;
+    }
     if (error) {
         TRACE_ERROR("SD_Init.Identify: %u\n\r", error);
         return error;
@@ -1988,6 +2311,28 @@ uint8_t SD_Init(SdCard *pSd, void *pSdDriver)
     return 0;
 }
 
+/**
+ * Run the SDcard initialization sequence. This function runs the
+ * initialisation procedure and the identification process, then it sets the
+ * SD card in transfer state to set the block length and the bus width.
+ * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
+ * \param pSd  Pointer to a SD card driver instance.
+ * \param pSdDriver  Pointer to SD driver already initialized.
+ */
+uint8_t SD_Init(SdCard *pSd, void *pSdDriver)
+{
+    uint8_t error;
+
+    error = SD_InitStart(pSd, pSdDriver);
+    if (error) {
+        return error;
+    }
+    do {
+        error = SD_InitStep(pSd);
+    } while (error == SDMMC_ERROR_BUSY);
+    return error;
+}
+
 /**
  * Return type of the card.
  * \param pSd Pointer to SdCard instance.
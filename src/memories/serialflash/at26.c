@@ -0,0 +1,212 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !Purpose
+///
+/// Implementation of the AT26 serial firmware flash command layer: builds
+/// the command and address bytes of each operation and hands them to the
+/// SPI command driver (see spid.h). The layer does not access any
+/// peripheral, so the host tests run it against a flash model.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "at26.h"
+
+#include <string.h>
+
+//------------------------------------------------------------------------------
+//         Internal variables
+//------------------------------------------------------------------------------
+
+/// Supported devices, JEDEC ID as read (manufacturer in the low byte). They
+/// all erase by 4K blocks, the unit used by the serial flash media.
+static const At26Desc at26Devices[] = {
+
+    // name         JEDEC ID    size              page  block      erase command
+    {"AT26F004",    0x0000041F, 512 * 1024,       256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+    {"AT26DF041",   0x0000441F, 512 * 1024,       256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+    {"AT26DF081A",  0x0001451F, 1 * 1024 * 1024,  256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+    {"AT26DF161",   0x0000461F, 2 * 1024 * 1024,  256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+    {"AT26DF161A",  0x0001461F, 2 * 1024 * 1024,  256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+    {"AT26DF321",   0x0000471F, 4 * 1024 * 1024,  256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+    {"AT25DF641",   0x0000481F, 8 * 1024 * 1024,  256,  4 * 1024,  AT26_BLOCK_ERASE_4K},
+};
+
+//------------------------------------------------------------------------------
+//         Internal functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Returns 1 if the data phase of a command is read from the device.
+/// \param cmd  Command code.
+//------------------------------------------------------------------------------
+static unsigned char AT26_IsReadCommand(unsigned char cmd)
+{
+    return (cmd == AT26_READ_ARRAY)
+           || (cmd == AT26_READ_ARRAY_LF)
+           || (cmd == AT26_READ_STATUS)
+           || (cmd == AT26_READ_JEDEC_ID)
+           || (cmd == AT26_READ_SECTOR_PROT);
+}
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Initializes an AT26 driver instance with the given SPI driver and chip
+/// select value.
+/// \param pAt26  Pointer to an AT26 driver instance.
+/// \param pSpid  Pointer to an SPI driver instance.
+/// \param cs  Chip select value to communicate with the serial flash.
+//------------------------------------------------------------------------------
+void AT26_Configure(At26 *pAt26, Spid *pSpid, unsigned char cs)
+{
+    SpidCmd *pCommand;
+
+    pAt26->pSpid = pSpid;
+    pAt26->pDesc = 0;
+    memset(pAt26->pCmdBuffer, 0, sizeof(pAt26->pCmdBuffer));
+
+    pCommand = &(pAt26->command);
+    pCommand->pCmd = (unsigned char *) pAt26->pCmdBuffer;
+    pCommand->cmdSize = 0;
+    pCommand->dataIn = 0;
+    pCommand->pData = 0;
+    pCommand->dataSize = 0;
+    pCommand->spiCs = cs;
+    pCommand->callback = 0;
+    pCommand->pArgument = 0;
+}
+
+//------------------------------------------------------------------------------
+/// Returns 1 if the serial flash driver is currently executing a command;
+/// otherwise returns 0.
+/// \param pAt26  Pointer to an At26 driver instance.
+//------------------------------------------------------------------------------
+unsigned char AT26_IsBusy(At26 *pAt26)
+{
+    return SPID_IsBusy(pAt26->pSpid);
+}
+
+//------------------------------------------------------------------------------
+/// Sends a command to the serial flash through the SPI. The command is made
+/// of the command code, then the address on 3 bytes (most significant
+/// first) if cmdSize is 4 or more, then dummy bytes up to cmdSize (fast
+/// read). The data phase is read from the device or written to it,
+/// depending on the command code.
+/// Returns 0 if the command is started, AT26_ERROR_BUSY if a command is in
+/// progress or AT26_ERROR_SPI if the SPI driver refuses it.
+/// \param pAt26  Pointer to an At26 driver instance.
+/// \param cmd  Command code.
+/// \param cmdSize  Size of command code + address + dummy bytes.
+/// \param pData  Data buffer.
+/// \param dataSize  Number of bytes to send/receive.
+/// \param address  Address to transmit.
+/// \param callback  Optional user-provided callback to invoke at end of transfer.
+/// \param pArgument  Optional argument to the callback function.
+//------------------------------------------------------------------------------
+unsigned char AT26_SendCommand(
+    At26 *pAt26,
+    unsigned char cmd,
+    unsigned char cmdSize,
+    unsigned char *pData,
+    unsigned int dataSize,
+    unsigned int address,
+    SpidCallback callback,
+    void *pArgument)
+{
+    SpidCmd *pCommand = &(pAt26->command);
+    unsigned char *pCmdBuffer = (unsigned char *) pAt26->pCmdBuffer;
+    unsigned char i;
+
+    // Check if the SPI driver is available
+    if (AT26_IsBusy(pAt26)) {
+
+        return AT26_ERROR_BUSY;
+    }
+
+    // Command code, address and dummy bytes
+    pCmdBuffer[0] = cmd;
+    if (cmdSize >= 4) {
+
+        pCmdBuffer[1] = (unsigned char) (address >> 16);
+        pCmdBuffer[2] = (unsigned char) (address >> 8);
+        pCmdBuffer[3] = (unsigned char) address;
+    }
+    for (i = 4; i < cmdSize; i++) {
+
+        pCmdBuffer[i] = 0;
+    }
+
+    // Update the SPI transfer descriptor
+    pCommand->cmdSize = cmdSize;
+    pCommand->dataIn = AT26_IsReadCommand(cmd);
+    pCommand->pData = pData;
+    pCommand->dataSize = dataSize;
+    pCommand->callback = callback;
+    pCommand->pArgument = pArgument;
+
+    if (SPID_SendCommand(pAt26->pSpid, pCommand)) {
+
+        return AT26_ERROR_SPI;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Tries to detect a serial firmware flash device given its JEDEC identifier.
+/// The JEDEC id can be retrieved by sending the correct command to the device.
+/// Returns the corresponding AT26 descriptor if found; otherwise returns 0.
+/// \param pAt26  Pointer to an AT26 driver instance.
+/// \param jedecId  JEDEC identifier of a device.
+//------------------------------------------------------------------------------
+const At26Desc * AT26_FindDevice(At26 *pAt26, unsigned int jedecId)
+{
+    unsigned int i;
+
+    pAt26->pDesc = 0;
+    for (i = 0; i < sizeof(at26Devices) / sizeof(at26Devices[0]); i++) {
+
+        if (at26Devices[i].jedecId == (jedecId & 0x00FFFFFF)) {
+
+            pAt26->pDesc = &(at26Devices[i]);
+            break;
+        }
+    }
+
+    return pAt26->pDesc;
+}
@@ -0,0 +1,335 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2008, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+//------------------------------------------------------------------------------
+/// \unit
+///
+/// !Purpose
+///
+/// Implementation of the AT26 serial flash operations on top of the command
+/// layer (at26.c). Every function returns once the device is done; the reads
+/// are a single fast read (AT26_READ_ARRAY) whatever their size, the SPI
+/// command driver streaming the data phase with the DMAC.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//         Headers
+//------------------------------------------------------------------------------
+
+#include "at26d.h"
+
+//------------------------------------------------------------------------------
+//         Local definitions
+//------------------------------------------------------------------------------
+
+/// Size of the fast read command: code, address, one dummy byte
+#define AT26D_FAST_READ_SIZE    5
+
+//------------------------------------------------------------------------------
+//         Local functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Records the status of a transfer (SPI command driver callback).
+//------------------------------------------------------------------------------
+static void AT26D_Callback(unsigned char status, void *pArgument)
+{
+    *(unsigned char *) pArgument = status;
+}
+
+//------------------------------------------------------------------------------
+/// Sends a command and waits for the end of its transfer.
+/// Returns 0 if successful, AT26_ERROR_SPI otherwise.
+//------------------------------------------------------------------------------
+static unsigned char AT26D_Command(
+    At26 *pAt26,
+    unsigned char cmd,
+    unsigned char cmdSize,
+    unsigned char *pData,
+    unsigned int dataSize,
+    unsigned int address)
+{
+    unsigned char status = 0;
+
+    if (AT26_SendCommand(pAt26, cmd, cmdSize, pData, dataSize, address, AT26D_Callback, &status)) {
+
+        return AT26_ERROR_SPI;
+    }
+    while (AT26_IsBusy(pAt26));
+
+    return status ? AT26_ERROR_SPI : 0;
+}
+
+//------------------------------------------------------------------------------
+/// Reads and returns the status register of the serial flash.
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+static unsigned char AT26D_ReadStatus(At26 *pAt26)
+{
+    unsigned char status = 0xFF;
+
+    AT26D_Command(pAt26, AT26_READ_STATUS, 1, &status, 1, 0);
+
+    return status;
+}
+
+//------------------------------------------------------------------------------
+/// Writes the given value in the status register of the serial flash device.
+/// \param pAt26  Pointer to an AT26 driver instance.
+/// \param status  Status to write.
+//------------------------------------------------------------------------------
+static void AT26D_WriteStatus(At26 *pAt26, unsigned char status)
+{
+    AT26D_Command(pAt26, AT26_WRITE_STATUS, 1, &status, 1, 0);
+}
+
+//------------------------------------------------------------------------------
+/// Waits for the end of an erase or program operation and returns the last
+/// status read.
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+static unsigned char AT26D_WaitStatus(At26 *pAt26)
+{
+    unsigned char status;
+
+    do {
+        status = AT26D_ReadStatus(pAt26);
+    } while ((status & AT26_STATUS_RDYBSY) == AT26_STATUS_RDYBSY_BUSY);
+
+    return status;
+}
+
+//------------------------------------------------------------------------------
+/// Enables critical writes operation on a serial flash device, such as sector
+/// protection, status register, etc.
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+static void AT26D_EnableWrite(At26 *pAt26)
+{
+    AT26D_Command(pAt26, AT26_WRITE_ENABLE, 1, 0, 0, 0);
+}
+
+//------------------------------------------------------------------------------
+//         Exported functions
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+/// Waits for the serial flash device to become ready to accept new commands.
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+void AT26D_WaitReady(At26 *pAt26)
+{
+    AT26D_WaitStatus(pAt26);
+}
+
+//------------------------------------------------------------------------------
+/// Reads and returns the serial flash device ID (manufacturer in the low
+/// byte, as expected by AT26_FindDevice()).
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+unsigned int AT26D_ReadJedecId(At26 *pAt26)
+{
+    unsigned char id[3] = {0, 0, 0};
+
+    AT26D_Command(pAt26, AT26_READ_JEDEC_ID, 1, id, 3, 0);
+
+    return id[0] | (id[1] << 8) | (id[2] << 16);
+}
+
+//------------------------------------------------------------------------------
+/// Unprotects the contents of the serial flash device (the sectors are
+/// protected at power-up). The sector protection registers are unlocked
+/// first if the write protect pin allows it.
+/// Returns 0 if the device has been unprotected; otherwise returns
+/// AT26_ERROR_PROTECTED.
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+unsigned char AT26D_Unprotect(At26 *pAt26)
+{
+    unsigned char status;
+
+    status = AT26D_ReadStatus(pAt26);
+    if ((status & AT26_STATUS_SWP) == AT26_STATUS_SWP_PROTNONE) {
+
+        return 0;
+    }
+
+    // Unlock the sector protection registers
+    if ((status & AT26_STATUS_SPRL) == AT26_STATUS_SPRL_LOCKED) {
+
+        if ((status & AT26_STATUS_WPP) == AT26_STATUS_WPP_ASSERTED) {
+
+            return AT26_ERROR_PROTECTED;
+        }
+        AT26D_EnableWrite(pAt26);
+        AT26D_WriteStatus(pAt26, 0);
+    }
+
+    // Global unprotect
+    AT26D_EnableWrite(pAt26);
+    AT26D_WriteStatus(pAt26, 0);
+
+    status = AT26D_ReadStatus(pAt26);
+    if ((status & AT26_STATUS_SWP) != AT26_STATUS_SWP_PROTNONE) {
+
+        return AT26_ERROR_PROTECTED;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Erases all the content of the memory chip.
+/// Returns 0 if successful, AT26_ERROR_PROTECTED if the device is protected
+/// or AT26_ERROR_PROGRAM if the erase failed.
+/// \param pAt26  Pointer to an AT26 driver instance.
+//------------------------------------------------------------------------------
+unsigned char AT26D_EraseChip(At26 *pAt26)
+{
+    unsigned char status;
+
+    status = AT26D_ReadStatus(pAt26);
+    if ((status & AT26_STATUS_SWP) != AT26_STATUS_SWP_PROTNONE) {
+
+        return AT26_ERROR_PROTECTED;
+    }
+
+    AT26D_EnableWrite(pAt26);
+    if (AT26D_Command(pAt26, AT26_CHIP_ERASE_2, 1, 0, 0, 0)) {
+
+        return AT26_ERROR_SPI;
+    }
+
+    status = AT26D_WaitStatus(pAt26);
+    if ((status & AT26_STATUS_EPE) == AT26_STATUS_EPE_ERROR) {
+
+        return AT26_ERROR_PROGRAM;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Erases the block (AT26_BlockSize() bytes) containing the given address.
+/// Returns 0 if successful, AT26_ERROR_PROTECTED if the device is protected
+/// or AT26_ERROR_PROGRAM if the erase failed.
+/// \param pAt26  Pointer to an AT26 driver instance.
+/// \param address  Address of the block to erase.
+//------------------------------------------------------------------------------
+unsigned char AT26D_EraseBlock(At26 *pAt26, unsigned int address)
+{
+    unsigned char status;
+
+    status = AT26D_ReadStatus(pAt26);
+    if ((status & AT26_STATUS_SWP) != AT26_STATUS_SWP_PROTNONE) {
+
+        return AT26_ERROR_PROTECTED;
+    }
+
+    AT26D_EnableWrite(pAt26);
+    if (AT26D_Command(pAt26, AT26_BlockEraseCmd(pAt26), 4, 0, 0, address)) {
+
+        return AT26_ERROR_SPI;
+    }
+
+    status = AT26D_WaitStatus(pAt26);
+    if ((status & AT26_STATUS_EPE) == AT26_STATUS_EPE_ERROR) {
+
+        return AT26_ERROR_PROGRAM;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Writes data at the specified address on the serial firmware flash, one
+/// page program command per page crossed. The area must have been erased.
+/// Returns 0 if successful; otherwise, returns AT26_ERROR_PROGRAM if there
+/// has been an error during the data programming.
+/// \param pAt26  Pointer to an AT26 driver instance.
+/// \param pData  Data buffer.
+/// \param size  Number of bytes in buffer.
+/// \param address  Write address.
+//------------------------------------------------------------------------------
+unsigned char AT26D_Write(
+    At26 *pAt26,
+    unsigned char *pData,
+    unsigned int size,
+    unsigned int address)
+{
+    unsigned int pageSize = AT26_PageSize(pAt26);
+    unsigned int writeSize;
+    unsigned char status;
+
+    while (size > 0) {
+
+        // Up to the end of the page
+        writeSize = pageSize - (address % pageSize);
+        if (writeSize > size) {
+
+            writeSize = size;
+        }
+
+        AT26D_EnableWrite(pAt26);
+        if (AT26D_Command(pAt26, AT26_BYTE_PAGE_PROGRAM, 4, pData, writeSize, address)) {
+
+            return AT26_ERROR_SPI;
+        }
+
+        status = AT26D_WaitStatus(pAt26);
+        if ((status & AT26_STATUS_EPE) == AT26_STATUS_EPE_ERROR) {
+
+            return AT26_ERROR_PROGRAM;
+        }
+
+        pData += writeSize;
+        size -= writeSize;
+        address += writeSize;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// Reads data from the specified address on the serial flash, with a single
+/// fast read command.
+/// Returns 0 if successful; otherwise, fails.
+/// \param pAt26  Pointer to an AT26 driver instance.
+/// \param pData  Data buffer.
+/// \param size  Number of bytes to read.
+/// \param address  Read address.
+//------------------------------------------------------------------------------
+unsigned char AT26D_Read(
+    At26 *pAt26,
+    unsigned char *pData,
+    unsigned int size,
+    unsigned int address)
+{
+    return AT26D_Command(pAt26, AT26_READ_ARRAY, AT26D_FAST_READ_SIZE, pData, size, address);
+}
@@ -0,0 +1,406 @@
+/**
+ * \file
+ *
+ * Implementation of the EMAC (Ethernet MAC 10/100) driver, polling mode.
+ *
+ * The receive ring belongs to the caller: the driver only points the EMAC at
+ * it, so that the caller can aim each descriptor at the buffer of its choice.
+ * The frames to send are copied in TX_BUFFERS transmit buffers, enough for
+ * the small frames of a boot protocol while the previous one is going out.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "chip.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Highest MDC frequency allowed by the IEEE 802.3 */
+#define EMAC_MDC_MAX            2500000
+
+/** Clause 22 management frame codes */
+#define EMAC_MAN_READ           2
+#define EMAC_MAN_WRITE          1
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+/** Transmit descriptors and buffers */
+static volatile EmacTxTDescriptor txTd[TX_BUFFERS] ;
+static uint8_t txBuffer[TX_BUFFERS][EMAC_TX_UNITSIZE] __attribute__ ((aligned (8))) ;
+
+/** Next transmit descriptor to fill */
+static uint32_t txHead ;
+
+/** Statistics accumulated since the last reset */
+static EmacStats emacStats ;
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Wait for the end of a management frame.
+ *
+ * \param pEmac   Pointer to the Emac instance.
+ * \param dwRetry Number of status reads before giving up, 0 to wait forever.
+ * \return 0 if the frame is done, 1 on timeout.
+ */
+static uint32_t _WaitPhy( Emac* pEmac, uint32_t dwRetry )
+{
+    uint32_t dwCount = 0 ;
+
+    while ( (pEmac->EMAC_NSR & EMAC_NSR_IDLE) == 0 )
+    {
+        if ( dwRetry && (++dwCount >= dwRetry) )
+        {
+            TRACE_ERROR( "EMAC: PHY management timeout\n\r" ) ;
+            return 1 ;
+        }
+    }
+
+    return 0 ;
+}
+
+/**
+ * \brief Account for the status of the transmit descriptors given back by the EMAC.
+ */
+static void _TxStatus( Emac* pEmac )
+{
+    uint32_t dwTsr = pEmac->EMAC_TSR ;
+
+    if ( dwTsr & EMAC_TSR_COMP )
+    {
+        emacStats.tx_comp++ ;
+    }
+    if ( dwTsr & EMAC_TSR_RLES )
+    {
+        emacStats.tx_errors++ ;
+    }
+    if ( dwTsr & EMAC_TSR_COL )
+    {
+        emacStats.collisions++ ;
+    }
+    if ( dwTsr & EMAC_TSR_BEX )
+    {
+        emacStats.tx_exausts++ ;
+    }
+    if ( dwTsr & EMAC_TSR_UND )
+    {
+        emacStats.tx_underruns++ ;
+    }
+    pEmac->EMAC_TSR = dwTsr & (EMAC_TSR_UBR | EMAC_TSR_COL | EMAC_TSR_RLES | EMAC_TSR_BEX | EMAC_TSR_COMP | EMAC_TSR_UND) ;
+}
+
+/*----------------------------------------------------------------------------
+ *        PHY Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Set the MDC clock divider for a master clock frequency.
+ *
+ * \param pEmac  Pointer to the Emac instance.
+ * \param dwMCk  Master clock frequency in Hz.
+ * \return 1 if successful, 0 if the master clock is too fast for the dividers.
+ */
+extern uint32_t EMAC_SetMdcClock( Emac* pEmac, uint32_t dwMCk )
+{
+    uint32_t dwClk ;
+
+    if ( dwMCk <= EMAC_MDC_MAX * 8 )
+    {
+        dwClk = EMAC_NCFGR_CLK_HCLK_8 ;
+    }
+    else if ( dwMCk <= EMAC_MDC_MAX * 16 )
+    {
+        dwClk = EMAC_NCFGR_CLK_HCLK_16 ;
+    }
+    else if ( dwMCk <= EMAC_MDC_MAX * 32 )
+    {
+        dwClk = EMAC_NCFGR_CLK_HCLK_32 ;
+    }
+    else if ( dwMCk <= EMAC_MDC_MAX * 64 )
+    {
+        dwClk = EMAC_NCFGR_CLK_HCLK_64 ;
+    }
+    else
+    {
+        TRACE_ERROR( "EMAC: master clock too fast for the MDC\n\r" ) ;
+        return 0 ;
+    }
+
+    pEmac->EMAC_NCFGR = (pEmac->EMAC_NCFGR & ~EMAC_NCFGR_CLK_Msk) | dwClk ;
+
+    return 1 ;
+}
+
+/**
+ * \brief Enable the management port.
+ */
+extern void EMAC_EnableMdio( Emac* pEmac )
+{
+    pEmac->EMAC_NCR |= EMAC_NCR_MPE ;
+}
+
+/**
+ * \brief Disable the management port.
+ */
+extern void EMAC_DisableMdio( Emac* pEmac )
+{
+    pEmac->EMAC_NCR &= ~EMAC_NCR_MPE ;
+}
+
+/**
+ * \brief Select the MII interface and enable its transceiver clock.
+ */
+extern void EMAC_EnableMII( Emac* pEmac )
+{
+    pEmac->EMAC_USRIO = EMAC_USRIO_CLKEN ;
+}
+
+/**
+ * \brief Select the RMII interface and enable its transceiver clock.
+ */
+extern void EMAC_EnableRMII( Emac* pEmac )
+{
+    pEmac->EMAC_USRIO = EMAC_USRIO_RMII | EMAC_USRIO_CLKEN ;
+}
+
+/**
+ * \brief Read a PHY register; the management port must be enabled.
+ *
+ * \param pEmac         Pointer to the Emac instance.
+ * \param dwPhyAddress  PHY address (0 to 31).
+ * \param dwAddress     Register address (0 to 31).
+ * \param pdwValue      Filled with the register value.
+ * \param dwRetry       Number of status reads before giving up, 0 to wait forever.
+ * \return 0 if successful, 1 on timeout.
+ */
+extern uint32_t EMAC_ReadPhy( Emac* pEmac, uint32_t dwPhyAddress, uint32_t dwAddress, uint32_t *pdwValue, uint32_t dwRetry )
+{
+    pEmac->EMAC_MAN = EMAC_MAN_SOF( 1 ) | EMAC_MAN_RW( EMAC_MAN_READ ) | EMAC_MAN_PHYA( dwPhyAddress )
+                    | EMAC_MAN_REGA( dwAddress ) | EMAC_MAN_CODE( 2 ) ;
+    if ( _WaitPhy( pEmac, dwRetry ) )
+    {
+        return 1 ;
+    }
+    *pdwValue = pEmac->EMAC_MAN & EMAC_MAN_DATA_Msk ;
+
+    return 0 ;
+}
+
+/**
+ * \brief Write a PHY register; the management port must be enabled.
+ *
+ * \param pEmac         Pointer to the Emac instance.
+ * \param dwPhyAddress  PHY address (0 to 31).
+ * \param dwAddress     Register address (0 to 31).
+ * \param dwValue       Value to write.
+ * \param dwRetry       Number of status reads before giving up, 0 to wait forever.
+ * \return 0 if successful, 1 on timeout.
+ */
+extern uint32_t EMAC_WritePhy( Emac* pEmac, uint32_t dwPhyAddress, uint32_t dwAddress, uint32_t dwValue, uint32_t dwRetry )
+{
+    pEmac->EMAC_MAN = EMAC_MAN_SOF( 1 ) | EMAC_MAN_RW( EMAC_MAN_WRITE ) | EMAC_MAN_PHYA( dwPhyAddress )
+                    | EMAC_MAN_REGA( dwAddress ) | EMAC_MAN_CODE( 2 ) | EMAC_MAN_DATA( dwValue ) ;
+
+    return _WaitPhy( pEmac, dwRetry ) ;
+}
+
+/**
+ * \brief Set the speed and duplex negotiated by the PHY.
+ *
+ * \param pEmac         Pointer to the Emac instance.
+ * \param dwSpeed       1 for 100 Mbit/s, 0 for 10 Mbit/s.
+ * \param dwFullduplex  1 for full duplex, 0 for half duplex.
+ */
+extern void EMAC_SetLinkSpeed( Emac* pEmac, uint32_t dwSpeed, uint32_t dwFullduplex )
+{
+    uint32_t dwCfg = pEmac->EMAC_NCFGR & ~(EMAC_NCFGR_SPD | EMAC_NCFGR_FD) ;
+
+    if ( dwSpeed )
+    {
+        dwCfg |= EMAC_NCFGR_SPD ;
+    }
+    if ( dwFullduplex )
+    {
+        dwCfg |= EMAC_NCFGR_FD ;
+    }
+    pEmac->EMAC_NCFGR = dwCfg ;
+}
+
+/*----------------------------------------------------------------------------
+ *        EMAC Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the EMAC: clock, station address, frame filtering and
+ * transmit ring. The receiver stays off until EMAC_StartRx().
+ *
+ * \param pEmac          Pointer to the Emac instance.
+ * \param dwId           Peripheral ID of the EMAC.
+ * \param pucMacAddress  Station address (6 bytes).
+ * \param dwMode         EMAC_CAF_xxx | EMAC_NBC_xxx.
+ */
+extern void EMAC_Init( Emac* pEmac, uint32_t dwId, const uint8_t *pucMacAddress, uint32_t dwMode )
+{
+    uint32_t dwCfg ;
+    uint32_t i ;
+
+    PMC_EnablePeripheral( dwId ) ;
+
+    EMAC_Reset( pEmac ) ;
+    pEmac->EMAC_NCR |= EMAC_NCR_CLRSTAT ;
+    memset( &emacStats, 0, sizeof( emacStats ) ) ;
+
+    /* Station address: writing the top half enables the filter */
+    pEmac->EMAC_SA[0].EMAC_SAxB = pucMacAddress[0] | (pucMacAddress[1] << 8) | (pucMacAddress[2] << 16) | ((uint32_t)pucMacAddress[3] << 24) ;
+    pEmac->EMAC_SA[0].EMAC_SAxT = pucMacAddress[4] | (pucMacAddress[5] << 8) ;
+
+    /* The frames start EMAC_RX_OFFSET bytes into their first buffer, without FCS */
+    dwCfg = (pEmac->EMAC_NCFGR & EMAC_NCFGR_CLK_Msk) | EMAC_NCFGR_SPD | EMAC_NCFGR_FD
+          | EMAC_NCFGR_RBOF_OFFSET_2 | EMAC_NCFGR_DRFCS ;
+    if ( dwMode & EMAC_CAF_ENABLE )
+    {
+        dwCfg |= EMAC_NCFGR_CAF ;
+    }
+    if ( dwMode & EMAC_NBC_ENABLE )
+    {
+        dwCfg |= EMAC_NCFGR_NBC ;
+    }
+    pEmac->EMAC_NCFGR = dwCfg ;
+
+    /* Transmit descriptors owned by the software until a frame is queued */
+    for ( i = 0 ; i < TX_BUFFERS ; i++ )
+    {
+        txTd[i].addr = (uint32_t)txBuffer[i] ;
+        txTd[i].status = EMAC_TX_USED_BIT ;
+    }
+    txTd[TX_BUFFERS - 1].status |= EMAC_TX_WRAP_BIT ;
+    txHead = 0 ;
+    pEmac->EMAC_TBQP = (uint32_t)txTd ;
+    pEmac->EMAC_NCR |= EMAC_NCR_TE ;
+}
+
+/**
+ * \brief Stop the receiver and the transmitter, mask and clear the status.
+ */
+extern void EMAC_Reset( Emac* pEmac )
+{
+    pEmac->EMAC_NCR &= ~(EMAC_NCR_RE | EMAC_NCR_TE) ;
+    pEmac->EMAC_IDR = 0xFFFFFFFF ;
+    pEmac->EMAC_RSR = EMAC_RSR_OVR | EMAC_RSR_REC | EMAC_RSR_BNA ;
+    pEmac->EMAC_TSR = EMAC_TSR_UBR | EMAC_TSR_COL | EMAC_TSR_RLES | EMAC_TSR_BEX | EMAC_TSR_COMP | EMAC_TSR_UND ;
+    pEmac->EMAC_ISR ;
+}
+
+/**
+ * \brief Point the receiver at a ring of descriptors and enable it.
+ *
+ * \param pEmac  Pointer to the Emac instance.
+ * \param pRing  First descriptor, aligned on 8 bytes; the last one of the
+ *               ring has EMAC_RX_WRAP_BIT set.
+ */
+extern void EMAC_StartRx( Emac* pEmac, volatile EmacRxTDescriptor* pRing )
+{
+    assert( ((uint32_t)pRing & 7) == 0 ) ;
+
+    pEmac->EMAC_NCR &= ~EMAC_NCR_RE ;
+    pEmac->EMAC_RBQP = (uint32_t)pRing ;
+    pEmac->EMAC_NCR |= EMAC_NCR_RE ;
+}
+
+/**
+ * \brief Pause or resume the receiver. A frame being received when it is
+ * paused is dropped; the position in the ring (EMAC_RBQP) is kept.
+ *
+ * \param pEmac      Pointer to the Emac instance.
+ * \param dwEnabled  1 to resume, 0 to pause.
+ */
+extern void EMAC_SetRxEnabled( Emac* pEmac, uint32_t dwEnabled )
+{
+    if ( dwEnabled )
+    {
+        pEmac->EMAC_NCR |= EMAC_NCR_RE ;
+    }
+    else
+    {
+        pEmac->EMAC_NCR &= ~EMAC_NCR_RE ;
+    }
+}
+
+/**
+ * \brief Queue a frame for transmission.
+ *
+ * \param pEmac     Pointer to the Emac instance.
+ * \param pvBuffer  Frame, from the destination address to the payload (the
+ *                  EMAC appends the FCS); copied, so it can be reused on return.
+ * \param dwSize    Frame size in bytes.
+ * \return EMAC_TX_OK, EMAC_TX_BUFFER_BUSY if the transmit buffers are all in
+ * use, EMAC_TX_INVALID_PACKET if the frame is too large.
+ */
+extern uint32_t EMAC_Send( Emac* pEmac, const void *pvBuffer, uint32_t dwSize )
+{
+    volatile EmacTxTDescriptor* pTd = &txTd[txHead] ;
+    uint32_t dwStatus ;
+
+    if ( dwSize > EMAC_TX_UNITSIZE )
+    {
+        return EMAC_TX_INVALID_PACKET ;
+    }
+
+    _TxStatus( pEmac ) ;
+    if ( (pTd->status & EMAC_TX_USED_BIT) == 0 )
+    {
+        return EMAC_TX_BUFFER_BUSY ;
+    }
+
+    memcpy( txBuffer[txHead], pvBuffer, dwSize ) ;
+    dwStatus = (dwSize & EMAC_LENGTH_FRAME) | EMAC_TX_LAST_BUFFER_BIT ;
+    if ( txHead == TX_BUFFERS - 1 )
+    {
+        dwStatus |= EMAC_TX_WRAP_BIT ;
+    }
+    /* Clearing the used bit gives the descriptor to the EMAC */
+    pTd->status = dwStatus ;
+    txHead = (txHead + 1) % TX_BUFFERS ;
+    emacStats.tx_packets++ ;
+
+    pEmac->EMAC_NCR |= EMAC_NCR_TSTART ;
+
+    return EMAC_TX_OK ;
+}
+
+/**
+ * \brief Get the statistics of the EMAC.
+ *
+ * \param pEmac    Pointer to the Emac instance.
+ * \param pStats   Filled with the statistics.
+ * \param dwReset  1 to restart the statistics from 0.
+ */
+extern void EMAC_GetStatistics( Emac* pEmac, EmacStats *pStats, uint32_t dwReset )
+{
+    uint32_t dwRsr = pEmac->EMAC_RSR ;
+
+    _TxStatus( pEmac ) ;
+
+    /* The statistics registers are cleared when read */
+    emacStats.rx_packets += pEmac->EMAC_FRO ;
+    emacStats.rx_ovrs += pEmac->EMAC_ROV ;
+    emacStats.rx_bnas += pEmac->EMAC_RRE ;
+    pEmac->EMAC_RSR = dwRsr & (EMAC_RSR_OVR | EMAC_RSR_REC | EMAC_RSR_BNA) ;
+
+    *pStats = emacStats ;
+    if ( dwReset )
+    {
+        memset( &emacStats, 0, sizeof( emacStats ) ) ;
+    }
+}
@@ -241,7 +241,7 @@ void SMC_NFC_SendCommand(Smc* pSmc, uint32_t cmd, uint32_t addressCycle, uint32_
  * \brief Counts and return the number of bits set to '1' in the given byte.
  * \param byte  Byte to count.
  */
-static uint8_t ECC_CountBitsInByte(uint8_t byte)
+static RAMFUNC uint8_t ECC_CountBitsInByte(uint8_t byte)
 {
     uint8_t count = 0;
 
@@ -261,7 +261,7 @@ static uint8_t ECC_CountBitsInByte(uint8_t byte)
  * \brief Counts and return the number of bits set to '1' in the given hsiao code.
  * \param code  Hsiao code.
  */
-static uint8_t ECC_CountBitsInCode(uint8_t *code)
+static RAMFUNC uint8_t ECC_CountBitsInCode(uint8_t *code)
 {
     return ECC_CountBitsInByte(code[0])
            + ECC_CountBitsInByte(code[1])
@@ -357,7 +357,7 @@ uint8_t SMC_ECC_GetStatus(Smc* pSmc, uint8_t eccNumber)
  * \param originalCode  Original codes.
  * \param verifyCode  codes to be verified.
  */
-static uint8_t SMC_ECC_VerifyPageOf8bitHsiao(
+static RAMFUNC uint8_t SMC_ECC_VerifyPageOf8bitHsiao(
     uint8_t *data,
     const uint8_t *originalCode,
     const uint8_t *verifyCode)
@@ -421,7 +421,7 @@ static uint8_t SMC_ECC_VerifyPageOf8bitHsiao(
  * \param originalCode  Original codes.
  * \param verifyCode  codes to be verified.
  */
-static uint8_t SMC_ECC_Verify256x8bitHsiao(
+static RAMFUNC uint8_t SMC_ECC_Verify256x8bitHsiao(
     uint8_t *data,
     uint32_t size,
     const uint8_t *originalCode,
@@ -486,7 +486,7 @@ static uint8_t SMC_ECC_Verify256x8bitHsiao(
  * \param originalCode  Original codes.
  * \param verifyCode  codes to be verified.
  */
-static uint8_t SMC_ECC_Verify512x8bitHsiao(
+static RAMFUNC uint8_t SMC_ECC_Verify512x8bitHsiao(
     uint8_t *data,
     uint32_t size,
     const uint8_t *originalCode,
@@ -550,7 +550,7 @@ static uint8_t SMC_ECC_Verify512x8bitHsiao(
  * \param originalCode  Original codes.
  * \param verifyCode  codes to be verified.
  */
-static uint8_t SMC_ECC_VerifyPageOf16bitHsiao(
+static RAMFUNC uint8_t SMC_ECC_VerifyPageOf16bitHsiao(
     uint16_t *data,
     const uint8_t *originalCode,
     const uint8_t *verifyCode)
@@ -615,7 +615,7 @@ static uint8_t SMC_ECC_VerifyPageOf16bitHsiao(
  * \param originalCode  Original codes.
  * \param verifyCode  codes to be verified.
  */
-static uint8_t SMC_ECC_Verify256x16bitHsiao(
+static RAMFUNC uint8_t SMC_ECC_Verify256x16bitHsiao(
     uint16_t *data,
     uint32_t size,
     const uint8_t *originalCode,
@@ -683,7 +683,7 @@ static uint8_t SMC_ECC_Verify256x16bitHsiao(
  * block(s) have had a single bit corrected, or either Hsiao_ERROR_ECC
  * or Hsiao_ERROR_MULTIPLEBITS.
  */
-uint8_t SMC_ECC_VerifyHsiao(
+RAMFUNC uint8_t SMC_ECC_VerifyHsiao(
     uint8_t *data,
     uint32_t size,
     const uint8_t *originalCode,
@@ -733,7 +733,7 @@ uint8_t SMC_ECC_VerifyHsiao(
  * \param size  Data size in bytes.
  * \param code  Codes buffer.
  */
-static void SMC_ECC_Get24bitPerPageEcc(uint32_t pageDataSize, uint8_t *code)
+static RAMFUNC void SMC_ECC_Get24bitPerPageEcc(uint32_t pageDataSize, uint8_t *code)
 {
     uint32_t eccParity;
     uint32_t eccNparity;
@@ -767,7 +767,7 @@ static void SMC_ECC_Get24bitPerPageEcc(uint32_t pageDataSize, uint8_t *code)
  * \param size  Data size in bytes.
  * \param code  Codes buffer.
  */
-static void SMC_ECC_Get24bitPer256Ecc(uint32_t pageDataSize, uint8_t *code)
+static RAMFUNC void SMC_ECC_Get24bitPer256Ecc(uint32_t pageDataSize, uint8_t *code)
 {
     uint8_t i;
     uint8_t numEcc;
@@ -800,7 +800,7 @@ static void SMC_ECC_Get24bitPer256Ecc(uint32_t pageDataSize, uint8_t *code)
  * \param size  Data size in bytes.
  * \param code  Codes buffer.
  */
-static void SMC_ECC_Get24bitPer512Ecc(uint32_t pageDataSize, uint8_t *code)
+static RAMFUNC void SMC_ECC_Get24bitPer512Ecc(uint32_t pageDataSize, uint8_t *code)
 {
     uint8_t i;
     uint8_t numEcc;
@@ -833,7 +833,7 @@ static void SMC_ECC_Get24bitPer512Ecc(uint32_t pageDataSize, uint8_t *code)
  * \param size  Data size in bytes.
  * \param code  Codes buffer.
  */
-static void SMC_ECC_Get32bitPer256Ecc(uint32_t pageDataSize, uint8_t *code)
+static RAMFUNC void SMC_ECC_Get32bitPer256Ecc(uint32_t pageDataSize, uint8_t *code)
 {
     uint8_t i;
     uint8_t numEcc;
@@ -875,7 +875,7 @@ static void SMC_ECC_Get32bitPer256Ecc(uint32_t pageDataSize, uint8_t *code)
  * \param size  Data size in bytes.
  * \param code  Codes buffer.
  */
-static void SMC_ECC_Get32bitPerPageEcc(uint32_t pageDataSize, uint8_t *code)
+static RAMFUNC void SMC_ECC_Get32bitPerPageEcc(uint32_t pageDataSize, uint8_t *code)
 {
     uint32_t eccParity;
     uint32_t eccNparity;
@@ -910,7 +910,7 @@ static void SMC_ECC_Get32bitPerPageEcc(uint32_t pageDataSize, uint8_t *code)
  * \param code  Codes buffer.
  * \param dataPath 8bit/16bit data path.
  */
-void SMC_ECC_GetEccParity(uint32_t pageDataSize, uint8_t *code, uint8_t dataPath)
+RAMFUNC void SMC_ECC_GetEccParity(uint32_t pageDataSize, uint8_t *code, uint8_t dataPath)
 {
     uint8_t correctionType;
 
@@ -114,6 +114,16 @@ void USART_Configure(Usart *usart,
         usart->US_BRGR = (masterClock / baudrate) / 16;
     }
 
+    /* Asynchronous, 8x oversampling with the fractional divider: needed
+       above 460800 bauds (921600 bauds from 84MHz is 0.2% off) */
+    if ( ((mode & US_MR_SYNC) == 0) && ((mode & US_MR_OVER) == US_MR_OVER) )
+    {
+        /* Divider in 1/8 steps, rounded to the nearest */
+        uint32_t cd8 = (masterClock + (baudrate / 2)) / baudrate;
+
+        usart->US_BRGR = (cd8 >> 3) | US_BRGR_FP( cd8 & 7 );
+    }
+
     if( ((mode & US_MR_USART_MODE_SPI_MASTER) == US_MR_USART_MODE_SPI_MASTER)
      || ((mode & US_MR_SYNC) == US_MR_SYNC))
     {